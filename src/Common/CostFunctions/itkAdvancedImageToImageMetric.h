@@ -33,8 +33,14 @@
 // Needed for checking for B-spline for faster implementation
 #include "itkAdvancedBSplineDeformableTransform.h"
 #include "itkAdvancedCombinationTransform.h"
+#include "itkBSplineSampleWeightCache.h"
+#include "itkSampleTransformBuffer.h"
 
 #include "itkMultiThreader.h"
+#include "itkSampleBlockScheduler.h"
+#include "itkPersistentThreadPool.h"
+#include "itkSharedObjectCache.h"
+#include <vector>
 
 namespace itk
 {
@@ -162,6 +168,19 @@ public:
   typedef typename BSplineOrder1TransformType::Pointer                             BSplineOrder1TransformPointer;
   typedef typename BSplineOrder2TransformType::Pointer                             BSplineOrder2TransformPointer;
   typedef typename BSplineOrder3TransformType::Pointer                             BSplineOrder3TransformPointer;
+  typedef AdvancedBSplineDeformableTransformBase< ScalarType, FixedImageDimension > BSplineBaseTransformType;
+
+  /** Typedef for the cache of the initial transform outputs of the samples. */
+  typedef typename CombinationTransformType::InitialTransformType CombinationInitialTransformType;
+
+  /** Typedefs for the cache of the B-spline weights of the samples. */
+  typedef BSplineSampleWeightCache< ScalarType, FixedImageDimension > BSplineWeightCacheType;
+  typedef typename BSplineWeightCacheType::Pointer                    BSplineWeightCachePointer;
+
+  /** Typedefs for the buffer of transformed samples, shared by metrics. */
+  typedef SampleTransformBuffer<
+    ImageSampleContainerType, AdvancedTransformType > SampleTransformBufferType;
+  typedef typename SampleTransformBufferType::Pointer SampleTransformBufferPointer;
 
   /** Hessian type; for SelfHessian (experimental feature) */
   typedef typename DerivativeType::ValueType    HessianValueType;
@@ -170,6 +189,8 @@ public:
   /** Typedefs for multi-threading. */
   typedef itk::MultiThreader                      ThreaderType;
   typedef typename ThreaderType::ThreadInfoStruct ThreadInfoType;
+  typedef SampleBlockScheduler                    SampleBlockSchedulerType;
+  typedef SampleBlockSchedulerType::Pointer       SampleBlockSchedulerPointer;
 
   /** Public methods ********************/
 
@@ -272,12 +293,62 @@ public:
   itkGetConstReferenceMacro( UseMetricSingleThreaded, bool );
   itkBooleanMacro( UseMetricSingleThreaded );
 
+  /** Returns whether GetValueAndDerivative() may run concurrently with that
+   * of other metrics that share the transform, after a single-threaded call
+   * of BeforeThreadedGetValueAndDerivative() with UseMetricSingleThreaded on.
+   * Metrics that do all their thread-unsafe work in that function override
+   * this to return true. Used by the CombinationImageToImageMetric.
+   */
+  virtual bool GetSupportsConcurrentEvaluation( void ) const
+  {
+    return false;
+  }
+
   /** Select the use of multi-threading*/
   // \todo: maybe these can be united, check base class.
   itkSetMacro( UseMultiThread, bool );
   itkGetConstReferenceMacro( UseMultiThread, bool );
   itkBooleanMacro( UseMultiThread );
 
+  /** Set/Get the scheduler that distributes the samples over the threads
+   * in the threaded metric computations. By default a static scheduler
+   * is used, which gives each thread one contiguous chunk of samples.
+   * Select a work-stealing scheduler for better load balancing.
+   */
+  itkSetObjectMacro( SampleBlockScheduler, SampleBlockSchedulerType );
+  itkGetObjectMacro( SampleBlockScheduler, SampleBlockSchedulerType );
+
+  /** Switch the caching of the B-spline support indices and weights of the
+   * samples on or off. Only effective when the transform is a B-spline
+   * transform without initial transform, and for metrics that pass the
+   * sample numbers to TransformPointOfSample(). Worthwhile when the same
+   * samples are used in every iteration. Default: false.
+   */
+  itkSetMacro( UseBSplineWeightCache, bool );
+  itkGetConstMacro( UseBSplineWeightCache, bool );
+  itkBooleanMacro( UseBSplineWeightCache );
+
+  /** Get the B-spline weight cache, for example to set its memory limit
+   * or to inspect its hit rate.
+   */
+  itkGetObjectMacro( BSplineWeightCache, BSplineWeightCacheType );
+
+  /** Set/Get a buffer with the transformed samples, which is filled by
+   * another object, such as the CombinationImageToImageMetric. It is only
+   * used in the threaded loops in which it is valid for the samples and the
+   * transform of this metric, and for metrics that pass the sample numbers
+   * to TransformPointOfSample(). Default: NULL.
+   */
+  itkSetObjectMacro( SampleTransformBuffer, SampleTransformBufferType );
+  itkGetObjectMacro( SampleTransformBuffer, SampleTransformBufferType );
+
+  /** Set/Get the cache in which the fixed image extrema are shared with
+   * other registrations to the same fixed image. With a fixed mask, only
+   * image masks (ImageMaskSpatialObject2) are supported. Default: NULL.
+   */
+  itkSetObjectMacro( FixedSideCache, SharedObjectCache );
+  itkGetObjectMacro( FixedSideCache, SharedObjectCache );
+
   /** Contains calls from GetValueAndDerivative that are thread-unsafe,
    * together with preparation for multi-threading.
    * Note that the only reason why this function is not protected, is
@@ -396,10 +467,96 @@ protected:
   /** AccumulateDerivatives threader callback function. */
   static ITK_THREAD_RETURN_TYPE AccumulateDerivativesThreaderCallback( void * arg );
 
+  /** Prepare the sample block scheduler for a threaded loop over the
+   * samples of the image sampler. Called before launching the threads.
+   */
+  virtual void InitializeSampleBlockScheduler( void ) const;
+
+  /** Deactivate the caches and the shared buffer that were prepared by
+   * InitializeSampleBlockScheduler(). Called after the threads finished.
+   */
+  virtual void FinalizeSampleBlockScheduler( void ) const;
+
+  /** Get the next range [ pos_begin, pos_end [ of samples to be processed
+   * by this thread. Returns false when no samples are left. The threaded
+   * functions should loop until this function returns false.
+   */
+  bool GetNextSampleBlock( ThreadIdType threadId,
+    SizeValueType & pos_begin, SizeValueType & pos_end ) const;
+
+  /** Prepare the B-spline weight cache for a threaded loop over the samples.
+   * Called by InitializeSampleBlockScheduler().
+   */
+  virtual void InitializeBSplineWeightCache( void ) const;
+
+  /** Prepare the initial transform cache for a threaded loop over the
+   * samples, when the transform is a composition with an initial transform
+   * that allows it. The entries are kept when the sample container and the
+   * initial transform did not change, and are otherwise computed on first
+   * use in the threaded loop. Called by InitializeSampleBlockScheduler().
+   */
+  virtual void InitializeInitialTransformCache( void ) const;
+
+  /** Get the output of the initial transform for sample sampleId, from the
+   * initial transform cache. It is computed on the first request.
+   */
+  const FixedImagePointType & GetInitialTransformOutputOfSample(
+    SizeValueType sampleId, const FixedImagePointType & fixedImagePoint ) const;
+
+  /** Transform the fixed point of sample sampleId, using the shared sample
+   * transform buffer, the B-spline weight cache, or the initial transform
+   * cache when active. Otherwise, TransformPoint() is called.
+   */
+  bool TransformPointOfSample( ThreadIdType threadId, SizeValueType sampleId,
+    const FixedImagePointType & fixedImagePoint,
+    MovingImagePointType & mappedPoint ) const;
+
+  /** Compute the inner product of the transform Jacobian of sample sampleId
+   * with the moving image gradient, using the B-spline weights of the shared
+   * sample transform buffer or the weight cache, or the initial transform
+   * cache. Returns false, without computing anything, when none of them
+   * is active for this sample.
+   */
+  bool EvaluateTransformJacobianInnerProductOfSample(
+    ThreadIdType threadId, SizeValueType sampleId,
+    const FixedImagePointType & fixedImagePoint,
+    const MovingImageDerivativeType & movingImageDerivative,
+    DerivativeType & imageJacobian,
+    NonZeroJacobianIndicesType & nzji ) const;
+
   /** Variables for multi-threading. */
-  bool m_UseMetricSingleThreaded;
-  bool m_UseMultiThread;
-  bool m_UseOpenMP;
+  bool                        m_UseMetricSingleThreaded;
+  bool                        m_UseMultiThread;
+  bool                        m_UseOpenMP;
+  SampleBlockSchedulerPointer m_SampleBlockScheduler;
+
+  /** Variables for the B-spline weight cache. The transform is only set
+   * during the threaded loops in which the cache is active.
+   */
+  bool                                     m_UseBSplineWeightCache;
+  BSplineWeightCachePointer                m_BSplineWeightCache;
+  mutable const BSplineBaseTransformType * m_BSplineWeightCacheTransform;
+
+  /** Variables for the initial transform cache: the outputs of the initial
+   * transform for the samples of this metric, and their key. The transform
+   * is only set during the threaded loops in which the cache is active.
+   */
+  mutable std::vector< FixedImagePointType >      m_InitialTransformCache;
+  mutable std::vector< unsigned char >            m_InitialTransformCacheStates;
+  mutable const DataObject *                      m_InitialTransformCacheSampleContainer;
+  mutable ModifiedTimeType                        m_InitialTransformCacheSampleContainerTime;
+  mutable const CombinationInitialTransformType * m_InitialTransformCacheInitialTransform;
+  mutable ModifiedTimeType                        m_InitialTransformCacheInitialTransformTime;
+  mutable const CombinationTransformType *        m_InitialTransformCacheTransform;
+
+  /** The shared buffer of transformed samples. The active pointer is only
+   * set during the threaded loops in which the buffer is valid.
+   */
+  SampleTransformBufferPointer              m_SampleTransformBuffer;
+  mutable const SampleTransformBufferType * m_ActiveSampleTransformBuffer;
+
+  /** The cache of the fixed-side results, or NULL. */
+  SharedObjectCache::Pointer m_FixedSideCache;
 
   /** Helper structs that multi-threads the computation of
    * the metric derivative using ITK threads.
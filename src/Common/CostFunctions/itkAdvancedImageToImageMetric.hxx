@@ -23,6 +23,9 @@
 #include "itkImageRegionConstIterator.h"          // used for extrema computation
 #include "itkImageRegionConstIteratorWithIndex.h" // used for extrema computation
 #include "itkAdvancedRayCastInterpolateImageFunction.h"
+#include "itkImageMaskSpatialObject2.h"
+#include "itkSimpleDataObjectDecorator.h"
+#include <algorithm>
 
 #ifdef ELASTIX_USE_OPENMP
 #include <omp.h>
@@ -101,6 +104,25 @@ AdvancedImageToImageMetric< TFixedImage, TMovingImage >
   /** Initialize the m_ThreaderMetricParameters. */
   this->m_ThreaderMetricParameters.st_Metric = this;
 
+  /** By default the samples are statically divided over the threads. */
+  this->m_SampleBlockScheduler = SampleBlockSchedulerType::New();
+
+  /** The B-spline weight cache is off by default. */
+  this->m_UseBSplineWeightCache       = false;
+  this->m_BSplineWeightCache          = BSplineWeightCacheType::New();
+  this->m_BSplineWeightCacheTransform = NULL;
+  this->m_ActiveSampleTransformBuffer = NULL;
+
+  /** The initial transform cache is empty. */
+  this->m_InitialTransformCacheSampleContainer      = NULL;
+  this->m_InitialTransformCacheSampleContainerTime  = 0;
+  this->m_InitialTransformCacheInitialTransform     = NULL;
+  this->m_InitialTransformCacheInitialTransformTime = 0;
+  this->m_InitialTransformCacheTransform            = NULL;
+
+  /** Fixed-side results are not shared by default. */
+  this->m_FixedSideCache = 0;
+
   // Multi-threading structs
   this->m_GetValuePerThreadVariables                  = NULL;
   this->m_GetValuePerThreadVariablesSize              = 0;
@@ -245,8 +267,37 @@ AdvancedImageToImageMetric< TFixedImage, TMovingImage >
   FixedImagePixelType trueMinTemp = NumericTraits< FixedImagePixelType >::max();
   FixedImagePixelType trueMaxTemp = NumericTraits< FixedImagePixelType >::NonpositiveMin();
 
+  /** The extrema depend on the image, the region and the mask only, so
+   * registrations to the same fixed image may share them. Masks that are
+   * not image masks cannot be identified, and are not shared.
+   */
+  typedef FixedArray< FixedImagePixelType, 2 >          ExtremaType;
+  typedef SimpleDataObjectDecorator< ExtremaType >      ExtremaObjectType;
+  typedef ImageMaskSpatialObject2< FixedImageDimension > FixedImageMaskSpatialObjectType;
+  const FixedImageMaskSpatialObjectType * imageMask
+    = dynamic_cast< const FixedImageMaskSpatialObjectType * >( this->m_FixedImageMask.GetPointer() );
+  const bool useCache = this->m_FixedSideCache.IsNotNull()
+    && ( this->m_FixedImageMask.IsNull() || imageMask != 0 );
+  std::ostringstream             key;
+  SharedObjectCache::Reservation reservation;
+  const ExtremaObjectType *      cachedExtrema = 0;
+  if( useCache )
+  {
+    key << "FixedImageExtrema";
+    SharedObjectCache::AppendToKey( key, image );
+    key << " " << region.GetIndex() << " " << region.GetSize();
+    SharedObjectCache::AppendToKey( key, imageMask ? imageMask->GetImage() : 0 );
+    cachedExtrema = dynamic_cast< const ExtremaObjectType * >(
+      this->m_FixedSideCache->FindOrReserve( key.str(), reservation ) );
+  }
+
+  if( cachedExtrema )
+  {
+    trueMinTemp = cachedExtrema->Get()[ 0 ];
+    trueMaxTemp = cachedExtrema->Get()[ 1 ];
+  }
   /** If no mask. */
-  if( this->m_FixedImageMask.IsNull() )
+  else if( this->m_FixedImageMask.IsNull() )
   {
     typedef ImageRegionConstIterator< FixedImageType > IteratorType;
     IteratorType it( image, region );
@@ -279,6 +330,17 @@ AdvancedImageToImageMetric< TFixedImage, TMovingImage >
     }
   }
 
+  /** Share the extrema. */
+  if( reservation.IsActive() )
+  {
+    ExtremaType extrema;
+    extrema[ 0 ] = trueMinTemp;
+    extrema[ 1 ] = trueMaxTemp;
+    typename ExtremaObjectType::Pointer extremaObject = ExtremaObjectType::New();
+    extremaObject->Set( extrema );
+    reservation.Insert( extremaObject );
+  }
+
   /** Update member variables. */
   this->m_FixedImageTrueMin = trueMinTemp;
   this->m_FixedImageTrueMax = trueMaxTemp;
@@ -950,12 +1012,14 @@ void
 AdvancedImageToImageMetric< TFixedImage, TMovingImage >
 ::LaunchGetValueThreaderCallback( void ) const
 {
-  /** Setup threader. */
-  this->m_Threader->SetSingleMethod( this->GetValueThreaderCallback,
-    const_cast< void * >( static_cast< const void * >( &this->m_ThreaderMetricParameters ) ) );
+  /** Divide the samples over the threads. */
+  this->InitializeSampleBlockScheduler();
 
-  /** Launch. */
-  this->m_Threader->SingleMethodExecute();
+  /** Launch, on the shared thread pool when available. */
+  PersistentThreadPool::SingleMethodExecute( this->m_Threader,
+    this->GetValueThreaderCallback,
+    const_cast< void * >( static_cast< const void * >( &this->m_ThreaderMetricParameters ) ) );
+  this->FinalizeSampleBlockScheduler();
 
 } // end LaunchGetValueThreaderCallback()
 
@@ -991,16 +1055,317 @@ void
 AdvancedImageToImageMetric< TFixedImage, TMovingImage >
 ::LaunchGetValueAndDerivativeThreaderCallback( void ) const
 {
-  /** Setup threader. */
-  this->m_Threader->SetSingleMethod( this->GetValueAndDerivativeThreaderCallback,
-    const_cast< void * >( static_cast< const void * >( &this->m_ThreaderMetricParameters ) ) );
+  /** Divide the samples over the threads. */
+  this->InitializeSampleBlockScheduler();
 
-  /** Launch. */
-  this->m_Threader->SingleMethodExecute();
+  /** Launch, on the shared thread pool when available. */
+  PersistentThreadPool::SingleMethodExecute( this->m_Threader,
+    this->GetValueAndDerivativeThreaderCallback,
+    const_cast< void * >( static_cast< const void * >( &this->m_ThreaderMetricParameters ) ) );
+  this->FinalizeSampleBlockScheduler();
 
 } // end LaunchGetValueAndDerivativeThreaderCallback()
 
 
+/**
+ * *********************** InitializeSampleBlockScheduler ***************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::InitializeSampleBlockScheduler( void ) const
+{
+  /** Metrics without a sampler do not use the scheduler. */
+  SizeValueType numberOfSamples = 0;
+  if( this->m_UseImageSampler && this->m_ImageSampler.IsNotNull() )
+  {
+    numberOfSamples = this->m_ImageSampler->GetOutput()->Size();
+  }
+
+  this->m_SampleBlockScheduler->Initialize( numberOfSamples, this->m_NumberOfThreads );
+
+  /** The weight cache and the shared buffer are indexed by the same
+   * sample numbers.
+   */
+  this->InitializeBSplineWeightCache();
+  this->InitializeInitialTransformCache();
+  this->m_ActiveSampleTransformBuffer = NULL;
+  if( this->m_SampleTransformBuffer.IsNotNull() && numberOfSamples > 0
+    && this->m_SampleTransformBuffer->IsValidFor( this->m_AdvancedTransform.GetPointer(),
+    this->m_ImageSampler->GetOutput() ) )
+  {
+    this->m_ActiveSampleTransformBuffer = this->m_SampleTransformBuffer.GetPointer();
+  }
+
+} // end InitializeSampleBlockScheduler()
+
+
+/**
+ * *********************** FinalizeSampleBlockScheduler ***************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::FinalizeSampleBlockScheduler( void ) const
+{
+  this->m_BSplineWeightCacheTransform    = NULL;
+  this->m_InitialTransformCacheTransform = NULL;
+  this->m_ActiveSampleTransformBuffer    = NULL;
+
+} // end FinalizeSampleBlockScheduler()
+
+
+/**
+ * *********************** GetNextSampleBlock ***************
+ */
+
+template< class TFixedImage, class TMovingImage >
+bool
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::GetNextSampleBlock( ThreadIdType threadId,
+  SizeValueType & pos_begin, SizeValueType & pos_end ) const
+{
+  return this->m_SampleBlockScheduler->GetNextBlock( threadId, pos_begin, pos_end );
+
+} // end GetNextSampleBlock()
+
+
+/**
+ * *********************** InitializeBSplineWeightCache ***************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::InitializeBSplineWeightCache( void ) const
+{
+  this->m_BSplineWeightCacheTransform = NULL;
+  if( !this->m_UseBSplineWeightCache || !this->m_UseImageSampler
+    || this->m_ImageSampler.IsNull() || this->m_AdvancedTransform.IsNull() )
+  {
+    return;
+  }
+
+  /** Only a B-spline transform without initial transform is supported,
+   * because only then the weights do not depend on the parameters.
+   */
+  const AdvancedTransformType *    transform = this->m_AdvancedTransform.GetPointer();
+  const CombinationTransformType * combo
+    = dynamic_cast< const CombinationTransformType * >( transform );
+  if( combo )
+  {
+    if( combo->GetInitialTransform() ) { return; }
+    transform = combo->GetCurrentTransform();
+  }
+  const BSplineBaseTransformType * bspline
+    = dynamic_cast< const BSplineBaseTransformType * >( transform );
+  if( !bspline || !bspline->GetSupportsPrecomputedWeights() )
+  {
+    return;
+  }
+
+  /** Activate the cache for this threaded loop. */
+  const ImageSampleContainerType * sampleContainer = this->m_ImageSampler->GetOutput();
+  this->m_BSplineWeightCache->Initialize( bspline, sampleContainer,
+    sampleContainer->Size(), this->m_NumberOfThreads );
+  this->m_BSplineWeightCacheTransform = bspline;
+
+} // end InitializeBSplineWeightCache()
+
+
+/**
+ * *********************** InitializeInitialTransformCache ***************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::InitializeInitialTransformCache( void ) const
+{
+  this->m_InitialTransformCacheTransform = NULL;
+  if( !this->m_UseImageSampler || this->m_ImageSampler.IsNull()
+    || this->m_AdvancedTransform.IsNull() )
+  {
+    return;
+  }
+
+  /** Only a composition with an initial transform benefits from the cache. */
+  const CombinationTransformType * combo
+    = dynamic_cast< const CombinationTransformType * >( this->m_AdvancedTransform.GetPointer() );
+  if( !combo || !combo->GetUseInitialTransformCache()
+    || !combo->GetUseComposition() || !combo->GetInitialTransform()
+    || !combo->GetCurrentTransform() )
+  {
+    return;
+  }
+
+  /** The entries are cleared when the samples of this metric or the initial
+   * transform changed. They are computed on first use in the threaded loop.
+   */
+  const ImageSampleContainerType *        sampleContainer  = this->m_ImageSampler->GetOutput();
+  const SizeValueType                     numberOfSamples  = sampleContainer->Size();
+  const CombinationInitialTransformType * initialTransform = combo->GetInitialTransform();
+  const ModifiedTimeType                  sampleContainerTime
+    = std::max( sampleContainer->GetMTime(), sampleContainer->GetUpdateMTime() );
+  if( sampleContainer != this->m_InitialTransformCacheSampleContainer
+    || sampleContainerTime != this->m_InitialTransformCacheSampleContainerTime
+    || initialTransform != this->m_InitialTransformCacheInitialTransform
+    || initialTransform->GetMTime() != this->m_InitialTransformCacheInitialTransformTime
+    || numberOfSamples != this->m_InitialTransformCacheStates.size() )
+  {
+    this->m_InitialTransformCache.resize( numberOfSamples );
+    this->m_InitialTransformCacheStates.assign( numberOfSamples, 0 );
+    this->m_InitialTransformCacheSampleContainer      = sampleContainer;
+    this->m_InitialTransformCacheSampleContainerTime  = sampleContainerTime;
+    this->m_InitialTransformCacheInitialTransform     = initialTransform;
+    this->m_InitialTransformCacheInitialTransformTime = initialTransform->GetMTime();
+  }
+  this->m_InitialTransformCacheTransform = combo;
+
+} // end InitializeInitialTransformCache()
+
+
+/**
+ * *********************** GetInitialTransformOutputOfSample ***************
+ */
+
+template< class TFixedImage, class TMovingImage >
+const typename AdvancedImageToImageMetric< TFixedImage, TMovingImage >::FixedImagePointType &
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::GetInitialTransformOutputOfSample( SizeValueType sampleId,
+  const FixedImagePointType & fixedImagePoint ) const
+{
+  /** Each sample is handled by a single thread, so no locking is needed. */
+  if( !this->m_InitialTransformCacheStates[ sampleId ] )
+  {
+    this->m_InitialTransformCache[ sampleId ]
+      = this->m_InitialTransformCacheInitialTransform->TransformPoint( fixedImagePoint );
+    this->m_InitialTransformCacheStates[ sampleId ] = 1;
+  }
+  return this->m_InitialTransformCache[ sampleId ];
+
+} // end GetInitialTransformOutputOfSample()
+
+
+/**
+ * *********************** TransformPointOfSample ***************
+ */
+
+template< class TFixedImage, class TMovingImage >
+bool
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::TransformPointOfSample( ThreadIdType threadId, SizeValueType sampleId,
+  const FixedImagePointType & fixedImagePoint,
+  MovingImagePointType & mappedPoint ) const
+{
+  /** The point was already transformed for another metric. */
+  if( this->m_ActiveSampleTransformBuffer )
+  {
+    mappedPoint = this->m_ActiveSampleTransformBuffer->GetMappedPoint( sampleId );
+    return true;
+  }
+
+  /** Only the current transform is evaluated for the cached points. */
+  if( this->m_InitialTransformCacheTransform )
+  {
+    mappedPoint = this->m_InitialTransformCacheTransform->GetCurrentTransform()->TransformPoint(
+      this->GetInitialTransformOutputOfSample( sampleId, fixedImagePoint ) );
+    return true;
+  }
+
+  if( !this->m_BSplineWeightCacheTransform )
+  {
+    return this->TransformPoint( fixedImagePoint, mappedPoint );
+  }
+
+  /** Outside the valid region the B-spline is the identity. */
+  typename BSplineBaseTransformType::IndexType supportIndex;
+  const ScalarType *                           weights = NULL;
+  if( this->m_BSplineWeightCache->GetSupportIndexAndWeights(
+    threadId, sampleId, fixedImagePoint, supportIndex, weights ) )
+  {
+    this->m_BSplineWeightCacheTransform->TransformPointUsingWeights(
+      fixedImagePoint, supportIndex, weights, mappedPoint );
+  }
+  else
+  {
+    mappedPoint = fixedImagePoint;
+  }
+
+  /** For future use: return whether the sample is valid */
+  const bool valid = true;
+  return valid;
+
+} // end TransformPointOfSample()
+
+
+/**
+ * *********************** EvaluateTransformJacobianInnerProductOfSample ***************
+ */
+
+template< class TFixedImage, class TMovingImage >
+bool
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::EvaluateTransformJacobianInnerProductOfSample(
+  ThreadIdType threadId, SizeValueType sampleId,
+  const FixedImagePointType & fixedImagePoint,
+  const MovingImageDerivativeType & movingImageDerivative,
+  DerivativeType & imageJacobian,
+  NonZeroJacobianIndicesType & nzji ) const
+{
+  /** Get the weights from the shared buffer, or else from the cache. */
+  const BSplineBaseTransformType *             bspline = NULL;
+  typename BSplineBaseTransformType::IndexType supportIndex;
+  const ScalarType *                           weights = NULL;
+  bool                                         inside  = false;
+  if( this->m_ActiveSampleTransformBuffer
+    && this->m_ActiveSampleTransformBuffer->HasWeights( sampleId ) )
+  {
+    bspline = this->m_ActiveSampleTransformBuffer->GetBSplineTransform();
+    inside  = this->m_ActiveSampleTransformBuffer->GetSupportIndexAndWeights(
+      sampleId, supportIndex, weights );
+  }
+  else if( this->m_BSplineWeightCacheTransform )
+  {
+    bspline = this->m_BSplineWeightCacheTransform;
+    inside  = this->m_BSplineWeightCache->GetSupportIndexAndWeights(
+      threadId, sampleId, fixedImagePoint, supportIndex, weights );
+  }
+  else if( this->m_InitialTransformCacheTransform )
+  {
+    this->m_InitialTransformCacheTransform->GetCurrentTransform()->EvaluateJacobianWithImageGradientProduct(
+      this->GetInitialTransformOutputOfSample( sampleId, fixedImagePoint ),
+      movingImageDerivative, imageJacobian, nzji );
+    return true;
+  }
+  else
+  {
+    return false;
+  }
+
+  /** Outside the valid region the Jacobian is zero. */
+  if( inside )
+  {
+    bspline->EvaluateJacobianWithImageGradientProductUsingWeights(
+      supportIndex, weights, movingImageDerivative, imageJacobian, nzji );
+  }
+  else
+  {
+    const NumberOfParametersType nnzji = bspline->GetNumberOfNonZeroJacobianIndices();
+    nzji.resize( nnzji );
+    for( NumberOfParametersType i = 0; i < nnzji; ++i )
+    {
+      nzji[ i ] = i;
+    }
+    imageJacobian.Fill( 0.0 );
+  }
+  return true;
+
+} // end EvaluateTransformJacobianInnerProductOfSample()
+
+
 /**
  *********** AccumulateDerivativesThreaderCallback *************
  */
@@ -1085,6 +1450,14 @@ AdvancedImageToImageMetric< TFixedImage, TMovingImage >
      << this->m_ImageSampler.GetPointer() << std::endl;
   os << indent.GetNextIndent() << "UseImageSampler: "
      << this->m_UseImageSampler << std::endl;
+  os << indent.GetNextIndent() << "SampleBlockScheduler: "
+     << this->m_SampleBlockScheduler.GetPointer() << std::endl;
+  os << indent.GetNextIndent() << "UseBSplineWeightCache: "
+     << this->m_UseBSplineWeightCache << std::endl;
+  os << indent.GetNextIndent() << "BSplineWeightCache: "
+     << this->m_BSplineWeightCache.GetPointer() << std::endl;
+  os << indent.GetNextIndent() << "SampleTransformBuffer: "
+     << this->m_SampleTransformBuffer.GetPointer() << std::endl;
 
   /** Variables for the Limiters. */
   os << indent << "Variables related to the Limiters: " << std::endl;
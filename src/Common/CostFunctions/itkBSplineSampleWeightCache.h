@@ -0,0 +1,181 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkBSplineSampleWeightCache_h
+#define __itkBSplineSampleWeightCache_h
+
+#include "itkObject.h"
+#include "itkObjectFactory.h"
+#include "itkDataObject.h"
+#include "itkAdvancedBSplineDeformableTransformBase.h"
+#include <vector>
+
+namespace itk
+{
+
+/** \class BSplineSampleWeightCache
+ *
+ * \brief Stores the B-spline support index and interpolation weights of
+ * each sample of a metric.
+ *
+ * The support region and the weights of a sample only depend on the
+ * fixed image point and on the B-spline grid, not on the parameters.
+ * When a metric uses the same samples in every iteration, for example
+ * with the ImageFullSampler, the ImageGridSampler, or a random sampler
+ * without NewSamplesEveryIteration, they can be computed once and reused.
+ *
+ * The entries are stored in one contiguous arena, indexed by the sample
+ * number. The size of the arena is limited by MaximumMemorySize; samples
+ * that do not fit are computed every time, in a per-thread buffer. The
+ * cache is cleared automatically in Initialize() when the sample container
+ * or the B-spline grid changed.
+ *
+ * GetSupportIndexAndWeights() is thread-safe as long as each sample is
+ * handled by a single thread during a threaded loop, which is guaranteed
+ * by the SampleBlockScheduler.
+ *
+ * \ingroup RegistrationMetrics
+ */
+
+template< class TScalarType, unsigned int NDimensions >
+class BSplineSampleWeightCache : public Object
+{
+public:
+
+  /** Standard class typedefs. */
+  typedef BSplineSampleWeightCache   Self;
+  typedef Object                     Superclass;
+  typedef SmartPointer< Self >       Pointer;
+  typedef SmartPointer< const Self > ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( BSplineSampleWeightCache, Object );
+
+  /** Typedefs. */
+  typedef TScalarType ScalarType;
+  typedef AdvancedBSplineDeformableTransformBase<
+    ScalarType, NDimensions >                           BSplineTransformType;
+  typedef typename BSplineTransformType::InputPointType InputPointType;
+  typedef typename BSplineTransformType::IndexType      IndexType;
+  typedef typename BSplineTransformType::RegionType     RegionType;
+  typedef typename BSplineTransformType::SpacingType    SpacingType;
+  typedef typename BSplineTransformType::OriginType     OriginType;
+  typedef typename BSplineTransformType::DirectionType  DirectionType;
+
+  /** Set/Get the maximum size of the arena, in bytes. Default: 256 MB. */
+  itkSetMacro( MaximumMemorySize, SizeValueType );
+  itkGetConstMacro( MaximumMemorySize, SizeValueType );
+
+  /** Prepare the cache for a threaded loop over numberOfSamples samples.
+   * The cached entries are kept when the transform, its grid and the
+   * sample container are the same as in the previous call. Not thread-safe;
+   * call this before launching the threads.
+   */
+  void Initialize( const BSplineTransformType * transform,
+    const DataObject * sampleContainer, SizeValueType numberOfSamples,
+    ThreadIdType numberOfThreads );
+
+  /** Get the support index and the weights of sample sampleId at point.
+   * They are computed and stored on the first request. Returns false when
+   * the support region is not inside the grid. The weights pointer stays
+   * valid until the next call from the same thread.
+   */
+  bool GetSupportIndexAndWeights( ThreadIdType threadId,
+    SizeValueType sampleId, const InputPointType & point,
+    IndexType & supportIndex, const ScalarType * & weights );
+
+  /** Remove all entries. */
+  void Clear( void );
+
+  /** Get the number of samples that fit in the arena. */
+  itkGetConstMacro( Capacity, SizeValueType );
+
+  /** Get the number of lookups that were served from the cache, and the
+   * number of lookups that needed a computation, since the last Clear().
+   */
+  SizeValueType GetNumberOfHits( void ) const;
+  SizeValueType GetNumberOfMisses( void ) const;
+
+  /** Get the ratio of hits over all lookups since the last Clear(). */
+  double GetHitRate( void ) const;
+
+protected:
+
+  BSplineSampleWeightCache();
+  virtual ~BSplineSampleWeightCache();
+
+  /** PrintSelf. */
+  void PrintSelf( std::ostream & os, Indent indent ) const;
+
+private:
+
+  BSplineSampleWeightCache( const Self & ); // purposely not implemented
+  void operator=( const Self & );           // purposely not implemented
+
+  /** The state of an entry. */
+  enum { Empty = 0, Inside = 1, Outside = 2 };
+
+  /** Per-thread counters and scratch buffer, padded to avoid false sharing. */
+  struct ThreadStruct
+  {
+    SizeValueType             st_NumberOfHits;
+    SizeValueType             st_NumberOfMisses;
+    std::vector< ScalarType > st_Weights;
+  };
+  itkPadStruct( ITK_CACHE_LINE_ALIGNMENT, ThreadStruct,
+    PaddedThreadStruct );
+  itkAlignedTypedef( ITK_CACHE_LINE_ALIGNMENT, PaddedThreadStruct,
+    AlignedThreadStruct );
+
+  /** The arena: for entry i, the weights are stored at
+   * m_Weights[ i * m_NumberOfWeights ].
+   */
+  std::vector< ScalarType >    m_Weights;
+  std::vector< IndexType >     m_SupportIndices;
+  std::vector< unsigned char > m_States;
+
+  AlignedThreadStruct * m_ThreadData;
+  ThreadIdType          m_ThreadDataSize;
+  SizeValueType         m_NumberOfHits;
+  SizeValueType         m_NumberOfMisses;
+
+  SizeValueType m_MaximumMemorySize;
+  SizeValueType m_Capacity;
+  SizeValueType m_NumberOfWeights;
+
+  /** The key of the cached entries. */
+  const BSplineTransformType * m_Transform;
+  const DataObject *           m_SampleContainer;
+  ModifiedTimeType             m_SampleContainerTime;
+  SizeValueType                m_NumberOfSamples;
+  RegionType                   m_GridRegion;
+  SpacingType                  m_GridSpacing;
+  OriginType                   m_GridOrigin;
+  DirectionType                m_GridDirection;
+
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkBSplineSampleWeightCache.hxx"
+#endif
+
+#endif // end #ifndef __itkBSplineSampleWeightCache_h
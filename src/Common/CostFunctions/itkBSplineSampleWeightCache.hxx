@@ -0,0 +1,289 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkBSplineSampleWeightCache_hxx
+#define __itkBSplineSampleWeightCache_hxx
+
+#include "itkBSplineSampleWeightCache.h"
+#include <algorithm>
+
+namespace itk
+{
+
+/**
+ * ****************** Constructor *********************************
+ */
+
+template< class TScalarType, unsigned int NDimensions >
+BSplineSampleWeightCache< TScalarType, NDimensions >
+::BSplineSampleWeightCache()
+{
+  this->m_ThreadData          = NULL;
+  this->m_ThreadDataSize      = 0;
+  this->m_NumberOfHits        = 0;
+  this->m_NumberOfMisses      = 0;
+  this->m_MaximumMemorySize   = 256 * 1024 * 1024;
+  this->m_Capacity            = 0;
+  this->m_NumberOfWeights     = 0;
+  this->m_Transform           = NULL;
+  this->m_SampleContainer     = NULL;
+  this->m_SampleContainerTime = 0;
+  this->m_NumberOfSamples     = 0;
+
+} // end Constructor
+
+
+/**
+ * ****************** Destructor *********************************
+ */
+
+template< class TScalarType, unsigned int NDimensions >
+BSplineSampleWeightCache< TScalarType, NDimensions >
+::~BSplineSampleWeightCache()
+{
+  delete[] this->m_ThreadData;
+
+} // end Destructor
+
+
+/**
+ * ****************** Initialize *********************************
+ */
+
+template< class TScalarType, unsigned int NDimensions >
+void
+BSplineSampleWeightCache< TScalarType, NDimensions >
+::Initialize( const BSplineTransformType * transform,
+  const DataObject * sampleContainer, SizeValueType numberOfSamples,
+  ThreadIdType numberOfThreads )
+{
+  if( numberOfThreads == 0 ) { numberOfThreads = 1; }
+  const SizeValueType numberOfWeights = transform->GetNumberOfAffectedWeights();
+
+  /** Collect the counters of the previous loop. */
+  for( ThreadIdType i = 0; i < this->m_ThreadDataSize; ++i )
+  {
+    this->m_NumberOfHits   += this->m_ThreadData[ i ].st_NumberOfHits;
+    this->m_NumberOfMisses += this->m_ThreadData[ i ].st_NumberOfMisses;
+    this->m_ThreadData[ i ].st_NumberOfHits   = 0;
+    this->m_ThreadData[ i ].st_NumberOfMisses = 0;
+  }
+
+  /** Only reallocate the per-thread data when the number of threads changed. */
+  if( this->m_ThreadDataSize != numberOfThreads )
+  {
+    delete[] this->m_ThreadData;
+    this->m_ThreadData     = new AlignedThreadStruct[ numberOfThreads ];
+    this->m_ThreadDataSize = numberOfThreads;
+    for( ThreadIdType i = 0; i < numberOfThreads; ++i )
+    {
+      this->m_ThreadData[ i ].st_NumberOfHits   = 0;
+      this->m_ThreadData[ i ].st_NumberOfMisses = 0;
+    }
+  }
+  for( ThreadIdType i = 0; i < numberOfThreads; ++i )
+  {
+    this->m_ThreadData[ i ].st_Weights.resize( numberOfWeights );
+  }
+
+  /** The sample container is regenerated when new samples are selected. */
+  const ModifiedTimeType sampleContainerTime = std::max(
+    sampleContainer->GetMTime(), sampleContainer->GetUpdateMTime() );
+
+  /** Keep the entries when nothing changed. */
+  if( transform == this->m_Transform
+    && sampleContainer == this->m_SampleContainer
+    && sampleContainerTime == this->m_SampleContainerTime
+    && numberOfSamples == this->m_NumberOfSamples
+    && numberOfWeights == this->m_NumberOfWeights
+    && transform->GetGridRegion() == this->m_GridRegion
+    && transform->GetGridSpacing() == this->m_GridSpacing
+    && transform->GetGridOrigin() == this->m_GridOrigin
+    && transform->GetGridDirection() == this->m_GridDirection )
+  {
+    return;
+  }
+
+  /** Store the new key. */
+  this->m_Transform           = transform;
+  this->m_SampleContainer     = sampleContainer;
+  this->m_SampleContainerTime = sampleContainerTime;
+  this->m_NumberOfSamples     = numberOfSamples;
+  this->m_NumberOfWeights     = numberOfWeights;
+  this->m_GridRegion          = transform->GetGridRegion();
+  this->m_GridSpacing         = transform->GetGridSpacing();
+  this->m_GridOrigin          = transform->GetGridOrigin();
+  this->m_GridDirection       = transform->GetGridDirection();
+
+  /** Determine how many samples fit in the arena. */
+  const SizeValueType bytesPerSample = numberOfWeights * sizeof( ScalarType )
+    + sizeof( IndexType ) + sizeof( unsigned char );
+  this->m_Capacity = std::min( numberOfSamples,
+    this->m_MaximumMemorySize / bytesPerSample );
+
+  /** Allocate the arena, and mark all entries as empty. */
+  this->m_Weights.resize( this->m_Capacity * numberOfWeights );
+  this->m_SupportIndices.resize( this->m_Capacity );
+  this->m_States.assign( this->m_Capacity, static_cast< unsigned char >( Empty ) );
+
+} // end Initialize()
+
+
+/**
+ * ****************** GetSupportIndexAndWeights *********************************
+ */
+
+template< class TScalarType, unsigned int NDimensions >
+bool
+BSplineSampleWeightCache< TScalarType, NDimensions >
+::GetSupportIndexAndWeights( ThreadIdType threadId,
+  SizeValueType sampleId, const InputPointType & point,
+  IndexType & supportIndex, const ScalarType * & weights )
+{
+  ThreadStruct & threadData = this->m_ThreadData[ threadId ];
+
+  /** Samples that do not fit in the arena are computed in the thread buffer. */
+  if( sampleId >= this->m_Capacity )
+  {
+    ++threadData.st_NumberOfMisses;
+    weights = &threadData.st_Weights[ 0 ];
+    return this->m_Transform->ComputeSupportIndexAndWeights(
+      point, supportIndex, &threadData.st_Weights[ 0 ] );
+  }
+
+  /** Compute and store the entry on the first request. */
+  ScalarType *    entryWeights = &this->m_Weights[ sampleId * this->m_NumberOfWeights ];
+  unsigned char & state        = this->m_States[ sampleId ];
+  if( state == Empty )
+  {
+    ++threadData.st_NumberOfMisses;
+    const bool inside = this->m_Transform->ComputeSupportIndexAndWeights(
+      point, this->m_SupportIndices[ sampleId ], entryWeights );
+    state = inside ? Inside : Outside;
+  }
+  else
+  {
+    ++threadData.st_NumberOfHits;
+  }
+
+  supportIndex = this->m_SupportIndices[ sampleId ];
+  weights      = entryWeights;
+  return state == Inside;
+
+} // end GetSupportIndexAndWeights()
+
+
+/**
+ * ****************** Clear *********************************
+ */
+
+template< class TScalarType, unsigned int NDimensions >
+void
+BSplineSampleWeightCache< TScalarType, NDimensions >
+::Clear( void )
+{
+  std::fill( this->m_States.begin(), this->m_States.end(),
+    static_cast< unsigned char >( Empty ) );
+  for( ThreadIdType i = 0; i < this->m_ThreadDataSize; ++i )
+  {
+    this->m_ThreadData[ i ].st_NumberOfHits   = 0;
+    this->m_ThreadData[ i ].st_NumberOfMisses = 0;
+  }
+  this->m_NumberOfHits   = 0;
+  this->m_NumberOfMisses = 0;
+
+} // end Clear()
+
+
+/**
+ * ****************** GetNumberOfHits *********************************
+ */
+
+template< class TScalarType, unsigned int NDimensions >
+SizeValueType
+BSplineSampleWeightCache< TScalarType, NDimensions >
+::GetNumberOfHits( void ) const
+{
+  SizeValueType hits = this->m_NumberOfHits;
+  for( ThreadIdType i = 0; i < this->m_ThreadDataSize; ++i )
+  {
+    hits += this->m_ThreadData[ i ].st_NumberOfHits;
+  }
+  return hits;
+
+} // end GetNumberOfHits()
+
+
+/**
+ * ****************** GetNumberOfMisses *********************************
+ */
+
+template< class TScalarType, unsigned int NDimensions >
+SizeValueType
+BSplineSampleWeightCache< TScalarType, NDimensions >
+::GetNumberOfMisses( void ) const
+{
+  SizeValueType misses = this->m_NumberOfMisses;
+  for( ThreadIdType i = 0; i < this->m_ThreadDataSize; ++i )
+  {
+    misses += this->m_ThreadData[ i ].st_NumberOfMisses;
+  }
+  return misses;
+
+} // end GetNumberOfMisses()
+
+
+/**
+ * ****************** GetHitRate *********************************
+ */
+
+template< class TScalarType, unsigned int NDimensions >
+double
+BSplineSampleWeightCache< TScalarType, NDimensions >
+::GetHitRate( void ) const
+{
+  const SizeValueType hits    = this->GetNumberOfHits();
+  const SizeValueType lookups = hits + this->GetNumberOfMisses();
+  if( lookups == 0 ) { return 0.0; }
+  return static_cast< double >( hits ) / static_cast< double >( lookups );
+
+} // end GetHitRate()
+
+
+/**
+ * ****************** PrintSelf *********************************
+ */
+
+template< class TScalarType, unsigned int NDimensions >
+void
+BSplineSampleWeightCache< TScalarType, NDimensions >
+::PrintSelf( std::ostream & os, Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "MaximumMemorySize: " << this->m_MaximumMemorySize << std::endl;
+  os << indent << "Capacity: " << this->m_Capacity << std::endl;
+  os << indent << "NumberOfWeights: " << this->m_NumberOfWeights << std::endl;
+  os << indent << "NumberOfHits: " << this->GetNumberOfHits() << std::endl;
+  os << indent << "NumberOfMisses: " << this->GetNumberOfMisses() << std::endl;
+
+} // end PrintSelf()
+
+
+} // end namespace itk
+
+#endif // end #ifndef __itkBSplineSampleWeightCache_hxx
@@ -0,0 +1,279 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkCostFunctionBatchEvaluator_cxx
+#define __itkCostFunctionBatchEvaluator_cxx
+
+#include "itkCostFunctionBatchEvaluator.h"
+#include "itkPersistentThreadPool.h"
+#include <algorithm>
+#include <exception>
+
+namespace itk
+{
+
+/**
+ * **************** Constructor *****************************
+ */
+
+CostFunctionBatchEvaluator
+::CostFunctionBatchEvaluator()
+{
+  this->m_Threader      = ThreaderType::New();
+  this->m_Positions     = NULL;
+  this->m_Values        = NULL;
+  this->m_Derivatives   = NULL;
+  this->m_Failures      = NULL;
+  this->m_Exceptions    = NULL;
+  this->m_NextPosition  = 0;
+
+} // end Constructor
+
+
+/**
+ * **************** AddCostFunction *****************************
+ */
+
+void
+CostFunctionBatchEvaluator
+::AddCostFunction( CostFunctionType * costFunction )
+{
+  if( costFunction == NULL )
+  {
+    itkExceptionMacro( << "The cost function should not be NULL." );
+  }
+  this->m_CostFunctions.push_back( costFunction );
+  this->Modified();
+
+} // end AddCostFunction()
+
+
+/**
+ * **************** RemoveAllCostFunctions *****************************
+ */
+
+void
+CostFunctionBatchEvaluator
+::RemoveAllCostFunctions( void )
+{
+  this->m_CostFunctions.clear();
+  this->Modified();
+
+} // end RemoveAllCostFunctions()
+
+
+/**
+ * **************** GetNumberOfConcurrentEvaluations *****************************
+ */
+
+unsigned int
+CostFunctionBatchEvaluator
+::GetNumberOfConcurrentEvaluations( void ) const
+{
+  return std::min( this->GetNumberOfCostFunctions(),
+    static_cast< unsigned int >( this->m_Threader->GetNumberOfThreads() ) );
+
+} // end GetNumberOfConcurrentEvaluations()
+
+
+/**
+ * **************** Evaluate *****************************
+ */
+
+void
+CostFunctionBatchEvaluator
+::Evaluate( const ParametersContainerType & positions,
+  MeasureContainerType & values,
+  FailureContainerType & failures,
+  ExceptionContainerType & exceptions )
+{
+  this->m_Derivatives = NULL;
+  this->EvaluateBatch( positions, values, failures, exceptions );
+
+} // end Evaluate()
+
+
+/**
+ * **************** EvaluateValuesAndDerivatives *****************************
+ */
+
+void
+CostFunctionBatchEvaluator
+::EvaluateValuesAndDerivatives( const ParametersContainerType & positions,
+  MeasureContainerType & values,
+  DerivativeContainerType & derivatives,
+  FailureContainerType & failures,
+  ExceptionContainerType & exceptions )
+{
+  derivatives.resize( positions.size() );
+  this->m_Derivatives = &derivatives;
+  this->EvaluateBatch( positions, values, failures, exceptions );
+  this->m_Derivatives = NULL;
+
+} // end EvaluateValuesAndDerivatives()
+
+
+/**
+ * **************** EvaluateBatch *****************************
+ */
+
+void
+CostFunctionBatchEvaluator
+::EvaluateBatch( const ParametersContainerType & positions,
+  MeasureContainerType & values,
+  FailureContainerType & failures,
+  ExceptionContainerType & exceptions )
+{
+  if( this->m_CostFunctions.empty() )
+  {
+    itkExceptionMacro( << "No cost function has been set." );
+  }
+
+  const SizeValueType numberOfPositions = positions.size();
+  values.assign( numberOfPositions, NumericTraits< MeasureType >::Zero );
+  failures.assign( numberOfPositions, false );
+  exceptions.assign( numberOfPositions, ExceptionObject() );
+
+  this->m_Positions     = &positions;
+  this->m_Values        = &values;
+  this->m_Failures      = &failures;
+  this->m_Exceptions    = &exceptions;
+  this->m_NextPosition  = 0;
+
+  /** Evaluate serially, in order, when only one instance can be used. */
+  const unsigned int numberOfConcurrentEvaluations = static_cast< unsigned int >(
+    std::min( static_cast< SizeValueType >( this->GetNumberOfConcurrentEvaluations() ),
+    numberOfPositions ) );
+  if( numberOfConcurrentEvaluations <= 1 )
+  {
+    for( SizeValueType i = 0; i < numberOfPositions; ++i )
+    {
+      this->EvaluatePosition( 0, i );
+    }
+  }
+  else
+  {
+    /** Thread t uses cost function instance t. The threads that are not
+     * needed return immediately. The threads of the cost functions
+     * themselves fall back to the regular threader.
+     */
+    PersistentThreadPool::SingleMethodExecute( this->m_Threader,
+      this->EvaluateThreaderCallback, this );
+  }
+
+  this->m_Positions     = NULL;
+  this->m_Values        = NULL;
+  this->m_Failures      = NULL;
+  this->m_Exceptions    = NULL;
+
+} // end EvaluateBatch()
+
+
+/**
+ * **************** EvaluatePosition *****************************
+ */
+
+void
+CostFunctionBatchEvaluator
+::EvaluatePosition( unsigned int c, SizeValueType i )
+{
+  try
+  {
+    if( this->m_Derivatives )
+    {
+      this->m_CostFunctions[ c ]->GetValueAndDerivative( ( *this->m_Positions )[ i ],
+        ( *this->m_Values )[ i ], ( *this->m_Derivatives )[ i ] );
+    }
+    else
+    {
+      ( *this->m_Values )[ i ]
+        = this->m_CostFunctions[ c ]->GetValue( ( *this->m_Positions )[ i ] );
+    }
+  }
+  catch( ExceptionObject & err )
+  {
+    ( *this->m_Failures )[ i ]   = true;
+    ( *this->m_Exceptions )[ i ] = err;
+  }
+  catch( std::exception & err )
+  {
+    ( *this->m_Failures )[ i ]   = true;
+    ( *this->m_Exceptions )[ i ] = ExceptionObject( __FILE__, __LINE__,
+      err.what(), ITK_LOCATION );
+  }
+  catch( ... )
+  {
+    ( *this->m_Failures )[ i ]   = true;
+    ( *this->m_Exceptions )[ i ] = ExceptionObject( __FILE__, __LINE__,
+      "Unknown exception in the cost function.", ITK_LOCATION );
+  }
+
+} // end EvaluatePosition()
+
+
+/**
+ * **************** EvaluateThreaderCallback *****************************
+ */
+
+ITK_THREAD_RETURN_TYPE
+CostFunctionBatchEvaluator
+::EvaluateThreaderCallback( void * arg )
+{
+  ThreadInfoType * infoStruct = static_cast< ThreadInfoType * >( arg );
+  ThreadIdType     threadId   = infoStruct->ThreadID;
+  Self *           temp       = static_cast< Self * >( infoStruct->UserData );
+
+  if( threadId >= temp->GetNumberOfCostFunctions() )
+  {
+    return ITK_THREAD_RETURN_VALUE;
+  }
+
+  const SizeValueType numberOfPositions = temp->m_Positions->size();
+  while( true )
+  {
+    temp->m_NextPositionLock.Lock();
+    const SizeValueType i = temp->m_NextPosition++;
+    temp->m_NextPositionLock.Unlock();
+    if( i >= numberOfPositions ) { break; }
+
+    temp->EvaluatePosition( threadId, i );
+  }
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end EvaluateThreaderCallback()
+
+
+/**
+ * **************** PrintSelf *****************************
+ */
+
+void
+CostFunctionBatchEvaluator
+::PrintSelf( std::ostream & os, Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "NumberOfCostFunctions: " << this->GetNumberOfCostFunctions() << std::endl;
+  os << indent << "NumberOfThreads: " << this->m_Threader->GetNumberOfThreads() << std::endl;
+
+} // end PrintSelf()
+
+
+} // end namespace itk
+
+#endif // end #ifndef __itkCostFunctionBatchEvaluator_cxx
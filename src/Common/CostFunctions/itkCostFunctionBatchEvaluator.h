@@ -0,0 +1,169 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkCostFunctionBatchEvaluator_h
+#define __itkCostFunctionBatchEvaluator_h
+
+#include "itkSingleValuedCostFunction.h"
+#include "itkMultiThreader.h"
+#include "itkSimpleFastMutexLock.h"
+#include <vector>
+
+namespace itk
+{
+/**
+ * \class CostFunctionBatchEvaluator
+ * \brief Computes the values, and optionally the derivatives, of a cost
+ * function at a batch of positions, concurrently when possible.
+ *
+ * Population based and exhaustive optimizers evaluate many independent
+ * positions. Most cost functions, like the image metrics, store the
+ * current position in their transform, so one instance can only evaluate
+ * one position at a time. This class therefore holds a list of cost function
+ * instances that compute the same function, for example clones of a metric,
+ * each with its own transform. Each instance is used by one thread at a time,
+ * so the number of concurrent evaluations is the minimum of the number of
+ * instances and the number of threads. With a single instance the positions
+ * are evaluated serially, in order.
+ *
+ * An evaluation that throws an exception does not stop the others; it is
+ * marked as failed and its exception is returned instead of its value, so
+ * that the caller can rethrow it. Exceptions that are not an
+ * itk::ExceptionObject are converted to one.
+ *
+ * \ingroup Numerics
+ */
+
+class CostFunctionBatchEvaluator : public Object
+{
+public:
+
+  /** Standard ITK-stuff. */
+  typedef CostFunctionBatchEvaluator Self;
+  typedef Object                     Superclass;
+  typedef SmartPointer< Self >       Pointer;
+  typedef SmartPointer< const Self > ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( CostFunctionBatchEvaluator, Object );
+
+  /** Typedefs. */
+  typedef SingleValuedCostFunction          CostFunctionType;
+  typedef CostFunctionType::Pointer         CostFunctionPointer;
+  typedef CostFunctionType::MeasureType     MeasureType;
+  typedef CostFunctionType::ParametersType  ParametersType;
+  typedef CostFunctionType::DerivativeType  DerivativeType;
+  typedef std::vector< ParametersType >     ParametersContainerType;
+  typedef std::vector< MeasureType >        MeasureContainerType;
+  typedef std::vector< DerivativeType >     DerivativeContainerType;
+  typedef std::vector< bool >               FailureContainerType;
+  typedef std::vector< ExceptionObject >    ExceptionContainerType;
+  typedef MultiThreader                     ThreaderType;
+  typedef ThreaderType::ThreadInfoStruct    ThreadInfoType;
+
+  /** Add a cost function instance. Instances should not share state that
+   * changes during GetValue(), such as the transform.
+   */
+  void AddCostFunction( CostFunctionType * costFunction );
+
+  /** Remove all cost function instances. */
+  void RemoveAllCostFunctions( void );
+
+  /** Get the number of cost function instances. */
+  unsigned int GetNumberOfCostFunctions( void ) const
+  {
+    return static_cast< unsigned int >( this->m_CostFunctions.size() );
+  }
+
+  /** Get cost function instance i. */
+  CostFunctionType * GetCostFunction( unsigned int i ) const
+  {
+    return this->m_CostFunctions[ i ].GetPointer();
+  }
+
+  /** Set the number of threads. */
+  void SetNumberOfThreads( ThreadIdType numberOfThreads )
+  {
+    this->m_Threader->SetNumberOfThreads( numberOfThreads );
+  }
+
+  /** Get the number of positions that can be evaluated concurrently. */
+  unsigned int GetNumberOfConcurrentEvaluations( void ) const;
+
+  /** Compute the value at each position. When the evaluation at position i
+   * failed, failures[ i ] is true and exceptions[ i ] holds the exception
+   * that was thrown. Not thread-safe.
+   */
+  void Evaluate( const ParametersContainerType & positions,
+    MeasureContainerType & values,
+    FailureContainerType & failures,
+    ExceptionContainerType & exceptions );
+
+  /** Compute the value and the derivative at each position, like Evaluate(). */
+  void EvaluateValuesAndDerivatives( const ParametersContainerType & positions,
+    MeasureContainerType & values,
+    DerivativeContainerType & derivatives,
+    FailureContainerType & failures,
+    ExceptionContainerType & exceptions );
+
+protected:
+
+  CostFunctionBatchEvaluator();
+  virtual ~CostFunctionBatchEvaluator() {}
+
+  /** PrintSelf. */
+  void PrintSelf( std::ostream & os, Indent indent ) const;
+
+  /** Evaluate all positions, with the derivatives if m_Derivatives is set. */
+  void EvaluateBatch( const ParametersContainerType & positions,
+    MeasureContainerType & values,
+    FailureContainerType & failures,
+    ExceptionContainerType & exceptions );
+
+  /** Evaluate position i with cost function instance c. */
+  void EvaluatePosition( unsigned int c, SizeValueType i );
+
+  /** The threader callback; each thread takes the next position from the
+   * shared counter, until all positions are done.
+   */
+  static ITK_THREAD_RETURN_TYPE EvaluateThreaderCallback( void * arg );
+
+private:
+
+  CostFunctionBatchEvaluator( const Self & ); // purposely not implemented
+  void operator=( const Self & );             // purposely not implemented
+
+  std::vector< CostFunctionPointer > m_CostFunctions;
+  ThreaderType::Pointer              m_Threader;
+
+  /** The batch that is currently evaluated. */
+  const ParametersContainerType * m_Positions;
+  MeasureContainerType *          m_Values;
+  DerivativeContainerType *       m_Derivatives;
+  FailureContainerType *          m_Failures;
+  ExceptionContainerType *        m_Exceptions;
+  SizeValueType                   m_NextPosition;
+  SimpleFastMutexLock             m_NextPositionLock;
+
+};
+
+} // end namespace itk
+
+#endif // end #ifndef __itkCostFunctionBatchEvaluator_h
@@ -0,0 +1,441 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef __itkJointPDFBatchUpdater_cxx
+#define __itkJointPDFBatchUpdater_cxx
+
+#include "itkJointPDFBatchUpdater.h"
+
+#include <cmath>
+
+/** The vectorised code uses function-level target attributes, so that
+ * the rest of elastix does not need to be compiled with -mavx2.
+ */
+#if defined( __x86_64__ ) && ( defined( __clang__ ) || ( defined( __GNUC__ ) && __GNUC__ >= 5 ) )
+#define ELX_JOINTPDF_USE_X86_DISPATCH
+#include <immintrin.h>
+
+/** AVX-512 implies FMA; prevent gcc from contracting multiply-adds, so that
+ * the rounding stays identical to the scalar code.
+ */
+#if defined( __clang__ )
+#define ELX_JOINTPDF_NO_CONTRACT
+#else
+#define ELX_JOINTPDF_NO_CONTRACT __attribute__( ( optimize( "fp-contract=off" ) ) )
+#endif
+#endif
+
+namespace itk
+{
+
+namespace
+{
+
+/** The instruction set in use; -1 means: not yet determined. */
+int s_InstructionSet = -1;
+
+/** Number of samples for which the vectorised code computes the weights at once. */
+const unsigned int s_MaximumVectorLength = 8;
+
+/**
+ * ****************** EvaluateBSplineWeights *********************************
+ *
+ * Same arithmetic as BSplineKernelFunction2::Evaluate( u, weights ).
+ */
+
+inline void
+EvaluateBSplineWeights( unsigned int order, double u, double * weights )
+{
+  const double absValue = std::abs( u );
+
+  switch( order )
+  {
+    case 0:
+      if( absValue < 0.5 ) { weights[ 0 ] = 1.0; }
+      else if( absValue == 0.5 ) { weights[ 0 ] = 0.5; }
+      else { weights[ 0 ] = 0.0; }
+      break;
+    case 1:
+      weights[ 0 ] = 1.0 - absValue;
+      weights[ 1 ] = absValue;
+      break;
+    case 2:
+    {
+      const double sqrValue = u * u;
+      weights[ 0 ] = ( 9.0 - 12.0 * absValue + 4.0 * sqrValue ) / 8.0;
+      weights[ 1 ] = -0.25 + 2.0 * absValue - sqrValue;
+      weights[ 2 ] = ( 1.0 - 4.0 * absValue + 4.0 * sqrValue ) / 8.0;
+      break;
+    }
+    default:
+    {
+      const double        sqrValue = u * u;
+      const double        uuu      = sqrValue * absValue;
+      static const double onesixth = 1.0 / 6.0;
+      weights[ 0 ] = (  8.0 - 12.0 * absValue +  6.0 * sqrValue -       uuu ) * onesixth;
+      weights[ 1 ] = ( -5.0 + 21.0 * absValue - 15.0 * sqrValue + 3.0 * uuu ) * onesixth;
+      weights[ 2 ] = (  4.0 - 12.0 * absValue + 12.0 * sqrValue - 3.0 * uuu ) * onesixth;
+      weights[ 3 ] = ( -1.0 +  3.0 * absValue -  3.0 * sqrValue +       uuu ) * onesixth;
+      break;
+    }
+  }
+
+} // end EvaluateBSplineWeights()
+
+
+/**
+ * ****************** UpdateJointPDFScalar *********************************
+ */
+
+void
+UpdateJointPDFScalar(
+  const double * fixedTerms, const double * movingTerms,
+  SizeValueType numberOfSamples,
+  unsigned int fixedKernelOrder, unsigned int movingKernelOrder,
+  double fixedTermToIndexOffset, double movingTermToIndexOffset,
+  double * pdf, OffsetValueType stride )
+{
+  double fixedWeights[ 4 ];
+  double movingWeights[ 4 ];
+
+  for( SizeValueType i = 0; i < numberOfSamples; ++i )
+  {
+    const OffsetValueType fixedIndex = static_cast< OffsetValueType >(
+      std::floor( fixedTerms[ i ] + fixedTermToIndexOffset ) );
+    const OffsetValueType movingIndex = static_cast< OffsetValueType >(
+      std::floor( movingTerms[ i ] + movingTermToIndexOffset ) );
+    EvaluateBSplineWeights( fixedKernelOrder,
+      static_cast< double >( fixedIndex ) - fixedTerms[ i ], fixedWeights );
+    EvaluateBSplineWeights( movingKernelOrder,
+      static_cast< double >( movingIndex ) - movingTerms[ i ], movingWeights );
+
+    double * row = pdf + fixedIndex * stride + movingIndex;
+    for( unsigned int f = 0; f <= fixedKernelOrder; ++f )
+    {
+      const double fv = fixedWeights[ f ];
+      for( unsigned int m = 0; m <= movingKernelOrder; ++m )
+      {
+        row[ m ] += fv * movingWeights[ m ];
+      }
+      row += stride;
+    }
+  }
+
+} // end UpdateJointPDFScalar()
+
+
+#ifdef ELX_JOINTPDF_USE_X86_DISPATCH
+
+/**
+ * ****************** AddCubicRows *********************************
+ *
+ * Adds the outer product of the fixed weights and the four cubic moving
+ * weights of one sample, one histogram row per vector instruction.
+ * The weights are stored per kernel position: movingWeights[ m ][ s ].
+ */
+
+__attribute__( ( target( "avx2" ) ) )
+inline void
+AddCubicRows(
+  const double * fixedTerms, const double * movingIndices,
+  const double ( *movingWeights )[ s_MaximumVectorLength ],
+  unsigned int numberOfSamples,
+  unsigned int fixedKernelOrder, double fixedTermToIndexOffset,
+  double * pdf, OffsetValueType stride )
+{
+  double fixedWeights[ 4 ];
+  for( unsigned int s = 0; s < numberOfSamples; ++s )
+  {
+    const OffsetValueType fixedIndex = static_cast< OffsetValueType >(
+      std::floor( fixedTerms[ s ] + fixedTermToIndexOffset ) );
+    EvaluateBSplineWeights( fixedKernelOrder,
+      static_cast< double >( fixedIndex ) - fixedTerms[ s ], fixedWeights );
+
+    const __m256d mv = _mm256_set_pd(
+      movingWeights[ 3 ][ s ], movingWeights[ 2 ][ s ],
+      movingWeights[ 1 ][ s ], movingWeights[ 0 ][ s ] );
+
+    double * row = pdf + fixedIndex * stride
+      + static_cast< OffsetValueType >( movingIndices[ s ] );
+    for( unsigned int f = 0; f <= fixedKernelOrder; ++f )
+    {
+      const __m256d fv = _mm256_set1_pd( fixedWeights[ f ] );
+      _mm256_storeu_pd( row, _mm256_add_pd( _mm256_loadu_pd( row ), _mm256_mul_pd( fv, mv ) ) );
+      row += stride;
+    }
+  }
+
+} // end AddCubicRows()
+
+
+/**
+ * ****************** UpdateJointPDFCubicAVX2 *********************************
+ *
+ * Computes the cubic moving weights of 4 samples at once. No FMA is
+ * used, so that the rounding is identical to the scalar code.
+ */
+
+__attribute__( ( target( "avx2" ) ) )
+void
+UpdateJointPDFCubicAVX2(
+  const double * fixedTerms, const double * movingTerms,
+  SizeValueType numberOfSamples,
+  unsigned int fixedKernelOrder,
+  double fixedTermToIndexOffset, double movingTermToIndexOffset,
+  double * pdf, OffsetValueType stride )
+{
+  const __m256d offset   = _mm256_set1_pd( movingTermToIndexOffset );
+  const __m256d onesixth = _mm256_set1_pd( 1.0 / 6.0 );
+  const __m256d c1  = _mm256_set1_pd( 1.0 );
+  const __m256d c3  = _mm256_set1_pd( 3.0 );
+  const __m256d c4  = _mm256_set1_pd( 4.0 );
+  const __m256d c5  = _mm256_set1_pd( 5.0 );
+  const __m256d c6  = _mm256_set1_pd( 6.0 );
+  const __m256d c8  = _mm256_set1_pd( 8.0 );
+  const __m256d c12 = _mm256_set1_pd( 12.0 );
+  const __m256d c15 = _mm256_set1_pd( 15.0 );
+  const __m256d c21 = _mm256_set1_pd( 21.0 );
+
+  double movingIndices[ 4 ];
+  double movingWeights[ 4 ][ s_MaximumVectorLength ];
+
+  SizeValueType i = 0;
+  for( ; i + 4 <= numberOfSamples; i += 4 )
+  {
+    /** absValue = | index - term | = term - index, since index <= term - 1. */
+    const __m256d term  = _mm256_loadu_pd( movingTerms + i );
+    const __m256d index = _mm256_floor_pd( _mm256_add_pd( term, offset ) );
+    const __m256d a     = _mm256_sub_pd( term, index );
+    const __m256d sqr   = _mm256_mul_pd( a, a );
+    const __m256d uuu   = _mm256_mul_pd( sqr, a );
+
+    const __m256d w0 = _mm256_sub_pd( _mm256_add_pd( _mm256_sub_pd( c8,
+      _mm256_mul_pd( c12, a ) ), _mm256_mul_pd( c6, sqr ) ), uuu );
+    const __m256d w1 = _mm256_add_pd( _mm256_sub_pd( _mm256_add_pd( _mm256_sub_pd( _mm256_setzero_pd(), c5 ),
+      _mm256_mul_pd( c21, a ) ), _mm256_mul_pd( c15, sqr ) ), _mm256_mul_pd( c3, uuu ) );
+    const __m256d w2 = _mm256_sub_pd( _mm256_add_pd( _mm256_sub_pd( c4,
+      _mm256_mul_pd( c12, a ) ), _mm256_mul_pd( c12, sqr ) ), _mm256_mul_pd( c3, uuu ) );
+    const __m256d w3 = _mm256_add_pd( _mm256_sub_pd( _mm256_add_pd( _mm256_sub_pd( _mm256_setzero_pd(), c1 ),
+      _mm256_mul_pd( c3, a ) ), _mm256_mul_pd( c3, sqr ) ), uuu );
+
+    _mm256_storeu_pd( movingIndices, index );
+    _mm256_storeu_pd( movingWeights[ 0 ], _mm256_mul_pd( w0, onesixth ) );
+    _mm256_storeu_pd( movingWeights[ 1 ], _mm256_mul_pd( w1, onesixth ) );
+    _mm256_storeu_pd( movingWeights[ 2 ], _mm256_mul_pd( w2, onesixth ) );
+    _mm256_storeu_pd( movingWeights[ 3 ], _mm256_mul_pd( w3, onesixth ) );
+
+    AddCubicRows( fixedTerms + i, movingIndices, movingWeights, 4,
+      fixedKernelOrder, fixedTermToIndexOffset, pdf, stride );
+  }
+
+  /** The remaining samples. */
+  UpdateJointPDFScalar( fixedTerms + i, movingTerms + i, numberOfSamples - i,
+    fixedKernelOrder, 3, fixedTermToIndexOffset, movingTermToIndexOffset,
+    pdf, stride );
+
+} // end UpdateJointPDFCubicAVX2()
+
+
+/**
+ * ****************** UpdateJointPDFCubicAVX512 *********************************
+ *
+ * Computes the cubic moving weights of 8 samples at once.
+ */
+
+__attribute__( ( target( "avx512f,avx2" ) ) ) ELX_JOINTPDF_NO_CONTRACT
+void
+UpdateJointPDFCubicAVX512(
+  const double * fixedTerms, const double * movingTerms,
+  SizeValueType numberOfSamples,
+  unsigned int fixedKernelOrder,
+  double fixedTermToIndexOffset, double movingTermToIndexOffset,
+  double * pdf, OffsetValueType stride )
+{
+  const __m512d offset   = _mm512_set1_pd( movingTermToIndexOffset );
+  const __m512d onesixth = _mm512_set1_pd( 1.0 / 6.0 );
+  const __m512d c1  = _mm512_set1_pd( 1.0 );
+  const __m512d c3  = _mm512_set1_pd( 3.0 );
+  const __m512d c4  = _mm512_set1_pd( 4.0 );
+  const __m512d c5  = _mm512_set1_pd( 5.0 );
+  const __m512d c6  = _mm512_set1_pd( 6.0 );
+  const __m512d c8  = _mm512_set1_pd( 8.0 );
+  const __m512d c12 = _mm512_set1_pd( 12.0 );
+  const __m512d c15 = _mm512_set1_pd( 15.0 );
+  const __m512d c21 = _mm512_set1_pd( 21.0 );
+
+  double movingIndices[ s_MaximumVectorLength ];
+  double movingWeights[ 4 ][ s_MaximumVectorLength ];
+
+  SizeValueType i = 0;
+  for( ; i + 8 <= numberOfSamples; i += 8 )
+  {
+    /** absValue = | index - term | = term - index, since index <= term - 1. */
+    const __m512d term  = _mm512_loadu_pd( movingTerms + i );
+    const __m512d index = _mm512_roundscale_pd( _mm512_add_pd( term, offset ),
+      _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC );
+    const __m512d a   = _mm512_sub_pd( term, index );
+    const __m512d sqr = _mm512_mul_pd( a, a );
+    const __m512d uuu = _mm512_mul_pd( sqr, a );
+
+    const __m512d w0 = _mm512_sub_pd( _mm512_add_pd( _mm512_sub_pd( c8,
+      _mm512_mul_pd( c12, a ) ), _mm512_mul_pd( c6, sqr ) ), uuu );
+    const __m512d w1 = _mm512_add_pd( _mm512_sub_pd( _mm512_add_pd( _mm512_sub_pd( _mm512_setzero_pd(), c5 ),
+      _mm512_mul_pd( c21, a ) ), _mm512_mul_pd( c15, sqr ) ), _mm512_mul_pd( c3, uuu ) );
+    const __m512d w2 = _mm512_sub_pd( _mm512_add_pd( _mm512_sub_pd( c4,
+      _mm512_mul_pd( c12, a ) ), _mm512_mul_pd( c12, sqr ) ), _mm512_mul_pd( c3, uuu ) );
+    const __m512d w3 = _mm512_add_pd( _mm512_sub_pd( _mm512_add_pd( _mm512_sub_pd( _mm512_setzero_pd(), c1 ),
+      _mm512_mul_pd( c3, a ) ), _mm512_mul_pd( c3, sqr ) ), uuu );
+
+    _mm512_storeu_pd( movingIndices, index );
+    _mm512_storeu_pd( movingWeights[ 0 ], _mm512_mul_pd( w0, onesixth ) );
+    _mm512_storeu_pd( movingWeights[ 1 ], _mm512_mul_pd( w1, onesixth ) );
+    _mm512_storeu_pd( movingWeights[ 2 ], _mm512_mul_pd( w2, onesixth ) );
+    _mm512_storeu_pd( movingWeights[ 3 ], _mm512_mul_pd( w3, onesixth ) );
+
+    AddCubicRows( fixedTerms + i, movingIndices, movingWeights, 8,
+      fixedKernelOrder, fixedTermToIndexOffset, pdf, stride );
+  }
+
+  /** The remaining samples. */
+  UpdateJointPDFCubicAVX2( fixedTerms + i, movingTerms + i, numberOfSamples - i,
+    fixedKernelOrder, fixedTermToIndexOffset, movingTermToIndexOffset,
+    pdf, stride );
+
+} // end UpdateJointPDFCubicAVX512()
+
+#endif // end #ifdef ELX_JOINTPDF_USE_X86_DISPATCH
+
+} // end anonymous namespace
+
+
+/**
+ * ****************** GetSupportedInstructionSet *********************************
+ */
+
+JointPDFBatchUpdater::InstructionSetType
+JointPDFBatchUpdater
+::GetSupportedInstructionSet( void )
+{
+#ifdef ELX_JOINTPDF_USE_X86_DISPATCH
+  __builtin_cpu_init();
+  if( __builtin_cpu_supports( "avx512f" ) ) { return AVX512; }
+  if( __builtin_cpu_supports( "avx2" ) ) { return AVX2; }
+#endif
+  return Scalar;
+
+} // end GetSupportedInstructionSet()
+
+
+/**
+ * ****************** SetInstructionSet *********************************
+ */
+
+void
+JointPDFBatchUpdater
+::SetInstructionSet( InstructionSetType instructionSet )
+{
+  const InstructionSetType supported = GetSupportedInstructionSet();
+  s_InstructionSet = static_cast< int >(
+    instructionSet > supported ? supported : instructionSet );
+
+} // end SetInstructionSet()
+
+
+/**
+ * ****************** GetInstructionSet *********************************
+ */
+
+JointPDFBatchUpdater::InstructionSetType
+JointPDFBatchUpdater
+::GetInstructionSet( void )
+{
+  if( s_InstructionSet < 0 )
+  {
+    s_InstructionSet = static_cast< int >( GetSupportedInstructionSet() );
+  }
+  return static_cast< InstructionSetType >( s_InstructionSet );
+
+} // end GetInstructionSet()
+
+
+/**
+ * ****************** GetInstructionSetName *********************************
+ */
+
+const char *
+JointPDFBatchUpdater
+::GetInstructionSetName( InstructionSetType instructionSet )
+{
+  switch( instructionSet )
+  {
+    case AVX2:
+      return "AVX2";
+    case AVX512:
+      return "AVX-512";
+    default:
+      return "Scalar";
+  }
+
+} // end GetInstructionSetName()
+
+
+/**
+ * ****************** UpdateJointPDF *********************************
+ */
+
+void
+JointPDFBatchUpdater
+::UpdateJointPDF(
+  const double * fixedTerms, const double * movingTerms,
+  SizeValueType numberOfSamples,
+  unsigned int fixedKernelOrder, unsigned int movingKernelOrder,
+  double fixedTermToIndexOffset, double movingTermToIndexOffset,
+  double * pdf, OffsetValueType stride )
+{
+#ifdef ELX_JOINTPDF_USE_X86_DISPATCH
+  /** The vectorised code handles the cubic moving kernel, which is the default. */
+  if( movingKernelOrder == 3 )
+  {
+    const InstructionSetType instructionSet = GetInstructionSet();
+    if( instructionSet == AVX512 )
+    {
+      UpdateJointPDFCubicAVX512( fixedTerms, movingTerms, numberOfSamples,
+        fixedKernelOrder, fixedTermToIndexOffset, movingTermToIndexOffset,
+        pdf, stride );
+      return;
+    }
+    else if( instructionSet == AVX2 )
+    {
+      UpdateJointPDFCubicAVX2( fixedTerms, movingTerms, numberOfSamples,
+        fixedKernelOrder, fixedTermToIndexOffset, movingTermToIndexOffset,
+        pdf, stride );
+      return;
+    }
+  }
+#endif
+
+  UpdateJointPDFScalar( fixedTerms, movingTerms, numberOfSamples,
+    fixedKernelOrder, movingKernelOrder,
+    fixedTermToIndexOffset, movingTermToIndexOffset, pdf, stride );
+
+} // end UpdateJointPDF()
+
+
+} // end namespace itk
+
+#endif // end #ifndef __itkJointPDFBatchUpdater_cxx
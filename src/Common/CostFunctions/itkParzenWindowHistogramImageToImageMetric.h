@@ -20,6 +20,7 @@
 
 #include "itkAdvancedImageToImageMetric.h"
 #include "itkKernelFunctionBase2.h"
+#include "itkJointPDFBatchUpdater.h"
 
 
 namespace itk
@@ -196,6 +197,24 @@ public:
   itkGetConstReferenceMacro( UseExplicitPDFDerivatives, bool );
   itkBooleanMacro( UseExplicitPDFDerivatives );
 
+  /** Option to let each thread keep track of the histogram bins it
+   * touched, so that clearing and merging the per-thread joint PDFs
+   * scales with the number of samples instead of with the number of
+   * bins times the number of threads. Useful for large histograms and
+   * many threads. Default: false.
+   */
+  itkSetMacro( UseSparsePerThreadJointPDFs, bool );
+  itkGetConstReferenceMacro( UseSparsePerThreadJointPDFs, bool );
+  itkBooleanMacro( UseSparsePerThreadJointPDFs );
+
+  /** The maximum number of bytes that the threads > 0 may allocate for
+   * their own copies of the joint PDF derivatives. When more is needed,
+   * e.g. for many parameters and bins, the joint PDF derivatives are
+   * computed single-threadedly. Default: 256 MiB.
+   */
+  itkSetMacro( MaximumMemoryForPerThreadJointPDFDerivatives, SizeValueType );
+  itkGetConstMacro( MaximumMemoryForPerThreadJointPDFDerivatives, SizeValueType );
+
   /** Whether you plan to call the GetDerivative/GetValueAndDerivative method or not.
    * This option should be set before calling Initialize(); Default: false.
    */
@@ -208,6 +227,14 @@ public:
   itkSetMacro( UseFiniteDifferenceDerivative, bool );
   itkGetConstMacro( UseFiniteDifferenceDerivative, bool );
 
+  /** The finite difference derivative sets the transform parameters, so it
+   * cannot be evaluated concurrently with other metrics.
+   */
+  virtual bool GetSupportsConcurrentEvaluation( void ) const
+  {
+    return !this->m_UseFiniteDifferenceDerivative;
+  }
+
   /** For computing the finite difference derivative, the perturbation (delta) of the
    * transform parameters; default: 1.0.
    * mu_right= mu + delta*e_k
@@ -313,6 +340,18 @@ protected:
   {
     SizeValueType   st_NumberOfPixelsCounted;
     JointPDFPointer st_JointPDF;
+
+    /** For each fixed bin, the range [ begin, end [ of moving bins
+     * touched in st_JointPDF. Only used for sparse per-thread PDFs.
+     */
+    std::vector< OffsetValueType > st_TouchedRowBegin;
+    std::vector< OffsetValueType > st_TouchedRowEnd;
+
+    /** The joint PDF derivatives of this thread. Only allocated for
+     * threads > 0 and explicit PDF derivatives, and released after they
+     * have been accumulated; thread 0 directly uses m_JointPDFDerivatives.
+     */
+    JointPDFDerivativesPointer st_JointPDFDerivatives;
   };
   itkPadStruct( ITK_CACHE_LINE_ALIGNMENT, ParzenWindowHistogramGetValueAndDerivativePerThreadStruct,
     PaddedParzenWindowHistogramGetValueAndDerivativePerThreadStruct );
@@ -327,9 +366,36 @@ protected:
   /** Multi-threaded versions of the ComputePDF function. */
   inline void ThreadedComputePDFs( ThreadIdType threadId );
 
-  /** Single-threadedly accumulate results. */
+  /** Accumulate results. The per-thread joint PDFs are merged in parallel. */
   inline void AfterThreadedComputePDFs( void ) const;
 
+  /** Merge the per-thread joint PDFs into m_JointPDF, for the part of the
+   * fixed bins assigned to this thread, when the merge is split over
+   * numberOfThreads threads.
+   */
+  void ThreadedReduceJointPDFs( ThreadIdType threadId, ThreadIdType numberOfThreads ) const;
+
+  /** Helper function to launch the threads. */
+  static ITK_THREAD_RETURN_TYPE ReduceJointPDFsThreaderCallback( void * arg );
+
+  /** Multi-threaded version of ComputePDFsAndPDFDerivatives(). */
+  inline void ThreadedComputePDFsAndPDFDerivatives( ThreadIdType threadId );
+
+  /** Accumulate the joint PDFs and the joint PDF derivatives of all threads. */
+  inline void AfterThreadedComputePDFsAndPDFDerivatives( void ) const;
+
+  /** Add the joint PDF derivatives of the threads > 0 to m_JointPDFDerivatives,
+   * for the part of the buffer assigned to this thread.
+   */
+  void ThreadedReduceJointPDFDerivatives( ThreadIdType threadId, ThreadIdType numberOfThreads ) const;
+
+  /** Helper functions to launch the threads. */
+  static ITK_THREAD_RETURN_TYPE ComputePDFsAndPDFDerivativesThreaderCallback( void * arg );
+
+  static ITK_THREAD_RETURN_TYPE ReduceJointPDFDerivativesThreaderCallback( void * arg );
+
+  void LaunchComputePDFsAndPDFDerivativesThreaderCallback( void ) const;
+
   /** Helper function to launch the threads. */
   static ITK_THREAD_RETURN_TYPE ComputePDFsThreaderCallback( void * arg );
 
@@ -348,14 +414,36 @@ protected:
     ParzenValueContainerType & parzenValues ) const;
 
   /** Update the joint PDF with a pixel pair; on demand also updates the
-   * pdf derivatives (if the Jacobian pointers are nonzero).
+   * pdf derivatives (if the Jacobian pointers are nonzero). The pdf
+   * derivatives are added to jointPDFDerivatives, or to
+   * m_JointPDFDerivatives if it is NULL.
    */
   virtual void UpdateJointPDFAndDerivatives(
     const RealType & fixedImageValue,
     const RealType & movingImageValue,
     const DerivativeType * imageJacobian,
     const NonZeroJacobianIndicesType * nzji,
-    JointPDFType * jointPDF ) const;
+    JointPDFType * jointPDF,
+    JointPDFDerivativesType * jointPDFDerivatives = NULL ) const;
+
+  /** The number of samples that UpdateJointPDFBatch() handles at once. */
+  itkStaticConstMacro( JointPDFBatchSize, unsigned int, 64 );
+
+  /** Update the joint PDF with a batch of pixel pairs. Equivalent to calling
+   * UpdateJointPDFAndDerivatives( f, m, 0, 0, jointPDF ) for each pair, but
+   * the Parzen weights are computed for the whole batch at once and added
+   * directly to the buffer of the joint PDF, using AVX2 or AVX-512 when the
+   * CPU supports it. See JointPDFBatchUpdater.
+   * When touchedRowBegin and touchedRowEnd are given, the range of moving
+   * bins touched in each fixed bin row is extended with the updated bins.
+   */
+  void UpdateJointPDFBatch(
+    const double * fixedImageValues,
+    const double * movingImageValues,
+    SizeValueType numberOfSamples,
+    JointPDFType * jointPDF,
+    OffsetValueType * touchedRowBegin = NULL,
+    OffsetValueType * touchedRowEnd = NULL ) const;
 
   /** Update the joint PDF and the incremental pdfs.
    * The input is a pixel pair (fixed, moving, moving mask) and
@@ -383,7 +471,8 @@ protected:
   void UpdateJointPDFDerivatives(
     const JointPDFIndexType & pdfIndex, double factor,
     const DerivativeType & imageJacobian,
-    const NonZeroJacobianIndicesType & nzji ) const;
+    const NonZeroJacobianIndicesType & nzji,
+    JointPDFDerivativesType * jointPDFDerivatives ) const;
 
   /** Multiply the pdf entries by the given normalization factor. */
   virtual void NormalizeJointPDF(
@@ -421,6 +510,9 @@ protected:
    */
   virtual void ComputePDFsAndPDFDerivatives( const ParametersType & parameters ) const;
 
+  /** Single-threaded version of ComputePDFsAndPDFDerivatives(). */
+  virtual void ComputePDFsAndPDFDerivativesSingleThreaded( const ParametersType & parameters ) const;
+
   /** Compute PDFs and incremental pdfs (which you can use to compute finite
    * difference estimate of the derivative).
    * Loops over the fixed image samples and constructs the m_JointPDF,
@@ -495,6 +587,8 @@ private:
   unsigned int  m_MovingKernelBSplineOrder;
   bool          m_UseDerivative;
   bool          m_UseExplicitPDFDerivatives;
+  bool          m_UseSparsePerThreadJointPDFs;
+  SizeValueType m_MaximumMemoryForPerThreadJointPDFDerivatives;
   bool          m_UseFiniteDifferenceDerivative;
   double        m_FiniteDifferencePerturbation;
 
@@ -25,6 +25,7 @@
 #include "itkImageLinearIteratorWithIndex.h"
 #include "itkImageScanlineIterator.h"
 #include "vnl/vnl_math.h"
+#include <algorithm>
 
 namespace itk
 {
@@ -67,7 +68,9 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
   this->SetUseFixedImageLimiter( true );
   this->SetUseMovingImageLimiter( true );
 
-  this->m_UseExplicitPDFDerivatives = true;
+  this->m_UseExplicitPDFDerivatives                    = true;
+  this->m_UseSparsePerThreadJointPDFs                  = false;
+  this->m_MaximumMemoryForPerThreadJointPDFDerivatives = 256 * 1024 * 1024;
 
   /** Initialize the m_ParzenWindowHistogramThreaderParameters */
   this->m_ParzenWindowHistogramThreaderParameters.m_Metric = this;
@@ -493,6 +496,14 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
       jointPDF->SetRegions( jointPDFRegion );
       jointPDF->Allocate();
     }
+
+    /** Mark all bins as touched, so that the first sparse clear
+     * initializes the complete joint pdf.
+     */
+    this->m_ParzenWindowHistogramGetValueAndDerivativePerThreadVariables[ i ].st_TouchedRowBegin
+      .assign( this->m_NumberOfFixedHistogramBins, 0 );
+    this->m_ParzenWindowHistogramGetValueAndDerivativePerThreadVariables[ i ].st_TouchedRowEnd
+      .assign( this->m_NumberOfFixedHistogramBins, this->m_NumberOfMovingHistogramBins );
   }
 
 } // end InitializeThreadingParameters()
@@ -564,7 +575,8 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
   const RealType & movingImageValue,
   const DerivativeType * imageJacobian,
   const NonZeroJacobianIndicesType * nzji,
-  JointPDFType * jointPDF ) const
+  JointPDFType * jointPDF,
+  JointPDFDerivativesType * jointPDFDerivatives ) const
 {
   typedef ImageScanlineIterator< JointPDFType > PDFIteratorType;
 
@@ -641,7 +653,7 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
         it.Value() += static_cast< PDFValueType >( fv * movingParzenValues[ m ] );
         this->UpdateJointPDFDerivatives(
           it.GetIndex(), fv_et * derivativeMovingParzenValues[ m ],
-          *imageJacobian, *nzji );
+          *imageJacobian, *nzji, jointPDFDerivatives );
         ++it;
       }
       it.NextLine();
@@ -651,6 +663,66 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
 } // end UpdateJointPDFAndDerivatives()
 
 
+/**
+ * ********************** UpdateJointPDFBatch ***************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
+::UpdateJointPDFBatch(
+  const double * fixedImageValues,
+  const double * movingImageValues,
+  SizeValueType numberOfSamples,
+  JointPDFType * jointPDF,
+  OffsetValueType * touchedRowBegin,
+  OffsetValueType * touchedRowEnd ) const
+{
+  if( numberOfSamples == 0 ) { return; }
+
+  /** Determine Parzen window arguments (see eq. 6 of Mattes paper [2]). */
+  double fixedImageParzenWindowTerms[ JointPDFBatchSize ];
+  double movingImageParzenWindowTerms[ JointPDFBatchSize ];
+  for( SizeValueType i = 0; i < numberOfSamples; ++i )
+  {
+    fixedImageParzenWindowTerms[ i ]
+      = fixedImageValues[ i ] / this->m_FixedImageBinSize - this->m_FixedImageNormalizedMin;
+    movingImageParzenWindowTerms[ i ]
+      = movingImageValues[ i ] / this->m_MovingImageBinSize - this->m_MovingImageNormalizedMin;
+  }
+
+  /** Add the Parzen windows of all samples directly to the buffer of the
+   * joint PDF. The moving bin index runs fastest, so the row stride is
+   * the offset of the fixed bin index.
+   */
+  JointPDFBatchUpdater::UpdateJointPDF(
+    fixedImageParzenWindowTerms, movingImageParzenWindowTerms, numberOfSamples,
+    this->m_FixedKernelBSplineOrder, this->m_MovingKernelBSplineOrder,
+    this->m_FixedParzenTermToIndexOffset, this->m_MovingParzenTermToIndexOffset,
+    jointPDF->GetBufferPointer(), jointPDF->GetOffsetTable()[ 1 ] );
+
+  /** Keep track of the touched bins. */
+  if( touchedRowBegin != NULL )
+  {
+    const OffsetValueType fixedWindowSize  = this->m_FixedKernelBSplineOrder + 1;
+    const OffsetValueType movingWindowSize = this->m_MovingKernelBSplineOrder + 1;
+    for( SizeValueType i = 0; i < numberOfSamples; ++i )
+    {
+      const OffsetValueType fixedIndex = static_cast< OffsetValueType >( std::floor(
+        fixedImageParzenWindowTerms[ i ] + this->m_FixedParzenTermToIndexOffset ) );
+      const OffsetValueType movingIndex = static_cast< OffsetValueType >( std::floor(
+        movingImageParzenWindowTerms[ i ] + this->m_MovingParzenTermToIndexOffset ) );
+      for( OffsetValueType f = fixedIndex; f < fixedIndex + fixedWindowSize; ++f )
+      {
+        touchedRowBegin[ f ] = std::min( touchedRowBegin[ f ], movingIndex );
+        touchedRowEnd[ f ]   = std::max( touchedRowEnd[ f ], movingIndex + movingWindowSize );
+      }
+    }
+  }
+
+} // end UpdateJointPDFBatch()
+
+
 /**
  * *************** UpdateJointPDFDerivatives ***************************
  */
@@ -661,12 +733,19 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
 ::UpdateJointPDFDerivatives(
   const JointPDFIndexType & pdfIndex, double factor,
   const DerivativeType & imageJacobian,
-  const NonZeroJacobianIndicesType & nzji ) const
+  const NonZeroJacobianIndicesType & nzji,
+  JointPDFDerivativesType * jointPDFDerivatives ) const
 {
+  /** Use the member by default. */
+  if( jointPDFDerivatives == NULL )
+  {
+    jointPDFDerivatives = this->m_JointPDFDerivatives.GetPointer();
+  }
+
   /** Get the pointer to the element with index [0, pdfIndex[0], pdfIndex[1]]. */
-  PDFDerivativeValueType * derivPtr = this->m_JointPDFDerivatives->GetBufferPointer()
-    + ( pdfIndex[ 0 ] * this->m_JointPDFDerivatives->GetOffsetTable()[ 1 ] )
-    + ( pdfIndex[ 1 ] * this->m_JointPDFDerivatives->GetOffsetTable()[ 2 ] );
+  PDFDerivativeValueType * derivPtr = jointPDFDerivatives->GetBufferPointer()
+    + ( pdfIndex[ 0 ] * jointPDFDerivatives->GetOffsetTable()[ 1 ] )
+    + ( pdfIndex[ 1 ] * jointPDFDerivatives->GetOffsetTable()[ 2 ] );
 
   if( nzji.size() == this->GetNumberOfParameters() )
   {
@@ -1053,6 +1132,11 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
   typename ImageSampleContainerType::ConstIterator fbegin = sampleContainer->Begin();
   typename ImageSampleContainerType::ConstIterator fend   = sampleContainer->End();
 
+  /** The valid samples are added to the joint PDF in batches. */
+  double        fixedImageValues[ JointPDFBatchSize ];
+  double        movingImageValues[ JointPDFBatchSize ];
+  SizeValueType batchSize = 0;
+
   /** Loop over sample container and compute contribution of each sample to pdfs. */
   for( fiter = fbegin; fiter != fend; ++fiter )
   {
@@ -1090,13 +1174,23 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
       fixedImageValue  = this->GetFixedImageLimiter()->Evaluate( fixedImageValue );
       movingImageValue = this->GetMovingImageLimiter()->Evaluate( movingImageValue );
 
-      /** Compute this sample's contribution to the joint distributions. */
-      this->UpdateJointPDFAndDerivatives(
-        fixedImageValue, movingImageValue, 0, 0, this->m_JointPDF.GetPointer() );
+      /** Store this sample's contribution to the joint distributions. */
+      fixedImageValues[ batchSize ]  = fixedImageValue;
+      movingImageValues[ batchSize ] = movingImageValue;
+      if( ++batchSize == JointPDFBatchSize )
+      {
+        this->UpdateJointPDFBatch( fixedImageValues, movingImageValues,
+          batchSize, this->m_JointPDF.GetPointer() );
+        batchSize = 0;
+      }
     }
 
   } // end iterating over fixed image spatial sample container for loop
 
+  /** Add the last, incomplete batch. */
+  this->UpdateJointPDFBatch( fixedImageValues, movingImageValues,
+    batchSize, this->m_JointPDF.GetPointer() );
+
   /** Check if enough samples were valid. */
   this->CheckNumberOfSamples( sampleContainer->Size(), this->m_NumberOfPixelsCounted );
 
@@ -1159,75 +1253,119 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
    * instead of sequentially in InitializeThreadingParameters().
    */
   JointPDFPointer & jointPDF = this->m_ParzenWindowHistogramGetValueAndDerivativePerThreadVariables[ threadId ].st_JointPDF;
-  jointPDF->FillBuffer( NumericTraits< PDFValueType >::ZeroValue() );
+  std::vector< OffsetValueType > & touchedRowBegin
+    = this->m_ParzenWindowHistogramGetValueAndDerivativePerThreadVariables[ threadId ].st_TouchedRowBegin;
+  std::vector< OffsetValueType > & touchedRowEnd
+    = this->m_ParzenWindowHistogramGetValueAndDerivativePerThreadVariables[ threadId ].st_TouchedRowEnd;
+  const OffsetValueType numberOfFixedBins  = static_cast< OffsetValueType >( touchedRowBegin.size() );
+  const OffsetValueType numberOfMovingBins = this->m_NumberOfMovingHistogramBins;
+
+  OffsetValueType * rowBegin = NULL;
+  OffsetValueType * rowEnd   = NULL;
+  if( this->m_UseSparsePerThreadJointPDFs )
+  {
+    /** Only clear the bins that were touched during the previous call,
+     * and start with empty ranges.
+     */
+    PDFValueType * pdfRow = jointPDF->GetBufferPointer();
+    for( OffsetValueType f = 0; f < numberOfFixedBins; ++f, pdfRow += numberOfMovingBins )
+    {
+      if( touchedRowBegin[ f ] < touchedRowEnd[ f ] )
+      {
+        std::fill( pdfRow + touchedRowBegin[ f ], pdfRow + touchedRowEnd[ f ],
+          NumericTraits< PDFValueType >::ZeroValue() );
+      }
+      touchedRowBegin[ f ] = numberOfMovingBins;
+      touchedRowEnd[ f ]   = 0;
+    }
+    rowBegin = &touchedRowBegin[ 0 ];
+    rowEnd   = &touchedRowEnd[ 0 ];
+  }
+  else
+  {
+    /** Clear everything, and mark everything as touched. */
+    jointPDF->FillBuffer( NumericTraits< PDFValueType >::ZeroValue() );
+    std::fill( touchedRowBegin.begin(), touchedRowBegin.end(), 0 );
+    std::fill( touchedRowEnd.begin(), touchedRowEnd.end(), numberOfMovingBins );
+  }
 
   /** Get a handle to the sample container. */
-  ImageSampleContainerPointer sampleContainer     = this->GetImageSampler()->GetOutput();
-  const unsigned long         sampleContainerSize = sampleContainer->Size();
-
-  /** Get the samples for this thread. */
-  const unsigned long nrOfSamplesPerThreads
-    = static_cast< unsigned long >( vcl_ceil( static_cast< double >( sampleContainerSize )
-    / static_cast< double >( this->m_NumberOfThreads ) ) );
-
-  unsigned long pos_begin = nrOfSamplesPerThreads * threadId;
-  unsigned long pos_end   = nrOfSamplesPerThreads * ( threadId + 1 );
-  pos_begin = ( pos_begin > sampleContainerSize ) ? sampleContainerSize : pos_begin;
-  pos_end   = ( pos_end > sampleContainerSize ) ? sampleContainerSize : pos_end;
-
-  /** Create iterator over the sample container. */
-  typename ImageSampleContainerType::ConstIterator fiter;
-  typename ImageSampleContainerType::ConstIterator fbegin = sampleContainer->Begin();
-  typename ImageSampleContainerType::ConstIterator fend   = sampleContainer->Begin();
-  fbegin                                                 += (int)pos_begin;
-  fend                                                   += (int)pos_end;
+  ImageSampleContainerPointer sampleContainer = this->GetImageSampler()->GetOutput();
 
   /** Create variables to store intermediate results. circumvent false sharing */
   unsigned long numberOfPixelsCounted = 0;
 
-  /** Loop over sample container and compute contribution of each sample to pdfs. */
-  for( fiter = fbegin; fiter != fend; ++fiter )
+  /** The valid samples are added to the joint PDF in batches. */
+  double        fixedImageValues[ JointPDFBatchSize ];
+  double        movingImageValues[ JointPDFBatchSize ];
+  SizeValueType batchSize = 0;
+
+  /** Loop over the blocks of samples assigned to this thread. */
+  SizeValueType pos_begin = 0;
+  SizeValueType pos_end   = 0;
+  while( this->GetNextSampleBlock( threadId, pos_begin, pos_end ) )
   {
-    /** Read fixed coordinates and initialize some variables. */
-    const FixedImagePointType & fixedPoint = ( *fiter ).Value().m_ImageCoordinates;
-    RealType                    movingImageValue;
-    MovingImagePointType        mappedPoint;
+    /** Create iterator over the sample container. */
+    typename ImageSampleContainerType::ConstIterator fiter;
+    typename ImageSampleContainerType::ConstIterator fbegin = sampleContainer->Begin();
+    typename ImageSampleContainerType::ConstIterator fend   = sampleContainer->Begin();
+    fbegin += (int)pos_begin;
+    fend   += (int)pos_end;
+
+    /** Loop over sample container and compute contribution of each sample to pdfs. */
+    for( fiter = fbegin; fiter != fend; ++fiter )
+    {
+      /** Read fixed coordinates and initialize some variables. */
+      const FixedImagePointType & fixedPoint = ( *fiter ).Value().m_ImageCoordinates;
+      RealType                    movingImageValue;
+      MovingImagePointType        mappedPoint;
 
-    /** Transform point and check if it is inside the B-spline support region. */
-    bool sampleOk = this->TransformPoint( fixedPoint, mappedPoint );
+      /** Transform point and check if it is inside the B-spline support region. */
+      bool sampleOk = this->TransformPointOfSample( threadId, fiter.Index(), fixedPoint, mappedPoint );
 
-    /** Check if point is inside mask. */
-    if( sampleOk )
-    {
-      sampleOk = this->IsInsideMovingMask( mappedPoint );
-    }
+      /** Check if point is inside mask. */
+      if( sampleOk )
+      {
+        sampleOk = this->IsInsideMovingMask( mappedPoint );
+      }
 
-    /** Compute the moving image value and check if the point is
-     * inside the moving image buffer.
-     */
-    if( sampleOk )
-    {
-      sampleOk = this->EvaluateMovingImageValueAndDerivative(
-        mappedPoint, movingImageValue, 0 );
-    }
+      /** Compute the moving image value and check if the point is
+       * inside the moving image buffer.
+       */
+      if( sampleOk )
+      {
+        sampleOk = this->EvaluateMovingImageValueAndDerivative(
+          mappedPoint, movingImageValue, 0 );
+      }
 
-    if( sampleOk )
-    {
-      numberOfPixelsCounted++;
+      if( sampleOk )
+      {
+        numberOfPixelsCounted++;
 
-      /** Get the fixed image value. */
-      RealType fixedImageValue = static_cast< RealType >( ( *fiter ).Value().m_ImageValue );
+        /** Get the fixed image value. */
+        RealType fixedImageValue = static_cast< RealType >( ( *fiter ).Value().m_ImageValue );
 
-      /** Make sure the values fall within the histogram range. */
-      fixedImageValue  = this->GetFixedImageLimiter()->Evaluate( fixedImageValue );
-      movingImageValue = this->GetMovingImageLimiter()->Evaluate( movingImageValue );
+        /** Make sure the values fall within the histogram range. */
+        fixedImageValue  = this->GetFixedImageLimiter()->Evaluate( fixedImageValue );
+        movingImageValue = this->GetMovingImageLimiter()->Evaluate( movingImageValue );
 
-      /** Compute this sample's contribution to the joint distributions. */
-      this->UpdateJointPDFAndDerivatives(
-        fixedImageValue, movingImageValue, 0, 0,
-        jointPDF.GetPointer() );
-    }
-  } // end iterating over fixed image spatial sample container for loop
+        /** Store this sample's contribution to the joint distributions. */
+        fixedImageValues[ batchSize ]  = fixedImageValue;
+        movingImageValues[ batchSize ] = movingImageValue;
+        if( ++batchSize == JointPDFBatchSize )
+        {
+          this->UpdateJointPDFBatch( fixedImageValues, movingImageValues,
+            batchSize, jointPDF.GetPointer(), rowBegin, rowEnd );
+          batchSize = 0;
+        }
+      }
+    } // end iterating over fixed image spatial sample container for loop
+
+  } // end while loop over the sample blocks
+
+  /** Add the last, incomplete batch. */
+  this->UpdateJointPDFBatch( fixedImageValues, movingImageValues,
+    batchSize, jointPDF.GetPointer(), rowBegin, rowEnd );
 
   /** Only update these variables at the end to prevent unnecessary "false sharing". */
   this->m_ParzenWindowHistogramGetValueAndDerivativePerThreadVariables[ threadId ].st_NumberOfPixelsCounted = numberOfPixelsCounted;
@@ -1264,40 +1402,89 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
   /** Compute alpha. */
   this->m_Alpha = 1.0 / static_cast< double >( this->m_NumberOfPixelsCounted );
 
-  /** Accumulate joint histogram. */
-  // could be multi-threaded too, by each thread updating only a part of the JointPDF.
-  typedef ImageScanlineIterator< JointPDFType > JointPDFIteratorType;
-  JointPDFIteratorType                it( this->m_JointPDF, this->m_JointPDF->GetBufferedRegion() );
-  std::vector< JointPDFIteratorType > itT( this->m_NumberOfThreads );
-  for( ThreadIdType i = 0; i < this->m_NumberOfThreads; ++i )
+  /** Accumulate joint histogram. Each thread merges a block of fixed bins
+   * of all per-thread joint PDFs. For small histograms launching the threads
+   * costs more than it saves, so then the merge is done by this thread.
+   */
+  const SizeValueType numberOfBinsToMerge = this->m_NumberOfFixedHistogramBins
+    * this->m_NumberOfMovingHistogramBins * this->m_NumberOfThreads;
+  if( this->m_NumberOfThreads > 1 && numberOfBinsToMerge >= 65536 )
+  {
+    PersistentThreadPool::SingleMethodExecute( this->m_Threader,
+      this->ReduceJointPDFsThreaderCallback,
+      const_cast< void * >( static_cast< const void * >( &this->m_ParzenWindowHistogramThreaderParameters ) ) );
+  }
+  else
   {
-    itT[ i ] = JointPDFIteratorType(
-      this->m_ParzenWindowHistogramGetValueAndDerivativePerThreadVariables[ i ].st_JointPDF,
-      this->m_JointPDF->GetBufferedRegion() );
+    this->ThreadedReduceJointPDFs( 0, 1 );
   }
 
-  PDFValueType sum;
-  while( !it.IsAtEnd() )
+} // end AfterThreadedComputePDFs()
+
+
+/**
+ * ******************* ThreadedReduceJointPDFs *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
+::ThreadedReduceJointPDFs( ThreadIdType threadId, ThreadIdType numberOfThreads ) const
+{
+  /** Determine the block of fixed bins (rows) for this thread. */
+  const OffsetValueType numberOfFixedBins  = this->m_NumberOfFixedHistogramBins;
+  const OffsetValueType numberOfMovingBins = this->m_NumberOfMovingHistogramBins;
+  const OffsetValueType rowsPerThread
+    = ( numberOfFixedBins + numberOfThreads - 1 ) / numberOfThreads;
+  const OffsetValueType rowBegin = std::min( numberOfFixedBins,
+    static_cast< OffsetValueType >( threadId ) * rowsPerThread );
+  const OffsetValueType rowEnd = std::min( numberOfFixedBins, rowBegin + rowsPerThread );
+
+  /** Add the touched part of each row of each per-thread joint PDF. The
+   * threads are added in the same order as before, so the result does not
+   * depend on the number of threads that do the merge.
+   */
+  PDFValueType * pdfRow = this->m_JointPDF->GetBufferPointer() + rowBegin * numberOfMovingBins;
+  for( OffsetValueType f = rowBegin; f < rowEnd; ++f, pdfRow += numberOfMovingBins )
   {
-    while( !it.IsAtEndOfLine() )
+    std::fill( pdfRow, pdfRow + numberOfMovingBins, NumericTraits< PDFValueType >::ZeroValue() );
+    for( ThreadIdType i = 0; i < this->m_NumberOfThreads; ++i )
     {
-      sum = NumericTraits< PDFValueType >::Zero;
-      for( ThreadIdType i = 0; i < this->m_NumberOfThreads; ++i )
+      const ParzenWindowHistogramGetValueAndDerivativePerThreadStruct & perThread
+        = this->m_ParzenWindowHistogramGetValueAndDerivativePerThreadVariables[ i ];
+      const OffsetValueType begin = perThread.st_TouchedRowBegin[ f ];
+      const OffsetValueType end   = perThread.st_TouchedRowEnd[ f ];
+      const PDFValueType *  src   = perThread.st_JointPDF->GetBufferPointer() + f * numberOfMovingBins;
+      for( OffsetValueType m = begin; m < end; ++m )
       {
-        sum += itT[ i ].Value();
-        ++itT[ i ];
+        pdfRow[ m ] += src[ m ];
       }
-      it.Set( sum );
-      ++it;
-    }
-    it.NextLine();
-    for( ThreadIdType i = 0; i < this->m_NumberOfThreads; ++i )
-    {
-      itT[ i ].NextLine();
     }
   }
 
-} // end AfterThreadedComputePDFs()
+} // end ThreadedReduceJointPDFs()
+
+
+/**
+ * **************** ReduceJointPDFsThreaderCallback *******
+ */
+
+template< class TFixedImage, class TMovingImage >
+ITK_THREAD_RETURN_TYPE
+ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
+::ReduceJointPDFsThreaderCallback( void * arg )
+{
+  ThreadInfoType * infoStruct = static_cast< ThreadInfoType * >( arg );
+  ThreadIdType     threadId   = infoStruct->ThreadID;
+
+  ParzenWindowHistogramMultiThreaderParameterType * temp
+    = static_cast< ParzenWindowHistogramMultiThreaderParameterType * >( infoStruct->UserData );
+
+  temp->m_Metric->ThreadedReduceJointPDFs( threadId, infoStruct->NumberOfThreads );
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end ReduceJointPDFsThreaderCallback()
 
 
 /**
@@ -1331,25 +1518,26 @@ void
 ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
 ::LaunchComputePDFsThreaderCallback( void ) const
 {
-  /** Setup threader. */
-  this->m_Threader->SetSingleMethod( this->ComputePDFsThreaderCallback,
-    const_cast< void * >( static_cast< const void * >(
-      &this->m_ParzenWindowHistogramThreaderParameters ) ) );
+  /** Distribute the samples over the threads. */
+  this->InitializeSampleBlockScheduler();
 
-  /** Launch. */
-  this->m_Threader->SingleMethodExecute();
+  /** Launch, on the shared thread pool when available. */
+  PersistentThreadPool::SingleMethodExecute( this->m_Threader,
+    this->ComputePDFsThreaderCallback,
+    const_cast< void * >( static_cast< const void * >( &this->m_ParzenWindowHistogramThreaderParameters ) ) );
+  this->FinalizeSampleBlockScheduler();
 
 } // end LaunchComputePDFsThreaderCallback()
 
 
 /**
- * ************************ ComputePDFsAndPDFDerivatives *******************
+ * ************************ ComputePDFsAndPDFDerivativesSingleThreaded *******************
  */
 
 template< class TFixedImage, class TMovingImage >
 void
 ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
-::ComputePDFsAndPDFDerivatives( const ParametersType & parameters ) const
+::ComputePDFsAndPDFDerivativesSingleThreaded( const ParametersType & parameters ) const
 {
   /** Initialize some variables. */
   this->m_JointPDF->FillBuffer( 0.0 );
@@ -1449,9 +1637,322 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
     this->m_Alpha = 1.0 / static_cast< double >( this->m_NumberOfPixelsCounted );
   }
 
+} // end ComputePDFsAndPDFDerivativesSingleThreaded()
+
+
+/**
+ * ************************ ComputePDFsAndPDFDerivatives *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
+::ComputePDFsAndPDFDerivatives( const ParametersType & parameters ) const
+{
+  /** Option for now to still use the single threaded code. */
+  if( !this->m_UseMultiThread )
+  {
+    return this->ComputePDFsAndPDFDerivativesSingleThreaded( parameters );
+  }
+
+  /** Each thread > 0 needs a copy of the joint PDF derivatives, which has
+   * the number of parameters times the number of bins squared values. Use
+   * the single threaded code when these copies do not fit in the budget.
+   */
+  const SizeValueType memoryForPerThreadJointPDFDerivatives
+    = static_cast< SizeValueType >( this->m_NumberOfThreads - 1 )
+    * this->m_JointPDFDerivatives->GetLargestPossibleRegion().GetNumberOfPixels()
+    * sizeof( PDFDerivativeValueType );
+  if( memoryForPerThreadJointPDFDerivatives > this->m_MaximumMemoryForPerThreadJointPDFDerivatives )
+  {
+    return this->ComputePDFsAndPDFDerivativesSingleThreaded( parameters );
+  }
+
+  /** Call non-thread-safe stuff, such as:
+   *   this->SetTransformParameters( parameters );
+   *   this->GetImageSampler()->Update();
+   * See ComputePDFs() for more information.
+   */
+  this->BeforeThreadedGetValueAndDerivative( parameters );
+
+  /** Launch multi-threading JointPDF and JointPDFDerivatives computation. */
+  this->LaunchComputePDFsAndPDFDerivativesThreaderCallback();
+
+  /** Gather the results from all threads. */
+  this->AfterThreadedComputePDFsAndPDFDerivatives();
+
 } // end ComputePDFsAndPDFDerivatives()
 
 
+/**
+ * ******************* ThreadedComputePDFsAndPDFDerivatives *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
+::ThreadedComputePDFsAndPDFDerivatives( ThreadIdType threadId )
+{
+  /** Get a handle to the pre-allocated joint PDF for the current thread,
+   * and clear it. All bins are considered touched.
+   */
+  ParzenWindowHistogramGetValueAndDerivativePerThreadStruct & perThread
+    = this->m_ParzenWindowHistogramGetValueAndDerivativePerThreadVariables[ threadId ];
+  JointPDFPointer & jointPDF = perThread.st_JointPDF;
+  jointPDF->FillBuffer( NumericTraits< PDFValueType >::ZeroValue() );
+  std::fill( perThread.st_TouchedRowBegin.begin(), perThread.st_TouchedRowBegin.end(), 0 );
+  std::fill( perThread.st_TouchedRowEnd.begin(), perThread.st_TouchedRowEnd.end(),
+    static_cast< OffsetValueType >( this->m_NumberOfMovingHistogramBins ) );
+
+  /** Thread 0 directly uses m_JointPDFDerivatives. The other threads allocate
+   * their own joint PDF derivatives here, so that this is done multi-threadedly.
+   */
+  JointPDFDerivativesType * jointPDFDerivatives = this->m_JointPDFDerivatives.GetPointer();
+  if( threadId > 0 )
+  {
+    JointPDFDerivativesPointer & threadJointPDFDerivatives = perThread.st_JointPDFDerivatives;
+    if( threadJointPDFDerivatives.IsNull() )
+    {
+      threadJointPDFDerivatives = JointPDFDerivativesType::New();
+    }
+    if( threadJointPDFDerivatives->GetLargestPossibleRegion()
+      != this->m_JointPDFDerivatives->GetLargestPossibleRegion() )
+    {
+      threadJointPDFDerivatives->SetRegions( this->m_JointPDFDerivatives->GetLargestPossibleRegion() );
+      threadJointPDFDerivatives->Allocate();
+    }
+    jointPDFDerivatives = threadJointPDFDerivatives.GetPointer();
+  }
+  jointPDFDerivatives->FillBuffer( NumericTraits< PDFDerivativeValueType >::ZeroValue() );
+
+  /** Get a handle to the sample container. */
+  ImageSampleContainerPointer sampleContainer = this->GetImageSampler()->GetOutput();
+
+  /** Create variables to store intermediate results. circumvent false sharing */
+  unsigned long numberOfPixelsCounted = 0;
+
+  /** Array that stores dM(x)/dmu, and the sparse jacobian+indices. */
+  NonZeroJacobianIndicesType nzji( this->m_AdvancedTransform->GetNumberOfNonZeroJacobianIndices() );
+  DerivativeType             imageJacobian( nzji.size() );
+  TransformJacobianType      jacobian;
+
+  /** Loop over the blocks of samples assigned to this thread. */
+  SizeValueType pos_begin = 0;
+  SizeValueType pos_end   = 0;
+  while( this->GetNextSampleBlock( threadId, pos_begin, pos_end ) )
+  {
+    /** Create iterator over the sample container. */
+    typename ImageSampleContainerType::ConstIterator fiter;
+    typename ImageSampleContainerType::ConstIterator fbegin = sampleContainer->Begin();
+    typename ImageSampleContainerType::ConstIterator fend   = sampleContainer->Begin();
+    fbegin += (int)pos_begin;
+    fend   += (int)pos_end;
+
+    /** Loop over sample container and compute contribution of each sample to pdfs. */
+    for( fiter = fbegin; fiter != fend; ++fiter )
+    {
+      /** Read fixed coordinates and initialize some variables. */
+      const FixedImagePointType & fixedPoint = ( *fiter ).Value().m_ImageCoordinates;
+      RealType                    movingImageValue;
+      MovingImagePointType        mappedPoint;
+      MovingImageDerivativeType   movingImageDerivative;
+
+      /** Transform point and check if it is inside the B-spline support region. */
+      bool sampleOk = this->TransformPointOfSample( threadId, fiter.Index(), fixedPoint, mappedPoint );
+
+      /** Check if point is inside mask. */
+      if( sampleOk )
+      {
+        sampleOk = this->IsInsideMovingMask( mappedPoint );
+      }
+
+      /** Compute the moving image value M(T(x)) and derivative dM/dx and check if
+       * the point is inside the moving image buffer.
+       */
+      if( sampleOk )
+      {
+        sampleOk = this->EvaluateMovingImageValueAndDerivative(
+          mappedPoint, movingImageValue, &movingImageDerivative );
+      }
+
+      if( sampleOk )
+      {
+        numberOfPixelsCounted++;
+
+        /** Get the fixed image value. */
+        RealType fixedImageValue = static_cast< RealType >( ( *fiter ).Value().m_ImageValue );
+
+        /** Make sure the values fall within the histogram range. */
+        fixedImageValue  = this->GetFixedImageLimiter()->Evaluate( fixedImageValue );
+        movingImageValue = this->GetMovingImageLimiter()->Evaluate(
+          movingImageValue, movingImageDerivative );
+
+        /** Compute the inner product (dM/dx)^T (dT/dmu), from the cached
+         * B-spline weights when available.
+         */
+        if( !this->EvaluateTransformJacobianInnerProductOfSample( threadId, fiter.Index(),
+          fixedPoint, movingImageDerivative, imageJacobian, nzji ) )
+        {
+          /** Get the TransformJacobian dT/dmu. */
+          this->EvaluateTransformJacobian( fixedPoint, jacobian, nzji );
+
+          /** Compute the inner product (dM/dx)^T (dT/dmu). */
+          this->EvaluateTransformJacobianInnerProduct(
+            jacobian, movingImageDerivative, imageJacobian );
+        }
+
+        /** Update the joint pdf and the joint pdf derivatives of this thread. */
+        this->UpdateJointPDFAndDerivatives(
+          fixedImageValue, movingImageValue, &imageJacobian, &nzji,
+          jointPDF.GetPointer(), jointPDFDerivatives );
+
+      } //end if-block check sampleOk
+    }   // end iterating over fixed image spatial sample container for loop
+
+  } // end while loop over the sample blocks
+
+  /** Only update these variables at the end to prevent unnecessary "false sharing". */
+  perThread.st_NumberOfPixelsCounted = numberOfPixelsCounted;
+
+} // end ThreadedComputePDFsAndPDFDerivatives()
+
+
+/**
+ * ******************* AfterThreadedComputePDFsAndPDFDerivatives *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
+::AfterThreadedComputePDFsAndPDFDerivatives( void ) const
+{
+  /** Accumulate the number of pixels and the joint histogram, and compute alpha. */
+  this->AfterThreadedComputePDFs();
+
+  /** Accumulate the joint PDF derivatives. Each thread adds a contiguous
+   * part of the buffers of threads > 0 to m_JointPDFDerivatives.
+   */
+  const SizeValueType numberOfValuesToMerge
+    = this->m_JointPDFDerivatives->GetPixelContainer()->Size() * this->m_NumberOfThreads;
+  if( this->m_NumberOfThreads > 1 && numberOfValuesToMerge >= 65536 )
+  {
+    PersistentThreadPool::SingleMethodExecute( this->m_Threader,
+      this->ReduceJointPDFDerivativesThreaderCallback,
+      const_cast< void * >( static_cast< const void * >( &this->m_ParzenWindowHistogramThreaderParameters ) ) );
+  }
+  else
+  {
+    this->ThreadedReduceJointPDFDerivatives( 0, 1 );
+  }
+
+  /** Release the copies of the threads; they are as large as
+   * m_JointPDFDerivatives each, and are allocated again in the next call.
+   */
+  for( ThreadIdType i = 1; i < this->m_NumberOfThreads; ++i )
+  {
+    this->m_ParzenWindowHistogramGetValueAndDerivativePerThreadVariables[ i ].st_JointPDFDerivatives = NULL;
+  }
+
+} // end AfterThreadedComputePDFsAndPDFDerivatives()
+
+
+/**
+ * ******************* ThreadedReduceJointPDFDerivatives *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
+::ThreadedReduceJointPDFDerivatives( ThreadIdType threadId, ThreadIdType numberOfThreads ) const
+{
+  /** Determine the part of the buffer for this thread. */
+  const SizeValueType numberOfValues = this->m_JointPDFDerivatives->GetPixelContainer()->Size();
+  const SizeValueType valuesPerThread
+    = ( numberOfValues + numberOfThreads - 1 ) / numberOfThreads;
+  const SizeValueType begin = std::min( numberOfValues,
+    static_cast< SizeValueType >( threadId ) * valuesPerThread );
+  const SizeValueType end = std::min( numberOfValues, begin + valuesPerThread );
+
+  /** Add the joint PDF derivatives of the other threads. */
+  PDFDerivativeValueType * dst = this->m_JointPDFDerivatives->GetBufferPointer();
+  for( ThreadIdType i = 1; i < this->m_NumberOfThreads; ++i )
+  {
+    const PDFDerivativeValueType * src = this->m_ParzenWindowHistogramGetValueAndDerivativePerThreadVariables[ i ]
+      .st_JointPDFDerivatives->GetBufferPointer();
+    for( SizeValueType j = begin; j < end; ++j )
+    {
+      dst[ j ] += src[ j ];
+    }
+  }
+
+} // end ThreadedReduceJointPDFDerivatives()
+
+
+/**
+ * **************** ComputePDFsAndPDFDerivativesThreaderCallback *******
+ */
+
+template< class TFixedImage, class TMovingImage >
+ITK_THREAD_RETURN_TYPE
+ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
+::ComputePDFsAndPDFDerivativesThreaderCallback( void * arg )
+{
+  ThreadInfoType * infoStruct = static_cast< ThreadInfoType * >( arg );
+  ThreadIdType     threadId   = infoStruct->ThreadID;
+
+  ParzenWindowHistogramMultiThreaderParameterType * temp
+    = static_cast< ParzenWindowHistogramMultiThreaderParameterType * >( infoStruct->UserData );
+
+  temp->m_Metric->ThreadedComputePDFsAndPDFDerivatives( threadId );
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end ComputePDFsAndPDFDerivativesThreaderCallback()
+
+
+/**
+ * **************** ReduceJointPDFDerivativesThreaderCallback *******
+ */
+
+template< class TFixedImage, class TMovingImage >
+ITK_THREAD_RETURN_TYPE
+ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
+::ReduceJointPDFDerivativesThreaderCallback( void * arg )
+{
+  ThreadInfoType * infoStruct = static_cast< ThreadInfoType * >( arg );
+  ThreadIdType     threadId   = infoStruct->ThreadID;
+
+  ParzenWindowHistogramMultiThreaderParameterType * temp
+    = static_cast< ParzenWindowHistogramMultiThreaderParameterType * >( infoStruct->UserData );
+
+  temp->m_Metric->ThreadedReduceJointPDFDerivatives( threadId, infoStruct->NumberOfThreads );
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end ReduceJointPDFDerivativesThreaderCallback()
+
+
+/**
+ * *********************** LaunchComputePDFsAndPDFDerivativesThreaderCallback ***************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
+::LaunchComputePDFsAndPDFDerivativesThreaderCallback( void ) const
+{
+  /** Distribute the samples over the threads. */
+  this->InitializeSampleBlockScheduler();
+
+  /** Launch, on the shared thread pool when available. */
+  PersistentThreadPool::SingleMethodExecute( this->m_Threader,
+    this->ComputePDFsAndPDFDerivativesThreaderCallback,
+    const_cast< void * >( static_cast< const void * >( &this->m_ParzenWindowHistogramThreaderParameters ) ) );
+  this->FinalizeSampleBlockScheduler();
+
+} // end LaunchComputePDFsAndPDFDerivativesThreaderCallback()
+
+
 /**
  * ************************ ComputePDFsAndIncrementalPDFs *******************
  */
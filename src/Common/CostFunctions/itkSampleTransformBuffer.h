@@ -0,0 +1,195 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkSampleTransformBuffer_h
+#define __itkSampleTransformBuffer_h
+
+#include "itkObject.h"
+#include "itkObjectFactory.h"
+#include "itkMultiThreader.h"
+#include "itkAdvancedCombinationTransform.h"
+#include "itkAdvancedBSplineDeformableTransformBase.h"
+#include "itkBSplineSampleWeightCache.h"
+#include <vector>
+
+namespace itk
+{
+
+/** \class SampleTransformBuffer
+ *
+ * \brief Stores the mapped points, and for B-spline transforms the support
+ * indices and weights, of all samples of a sample container.
+ *
+ * When several metrics use the same samples and the same transform, as in
+ * the CombinationImageToImageMetric with a shared image sampler, each metric
+ * would transform every sample again. Update() transforms all samples once,
+ * multi-threaded, and the metrics read the results in their threaded loops.
+ *
+ * For a B-spline transform without initial transform, the support indices
+ * and weights are kept in a BSplineSampleWeightCache and are also used for
+ * the transform Jacobians. They are only recomputed when the samples or the
+ * B-spline grid change; the mapped points are recomputed in every Update().
+ *
+ * After Update(), all lookups are read-only and can be done from any thread,
+ * also by metrics that are evaluated concurrently. The buffer is only valid
+ * for the samples and the transform parameters of the last Update(), which
+ * IsValidFor() checks.
+ *
+ * \ingroup RegistrationMetrics
+ */
+
+template< class TSampleContainer, class TTransform >
+class SampleTransformBuffer : public Object
+{
+public:
+
+  /** Standard class typedefs. */
+  typedef SampleTransformBuffer      Self;
+  typedef Object                     Superclass;
+  typedef SmartPointer< Self >       Pointer;
+  typedef SmartPointer< const Self > ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( SampleTransformBuffer, Object );
+
+  /** Typedefs. */
+  typedef TSampleContainer                        SampleContainerType;
+  typedef TTransform                              TransformType;
+  typedef typename TransformType::ScalarType      ScalarType;
+  typedef typename TransformType::InputPointType  InputPointType;
+  typedef typename TransformType::OutputPointType OutputPointType;
+  typedef typename TransformType::ParametersType  ParametersType;
+  typedef MultiThreader                           ThreaderType;
+  typedef ThreaderType::ThreadInfoStruct          ThreadInfoType;
+
+  itkStaticConstMacro( SpaceDimension, unsigned int, TransformType::InputSpaceDimension );
+
+  typedef AdvancedCombinationTransform<
+    ScalarType, itkGetStaticConstMacro( SpaceDimension ) > CombinationTransformType;
+  typedef AdvancedBSplineDeformableTransformBase<
+    ScalarType, itkGetStaticConstMacro( SpaceDimension ) > BSplineTransformType;
+  typedef typename BSplineTransformType::IndexType         IndexType;
+  typedef BSplineSampleWeightCache<
+    ScalarType, itkGetStaticConstMacro( SpaceDimension ) > BSplineWeightCacheType;
+  typedef typename BSplineWeightCacheType::Pointer         BSplineWeightCachePointer;
+
+  /** Get the B-spline weight cache, for example to set its memory limit. */
+  itkGetObjectMacro( BSplineWeightCache, BSplineWeightCacheType );
+
+  /** Transform all samples with the current parameters of the transform.
+   * Not thread-safe; call this before the metrics launch their threads.
+   */
+  void Update( const TransformType * transform,
+    const SampleContainerType * sampleContainer, ThreadIdType numberOfThreads );
+
+  /** Mark the buffer as outdated, for example because the parameters change. */
+  void Invalidate( void );
+
+  /** Returns whether the buffer holds the samples of sampleContainer, as
+   * transformed by transform with its current parameters.
+   */
+  bool IsValidFor( const TransformType * transform,
+    const SampleContainerType * sampleContainer ) const;
+
+  /** Get the mapped point of sample sampleId. */
+  const OutputPointType & GetMappedPoint( SizeValueType sampleId ) const
+  {
+    return this->m_MappedPoints[ sampleId ];
+  }
+
+  /** Get the B-spline transform of which the weights are stored, or NULL. */
+  const BSplineTransformType * GetBSplineTransform( void ) const
+  {
+    return this->m_BSplineTransform;
+  }
+
+  /** Returns whether the support index and weights of sample sampleId are
+   * stored. They are not when the memory limit of the cache is exceeded.
+   */
+  bool HasWeights( SizeValueType sampleId ) const
+  {
+    return this->m_States[ sampleId ] != NotStored;
+  }
+
+  /** Get the support index and weights of sample sampleId. Returns false
+   * when the support region is not inside the grid. Only valid when
+   * HasWeights( sampleId ) is true.
+   */
+  bool GetSupportIndexAndWeights( SizeValueType sampleId,
+    IndexType & supportIndex, const ScalarType * & weights ) const
+  {
+    supportIndex = this->m_SupportIndices[ sampleId ];
+    weights      = this->m_Weights[ sampleId ];
+    return this->m_States[ sampleId ] == Inside;
+  }
+
+protected:
+
+  SampleTransformBuffer();
+  virtual ~SampleTransformBuffer() {}
+
+  /** PrintSelf. */
+  void PrintSelf( std::ostream & os, Indent indent ) const;
+
+  /** Get the B-spline transform of which the weights do not depend on the
+   * parameters, or NULL.
+   */
+  const BSplineTransformType * GetBSplineTransformWithFixedWeights(
+    const TransformType * transform ) const;
+
+  /** Transform the samples of one thread. */
+  void ThreadedUpdate( ThreadIdType threadId, ThreadIdType numberOfThreads );
+
+  /** The threader callback of Update(). */
+  static ITK_THREAD_RETURN_TYPE UpdateThreaderCallback( void * arg );
+
+private:
+
+  SampleTransformBuffer( const Self & ); // purposely not implemented
+  void operator=( const Self & );        // purposely not implemented
+
+  /** The state of the weights of a sample. */
+  enum { NotStored = 0, Inside = 1, Outside = 2 };
+
+  /** The per-sample results. The weights point into the cache arena. */
+  std::vector< OutputPointType >    m_MappedPoints;
+  std::vector< IndexType >          m_SupportIndices;
+  std::vector< const ScalarType * > m_Weights;
+  std::vector< unsigned char >      m_States;
+
+  /** The key of the stored results. */
+  const TransformType *        m_Transform;
+  const BSplineTransformType * m_BSplineTransform;
+  const SampleContainerType *  m_SampleContainer;
+  ModifiedTimeType             m_SampleContainerTime;
+  ParametersType               m_Parameters;
+
+  BSplineWeightCachePointer m_BSplineWeightCache;
+  ThreaderType::Pointer     m_Threader;
+
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkSampleTransformBuffer.hxx"
+#endif
+
+#endif // end #ifndef __itkSampleTransformBuffer_h
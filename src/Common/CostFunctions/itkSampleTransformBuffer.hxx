@@ -0,0 +1,269 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkSampleTransformBuffer_hxx
+#define __itkSampleTransformBuffer_hxx
+
+#include "itkSampleTransformBuffer.h"
+#include "itkPersistentThreadPool.h"
+#include <algorithm>
+
+namespace itk
+{
+
+/**
+ * ****************** Constructor *********************************
+ */
+
+template< class TSampleContainer, class TTransform >
+SampleTransformBuffer< TSampleContainer, TTransform >
+::SampleTransformBuffer()
+{
+  this->m_Transform           = NULL;
+  this->m_BSplineTransform    = NULL;
+  this->m_SampleContainer     = NULL;
+  this->m_SampleContainerTime = 0;
+  this->m_BSplineWeightCache  = BSplineWeightCacheType::New();
+  this->m_Threader            = ThreaderType::New();
+
+} // end Constructor
+
+
+/**
+ * ****************** GetBSplineTransformWithFixedWeights *********************************
+ */
+
+template< class TSampleContainer, class TTransform >
+const typename SampleTransformBuffer< TSampleContainer, TTransform >::BSplineTransformType *
+SampleTransformBuffer< TSampleContainer, TTransform >
+::GetBSplineTransformWithFixedWeights( const TransformType * transform ) const
+{
+  /** Only a B-spline transform without initial transform is supported,
+   * because only then the weights do not depend on the parameters.
+   */
+  const TransformType *            current = transform;
+  const CombinationTransformType * combo
+    = dynamic_cast< const CombinationTransformType * >( transform );
+  if( combo )
+  {
+    if( combo->GetInitialTransform() ) { return NULL; }
+    current = combo->GetCurrentTransform();
+  }
+  const BSplineTransformType * bspline
+    = dynamic_cast< const BSplineTransformType * >( current );
+  if( !bspline || !bspline->GetSupportsPrecomputedWeights() )
+  {
+    return NULL;
+  }
+  return bspline;
+
+} // end GetBSplineTransformWithFixedWeights()
+
+
+/**
+ * ****************** Update *********************************
+ */
+
+template< class TSampleContainer, class TTransform >
+void
+SampleTransformBuffer< TSampleContainer, TTransform >
+::Update( const TransformType * transform,
+  const SampleContainerType * sampleContainer, ThreadIdType numberOfThreads )
+{
+  if( !transform || !sampleContainer )
+  {
+    itkExceptionMacro( << "The transform and the sample container should be set." );
+  }
+
+  /** The threader may clamp the number of threads. */
+  this->m_Threader->SetNumberOfThreads( std::max( numberOfThreads, static_cast< ThreadIdType >( 1 ) ) );
+  const ThreadIdType  nrOfThreads     = this->m_Threader->GetNumberOfThreads();
+  const SizeValueType numberOfSamples = sampleContainer->Size();
+
+  /** Prepare the weight cache; it keeps its entries when the samples
+   * and the B-spline grid did not change.
+   */
+  const BSplineTransformType * bspline = this->GetBSplineTransformWithFixedWeights( transform );
+  if( bspline )
+  {
+    this->m_BSplineWeightCache->Initialize( bspline, sampleContainer,
+      numberOfSamples, nrOfThreads );
+    this->m_SupportIndices.resize( numberOfSamples );
+    this->m_Weights.resize( numberOfSamples );
+  }
+  this->m_MappedPoints.resize( numberOfSamples );
+  this->m_States.assign( numberOfSamples, static_cast< unsigned char >( NotStored ) );
+
+  /** Store the key. */
+  this->m_Transform           = transform;
+  this->m_BSplineTransform    = bspline;
+  this->m_SampleContainer     = sampleContainer;
+  this->m_SampleContainerTime = std::max(
+    sampleContainer->GetMTime(), sampleContainer->GetUpdateMTime() );
+  this->m_Parameters = transform->GetParameters();
+
+  /** Transform the samples, on the shared thread pool when available. */
+  PersistentThreadPool::SingleMethodExecute( this->m_Threader,
+    this->UpdateThreaderCallback, this );
+
+} // end Update()
+
+
+/**
+ * ****************** ThreadedUpdate *********************************
+ */
+
+template< class TSampleContainer, class TTransform >
+void
+SampleTransformBuffer< TSampleContainer, TTransform >
+::ThreadedUpdate( ThreadIdType threadId, ThreadIdType numberOfThreads )
+{
+  /** Determine the contiguous range of samples of this thread. */
+  const SizeValueType numberOfSamples = this->m_MappedPoints.size();
+  const SizeValueType chunkSize
+    = ( numberOfSamples + numberOfThreads - 1 ) / numberOfThreads;
+  const SizeValueType pos_begin = std::min( threadId * chunkSize, numberOfSamples );
+  const SizeValueType pos_end   = std::min( pos_begin + chunkSize, numberOfSamples );
+
+  const BSplineTransformType * bspline  = this->m_BSplineTransform;
+  const SizeValueType          capacity = this->m_BSplineWeightCache->GetCapacity();
+
+  for( SizeValueType i = pos_begin; i < pos_end; ++i )
+  {
+    const InputPointType & point = this->m_SampleContainer->ElementAt( i ).m_ImageCoordinates;
+
+    if( !bspline )
+    {
+      this->m_MappedPoints[ i ] = this->m_Transform->TransformPoint( point );
+      continue;
+    }
+
+    /** Outside the valid region the B-spline is the identity. */
+    IndexType          supportIndex;
+    const ScalarType * weights = NULL;
+    const bool         inside  = this->m_BSplineWeightCache->GetSupportIndexAndWeights(
+      threadId, i, point, supportIndex, weights );
+    if( inside )
+    {
+      bspline->TransformPointUsingWeights( point, supportIndex, weights,
+        this->m_MappedPoints[ i ] );
+    }
+    else
+    {
+      this->m_MappedPoints[ i ] = point;
+    }
+
+    /** Samples beyond the capacity of the cache use a per-thread buffer,
+     * so their weights are not kept.
+     */
+    if( i < capacity )
+    {
+      this->m_SupportIndices[ i ] = supportIndex;
+      this->m_Weights[ i ]        = weights;
+      this->m_States[ i ]         = inside ? Inside : Outside;
+    }
+  }
+
+} // end ThreadedUpdate()
+
+
+/**
+ * ****************** UpdateThreaderCallback *********************************
+ */
+
+template< class TSampleContainer, class TTransform >
+ITK_THREAD_RETURN_TYPE
+SampleTransformBuffer< TSampleContainer, TTransform >
+::UpdateThreaderCallback( void * arg )
+{
+  ThreadInfoType * infoStruct  = static_cast< ThreadInfoType * >( arg );
+  ThreadIdType     threadId    = infoStruct->ThreadID;
+  ThreadIdType     nrOfThreads = infoStruct->NumberOfThreads;
+
+  Self * temp = static_cast< Self * >( infoStruct->UserData );
+  temp->ThreadedUpdate( threadId, nrOfThreads );
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end UpdateThreaderCallback()
+
+
+/**
+ * ****************** Invalidate *********************************
+ */
+
+template< class TSampleContainer, class TTransform >
+void
+SampleTransformBuffer< TSampleContainer, TTransform >
+::Invalidate( void )
+{
+  this->m_Transform        = NULL;
+  this->m_BSplineTransform = NULL;
+  this->m_SampleContainer  = NULL;
+
+} // end Invalidate()
+
+
+/**
+ * ****************** IsValidFor *********************************
+ */
+
+template< class TSampleContainer, class TTransform >
+bool
+SampleTransformBuffer< TSampleContainer, TTransform >
+::IsValidFor( const TransformType * transform,
+  const SampleContainerType * sampleContainer ) const
+{
+  if( !sampleContainer || transform != this->m_Transform
+    || sampleContainer != this->m_SampleContainer )
+  {
+    return false;
+  }
+
+  /** The sample container is regenerated when new samples are selected. */
+  const ModifiedTimeType sampleContainerTime = std::max(
+    sampleContainer->GetMTime(), sampleContainer->GetUpdateMTime() );
+  return sampleContainerTime == this->m_SampleContainerTime
+         && sampleContainer->Size() == this->m_MappedPoints.size()
+         && transform->GetParameters() == this->m_Parameters;
+
+} // end IsValidFor()
+
+
+/**
+ * ****************** PrintSelf *********************************
+ */
+
+template< class TSampleContainer, class TTransform >
+void
+SampleTransformBuffer< TSampleContainer, TTransform >
+::PrintSelf( std::ostream & os, Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "NumberOfSamples: " << this->m_MappedPoints.size() << std::endl;
+  os << indent << "Transform: " << this->m_Transform << std::endl;
+  os << indent << "BSplineTransform: " << this->m_BSplineTransform << std::endl;
+  os << indent << "SampleContainer: " << this->m_SampleContainer << std::endl;
+  os << indent << "BSplineWeightCache: " << this->m_BSplineWeightCache.GetPointer() << std::endl;
+
+} // end PrintSelf()
+
+
+} // end namespace itk
+
+#endif // end #ifndef __itkSampleTransformBuffer_hxx
@@ -171,6 +171,14 @@ public:
   itkGetConstReferenceMacro( UseMetricSingleThreaded, bool );
   itkBooleanMacro( UseMetricSingleThreaded );
 
+  /** Returns whether GetValueAndDerivative() may run concurrently with that
+   * of other metrics, see AdvancedImageToImageMetric. Default: false.
+   */
+  virtual bool GetSupportsConcurrentEvaluation( void ) const
+  {
+    return false;
+  }
+
 protected:
 
   SingleValuedPointSetToPointSetMetric();
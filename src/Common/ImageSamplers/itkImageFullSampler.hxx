@@ -34,11 +34,20 @@ void
 ImageFullSampler< TInputImage >
 ::GenerateData( void )
 {
+  /** Reuse the samples of another registration to the same fixed image. */
+  SharedObjectCache::Reservation sharedSamples;
+  if( this->CopySharedSamples( "", sharedSamples ) )
+  {
+    return;
+  }
+
   /** If desired we exercise a multi-threaded version. */
   if( this->m_UseMultiThread )
   {
     /** Calls ThreadedGenerateData(). */
-    return Superclass::GenerateData();
+    Superclass::GenerateData();
+    this->ShareSamples( sharedSamples );
+    return;
   }
 
   /** Get handles to the input image, output sample container, and the mask. */
@@ -127,6 +136,8 @@ ImageFullSampler< TInputImage >
     }   // end for
   }     // end else (if mask exists)
 
+  this->ShareSamples( sharedSamples );
+
 } // end GenerateData()
 
 
@@ -81,6 +81,15 @@ ImageGridSampler< TInputImage >
   /** Take into account the possibility of a smaller bounding box around the mask */
   this->SetNumberOfSamples( this->m_RequestedNumberOfSamples );
 
+  /** Reuse the samples of another registration to the same fixed image. */
+  std::ostringstream settings;
+  settings << "spacing " << this->GetSampleGridSpacing();
+  SharedObjectCache::Reservation sharedSamples;
+  if( this->CopySharedSamples( settings.str(), sharedSamples ) )
+  {
+    return;
+  }
+
   /** Determine the grid. */
   SampleGridIndexType index;
   SampleGridSizeType  sampleGridSize;
@@ -215,6 +224,8 @@ ImageGridSampler< TInputImage >
     } // end t
   }   // else (if mask exists)
 
+  this->ShareSamples( sharedSamples );
+
 } // end GenerateData()
 
 
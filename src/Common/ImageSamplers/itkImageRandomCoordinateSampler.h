@@ -33,6 +33,16 @@ namespace itk
  * This image sampler generates not only samples that correspond with
  * pixel locations, but selects points in physical space.
  *
+ * With UseMultiThread, the samples are generated with multiple threads,
+ * also when a mask is given. In the masked case every thread draws from its
+ * own random streams (see ImageRandomSamplerBase), so the samples have the
+ * same distribution as in the single-threaded case, but are not the same.
+ *
+ * With UseMaskVoxelList, a sample is drawn uniformly from the cell of a
+ * random voxel inside the mask, instead of from the whole bounding box. If
+ * the mask has the same grid as the input image, this gives the same
+ * distribution. The mask voxel list is not used with UseRandomSampleRegion.
+ *
  * \ingroup ImageSamplers
  */
 
@@ -73,6 +83,7 @@ public:
   typedef typename Superclass::InputImagePointType          InputImagePointType;
   typedef typename Superclass::InputImagePointValueType     InputImagePointValueType;
   typedef typename Superclass::ImageSampleValueType         ImageSampleValueType;
+  typedef typename Superclass::RandomStreamType             RandomStreamType;
 
   /** The input image dimension. */
   itkStaticConstMacro( InputImageDimension, unsigned int,
@@ -127,16 +138,32 @@ protected:
     const InputImageRegionType & inputRegionForThread,
     ThreadIdType threadId );
 
+  /** Generates the samples of the random streams of a thread within the mask. */
+  virtual void ThreadedGenerateDataWithMask( ThreadIdType threadId );
+
   /** Generate a point randomly in a bounding box. */
   virtual void GenerateRandomCoordinate(
     const InputImageContinuousIndexType & smallestContIndex,
     const InputImageContinuousIndexType & largestContIndex,
     InputImageContinuousIndexType &       randomContIndex );
 
+  /** Generate a point randomly in the voxel cell of a random voxel of the
+   * mask voxel list. Returns false if the point is outside the bounding box.
+   */
+  bool GenerateRandomCoordinateInMaskVoxel(
+    RandomGeneratorType * generator,
+    const InputImageContinuousIndexType & smallestContIndex,
+    const InputImageContinuousIndexType & largestContIndex,
+    InputImageContinuousIndexType &       randomContIndex ) const;
+
   InterpolatorPointer    m_Interpolator;
   RandomGeneratorPointer m_RandomGenerator;
   InputImageSpacingType  m_SampleRegionSize;
 
+  /** The bounding box of the samples, used by ThreadedGenerateDataWithMask(). */
+  InputImageContinuousIndexType m_ThreaderSmallestContIndex;
+  InputImageContinuousIndexType m_ThreaderLargestContIndex;
+
   /** Generate the two corners of a sampling region, given the two corners
   * of an image. If UseRandomSampleRegion=false, the smallesPoint and largestPoint
   * are just copies of the smallestImagePoint and largestImagePoint
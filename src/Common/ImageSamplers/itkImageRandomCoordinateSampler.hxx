@@ -19,6 +19,7 @@
 #define __ImageRandomCoordinateSampler_hxx
 
 #include "itkImageRandomCoordinateSampler.h"
+#include "itkThreadRandomGenerator.h"
 #include "vnl/vnl_math.h"
 
 namespace itk
@@ -39,7 +40,7 @@ ImageRandomCoordinateSampler< TInputImage >
   this->m_Interpolator = bsplineInterpolator;
 
   /** Setup random generator. */
-  this->m_RandomGenerator = RandomGeneratorType::GetInstance();
+  this->m_RandomGenerator = ThreadRandomGenerator::GetInstance();
 
   this->m_UseRandomSampleRegion = false;
   this->m_SampleRegionSize.Fill( 1.0 );
@@ -56,9 +57,9 @@ void
 ImageRandomCoordinateSampler< TInputImage >
 ::GenerateData( void )
 {
-  /** Get a handle to the mask. If there was no mask supplied we exercise a multi-threaded version. */
+  /** Get a handle to the mask. */
   typename MaskType::ConstPointer mask = this->GetMask();
-  if( mask.IsNull() && this->m_UseMultiThread )
+  if( this->m_UseMultiThread )
   {
     /** Calls ThreadedGenerateData(). */
     return Superclass::GenerateData();
@@ -123,10 +124,19 @@ ImageRandomCoordinateSampler< TInputImage >
     {
       mask->GetSource()->Update();
     }
+    /** Draw from the voxels inside the mask, if desired. */
+    const bool useMaskVoxelList = this->GetUseMaskVoxelList()
+      && !this->GetUseRandomSampleRegion();
+    if( useMaskVoxelList )
+    {
+      this->UpdateMaskVoxelList();
+    }
+
     /** Set up some variable that are used to make sure we are not forever
      * walking around on this image, trying to look for valid samples. */
     unsigned long numberOfSamplesTried        = 0;
     unsigned long maximumNumberOfSamplesToTry = 10 * this->GetNumberOfSamples();
+    bool          insideBox                   = true;
 
     /** Start looping over the sample container */
     for( iter = sampleContainer->Begin(); iter != end; ++iter )
@@ -152,11 +162,19 @@ ImageRandomCoordinateSampler< TInputImage >
         }
 
         /** Generate a point in the input image region. */
-        this->GenerateRandomCoordinate( smallestContIndex, largestContIndex, sampleContIndex );
+        if( useMaskVoxelList )
+        {
+          insideBox = this->GenerateRandomCoordinateInMaskVoxel( this->m_RandomGenerator,
+            smallestContIndex, largestContIndex, sampleContIndex );
+        }
+        else
+        {
+          this->GenerateRandomCoordinate( smallestContIndex, largestContIndex, sampleContIndex );
+        }
         inputImage->TransformContinuousIndexToPhysicalPoint( sampleContIndex, samplePoint );
 
       }
-      while( !interpolator->IsInsideBuffer( sampleContIndex )
+      while( !insideBox || !interpolator->IsInsideBuffer( sampleContIndex )
         || !mask->IsInside( samplePoint ) );
 
       /** Compute the value at the point. */
@@ -182,10 +200,6 @@ ImageRandomCoordinateSampler< TInputImage >
   typename InterpolatorType::Pointer interpolator = this->GetInterpolator();
   interpolator->SetInputImage( this->GetInput() ); // only once per resolution?
 
-  /** Clear the random number list. */
-  this->m_RandomNumberList.resize( 0 );
-  this->m_RandomNumberList.reserve( this->m_NumberOfSamples * InputImageDimension );
-
   /** Convert inputImageRegion to bounding box in physical space. */
   InputImageSizeType  unitSize; unitSize.Fill( 1 );
   InputImageIndexType smallestIndex
@@ -198,6 +212,23 @@ ImageRandomCoordinateSampler< TInputImage >
   this->GenerateSampleRegion( smallestImageCIndex, largestImageCIndex,
     smallestCIndex, largestCIndex );
 
+  /** With a mask, the threads draw their own random coordinates. */
+  if( this->GetMask() )
+  {
+    this->m_ThreaderSmallestContIndex = smallestCIndex;
+    this->m_ThreaderLargestContIndex  = largestCIndex;
+    this->BeforeThreadedGenerateDataWithMask();
+    if( this->GetUseMaskVoxelList() && !this->GetUseRandomSampleRegion() )
+    {
+      this->UpdateMaskVoxelList();
+    }
+    return;
+  }
+
+  /** Clear the random number list. */
+  this->m_RandomNumberList.resize( 0 );
+  this->m_RandomNumberList.reserve( this->m_NumberOfSamples * InputImageDimension );
+
   /** Fill the list with random numbers. */
   for( unsigned long i = 0; i < this->m_NumberOfSamples; i++ )
   {
@@ -228,11 +259,11 @@ void
 ImageRandomCoordinateSampler< TInputImage >
 ::ThreadedGenerateData( const InputImageRegionType &, ThreadIdType threadId )
 {
-  /** Sanity check. */
-  typename MaskType::ConstPointer mask = this->GetMask();
-  if( mask.IsNotNull() )
+  /** The masked case is handled separately. */
+  if( this->GetMask() )
   {
-    itkExceptionMacro( << "ERROR: do not call this function when a mask is supplied." );
+    this->ThreadedGenerateDataWithMask( threadId );
+    return;
   }
 
   /** Get handle to the input image. */
@@ -283,6 +314,89 @@ ImageRandomCoordinateSampler< TInputImage >
 } // end ThreadedGenerateData()
 
 
+/**
+ * ******************* ThreadedGenerateDataWithMask *******************
+ */
+
+template< class TInputImage >
+void
+ImageRandomCoordinateSampler< TInputImage >
+::ThreadedGenerateDataWithMask( ThreadIdType threadId )
+{
+  /** Get handles to the input image, mask, output and random generator. */
+  InputImageConstPointer     inputImage      = this->GetInput();
+  const MaskType *           mask            = this->GetMask();
+  ImageSampleContainerType * sampleContainer = this->GetOutput();
+  RandomStreamType *         generator       = this->m_RandomStreams[ threadId ];
+  const bool                 useMaskVoxelList
+    = this->GetUseMaskVoxelList() && !this->GetUseRandomSampleRegion();
+
+  /** Make sure we are not eternally trying to find samples. Each thread
+   * gets the budget of the single-threaded code, for all its streams, so
+   * that a sparse mask does not exhaust the budget of a short stream.
+   */
+  unsigned long       numberOfSamplesTried        = 0;
+  const unsigned long maximumNumberOfSamplesToTry = 10 * this->GetNumberOfSamples();
+
+  /** Loop over the random streams of this thread. */
+  const unsigned long numberOfStreams = this->GetNumberOfRandomStreams();
+  for( unsigned long streamId = threadId; streamId < numberOfStreams;
+    streamId += this->m_NumberOfRandomStreamThreads )
+  {
+    unsigned long firstSampleId, lastSampleId;
+    this->InitializeRandomStream( streamId, generator, firstSampleId, lastSampleId );
+    bool insideBox = true;
+
+    InputImageContinuousIndexType sampleContIndex;
+    for( unsigned long sampleId = firstSampleId; sampleId < lastSampleId; ++sampleId )
+    {
+      /** Make a reference to the current sample in the container. */
+      InputImagePointType &  samplePoint = sampleContainer->ElementAt( sampleId ).m_ImageCoordinates;
+      ImageSampleValueType & sampleValue = sampleContainer->ElementAt( sampleId ).m_ImageValue;
+
+      /** Walk over the image until we find a valid point. */
+      do
+      {
+        ++numberOfSamplesTried;
+        if( numberOfSamplesTried > maximumNumberOfSamplesToTry )
+        {
+          /** The exception is thrown in AfterThreadedGenerateData(). */
+          this->m_FirstFailedSampleIds[ threadId ] = sampleId;
+          return;
+        }
+
+        /** Generate a point in the sample region, as in GenerateRandomCoordinate(). */
+        if( useMaskVoxelList )
+        {
+          insideBox = this->GenerateRandomCoordinateInMaskVoxel( generator,
+            this->m_ThreaderSmallestContIndex, this->m_ThreaderLargestContIndex,
+            sampleContIndex );
+        }
+        else
+        {
+          for( unsigned int i = 0; i < InputImageDimension; ++i )
+          {
+            sampleContIndex[ i ] = static_cast< InputImagePointValueType >(
+              generator->GetUniformVariate( this->m_ThreaderSmallestContIndex[ i ],
+              this->m_ThreaderLargestContIndex[ i ] ) );
+          }
+        }
+        inputImage->TransformContinuousIndexToPhysicalPoint( sampleContIndex, samplePoint );
+
+      }
+      while( !insideBox || !this->m_Interpolator->IsInsideBuffer( sampleContIndex )
+        || !mask->IsInside( samplePoint ) );
+
+      /** Compute the value at the point. */
+      sampleValue = static_cast< ImageSampleValueType >(
+        this->m_Interpolator->EvaluateAtContinuousIndex( sampleContIndex ) );
+
+    } // end for loop over the samples
+  }   // end for loop over the streams
+
+} // end ThreadedGenerateDataWithMask()
+
+
 /**
  * ******************* GenerateRandomCoordinate *******************
  */
@@ -304,6 +418,35 @@ ImageRandomCoordinateSampler< TInputImage >
 } // end GenerateRandomCoordinate()
 
 
+/**
+ * ******************* GenerateRandomCoordinateInMaskVoxel *******************
+ */
+
+template< class TInputImage >
+bool
+ImageRandomCoordinateSampler< TInputImage >
+::GenerateRandomCoordinateInMaskVoxel(
+  RandomGeneratorType * generator,
+  const InputImageContinuousIndexType & smallestContIndex,
+  const InputImageContinuousIndexType & largestContIndex,
+  InputImageContinuousIndexType &       randomContIndex ) const
+{
+  InputImageIndexType voxelIndex;
+  this->GetRandomMaskVoxelIndex( generator, voxelIndex );
+
+  bool inside = true;
+  for( unsigned int i = 0; i < InputImageDimension; ++i )
+  {
+    randomContIndex[ i ] = static_cast< InputImagePointValueType >(
+      voxelIndex[ i ] + generator->GetUniformVariate( -0.5, 0.5 ) );
+    inside &= randomContIndex[ i ] >= smallestContIndex[ i ]
+      && randomContIndex[ i ] <= largestContIndex[ i ];
+  }
+  return inside;
+
+} // end GenerateRandomCoordinateInMaskVoxel()
+
+
 /**
  * ******************* GenerateSampleRegion *******************
  */
@@ -32,6 +32,11 @@ namespace itk
  * mask. If the mask is very sparse, this may take some time. In this case,
  * consider using the ImageRandomSamplerSparseMask.
  *
+ * With UseMultiThread, the samples are generated with multiple threads,
+ * also when a mask is given. In the masked case every thread draws from its
+ * own random streams (see ImageRandomSamplerBase), so the samples have the
+ * same distribution as in the single-threaded case, but are not the same.
+ *
  * \ingroup ImageSamplers
  */
 
@@ -68,6 +73,7 @@ public:
   typedef typename Superclass::ImageSampleContainerPointer  ImageSampleContainerPointer;
   typedef typename Superclass::MaskType                     MaskType;
   typedef typename Superclass::InputImageSizeType           InputImageSizeType;
+  typedef typename Superclass::RandomStreamType             RandomStreamType;
 
   /** The input image dimension. */
   itkStaticConstMacro( InputImageDimension, unsigned int,
@@ -87,10 +93,15 @@ protected:
   /** Functions that do the work. */
   virtual void GenerateData( void );
 
+  virtual void BeforeThreadedGenerateData( void );
+
   virtual void ThreadedGenerateData(
     const InputImageRegionType & inputRegionForThread,
     ThreadIdType threadId );
 
+  /** Generates the samples of the random streams of a thread within the mask. */
+  virtual void ThreadedGenerateDataWithMask( ThreadIdType threadId );
+
 private:
 
   /** The private constructor. */
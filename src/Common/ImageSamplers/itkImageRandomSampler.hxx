@@ -20,7 +20,7 @@
 
 #include "itkImageRandomSampler.h"
 
-#include "itkMersenneTwisterRandomVariateGenerator.h"
+#include "itkThreadRandomGenerator.h"
 #include "itkImageRandomConstIteratorWithIndex.h"
 
 namespace itk
@@ -35,9 +35,9 @@ void
 ImageRandomSampler< TInputImage >
 ::GenerateData( void )
 {
-  /** Get a handle to the mask. If there was no mask supplied we exercise a multi-threaded version. */
+  /** Get a handle to the mask. */
   typename MaskType::ConstPointer mask = this->GetMask();
-  if( mask.IsNull() && this->m_UseMultiThread )
+  if( this->m_UseMultiThread )
   {
     /** Calls ThreadedGenerateData(). */
     return Superclass::GenerateData();
@@ -86,6 +86,23 @@ ImageRandomSampler< TInputImage >
       mask->GetSource()->Update();
     }
 
+    /** Draw the samples directly from the voxels inside the mask. */
+    if( this->m_UseMaskVoxelList )
+    {
+      this->UpdateMaskVoxelList();
+      typename RandomStreamType::Pointer generator = ThreadRandomGenerator::GetInstance();
+      InputImageIndexType index;
+      for( iter = sampleContainer->Begin(); iter != end; ++iter )
+      {
+        this->GetRandomMaskVoxelIndex( generator, index );
+        inputImage->TransformIndexToPhysicalPoint( index,
+          ( *iter ).Value().m_ImageCoordinates );
+        ( *iter ).Value().m_ImageValue = static_cast< ImageSampleValueType >(
+          inputImage->GetPixel( index ) );
+      }
+      return;
+    }
+
     /** Make sure we are not eternally trying to find samples: */
     randIter.SetNumberOfSamples( 10 * this->GetNumberOfSamples() );
 
@@ -133,6 +150,30 @@ ImageRandomSampler< TInputImage >
 } // end GenerateData()
 
 
+/**
+ * ******************* BeforeThreadedGenerateData *******************
+ */
+
+template< class TInputImage >
+void
+ImageRandomSampler< TInputImage >
+::BeforeThreadedGenerateData( void )
+{
+  if( this->GetMask() )
+  {
+    this->BeforeThreadedGenerateDataWithMask();
+    if( this->m_UseMaskVoxelList )
+    {
+      this->UpdateMaskVoxelList();
+    }
+    return;
+  }
+
+  Superclass::BeforeThreadedGenerateData();
+
+} // end BeforeThreadedGenerateData()
+
+
 /**
  * ******************* ThreadedGenerateData *******************
  */
@@ -142,11 +183,11 @@ void
 ImageRandomSampler< TInputImage >
 ::ThreadedGenerateData( const InputImageRegionType &, ThreadIdType threadId )
 {
-  /** Sanity check. */
-  typename MaskType::ConstPointer mask = this->GetMask();
-  if( mask.IsNotNull() )
+  /** The masked case is handled separately. */
+  if( this->GetMask() )
   {
-    itkExceptionMacro( << "ERROR: do not call this function when a mask is supplied." );
+    this->ThreadedGenerateDataWithMask( threadId );
+    return;
   }
 
   /** Get handle to the input image. */
@@ -202,6 +243,94 @@ ImageRandomSampler< TInputImage >
 } // end ThreadedGenerateData()
 
 
+/**
+ * ******************* ThreadedGenerateDataWithMask *******************
+ */
+
+template< class TInputImage >
+void
+ImageRandomSampler< TInputImage >
+::ThreadedGenerateDataWithMask( ThreadIdType threadId )
+{
+  /** Get handles to the input image, mask, output and random generator. */
+  InputImageConstPointer     inputImage      = this->GetInput();
+  const MaskType *           mask            = this->GetMask();
+  ImageSampleContainerType * sampleContainer = this->GetOutput();
+  RandomStreamType *         generator       = this->m_RandomStreams[ threadId ];
+
+  const InputImageSizeType  regionSize  = this->GetCroppedInputImageRegion().GetSize();
+  const InputImageIndexType regionIndex = this->GetCroppedInputImageRegion().GetIndex();
+  const double              numPixels   = static_cast< double >(
+    this->GetCroppedInputImageRegion().GetNumberOfPixels() );
+
+  /** Make sure we are not eternally trying to find samples. Each thread
+   * gets the budget of the single-threaded code, for all its streams, so
+   * that a sparse mask does not exhaust the budget of a short stream.
+   */
+  unsigned long       numberOfSamplesTried        = 0;
+  const unsigned long maximumNumberOfSamplesToTry = 10 * this->GetNumberOfSamples();
+
+  /** Loop over the random streams of this thread. */
+  const unsigned long numberOfStreams = this->GetNumberOfRandomStreams();
+  for( unsigned long streamId = threadId; streamId < numberOfStreams;
+    streamId += this->m_NumberOfRandomStreamThreads )
+  {
+    unsigned long firstSampleId, lastSampleId;
+    this->InitializeRandomStream( streamId, generator, firstSampleId, lastSampleId );
+
+    InputImageIndexType positionIndex;
+    InputImagePointType inputPoint;
+    for( unsigned long sampleId = firstSampleId; sampleId < lastSampleId; ++sampleId )
+    {
+      /** Draw the sample directly from the voxels inside the mask. */
+      if( this->m_UseMaskVoxelList )
+      {
+        this->GetRandomMaskVoxelIndex( generator, positionIndex );
+        inputImage->TransformIndexToPhysicalPoint( positionIndex, inputPoint );
+      }
+      else
+      {
+        /** Loop until a valid sample is found. */
+        do
+        {
+          ++numberOfSamplesTried;
+          if( numberOfSamplesTried > maximumNumberOfSamplesToTry )
+          {
+            /** The exception is thrown in AfterThreadedGenerateData(). */
+            this->m_FirstFailedSampleIds[ threadId ] = sampleId;
+            return;
+          }
+
+          /** Translate a random position to an index, as in ThreadedGenerateData(). */
+          unsigned long randomPosition = static_cast< unsigned long >(
+            generator->GetVariateWithOpenRange( numPixels - 0.5 ) );
+          for( unsigned int dim = 0; dim < InputImageDimension; dim++ )
+          {
+            const unsigned long sizeInThisDimension = regionSize[ dim ];
+            const unsigned long residual            = randomPosition % sizeInThisDimension;
+            positionIndex[ dim ] = residual + regionIndex[ dim ];
+            randomPosition      -= residual;
+            randomPosition      /= sizeInThisDimension;
+          }
+
+          /** Transform the index to physical coordinates. */
+          inputImage->TransformIndexToPhysicalPoint( positionIndex, inputPoint );
+        }
+        while( !mask->IsInside( inputPoint ) );
+      }
+
+      /** Put the coordinates and the value in the sample. */
+      ImageSampleType & sample = sampleContainer->ElementAt( sampleId );
+      sample.m_ImageCoordinates = inputPoint;
+      sample.m_ImageValue       = static_cast< ImageSampleValueType >(
+        inputImage->GetPixel( positionIndex ) );
+
+    } // end for loop over the samples
+  }   // end for loop over the streams
+
+} // end ThreadedGenerateDataWithMask()
+
+
 } // end namespace itk
 
 #endif // end #ifndef __ImageRandomSampler_hxx
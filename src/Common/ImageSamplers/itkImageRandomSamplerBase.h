@@ -19,6 +19,7 @@
 #define __ImageRandomSamplerBase_h
 
 #include "itkImageSamplerBase.h"
+#include "itkMersenneTwisterRandomVariateGenerator.h"
 
 namespace itk
 {
@@ -29,6 +30,13 @@ namespace itk
  *
  * It adds the Set/GetNumberOfSamples function.
  *
+ * It also provides the machinery for generating samples within a mask with
+ * multiple threads. The samples are divided into streams of
+ * NumberOfSamplesPerRandomStream samples. Each stream has its own random
+ * generator, seeded from one number that is drawn from the global generator,
+ * and writes its samples directly to their place in the output. The result
+ * therefore does not depend on the number of threads.
+ *
  * \ingroup ImageSamplers
  */
 
@@ -63,6 +71,7 @@ public:
   typedef typename Superclass::ImageSampleContainerType     ImageSampleContainerType;
   typedef typename Superclass::ImageSampleContainerPointer  ImageSampleContainerPointer;
   typedef typename Superclass::MaskType                     MaskType;
+  typedef typename Superclass::InputImageIndexType          InputImageIndexType;
 
   /** The input image dimension. */
   itkStaticConstMacro( InputImageDimension, unsigned int,
@@ -71,8 +80,18 @@ public:
   /** Set the number of samples. */
   itkSetClampMacro( NumberOfSamples, unsigned long, 1, NumericTraits< unsigned long >::max() );
 
+  /** Set/Get the number of samples that are drawn from one random stream,
+   * when generating samples within a mask with multiple threads. Default: 1024.
+   */
+  itkSetClampMacro( NumberOfSamplesPerRandomStream, unsigned long, 1, NumericTraits< unsigned long >::max() );
+  itkGetConstMacro( NumberOfSamplesPerRandomStream, unsigned long );
+
 protected:
 
+  /** Typedefs for the random streams. */
+  typedef Statistics::MersenneTwisterRandomVariateGenerator RandomStreamType;
+  typedef RandomStreamType::Pointer                         RandomStreamPointer;
+
   /** The constructor. */
   ImageRandomSamplerBase();
 
@@ -82,12 +101,54 @@ protected:
   /** Multi-threaded function that does the work. */
   virtual void BeforeThreadedGenerateData( void );
 
+  /** Combines the results of the threads, or, when the samples were
+   * generated in place, checks that all streams found enough samples.
+   */
+  virtual void AfterThreadedGenerateData( void );
+
+  /** Prepares generating samples within the mask with multiple threads:
+   * updates the mask, draws the seed of the random streams and allocates the
+   * output. To be called from BeforeThreadedGenerateData() by subclasses that
+   * implement the masked case in ThreadedGenerateData().
+   */
+  virtual void BeforeThreadedGenerateDataWithMask( void );
+
+  /** Get the number of random streams. */
+  unsigned long GetNumberOfRandomStreams( void ) const;
+
+  /** Seed the random generator of a thread for a stream, and get the range
+   * [ firstSampleId, lastSampleId ) of the samples of that stream.
+   */
+  void InitializeRandomStream( unsigned long streamId,
+    RandomStreamType * generator,
+    unsigned long & firstSampleId, unsigned long & lastSampleId ) const;
+
+  /** Get the index of a random voxel of the mask voxel list. All voxels
+   * have the same probability. Thread-safe, provided that each thread uses
+   * its own generator.
+   */
+  void GetRandomMaskVoxelIndex( RandomStreamType * generator,
+    InputImageIndexType & index ) const;
+
   /** PrintSelf. */
   void PrintSelf( std::ostream & os, Indent indent ) const;
 
   /** Member variable used when threading. */
   std::vector< double > m_RandomNumberList;
 
+  /** Member variables used when generating samples within a mask with
+   * multiple threads. The random streams are assigned round robin to the
+   * m_NumberOfRandomStreamThreads threads that run. A thread that gives up,
+   * after trying ten times the number of samples over all its streams,
+   * stores the first sample that it could not find.
+   */
+  std::vector< RandomStreamPointer > m_RandomStreams;
+  std::vector< unsigned long >       m_FirstFailedSampleIds;
+  ThreadIdType                       m_NumberOfRandomStreamThreads;
+  RandomStreamType::IntegerType      m_RandomStreamSeed;
+  unsigned long                      m_NumberOfSamplesPerRandomStream;
+  bool                               m_GenerateSamplesInPlace;
+
 private:
 
   /** The private constructor. */
@@ -20,8 +20,9 @@
 
 #include "itkImageRandomSamplerBase.h"
 
-#include "itkMersenneTwisterRandomVariateGenerator.h"
+#include "itkThreadRandomGenerator.h"
 #include "itkImageRandomConstIteratorWithIndex.h"
+#include <algorithm>
 
 namespace itk
 {
@@ -34,7 +35,11 @@ template< class TInputImage >
 ImageRandomSamplerBase< TInputImage >
 ::ImageRandomSamplerBase()
 {
-  this->m_NumberOfSamples = 1000;
+  this->m_NumberOfSamples                = 1000;
+  this->m_NumberOfSamplesPerRandomStream = 1024;
+  this->m_NumberOfRandomStreamThreads    = 1;
+  this->m_RandomStreamSeed               = 0;
+  this->m_GenerateSamplesInPlace         = false;
 
 } // end Constructor
 
@@ -50,7 +55,7 @@ ImageRandomSamplerBase< TInputImage >
 {
   /** Create a random number generator. Also used in the ImageRandomConstIteratorWithIndex. */
   typedef typename Statistics::MersenneTwisterRandomVariateGenerator::Pointer GeneratorPointer;
-  GeneratorPointer localGenerator = Statistics::MersenneTwisterRandomVariateGenerator::GetInstance();
+  GeneratorPointer localGenerator = ThreadRandomGenerator::GetInstance();
   // \todo: should probably be global?
 
   /** Clear the random number list. */
@@ -74,6 +79,148 @@ ImageRandomSamplerBase< TInputImage >
 } // end BeforeThreadedGenerateData()
 
 
+/**
+ * ******************* BeforeThreadedGenerateDataWithMask *******************
+ */
+
+template< class TInputImage >
+void
+ImageRandomSamplerBase< TInputImage >
+::BeforeThreadedGenerateDataWithMask( void )
+{
+  /** Update the mask, before the threads use it. */
+  typename MaskType::ConstPointer mask = this->GetMask();
+  if( mask->GetSource() )
+  {
+    mask->GetSource()->Update();
+  }
+
+  /** Draw the seed of the random streams from the generator of this thread,
+   * so that the samples are still determined by the RandomSeed.
+   */
+  RandomStreamPointer threadGenerator = ThreadRandomGenerator::GetInstance();
+  this->m_RandomStreamSeed = threadGenerator->GetIntegerVariate();
+
+  /** Only the threads that get a region run ThreadedGenerateData(). */
+  InputImageRegionType dummyRegion;
+  this->m_NumberOfRandomStreamThreads = this->SplitRequestedRegion(
+    0, this->GetNumberOfThreads(), dummyRegion );
+
+  /** Create one generator per thread. This is not done in the threads,
+   * since New() accesses the global generator.
+   */
+  this->m_RandomStreams.resize( this->m_NumberOfRandomStreamThreads );
+  for( ThreadIdType i = 0; i < this->m_NumberOfRandomStreamThreads; ++i )
+  {
+    if( this->m_RandomStreams[ i ].IsNull() )
+    {
+      this->m_RandomStreams[ i ] = ThreadRandomGenerator::New();
+    }
+  }
+  this->m_FirstFailedSampleIds.assign(
+    this->m_NumberOfRandomStreamThreads, this->m_NumberOfSamples );
+
+  /** The threads write their samples directly to the output. */
+  typename ImageSampleContainerType::Pointer sampleContainer = this->GetOutput();
+  sampleContainer->resize( this->m_NumberOfSamples );
+  this->m_GenerateSamplesInPlace = true;
+
+} // end BeforeThreadedGenerateDataWithMask()
+
+
+/**
+ * ******************* AfterThreadedGenerateData *******************
+ */
+
+template< class TInputImage >
+void
+ImageRandomSamplerBase< TInputImage >
+::AfterThreadedGenerateData( void )
+{
+  if( !this->m_GenerateSamplesInPlace )
+  {
+    Superclass::AfterThreadedGenerateData();
+    return;
+  }
+  this->m_GenerateSamplesInPlace = false;
+
+  /** All streams before the first failure are complete. */
+  unsigned long firstFailedSampleId = this->m_NumberOfSamples;
+  for( ThreadIdType i = 0; i < this->m_NumberOfRandomStreamThreads; ++i )
+  {
+    firstFailedSampleId = std::min( firstFailedSampleId,
+      this->m_FirstFailedSampleIds[ i ] );
+  }
+
+  if( firstFailedSampleId < this->m_NumberOfSamples )
+  {
+    /** Squeeze the sample container to the size that is still valid. */
+    typename ImageSampleContainerType::Pointer sampleContainer = this->GetOutput();
+    sampleContainer->resize( firstFailedSampleId );
+    itkExceptionMacro( << "Could not find enough image samples within "
+                       << "reasonable time. Probably the mask is too small" );
+  }
+
+} // end AfterThreadedGenerateData()
+
+
+/**
+ * ******************* GetNumberOfRandomStreams *******************
+ */
+
+template< class TInputImage >
+unsigned long
+ImageRandomSamplerBase< TInputImage >
+::GetNumberOfRandomStreams( void ) const
+{
+  return ( this->m_NumberOfSamples + this->m_NumberOfSamplesPerRandomStream - 1 )
+         / this->m_NumberOfSamplesPerRandomStream;
+
+} // end GetNumberOfRandomStreams()
+
+
+/**
+ * ******************* InitializeRandomStream *******************
+ */
+
+template< class TInputImage >
+void
+ImageRandomSamplerBase< TInputImage >
+::InitializeRandomStream( unsigned long streamId,
+  RandomStreamType * generator,
+  unsigned long & firstSampleId, unsigned long & lastSampleId ) const
+{
+  /** Spread the seeds of consecutive streams with a multiplicative hash. */
+  const RandomStreamType::IntegerType seed = this->m_RandomStreamSeed
+    + static_cast< RandomStreamType::IntegerType >( 2654435761u * ( streamId + 1 ) );
+  generator->SetSeed( seed );
+
+  firstSampleId = streamId * this->m_NumberOfSamplesPerRandomStream;
+  lastSampleId  = std::min( firstSampleId + this->m_NumberOfSamplesPerRandomStream,
+    this->m_NumberOfSamples );
+
+} // end InitializeRandomStream()
+
+
+/**
+ * ******************* GetRandomMaskVoxelIndex *******************
+ */
+
+template< class TInputImage >
+void
+ImageRandomSamplerBase< TInputImage >
+::GetRandomMaskVoxelIndex( RandomStreamType * generator,
+  InputImageIndexType & index ) const
+{
+  const SizeValueType numberOfVoxels = this->m_MaskVoxelList.size();
+  const SizeValueType randomVoxel    = std::min( numberOfVoxels - 1,
+    static_cast< SizeValueType >( generator->GetVariateWithOpenUpperRange(
+    static_cast< double >( numberOfVoxels ) ) ) );
+  this->ComputeMaskVoxelIndex( this->m_MaskVoxelList[ randomVoxel ], index );
+
+} // end GetRandomMaskVoxelIndex()
+
+
 /**
  * ******************* PrintSelf *******************
  */
@@ -86,6 +233,8 @@ ImageRandomSamplerBase< TInputImage >
   Superclass::PrintSelf( os, indent );
 
   os << indent << "NumberOfSamples: " << this->m_NumberOfSamples << std::endl;
+  os << indent << "NumberOfSamplesPerRandomStream: "
+     << this->m_NumberOfSamplesPerRandomStream << std::endl;
 
 } // end PrintSelf()
 
@@ -19,6 +19,7 @@
 #define __ImageRandomSamplerSparseMask_hxx
 
 #include "itkImageRandomSamplerSparseMask.h"
+#include "itkThreadRandomGenerator.h"
 
 namespace itk
 {
@@ -32,7 +33,7 @@ ImageRandomSamplerSparseMask< TInputImage >
 ::ImageRandomSamplerSparseMask()
 {
   /** Setup random generator. */
-  this->m_RandomGenerator = RandomGeneratorType::GetInstance();
+  this->m_RandomGenerator = ThreadRandomGenerator::GetInstance();
 
   this->m_InternalFullSampler = InternalFullSamplerType::New();
 
@@ -22,6 +22,7 @@
 #include "itkImageSample.h"
 #include "itkVectorDataContainer.h"
 #include "itkSpatialObject.h"
+#include "itkSharedObjectCache.h"
 
 namespace itk
 {
@@ -170,8 +171,32 @@ public:
   /** \todo: Temporary, should think about interface. */
   itkSetMacro( UseMultiThread, bool );
 
+  /** Set/Get whether samplers that support it draw their samples from a
+   * list of the voxels that are inside the (first) mask, instead of testing
+   * random candidates against the mask. The list is computed once for the
+   * cropped input image region, and reused as long as the input image, the
+   * mask and the region do not change. This pays off for small masks in
+   * large images. Default: false.
+   */
+  itkSetMacro( UseMaskVoxelList, bool );
+  itkGetConstMacro( UseMaskVoxelList, bool );
+  itkBooleanMacro( UseMaskVoxelList );
+
+  /** Set/Get the cache in which samplers that support it share their
+   * samples with other registrations to the same fixed image. Only
+   * deterministic samplers, with no mask or an image mask
+   * (ImageMaskSpatialObject2), support this. Default: NULL.
+   */
+  itkSetObjectMacro( FixedSideCache, SharedObjectCache );
+  itkGetObjectMacro( FixedSideCache, SharedObjectCache );
+
 protected:
 
+  /** The voxels inside the mask, stored as offsets in the cropped input
+   * image region, in scanline order.
+   */
+  typedef std::vector< SizeValueType > MaskVoxelListType;
+
   /** The constructor. */
   ImageSamplerBase();
 
@@ -203,6 +228,42 @@ protected:
 
   virtual void AfterThreadedGenerateData( void );
 
+  /** Compute the list of voxels of the cropped input image region that are
+   * inside the first mask, unless it is still up-to-date. Throws an
+   * exception when there are no such voxels. Not thread-safe; call this
+   * before launching the threads.
+   */
+  virtual void UpdateMaskVoxelList( void );
+
+  /** Copy the samples from the FixedSideCache into the output, if they are
+   * there, or are being computed by another registration. The key of the
+   * samples is built from the class, the input image, the cropped input
+   * image region, the first mask and the settings of the sampler. When the
+   * samples are not there, the key is reserved in reservation, and the
+   * sampler should compute them and call ShareSamples(). Call this after
+   * CropInputImageRegion().
+   */
+  bool CopySharedSamples( const std::string & settings,
+    SharedObjectCache::Reservation & reservation );
+
+  /** Store a copy of the output in the FixedSideCache under the key reserved
+   * by CopySharedSamples(). Does nothing for an inactive reservation.
+   */
+  void ShareSamples( SharedObjectCache::Reservation & reservation );
+
+  /** Convert an entry of the mask voxel list to an image index. */
+  void ComputeMaskVoxelIndex( SizeValueType offset, InputImageIndexType & index ) const
+  {
+    const InputImageSizeType &  size  = this->m_MaskVoxelListRegion.GetSize();
+    const InputImageIndexType & start = this->m_MaskVoxelListRegion.GetIndex();
+    for( unsigned int dim = 0; dim < InputImageDimension; ++dim )
+    {
+      index[ dim ] = start[ dim ] + static_cast< IndexValueType >( offset % size[ dim ] );
+      offset      /= size[ dim ];
+    }
+  }
+
+
   /***/
   unsigned long                              m_NumberOfSamples;
   std::vector< ImageSampleContainerPointer > m_ThreaderSampleContainer;
@@ -210,6 +271,9 @@ protected:
   //tmp?
   bool m_UseMultiThread;
 
+  bool              m_UseMaskVoxelList;
+  MaskVoxelListType m_MaskVoxelList;
+
 private:
 
   /** The private constructor. */
@@ -228,6 +292,15 @@ private:
   InputImageRegionType m_CroppedInputImageRegion;
   InputImageRegionType m_DummyInputImageRegion;
 
+  /** The key of the mask voxel list. */
+  const InputImageType * m_MaskVoxelListInput;
+  ModifiedTimeType       m_MaskVoxelListInputTime;
+  const MaskType *       m_MaskVoxelListMask;
+  ModifiedTimeType       m_MaskVoxelListMaskTime;
+  InputImageRegionType   m_MaskVoxelListRegion;
+
+  SharedObjectCache::Pointer m_FixedSideCache;
+
 };
 
 } // end namespace itk
@@ -19,6 +19,8 @@
 #define __ImageSamplerBase_hxx
 
 #include "itkImageSamplerBase.h"
+#include "itkImageRegionConstIteratorWithIndex.h"
+#include "itkImageMaskSpatialObject2.h"
 
 namespace itk
 {
@@ -39,6 +41,14 @@ ImageSamplerBase< TInputImage >
   //tmp?
   this->m_UseMultiThread = false;
 
+  this->m_UseMaskVoxelList       = false;
+  this->m_MaskVoxelListInput     = 0;
+  this->m_MaskVoxelListInputTime = 0;
+  this->m_MaskVoxelListMask      = 0;
+  this->m_MaskVoxelListMaskTime  = 0;
+
+  this->m_FixedSideCache = 0;
+
 } // end Constructor()
 
 
@@ -458,6 +468,142 @@ ImageSamplerBase< TInputImage >
 } // end AfterThreadedGenerateData()
 
 
+/**
+ * ******************* UpdateMaskVoxelList *******************
+ */
+
+template< class TInputImage >
+void
+ImageSamplerBase< TInputImage >
+::UpdateMaskVoxelList( void )
+{
+  /** Get handles to the input image and the mask. */
+  const InputImageType * inputImage = this->GetInput();
+  const MaskType *       mask       = this->GetMask();
+  if( mask == 0 )
+  {
+    itkExceptionMacro( << "ERROR: the mask voxel list requires a mask." );
+  }
+
+  /** Make sure the mask is up-to-date. */
+  if( mask->GetSource() )
+  {
+    mask->GetSource()->Update();
+  }
+
+  /** Reuse the list if nothing changed. */
+  const InputImageRegionType & region = this->GetCroppedInputImageRegion();
+  if( inputImage == this->m_MaskVoxelListInput
+    && inputImage->GetMTime() == this->m_MaskVoxelListInputTime
+    && mask == this->m_MaskVoxelListMask
+    && mask->GetMTime() == this->m_MaskVoxelListMaskTime
+    && region == this->m_MaskVoxelListRegion )
+  {
+    return;
+  }
+
+  /** Loop over the region, and store the offsets of the voxels inside the mask. */
+  this->m_MaskVoxelList.clear();
+  typedef ImageRegionConstIteratorWithIndex< InputImageType > InputImageIterator;
+  InputImageIterator  iter( inputImage, region );
+  InputImagePointType point;
+  SizeValueType       offset = 0;
+  for( iter.GoToBegin(); !iter.IsAtEnd(); ++iter, ++offset )
+  {
+    inputImage->TransformIndexToPhysicalPoint( iter.GetIndex(), point );
+    if( mask->IsInside( point ) )
+    {
+      this->m_MaskVoxelList.push_back( offset );
+    }
+  }
+
+  /** Store the key. */
+  this->m_MaskVoxelListInput     = inputImage;
+  this->m_MaskVoxelListInputTime = inputImage->GetMTime();
+  this->m_MaskVoxelListMask      = mask;
+  this->m_MaskVoxelListMaskTime  = mask->GetMTime();
+  this->m_MaskVoxelListRegion    = region;
+
+  if( this->m_MaskVoxelList.empty() )
+  {
+    /** Make sure the next call tries again. */
+    this->m_MaskVoxelListInput = 0;
+    itkExceptionMacro( << "Could not find enough image samples within "
+                       << "reasonable time. Probably the mask is too small" );
+  }
+
+} // end UpdateMaskVoxelList()
+
+
+/**
+ * ******************* CopySharedSamples *******************
+ */
+
+template< class TInputImage >
+bool
+ImageSamplerBase< TInputImage >
+::CopySharedSamples( const std::string & settings,
+  SharedObjectCache::Reservation & reservation )
+{
+  if( this->m_FixedSideCache.IsNull() )
+  {
+    return false;
+  }
+
+  /** Masks that are not image masks cannot be identified. */
+  typedef ImageMaskSpatialObject2< InputImageDimension > ImageMaskType;
+  const MaskType *      mask      = this->GetMask();
+  const ImageMaskType * imageMask = dynamic_cast< const ImageMaskType * >( mask );
+  if( mask && !imageMask )
+  {
+    return false;
+  }
+
+  std::ostringstream keyStream;
+  keyStream << "ImageSamples " << this->GetNameOfClass();
+  SharedObjectCache::AppendToKey( keyStream, this->GetInput() );
+  keyStream << " " << this->GetCroppedInputImageRegion().GetIndex()
+            << " " << this->GetCroppedInputImageRegion().GetSize();
+  SharedObjectCache::AppendToKey( keyStream, imageMask ? imageMask->GetImage() : 0 );
+  keyStream << " " << settings;
+
+  const ImageSampleContainerType * sharedSamples
+    = dynamic_cast< const ImageSampleContainerType * >(
+    this->m_FixedSideCache->FindOrReserve( keyStream.str(), reservation ) );
+  if( !sharedSamples )
+  {
+    return false;
+  }
+
+  ImageSampleContainerType * sampleContainer = this->GetOutput();
+  sampleContainer->CastToSTLContainer() = sharedSamples->CastToSTLConstContainer();
+  return true;
+
+} // end CopySharedSamples()
+
+
+/**
+ * ******************* ShareSamples *******************
+ */
+
+template< class TInputImage >
+void
+ImageSamplerBase< TInputImage >
+::ShareSamples( SharedObjectCache::Reservation & reservation )
+{
+  if( !reservation.IsActive() )
+  {
+    return;
+  }
+
+  /** Store a copy, since the output is overwritten by the next Update(). */
+  ImageSampleContainerPointer sharedSamples = ImageSampleContainerType::New();
+  sharedSamples->CastToSTLContainer() = this->GetOutput()->CastToSTLConstContainer();
+  reservation.Insert( sharedSamples );
+
+} // end ShareSamples()
+
+
 /**
  * ******************* PrintSelf *******************
  */
@@ -485,6 +631,8 @@ ImageSamplerBase< TInputImage >
     os << indent.GetNextIndent() << this->m_InputImageRegionVector[ i ] << std::endl;
   }
   os << indent << "CroppedInputImageRegion" << this->m_CroppedInputImageRegion << std::endl;
+  os << indent << "UseMaskVoxelList: " << this->m_UseMaskVoxelList << std::endl;
+  os << indent << "MaskVoxelList size: " << this->m_MaskVoxelList.size() << std::endl;
 
 } // end PrintSelf()
 
@@ -19,6 +19,7 @@
 #define __MultiInputImageRandomCoordinateSampler_hxx
 
 #include "itkMultiInputImageRandomCoordinateSampler.h"
+#include "itkThreadRandomGenerator.h"
 #include "vnl/vnl_inverse.h"
 #include "itkConfigure.h"
 
@@ -40,7 +41,7 @@ MultiInputImageRandomCoordinateSampler< TInputImage >
   this->m_Interpolator = bsplineInterpolator;
 
   /** Setup the random generator. */
-  this->m_RandomGenerator = RandomGeneratorType::GetInstance();
+  this->m_RandomGenerator = ThreadRandomGenerator::GetInstance();
 
   this->m_UseRandomSampleRegion = false;
   this->m_SampleRegionSize.Fill( 1.0 );
@@ -183,6 +183,7 @@ public:
   typedef typename Superclass::InternalMatrixType           InternalMatrixType;
   typedef typename Superclass::MovingImageGradientType      MovingImageGradientType;
   typedef typename Superclass::MovingImageGradientValueType MovingImageGradientValueType;
+  typedef typename Superclass::SampleBatchType              SampleBatchType;
 
   /** Parameters as SpaceDimension number of images. */
   typedef typename Superclass::PixelType    PixelType;
@@ -266,6 +267,47 @@ public:
     DerivativeType & imageJacobian,
     NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const;
 
+  /** Transform a block of points at once. The weights and indices
+   * containers are shared by all points of the block.
+   */
+  virtual void TransformPointBatch(
+    const InputPointType * points,
+    SizeValueType numberOfSamples,
+    SampleBatchType & batch ) const;
+
+  /** Compute the inner products of the Jacobian with the moving image
+   * gradients for a block of points at once, writing directly into the
+   * buffers of the batch.
+   */
+  virtual void EvaluateJacobianWithImageGradientProductBatch(
+    const InputPointType * points,
+    const MovingImageGradientType * movingImageGradients,
+    SizeValueType numberOfSamples,
+    SampleBatchType & batch ) const;
+
+  /** Compute the start index of the support region and the weights of a point. */
+  virtual bool ComputeSupportIndexAndWeights(
+    const InputPointType & point,
+    IndexType & supportIndex,
+    ScalarType * weights ) const;
+
+  /** Transform a point using the precomputed support index and weights. */
+  virtual void TransformPointUsingWeights(
+    const InputPointType & point,
+    const IndexType & supportIndex,
+    const ScalarType * weights,
+    OutputPointType & outputPoint ) const;
+
+  /** Compute the inner product of the Jacobian with the moving image gradient,
+   * using the precomputed support index and weights.
+   */
+  virtual void EvaluateJacobianWithImageGradientProductUsingWeights(
+    const IndexType & supportIndex,
+    const ScalarType * weights,
+    const MovingImageGradientType & movingImageGradient,
+    DerivativeType & imageJacobian,
+    NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const;
+
   /** Compute the spatial Jacobian of the transformation. */
   virtual void GetSpatialJacobian(
     const InputPointType & ipp,
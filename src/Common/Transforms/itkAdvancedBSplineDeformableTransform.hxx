@@ -517,6 +517,273 @@ AdvancedBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
 } // end EvaluateJacobianWithImageGradientProduct()
 
 
+/**
+ * ********************* TransformPointBatch ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions, unsigned int VSplineOrder >
+void
+AdvancedBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
+::TransformPointBatch(
+  const InputPointType * points,
+  SizeValueType numberOfSamples,
+  SampleBatchType & batch ) const
+{
+  this->ResizeSampleBatch( batch, numberOfSamples, false );
+
+  /** Allocate memory on the stack, once for all points. */
+  const unsigned long numberOfWeights = WeightsFunctionType::NumberOfWeights;
+  typename WeightsType::ValueType weightsArray[ numberOfWeights ];
+  typename ParameterIndexArrayType::ValueType indicesArray[ numberOfWeights ];
+  WeightsType             weights( weightsArray, numberOfWeights, false );
+  ParameterIndexArrayType indices( indicesArray, numberOfWeights, false );
+
+  OutputPointType outputPoint;
+  bool            inside;
+  for( SizeValueType s = 0; s < numberOfSamples; ++s )
+  {
+    this->TransformPoint( points[ s ], outputPoint, weights, indices, inside );
+    for( unsigned int d = 0; d < SpaceDimension; ++d )
+    {
+      batch.m_TransformedPoints[ d * numberOfSamples + s ] = outputPoint[ d ];
+    }
+  }
+
+} // end TransformPointBatch()
+
+
+/**
+ * ********************* EvaluateJacobianWithImageGradientProductBatch ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions, unsigned int VSplineOrder >
+void
+AdvancedBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
+::EvaluateJacobianWithImageGradientProductBatch(
+  const InputPointType * points,
+  const MovingImageGradientType * movingImageGradients,
+  SizeValueType numberOfSamples,
+  SampleBatchType & batch ) const
+{
+  this->ResizeSampleBatch( batch, numberOfSamples, true );
+
+  /** Get sizes. */
+  const NumberOfParametersType nnzji             = batch.m_NumberOfNonZeroJacobianIndices;
+  const NumberOfParametersType nnzjiPerDimension = nnzji / SpaceDimension;
+
+  /** Allocate memory on the stack, and the indices container, once for all points. */
+  const unsigned long numberOfWeights = WeightsFunctionType::NumberOfWeights;
+  typename WeightsType::ValueType weightsArray[ numberOfWeights ];
+  WeightsType                weights( weightsArray, numberOfWeights, false );
+  NonZeroJacobianIndicesType nonZeroJacobianIndices( nnzji );
+
+  RegionType supportRegion;
+  supportRegion.SetSize( this->m_SupportSize );
+
+  for( SizeValueType s = 0; s < numberOfSamples; ++s )
+  {
+    ParametersValueType * imageJacobian = &batch.m_ImageJacobians[ s * nnzji ];
+    unsigned long *       nzji          = &batch.m_NonZeroJacobianIndices[ s * nnzji ];
+
+    /** Convert the physical point to a continuous index. */
+    ContinuousIndexType cindex;
+    this->TransformPointToContinuousGridIndex( points[ s ], cindex );
+
+    /** NOTE: if the support region does not lie totally within the grid
+     * we assume zero displacement and zero Jacobian.
+     */
+    if( !this->InsideValidRegion( cindex ) )
+    {
+      for( NumberOfParametersType i = 0; i < nnzji; ++i )
+      {
+        imageJacobian[ i ] = 0.0;
+        nzji[ i ]          = i;
+      }
+      continue;
+    }
+
+    /** Compute the B-spline weights. */
+    IndexType supportIndex;
+    this->m_WeightsFunction->ComputeStartIndex( cindex, supportIndex );
+    this->m_WeightsFunction->Evaluate( cindex, supportIndex, weights );
+
+    /** Compute the inner product. */
+    NumberOfParametersType counter = 0;
+    for( unsigned int d = 0; d < SpaceDimension; ++d )
+    {
+      const MovingImageGradientValueType mig = movingImageGradients[ s ][ d ];
+      for( NumberOfParametersType i = 0; i < nnzjiPerDimension; ++i )
+      {
+        imageJacobian[ counter ] = weightsArray[ i ] * mig;
+        ++counter;
+      }
+    }
+
+    /** Compute the nonzero Jacobian indices. */
+    supportRegion.SetIndex( supportIndex );
+    this->ComputeNonZeroJacobianIndices( nonZeroJacobianIndices, supportRegion );
+    std::copy( nonZeroJacobianIndices.begin(), nonZeroJacobianIndices.end(), nzji );
+  }
+
+} // end EvaluateJacobianWithImageGradientProductBatch()
+
+
+/**
+ * ********************* ComputeSupportIndexAndWeights ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions, unsigned int VSplineOrder >
+bool
+AdvancedBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
+::ComputeSupportIndexAndWeights(
+  const InputPointType & point,
+  IndexType & supportIndex,
+  ScalarType * weights ) const
+{
+  /** Convert the physical point to a continuous index. */
+  ContinuousIndexType cindex;
+  this->TransformPointToContinuousGridIndex( point, cindex );
+
+  /** NOTE: if the support region does not lie totally within the grid
+   * we assume zero displacement and zero Jacobian.
+   */
+  if( !this->InsideValidRegion( cindex ) )
+  {
+    supportIndex.Fill( 0 );
+    return false;
+  }
+
+  /** Compute the weights on the stack, and copy them to the output. */
+  const unsigned long numberOfWeights = WeightsFunctionType::NumberOfWeights;
+  typename WeightsType::ValueType weightsArray[ numberOfWeights ];
+  WeightsType weightsWrapper( weightsArray, numberOfWeights, false );
+
+  this->m_WeightsFunction->ComputeStartIndex( cindex, supportIndex );
+  this->m_WeightsFunction->Evaluate( cindex, supportIndex, weightsWrapper );
+  std::copy( weightsArray, weightsArray + numberOfWeights, weights );
+
+  return true;
+
+} // end ComputeSupportIndexAndWeights()
+
+
+/**
+ * ********************* TransformPointUsingWeights ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions, unsigned int VSplineOrder >
+void
+AdvancedBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
+::TransformPointUsingWeights(
+  const InputPointType & point,
+  const IndexType & supportIndex,
+  const ScalarType * weights,
+  OutputPointType & outputPoint ) const
+{
+  /** Check if the coefficient image has been set. */
+  outputPoint = point;
+  if( !this->m_CoefficientImages[ 0 ] )
+  {
+    itkWarningMacro( << "B-spline coefficients have not been set" );
+    return;
+  }
+
+  /** Get the coefficient buffers, and the offset of the support region. */
+  const PixelType * basePointer[ SpaceDimension ];
+  OffsetValueType   rowStart = 0;
+  for( unsigned int d = 0; d < SpaceDimension; ++d )
+  {
+    basePointer[ d ] = this->m_CoefficientImages[ d ]->GetBufferPointer();
+    rowStart        += ( supportIndex[ d ] - this->m_GridRegion.GetIndex()[ d ] )
+      * this->m_GridOffsetTable[ d ];
+  }
+
+  /** Loop over the lines of the support region, in the same order as
+   * the weights, and correlate the coefficients with the weights.
+   */
+  ScalarType    displacement[ SpaceDimension ];
+  unsigned long position[ SpaceDimension ];
+  for( unsigned int d = 0; d < SpaceDimension; ++d )
+  {
+    displacement[ d ] = NumericTraits< ScalarType >::ZeroValue();
+    position[ d ]     = 0;
+  }
+
+  const unsigned long lineLength = this->m_SupportSize[ 0 ];
+  unsigned long       counter    = 0;
+  bool                done       = false;
+  while( !done )
+  {
+    for( unsigned long x = 0; x < lineLength; ++x, ++counter )
+    {
+      const ScalarType w = weights[ counter ];
+      for( unsigned int d = 0; d < SpaceDimension; ++d )
+      {
+        displacement[ d ] += static_cast< ScalarType >( w * basePointer[ d ][ rowStart + x ] );
+      }
+    }
+
+    /** Move to the next line. */
+    done = true;
+    for( unsigned int d = 1; d < SpaceDimension; ++d )
+    {
+      ++position[ d ];
+      rowStart += this->m_GridOffsetTable[ d ];
+      if( position[ d ] < this->m_SupportSize[ d ] )
+      {
+        done = false;
+        break;
+      }
+      rowStart     -= this->m_SupportSize[ d ] * this->m_GridOffsetTable[ d ];
+      position[ d ] = 0;
+    }
+  }
+
+  /** The output point is the start point + displacement. */
+  for( unsigned int d = 0; d < SpaceDimension; ++d )
+  {
+    outputPoint[ d ] += displacement[ d ];
+  }
+
+} // end TransformPointUsingWeights()
+
+
+/**
+ * ********************* EvaluateJacobianWithImageGradientProductUsingWeights ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions, unsigned int VSplineOrder >
+void
+AdvancedBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
+::EvaluateJacobianWithImageGradientProductUsingWeights(
+  const IndexType & supportIndex,
+  const ScalarType * weights,
+  const MovingImageGradientType & movingImageGradient,
+  DerivativeType & imageJacobian,
+  NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const
+{
+  /** Compute the inner product. */
+  const NumberOfParametersType numberOfWeights = WeightsFunctionType::NumberOfWeights;
+  NumberOfParametersType       counter         = 0;
+  for( unsigned int d = 0; d < SpaceDimension; ++d )
+  {
+    const MovingImageGradientValueType mig = movingImageGradient[ d ];
+    for( NumberOfParametersType i = 0; i < numberOfWeights; ++i )
+    {
+      imageJacobian[ counter ] = weights[ i ] * mig;
+      ++counter;
+    }
+  }
+
+  /** Compute the nonzero Jacobian indices. */
+  RegionType supportRegion;
+  supportRegion.SetSize( this->m_SupportSize );
+  supportRegion.SetIndex( supportIndex );
+  this->ComputeNonZeroJacobianIndices( nonZeroJacobianIndices, supportRegion );
+
+} // end EvaluateJacobianWithImageGradientProductUsingWeights()
+
+
 /**
  * ********************* GetSpatialJacobian ****************************
  */
@@ -280,6 +280,46 @@ public:
 
   virtual NumberOfParametersType GetNumberOfNonZeroJacobianIndices( void ) const = 0;
 
+  /** Functions that split the evaluation of the transform in a part that
+   * only depends on the input point and the grid (the start index of the
+   * support region and the interpolation weights), and a part that depends
+   * on the parameters. The first part may be computed once per sample and
+   * reused during the iterations, see BSplineSampleWeightCache.
+   * The weights array has GetNumberOfAffectedWeights() elements.
+   */
+
+  /** Whether the functions below give the same results as TransformPoint()
+   * and EvaluateJacobianWithImageGradientProduct(). False for subclasses
+   * that change the mapping of points to the grid.
+   */
+  virtual bool GetSupportsPrecomputedWeights( void ) const { return true; }
+
+  /** Compute the start index of the support region and the weights of a
+   * point. Returns false when the support region is not inside the grid,
+   * in which case the transform is the identity at this point.
+   */
+  virtual bool ComputeSupportIndexAndWeights(
+    const InputPointType & point,
+    IndexType & supportIndex,
+    ScalarType * weights ) const = 0;
+
+  /** Transform a point using the precomputed support index and weights. */
+  virtual void TransformPointUsingWeights(
+    const InputPointType & point,
+    const IndexType & supportIndex,
+    const ScalarType * weights,
+    OutputPointType & outputPoint ) const = 0;
+
+  /** Compute the inner product of the Jacobian with the moving image gradient,
+   * using the precomputed support index and weights.
+   */
+  virtual void EvaluateJacobianWithImageGradientProductUsingWeights(
+    const IndexType & supportIndex,
+    const ScalarType * weights,
+    const MovingImageGradientType & movingImageGradient,
+    DerivativeType & imageJacobian,
+    NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const = 0;
+
   /** This typedef should be equal to the typedef used
    * in derived classes based on the weights function.
    */
@@ -49,6 +49,11 @@ namespace itk
  * Note: It is mandatory to set a current transform. An initial transform
  * is not mandatory.
  *
+ * With composition, the initial transform is evaluated again for every
+ * sample in every iteration. When UseInitialTransformCache is set, a metric
+ * may store the outputs of the initial transform for its own samples, and
+ * then only evaluate the current transform for them.
+ *
  * \ingroup Transforms
  */
 
@@ -101,6 +106,7 @@ public:
   typedef typename Superclass::TransformCategoryType         TransformCategoryType;
   typedef typename Superclass::MovingImageGradientType       MovingImageGradientType;
   typedef typename Superclass::MovingImageGradientValueType  MovingImageGradientValueType;
+  typedef typename Superclass::SampleBatchType               SampleBatchType;
 
   /** Transform typedefs for the from Superclass. */
   typedef typename Superclass::TransformType   TransformType;
@@ -159,6 +165,15 @@ public:
 
   itkGetConstMacro( UseAddition, bool );
 
+  /** Set/Get whether metrics may cache the outputs of the initial transform
+   * per sample. Only used with composition. The initial transform is assumed
+   * to be fixed; a metric refills its cache when the modified time of the
+   * initial transform changes. Default: false.
+   */
+  itkSetMacro( UseInitialTransformCache, bool );
+  itkGetConstMacro( UseInitialTransformCache, bool );
+  itkBooleanMacro( UseInitialTransformCache );
+
   /**  Method to transform a point. */
   virtual OutputPointType TransformPoint( const InputPointType  & point ) const;
 
@@ -253,6 +268,25 @@ public:
     DerivativeType & imageJacobian,
     NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const;
 
+  /** Transform a block of points at once. Forwarded to the batch function of
+   * the current transform when there is no initial transform.
+   */
+  virtual void TransformPointBatch(
+    const InputPointType * points,
+    SizeValueType numberOfSamples,
+    SampleBatchType & batch ) const;
+
+  /** Compute the inner products of the Jacobian with the moving image
+   * gradients for a block of points at once. Forwarded to the batch function
+   * of the current transform when there is no initial transform, or when
+   * addition is used; otherwise the points are evaluated one by one.
+   */
+  virtual void EvaluateJacobianWithImageGradientProductBatch(
+    const InputPointType * points,
+    const MovingImageGradientType * movingImageGradients,
+    SizeValueType numberOfSamples,
+    SampleBatchType & batch ) const;
+
   /** Compute the spatial Jacobian of the transformation. */
   virtual void GetSpatialJacobian(
     const InputPointType & ipp,
@@ -625,6 +659,9 @@ protected:
   bool m_UseAddition;
   bool m_UseComposition;
 
+  /** Whether metrics may cache the outputs of the initial transform. */
+  bool m_UseInitialTransformCache;
+
 private:
 
   AdvancedCombinationTransform( const Self & ); // purposely not implemented
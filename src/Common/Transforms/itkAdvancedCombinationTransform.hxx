@@ -39,6 +39,9 @@ AdvancedCombinationTransform< TScalarType, NDimensions >
   this->m_UseAddition    = false;
   this->m_UseComposition = true;
 
+  /** Metrics do not cache the outputs of the initial transform. */
+  this->m_UseInitialTransformCache = false;
+
   /** Set everything to have no current transform. */
   this->m_SelectedTransformPointFunction
     = &Self::TransformPointNoCurrentTransform;
@@ -964,6 +967,58 @@ AdvancedCombinationTransform< TScalarType, NDimensions >
 } // end EvaluateJacobianWithImageGradientProductNoInitialTransform()
 
 
+/**
+ * **************** TransformPointBatch ******************
+ */
+
+template< typename TScalarType, unsigned int NDimensions >
+void
+AdvancedCombinationTransform< TScalarType, NDimensions >
+::TransformPointBatch(
+  const InputPointType * points,
+  SizeValueType numberOfSamples,
+  SampleBatchType & batch ) const
+{
+  if( this->m_CurrentTransform.IsNotNull() && this->m_InitialTransform.IsNull() )
+  {
+    this->m_CurrentTransform->TransformPointBatch( points, numberOfSamples, batch );
+    return;
+  }
+
+  /** Otherwise transform the points one by one. */
+  this->Superclass::TransformPointBatch( points, numberOfSamples, batch );
+
+} // end TransformPointBatch()
+
+
+/**
+ * **************** EvaluateJacobianWithImageGradientProductBatch ******************
+ */
+
+template< typename TScalarType, unsigned int NDimensions >
+void
+AdvancedCombinationTransform< TScalarType, NDimensions >
+::EvaluateJacobianWithImageGradientProductBatch(
+  const InputPointType * points,
+  const MovingImageGradientType * movingImageGradients,
+  SizeValueType numberOfSamples,
+  SampleBatchType & batch ) const
+{
+  if( this->m_CurrentTransform.IsNotNull()
+    && ( this->m_InitialTransform.IsNull() || this->m_UseAddition ) )
+  {
+    this->m_CurrentTransform->EvaluateJacobianWithImageGradientProductBatch(
+      points, movingImageGradients, numberOfSamples, batch );
+    return;
+  }
+
+  /** Otherwise evaluate the points one by one. */
+  this->Superclass::EvaluateJacobianWithImageGradientProductBatch(
+    points, movingImageGradients, numberOfSamples, batch );
+
+} // end EvaluateJacobianWithImageGradientProductBatch()
+
+
 /**
  * ******** EvaluateJacobianWithImageGradientProductNoCurrentTransform ******************
  */
@@ -146,6 +146,9 @@ public:
   typedef typename Superclass
     ::JacobianOfSpatialHessianType JacobianOfSpatialHessianType;
   typedef typename Superclass::InternalMatrixType InternalMatrixType;
+  typedef typename Superclass::ParametersValueType ParametersValueType;
+  typedef typename Superclass::MovingImageGradientType MovingImageGradientType;
+  typedef typename Superclass::SampleBatchType         SampleBatchType;
 
   /** Standard matrix type for this class. */
   typedef Matrix< TScalarType,
@@ -400,6 +403,25 @@ public:
     JacobianType &,
     NonZeroJacobianIndicesType & ) const;
 
+  /** Transform a block of points at once. */
+  virtual void TransformPointBatch(
+    const InputPointType * points,
+    SizeValueType numberOfSamples,
+    SampleBatchType & batch ) const;
+
+  /** Compute the inner products of the Jacobian with the moving image
+   * gradients for a block of points at once. The Jacobian of a matrix-offset
+   * transform is an affine function of the point, also for the subclasses
+   * with other parameterizations. So GetJacobian() is only called at the
+   * center and at the center plus each unit vector, once per block, and the
+   * Jacobian at each point is interpolated linearly from these.
+   */
+  virtual void EvaluateJacobianWithImageGradientProductBatch(
+    const InputPointType * points,
+    const MovingImageGradientType * movingImageGradients,
+    SizeValueType numberOfSamples,
+    SampleBatchType & batch ) const;
+
   /** Compute the spatial Jacobian of the transformation. */
   virtual void GetSpatialJacobian(
     const InputPointType &,
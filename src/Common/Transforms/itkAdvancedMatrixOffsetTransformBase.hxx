@@ -607,6 +607,102 @@ AdvancedMatrixOffsetTransformBase< TScalarType, NInputDimensions, NOutputDimensi
 } // end GetJacobian()
 
 
+/**
+ * ********************* TransformPointBatch ****************************
+ */
+
+template< class TScalarType, unsigned int NInputDimensions, unsigned int NOutputDimensions >
+void
+AdvancedMatrixOffsetTransformBase< TScalarType, NInputDimensions, NOutputDimensions >
+::TransformPointBatch(
+  const InputPointType * points,
+  SizeValueType numberOfSamples,
+  SampleBatchType & batch ) const
+{
+  this->ResizeSampleBatch( batch, numberOfSamples, false );
+
+  /** Compute each output dimension for all points in one go. */
+  for( unsigned int d = 0; d < NOutputDimensions; ++d )
+  {
+    ScalarType *     out    = &batch.m_TransformedPoints[ d * numberOfSamples ];
+    const ScalarType offset = this->m_Offset[ d ];
+    for( SizeValueType s = 0; s < numberOfSamples; ++s )
+    {
+      ScalarType value = offset;
+      for( unsigned int j = 0; j < NInputDimensions; ++j )
+      {
+        value += this->m_Matrix[ d ][ j ] * points[ s ][ j ];
+      }
+      out[ s ] = value;
+    }
+  }
+
+} // end TransformPointBatch()
+
+
+/**
+ * ********************* EvaluateJacobianWithImageGradientProductBatch ****************************
+ */
+
+template< class TScalarType, unsigned int NInputDimensions, unsigned int NOutputDimensions >
+void
+AdvancedMatrixOffsetTransformBase< TScalarType, NInputDimensions, NOutputDimensions >
+::EvaluateJacobianWithImageGradientProductBatch(
+  const InputPointType * points,
+  const MovingImageGradientType * movingImageGradients,
+  SizeValueType numberOfSamples,
+  SampleBatchType & batch ) const
+{
+  this->ResizeSampleBatch( batch, numberOfSamples, true );
+  const NumberOfParametersType nnzji = batch.m_NumberOfNonZeroJacobianIndices;
+  if( numberOfSamples == 0 ) { return; }
+
+  /** The Jacobian at point p equals J( c ) + sum_i ( p_i - c_i ) dJ_i, with
+   * dJ_i = J( c + e_i ) - J( c ). Evaluate these with the virtual GetJacobian(),
+   * so that the parameterization of the subclass is respected.
+   */
+  const InputPointType       center = this->GetCenter();
+  JacobianType               jacobian0;
+  JacobianType               jacobianDerivatives[ NInputDimensions ];
+  NonZeroJacobianIndicesType nonZeroJacobianIndices;
+  this->GetJacobian( center, jacobian0, nonZeroJacobianIndices );
+  for( unsigned int i = 0; i < NInputDimensions; ++i )
+  {
+    InputPointType             point = center;
+    NonZeroJacobianIndicesType dummy;
+    point[ i ] += 1.0;
+    this->GetJacobian( point, jacobianDerivatives[ i ], dummy );
+    jacobianDerivatives[ i ] -= jacobian0;
+  }
+
+  /** Compute the inner products. */
+  for( SizeValueType s = 0; s < numberOfSamples; ++s )
+  {
+    const InputVectorType v = points[ s ] - center;
+    ParametersValueType * imjac = &batch.m_ImageJacobians[ s * nnzji ];
+    for( NumberOfParametersType mu = 0; mu < nnzji; ++mu )
+    {
+      ParametersValueType sum = 0.0;
+      for( unsigned int d = 0; d < NOutputDimensions; ++d )
+      {
+        ParametersValueType jac = jacobian0( d, mu );
+        for( unsigned int i = 0; i < NInputDimensions; ++i )
+        {
+          jac += v[ i ] * jacobianDerivatives[ i ]( d, mu );
+        }
+        sum += jac * movingImageGradients[ s ][ d ];
+      }
+      imjac[ mu ] = sum;
+    }
+
+    /** The nonzero Jacobian indices are the same for all points. */
+    std::copy( nonZeroJacobianIndices.begin(), nonZeroJacobianIndices.end(),
+      batch.m_NonZeroJacobianIndices.begin() + s * nnzji );
+  }
+
+} // end EvaluateJacobianWithImageGradientProductBatch()
+
+
 /**
  * ********************* GetSpatialJacobian ****************************
  */
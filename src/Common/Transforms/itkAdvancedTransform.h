@@ -37,6 +37,8 @@
 #include "itkTransform.h"
 #include "itkMatrix.h"
 #include "itkFixedArray.h"
+#include <vector>
+#include <algorithm>
 
 namespace itk
 {
@@ -158,6 +160,28 @@ public:
   typedef OutputCovariantVectorType                   MovingImageGradientType;
   typedef typename MovingImageGradientType::ValueType MovingImageGradientValueType;
 
+  /** Structure-of-arrays buffers for the batch functions, which evaluate
+   * a block of samples at once. For sample s, output dimension d and
+   * nonzero Jacobian index k, with n = m_NumberOfSamples and
+   * nnz = m_NumberOfNonZeroJacobianIndices:
+   * \li m_TransformedPoints[ d * n + s ]: the transformed point,
+   * \li m_ImageJacobians[ s * nnz + k ]: the inner product of the Jacobian
+   *   and the moving image gradient,
+   * \li m_NonZeroJacobianIndices[ s * nnz + k ]: the corresponding parameter.
+   * The capacity of the buffers is kept, so a metric can reuse one batch
+   * per thread for all its blocks of samples.
+   */
+  struct SampleBatchType
+  {
+    SampleBatchType() : m_NumberOfSamples( 0 ), m_NumberOfNonZeroJacobianIndices( 0 ) {}
+
+    SizeValueType                      m_NumberOfSamples;
+    NumberOfParametersType             m_NumberOfNonZeroJacobianIndices;
+    std::vector< ScalarType >          m_TransformedPoints;
+    std::vector< ParametersValueType > m_ImageJacobians;
+    NonZeroJacobianIndicesType         m_NonZeroJacobianIndices;
+  };
+
   /** Get the number of nonzero Jacobian indices. By default all. */
   virtual NumberOfParametersType GetNumberOfNonZeroJacobianIndices( void ) const;
 
@@ -205,6 +229,30 @@ public:
     DerivativeType & imageJacobian,
     NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const;
 
+  /** Transform a block of numberOfSamples points, and store the results
+   * in batch.m_TransformedPoints. The default implementation calls
+   * TransformPoint() for each point; subclasses override it to avoid the
+   * per-sample overhead.
+   */
+  virtual void TransformPointBatch(
+    const InputPointType * points,
+    SizeValueType numberOfSamples,
+    SampleBatchType & batch ) const;
+
+  /** Compute the inner products of the Jacobian with the moving image
+   * gradients, and the nonzero Jacobian indices, for a block of
+   * numberOfSamples points. The results are stored in
+   * batch.m_ImageJacobians and batch.m_NonZeroJacobianIndices. The moving
+   * image gradients are usually evaluated at the points returned by
+   * TransformPointBatch(). The default implementation calls
+   * EvaluateJacobianWithImageGradientProduct() for each point.
+   */
+  virtual void EvaluateJacobianWithImageGradientProductBatch(
+    const InputPointType * points,
+    const MovingImageGradientType * movingImageGradients,
+    SizeValueType numberOfSamples,
+    SampleBatchType & batch ) const;
+
   /** Compute the spatial Jacobian of the transformation.
    *
    * The spatial Jacobian is expressed as a vector of partial derivatives of the
@@ -316,6 +364,10 @@ protected:
   AdvancedTransform( NumberOfParametersType numberOfParameters );
   virtual ~AdvancedTransform() {}
 
+  /** Set the sizes of the buffers of a batch. */
+  void ResizeSampleBatch( SampleBatchType & batch, SizeValueType numberOfSamples,
+    bool withJacobians ) const;
+
   bool m_HasNonZeroSpatialHessian;
   bool m_HasNonZeroJacobianOfSpatialHessian;
 
@@ -107,6 +107,87 @@ AdvancedTransform< TScalarType, NInputDimensions, NOutputDimensions >
 } // end EvaluateJacobianWithImageGradientProduct()
 
 
+/**
+ * ********************* ResizeSampleBatch ****************************
+ */
+
+template< class TScalarType, unsigned int NInputDimensions, unsigned int NOutputDimensions >
+void
+AdvancedTransform< TScalarType, NInputDimensions, NOutputDimensions >
+::ResizeSampleBatch( SampleBatchType & batch, SizeValueType numberOfSamples,
+  bool withJacobians ) const
+{
+  batch.m_NumberOfSamples = numberOfSamples;
+  batch.m_TransformedPoints.resize( numberOfSamples * OutputSpaceDimension );
+  if( withJacobians )
+  {
+    const NumberOfParametersType nnzji = this->GetNumberOfNonZeroJacobianIndices();
+    batch.m_NumberOfNonZeroJacobianIndices = nnzji;
+    batch.m_ImageJacobians.resize( numberOfSamples * nnzji );
+    batch.m_NonZeroJacobianIndices.resize( numberOfSamples * nnzji );
+  }
+
+} // end ResizeSampleBatch()
+
+
+/**
+ * ********************* TransformPointBatch ****************************
+ */
+
+template< class TScalarType, unsigned int NInputDimensions, unsigned int NOutputDimensions >
+void
+AdvancedTransform< TScalarType, NInputDimensions, NOutputDimensions >
+::TransformPointBatch(
+  const InputPointType * points,
+  SizeValueType numberOfSamples,
+  SampleBatchType & batch ) const
+{
+  this->ResizeSampleBatch( batch, numberOfSamples, false );
+
+  for( SizeValueType s = 0; s < numberOfSamples; ++s )
+  {
+    const OutputPointType opp = this->TransformPoint( points[ s ] );
+    for( unsigned int d = 0; d < OutputSpaceDimension; ++d )
+    {
+      batch.m_TransformedPoints[ d * numberOfSamples + s ] = opp[ d ];
+    }
+  }
+
+} // end TransformPointBatch()
+
+
+/**
+ * ********************* EvaluateJacobianWithImageGradientProductBatch ****************************
+ */
+
+template< class TScalarType, unsigned int NInputDimensions, unsigned int NOutputDimensions >
+void
+AdvancedTransform< TScalarType, NInputDimensions, NOutputDimensions >
+::EvaluateJacobianWithImageGradientProductBatch(
+  const InputPointType * points,
+  const MovingImageGradientType * movingImageGradients,
+  SizeValueType numberOfSamples,
+  SampleBatchType & batch ) const
+{
+  this->ResizeSampleBatch( batch, numberOfSamples, true );
+  const NumberOfParametersType nnzji = batch.m_NumberOfNonZeroJacobianIndices;
+
+  /** Allocate the per-sample containers once for the whole batch. */
+  DerivativeType             imageJacobian( nnzji );
+  NonZeroJacobianIndicesType nonZeroJacobianIndices( nnzji );
+  for( SizeValueType s = 0; s < numberOfSamples; ++s )
+  {
+    this->EvaluateJacobianWithImageGradientProduct(
+      points[ s ], movingImageGradients[ s ], imageJacobian, nonZeroJacobianIndices );
+    std::copy( imageJacobian.begin(), imageJacobian.end(),
+      batch.m_ImageJacobians.begin() + s * nnzji );
+    std::copy( nonZeroJacobianIndices.begin(), nonZeroJacobianIndices.end(),
+      batch.m_NonZeroJacobianIndices.begin() + s * nnzji );
+  }
+
+} // end EvaluateJacobianWithImageGradientProductBatch()
+
+
 /**
  * ********************* GetNumberOfNonZeroJacobianIndices ****************************
  */
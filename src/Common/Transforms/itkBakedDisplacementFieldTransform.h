@@ -0,0 +1,335 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkBakedDisplacementFieldTransform_h
+#define __itkBakedDisplacementFieldTransform_h
+
+#include "itkAdvancedTransform.h"
+#include "itkImage.h"
+#include "itkMultiThreader.h"
+#include <vector>
+
+namespace itk
+{
+
+/** \class BakedDisplacementFieldTransform
+ *
+ * \brief Approximates a fixed transform by a dense displacement field.
+ *
+ * An initial transform that is read from a chain of transform parameter
+ * files is an AdvancedCombinationTransform of which every stage is
+ * evaluated for every point. Bake() samples such a SourceTransform once on
+ * a regular grid and stores the displacements T(x) - x, so that
+ * TransformPoint() costs one multilinear interpolation, regardless of the
+ * length of the chain.
+ *
+ * The grid is defined by Size, Spacing, Origin and Direction. Points
+ * outside the grid are transformed by the SourceTransform itself. Bake()
+ * also measures the approximation error at the cell centres of the grid,
+ * where the interpolation error is largest, see GetMeanApproximationError()
+ * and GetMaximumApproximationError().
+ *
+ * The spatial Jacobian is the derivative of the interpolated field; the
+ * spatial Hessian is taken from the SourceTransform. The transform has no
+ * parameters and is only meant to be used as a fixed (initial) transform.
+ *
+ * \ingroup Transforms
+ */
+
+template< class TScalarType, unsigned int NDimensions = 3 >
+class BakedDisplacementFieldTransform :
+  public AdvancedTransform< TScalarType, NDimensions, NDimensions >
+{
+public:
+
+  /** Standard class typedefs. */
+  typedef BakedDisplacementFieldTransform Self;
+  typedef AdvancedTransform<
+    TScalarType, NDimensions, NDimensions > Superclass;
+  typedef SmartPointer< Self >       Pointer;
+  typedef SmartPointer< const Self > ConstPointer;
+
+  /** New macro for creation of through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( BakedDisplacementFieldTransform, AdvancedTransform );
+
+  /** Dimension of the domain spaces. */
+  itkStaticConstMacro( SpaceDimension, unsigned int, NDimensions );
+
+  /** Superclass typedefs. */
+  typedef typename Superclass::ScalarType                    ScalarType;
+  typedef typename Superclass::ParametersType                ParametersType;
+  typedef typename Superclass::JacobianType                  JacobianType;
+  typedef typename Superclass::InputVectorType               InputVectorType;
+  typedef typename Superclass::OutputVectorType              OutputVectorType;
+  typedef typename Superclass::InputCovariantVectorType      InputCovariantVectorType;
+  typedef typename Superclass::OutputCovariantVectorType     OutputCovariantVectorType;
+  typedef typename Superclass::InputVnlVectorType            InputVnlVectorType;
+  typedef typename Superclass::OutputVnlVectorType           OutputVnlVectorType;
+  typedef typename Superclass::InputPointType                InputPointType;
+  typedef typename Superclass::OutputPointType               OutputPointType;
+  typedef typename Superclass::NonZeroJacobianIndicesType    NonZeroJacobianIndicesType;
+  typedef typename Superclass::SpatialJacobianType           SpatialJacobianType;
+  typedef typename Superclass::JacobianOfSpatialJacobianType JacobianOfSpatialJacobianType;
+  typedef typename Superclass::SpatialHessianType            SpatialHessianType;
+  typedef typename Superclass::JacobianOfSpatialHessianType  JacobianOfSpatialHessianType;
+
+  /** The transform that is approximated. */
+  typedef Superclass                                 SourceTransformType;
+  typedef typename SourceTransformType::ConstPointer SourceTransformConstPointer;
+
+  /** The displacement field is stored in single precision, which is
+   * accurate enough for displacements and halves the memory.
+   */
+  typedef Vector< float, NDimensions >                   DisplacementVectorType;
+  typedef Image< DisplacementVectorType, NDimensions >   DisplacementFieldType;
+  typedef typename DisplacementFieldType::Pointer        DisplacementFieldPointer;
+  typedef typename DisplacementFieldType::SizeType       SizeType;
+  typedef typename DisplacementFieldType::SpacingType    SpacingType;
+  typedef typename DisplacementFieldType::PointType      OriginType;
+  typedef typename DisplacementFieldType::DirectionType  DirectionType;
+  typedef Matrix< ScalarType, NDimensions, NDimensions > GridMatrixType;
+
+  typedef MultiThreader                  ThreaderType;
+  typedef ThreaderType::ThreadInfoStruct ThreadInfoType;
+
+  /** Set/Get the transform that is approximated. */
+  itkSetConstObjectMacro( SourceTransform, SourceTransformType );
+  itkGetConstObjectMacro( SourceTransform, SourceTransformType );
+
+  /** Set/Get the grid of the displacement field. The size should be at
+   * least 2 in each dimension.
+   */
+  itkSetMacro( Size, SizeType );
+  itkGetConstReferenceMacro( Size, SizeType );
+  itkSetMacro( Spacing, SpacingType );
+  itkGetConstReferenceMacro( Spacing, SpacingType );
+  itkSetMacro( Origin, OriginType );
+  itkGetConstReferenceMacro( Origin, OriginType );
+  itkSetMacro( Direction, DirectionType );
+  itkGetConstReferenceMacro( Direction, DirectionType );
+
+  /** Set/Get the number of threads used by Bake(). */
+  itkSetMacro( NumberOfThreads, ThreadIdType );
+  itkGetConstMacro( NumberOfThreads, ThreadIdType );
+
+  /** Set/Get the maximum number of cell centres at which the approximation
+   * error is measured. Default: 100000. Zero skips the measurement.
+   */
+  itkSetMacro( MaximumNumberOfErrorSamples, SizeValueType );
+  itkGetConstMacro( MaximumNumberOfErrorSamples, SizeValueType );
+
+  /** Sample the SourceTransform on the grid and measure the approximation
+   * error. Call this again when the SourceTransform or the grid changed.
+   */
+  virtual void Bake( void );
+
+  /** Get the displacement field of the last Bake(). */
+  itkGetConstObjectMacro( DisplacementField, DisplacementFieldType );
+
+  /** Get the mean and the maximum distance between the baked and the
+   * source transform at the cell centres, as measured in the last Bake().
+   */
+  itkGetConstMacro( MeanApproximationError, double );
+  itkGetConstMacro( MaximumApproximationError, double );
+  itkGetConstMacro( NumberOfErrorSamples, SizeValueType );
+
+  /** Setting the parameters is not supported. */
+  virtual void SetParameters( const ParametersType & )
+  {
+    itkExceptionMacro( << "ERROR: SetParameters() is not implemented "
+                       << "for BakedDisplacementFieldTransform.\n"
+                       << "Use it as an (initial) fixed transform that is not optimized." );
+  }
+
+
+  /** Set the fixed parameters. */
+  virtual void SetFixedParameters( const ParametersType & )
+  {
+    // This transform has no fixed parameters.
+  }
+
+
+  /** Get the Fixed Parameters. */
+  virtual const ParametersType & GetFixedParameters( void ) const
+  {
+    // This transform has no fixed parameters.
+    return this->m_FixedParameters;
+  }
+
+
+  /** Transform a point, by interpolating the displacement field. */
+  virtual OutputPointType TransformPoint( const InputPointType & point ) const;
+
+  /** These vector transforms are not implemented for this transform. */
+  virtual OutputVectorType TransformVector( const InputVectorType & ) const
+  {
+    itkExceptionMacro(
+        << "TransformVector(const InputVectorType &) is not implemented "
+        << "for BakedDisplacementFieldTransform" );
+  }
+
+
+  virtual OutputVnlVectorType TransformVector( const InputVnlVectorType & ) const
+  {
+    itkExceptionMacro(
+        << "TransformVector(const InputVnlVectorType &) is not implemented "
+        << "for BakedDisplacementFieldTransform" );
+  }
+
+
+  virtual OutputCovariantVectorType TransformCovariantVector( const InputCovariantVectorType & ) const
+  {
+    itkExceptionMacro(
+        << "TransformCovariantVector(const InputCovariantVectorType &) is not implemented "
+        << "for BakedDisplacementFieldTransform" );
+  }
+
+
+  virtual bool IsLinear( void ) const { return false; }
+
+  /** Compute the spatial Jacobian of the interpolated field. */
+  virtual void GetSpatialJacobian(
+    const InputPointType & ipp, SpatialJacobianType & sj ) const;
+
+  /** Compute the spatial Hessian, of the SourceTransform. */
+  virtual void GetSpatialHessian(
+    const InputPointType & ipp, SpatialHessianType & sh ) const;
+
+  /** The derivatives with respect to the parameters are not defined. */
+  virtual void GetJacobian(
+    const InputPointType &, JacobianType &,
+    NonZeroJacobianIndicesType & ) const
+  {
+    itkExceptionMacro( << "Not implemented for BakedDisplacementFieldTransform" );
+  }
+
+
+  virtual void GetJacobianOfSpatialJacobian(
+    const InputPointType &, JacobianOfSpatialJacobianType &,
+    NonZeroJacobianIndicesType & ) const
+  {
+    itkExceptionMacro( << "Not implemented for BakedDisplacementFieldTransform" );
+  }
+
+
+  virtual void GetJacobianOfSpatialJacobian(
+    const InputPointType &, SpatialJacobianType &,
+    JacobianOfSpatialJacobianType &,
+    NonZeroJacobianIndicesType & ) const
+  {
+    itkExceptionMacro( << "Not implemented for BakedDisplacementFieldTransform" );
+  }
+
+
+  virtual void GetJacobianOfSpatialHessian(
+    const InputPointType &, JacobianOfSpatialHessianType &,
+    NonZeroJacobianIndicesType & ) const
+  {
+    itkExceptionMacro( << "Not implemented for BakedDisplacementFieldTransform" );
+  }
+
+
+  virtual void GetJacobianOfSpatialHessian(
+    const InputPointType &, SpatialHessianType &,
+    JacobianOfSpatialHessianType &,
+    NonZeroJacobianIndicesType & ) const
+  {
+    itkExceptionMacro( << "Not implemented for BakedDisplacementFieldTransform" );
+  }
+
+
+protected:
+
+  BakedDisplacementFieldTransform();
+  virtual ~BakedDisplacementFieldTransform() {}
+
+  /** PrintSelf. */
+  void PrintSelf( std::ostream & os, Indent indent ) const;
+
+  /** Compute the grid cell of point: the offset of its first corner in the
+   * buffer and the fractions along each dimension. Returns false when the
+   * point is outside the grid.
+   */
+  bool ComputeCell( const InputPointType & point,
+    OffsetValueType & cellOffset, ScalarType * fractions ) const;
+
+  /** Sample the SourceTransform for the grid points of one thread. */
+  void ThreadedBake( ThreadIdType threadId, ThreadIdType numberOfThreads );
+
+  /** Measure the approximation error at the cell centres of one thread. */
+  void ThreadedComputeApproximationError( ThreadIdType threadId,
+    ThreadIdType numberOfThreads );
+
+  /** The threader callbacks of Bake(). */
+  static ITK_THREAD_RETURN_TYPE BakeThreaderCallback( void * arg );
+
+  static ITK_THREAD_RETURN_TYPE ComputeApproximationErrorThreaderCallback( void * arg );
+
+private:
+
+  BakedDisplacementFieldTransform( const Self & ); // purposely not implemented
+  void operator=( const Self & );                  // purposely not implemented
+
+  /** The per-thread results of the error measurement. */
+  struct ApproximationErrorPerThreadStruct
+  {
+    double        st_SumOfErrors;
+    double        st_MaximumError;
+    SizeValueType st_NumberOfSamples;
+  };
+
+  SourceTransformConstPointer m_SourceTransform;
+  DisplacementFieldPointer    m_DisplacementField;
+
+  SizeType      m_Size;
+  SpacingType   m_Spacing;
+  OriginType    m_Origin;
+  DirectionType m_Direction;
+
+  /** The grid, as set up by Bake(): the mapping from index to physical
+   * space, its inverse, and the buffer offsets of the dimensions and of
+   * the corners of a cell.
+   */
+  GridMatrixType  m_IndexToPhysicalPoint;
+  GridMatrixType  m_PhysicalPointToIndex;
+  OffsetValueType m_OffsetTable[ NDimensions + 1 ];
+  OffsetValueType m_CornerOffsets[ 1 << NDimensions ];
+
+  ThreadIdType          m_NumberOfThreads;
+  ThreaderType::Pointer m_Threader;
+
+  /** The error measurement; the cell centres are taken with a stride. */
+  SizeValueType                                    m_MaximumNumberOfErrorSamples;
+  SizeValueType                                    m_ErrorSampleStride;
+  SizeType                                         m_ErrorSampleSize;
+  std::vector< ApproximationErrorPerThreadStruct > m_ApproximationErrorPerThreadVariables;
+  double                                           m_MeanApproximationError;
+  double                                           m_MaximumApproximationError;
+  SizeValueType                                    m_NumberOfErrorSamples;
+
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkBakedDisplacementFieldTransform.hxx"
+#endif
+
+#endif // end #ifndef __itkBakedDisplacementFieldTransform_h
@@ -0,0 +1,531 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkBakedDisplacementFieldTransform_hxx
+#define __itkBakedDisplacementFieldTransform_hxx
+
+#include "itkBakedDisplacementFieldTransform.h"
+#include "itkPersistentThreadPool.h"
+#include <algorithm>
+
+namespace itk
+{
+
+/**
+ * ********************* Constructor ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions >
+BakedDisplacementFieldTransform< TScalarType, NDimensions >
+::BakedDisplacementFieldTransform() : Superclass( 0 )
+{
+  this->m_SourceTransform   = NULL;
+  this->m_DisplacementField = NULL;
+
+  this->m_Size.Fill( 2 );
+  this->m_Spacing.Fill( 1.0 );
+  this->m_Origin.Fill( 0.0 );
+  this->m_Direction.SetIdentity();
+
+  this->m_IndexToPhysicalPoint.SetIdentity();
+  this->m_PhysicalPointToIndex.SetIdentity();
+  std::fill( this->m_OffsetTable, this->m_OffsetTable + SpaceDimension + 1, 0 );
+  std::fill( this->m_CornerOffsets, this->m_CornerOffsets + ( 1 << SpaceDimension ), 0 );
+
+  this->m_NumberOfThreads = ThreaderType::GetGlobalDefaultNumberOfThreads();
+  this->m_Threader        = ThreaderType::New();
+
+  this->m_MaximumNumberOfErrorSamples = 100000;
+  this->m_ErrorSampleStride           = 1;
+  this->m_ErrorSampleSize.Fill( 0 );
+  this->m_MeanApproximationError    = 0.0;
+  this->m_MaximumApproximationError = 0.0;
+  this->m_NumberOfErrorSamples      = 0;
+
+} // end Constructor
+
+
+/**
+ * ********************* Bake ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions >
+void
+BakedDisplacementFieldTransform< TScalarType, NDimensions >
+::Bake( void )
+{
+  if( this->m_SourceTransform.IsNull() )
+  {
+    itkExceptionMacro( << "The SourceTransform should be set." );
+  }
+  for( unsigned int d = 0; d < SpaceDimension; ++d )
+  {
+    if( this->m_Size[ d ] < 2 )
+    {
+      itkExceptionMacro( << "The size of the grid should be at least 2 in each dimension." );
+    }
+  }
+
+  /** Allocate the displacement field. */
+  this->m_DisplacementField = DisplacementFieldType::New();
+  this->m_DisplacementField->SetRegions( this->m_Size );
+  this->m_DisplacementField->SetSpacing( this->m_Spacing );
+  this->m_DisplacementField->SetOrigin( this->m_Origin );
+  this->m_DisplacementField->SetDirection( this->m_Direction );
+  this->m_DisplacementField->Allocate();
+
+  /** Set up the mapping between index and physical space. */
+  for( unsigned int i = 0; i < SpaceDimension; ++i )
+  {
+    for( unsigned int j = 0; j < SpaceDimension; ++j )
+    {
+      this->m_IndexToPhysicalPoint[ i ][ j ]
+        = this->m_Direction[ i ][ j ] * this->m_Spacing[ j ];
+    }
+  }
+  this->m_PhysicalPointToIndex = this->m_IndexToPhysicalPoint.GetInverse();
+
+  /** Store the buffer offsets of the corners of a cell. */
+  const OffsetValueType * offsetTable = this->m_DisplacementField->GetOffsetTable();
+  std::copy( offsetTable, offsetTable + SpaceDimension + 1, this->m_OffsetTable );
+  for( unsigned int corner = 0; corner < ( 1u << SpaceDimension ); ++corner )
+  {
+    this->m_CornerOffsets[ corner ] = 0;
+    for( unsigned int d = 0; d < SpaceDimension; ++d )
+    {
+      if( corner & ( 1u << d ) )
+      {
+        this->m_CornerOffsets[ corner ] += this->m_OffsetTable[ d ];
+      }
+    }
+  }
+
+  /** Sample the source transform, on the shared thread pool when available. */
+  this->m_Threader->SetNumberOfThreads(
+    std::max( this->m_NumberOfThreads, static_cast< ThreadIdType >( 1 ) ) );
+  PersistentThreadPool::SingleMethodExecute( this->m_Threader,
+    this->BakeThreaderCallback, this );
+
+  /** Measure the approximation error at the cell centres. The cells are
+   * taken with a stride, such that at most MaximumNumberOfErrorSamples
+   * centres are evaluated.
+   */
+  this->m_MeanApproximationError    = 0.0;
+  this->m_MaximumApproximationError = 0.0;
+  this->m_NumberOfErrorSamples      = 0;
+  if( this->m_MaximumNumberOfErrorSamples > 0 )
+  {
+    SizeValueType stride = 1;
+    while( true )
+    {
+      SizeValueType numberOfSamples = 1;
+      for( unsigned int d = 0; d < SpaceDimension; ++d )
+      {
+        this->m_ErrorSampleSize[ d ] = ( this->m_Size[ d ] - 1 + stride - 1 ) / stride;
+        numberOfSamples *= this->m_ErrorSampleSize[ d ];
+      }
+      if( numberOfSamples <= this->m_MaximumNumberOfErrorSamples ) { break; }
+      ++stride;
+    }
+    this->m_ErrorSampleStride = stride;
+
+    const ThreadIdType                nrOfThreads = this->m_Threader->GetNumberOfThreads();
+    ApproximationErrorPerThreadStruct zero;
+    zero.st_SumOfErrors     = 0.0;
+    zero.st_MaximumError    = 0.0;
+    zero.st_NumberOfSamples = 0;
+    this->m_ApproximationErrorPerThreadVariables.assign( nrOfThreads, zero );
+
+    PersistentThreadPool::SingleMethodExecute( this->m_Threader,
+      this->ComputeApproximationErrorThreaderCallback, this );
+
+    /** Accumulate the results of the threads. */
+    double sumOfErrors = 0.0;
+    for( ThreadIdType i = 0; i < nrOfThreads; ++i )
+    {
+      const ApproximationErrorPerThreadStruct & threadData
+        = this->m_ApproximationErrorPerThreadVariables[ i ];
+      sumOfErrors                      += threadData.st_SumOfErrors;
+      this->m_NumberOfErrorSamples     += threadData.st_NumberOfSamples;
+      this->m_MaximumApproximationError = std::max(
+        this->m_MaximumApproximationError, threadData.st_MaximumError );
+    }
+    if( this->m_NumberOfErrorSamples > 0 )
+    {
+      this->m_MeanApproximationError = sumOfErrors / this->m_NumberOfErrorSamples;
+    }
+  }
+
+  this->Modified();
+
+} // end Bake()
+
+
+/**
+ * ********************* ThreadedBake ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions >
+void
+BakedDisplacementFieldTransform< TScalarType, NDimensions >
+::ThreadedBake( ThreadIdType threadId, ThreadIdType numberOfThreads )
+{
+  /** Determine the contiguous range of grid points of this thread. */
+  const SizeValueType numberOfPoints = this->m_DisplacementField
+    ->GetLargestPossibleRegion().GetNumberOfPixels();
+  const SizeValueType chunkSize
+    = ( numberOfPoints + numberOfThreads - 1 ) / numberOfThreads;
+  const SizeValueType pos_begin = std::min( threadId * chunkSize, numberOfPoints );
+  const SizeValueType pos_end   = std::min( pos_begin + chunkSize, numberOfPoints );
+
+  DisplacementVectorType * buffer = this->m_DisplacementField->GetBufferPointer();
+  for( SizeValueType i = pos_begin; i < pos_end; ++i )
+  {
+    /** Compute the grid point of buffer position i. */
+    SizeValueType  remainder = i;
+    InputPointType point;
+    point.Fill( 0.0 );
+    for( unsigned int k = 0; k < SpaceDimension; ++k )
+    {
+      const ScalarType index = static_cast< ScalarType >( remainder % this->m_Size[ k ] );
+      remainder /= this->m_Size[ k ];
+      for( unsigned int j = 0; j < SpaceDimension; ++j )
+      {
+        point[ j ] += this->m_IndexToPhysicalPoint[ j ][ k ] * index;
+      }
+    }
+    for( unsigned int j = 0; j < SpaceDimension; ++j )
+    {
+      point[ j ] += this->m_Origin[ j ];
+    }
+
+    const OutputPointType mappedPoint = this->m_SourceTransform->TransformPoint( point );
+    for( unsigned int j = 0; j < SpaceDimension; ++j )
+    {
+      buffer[ i ][ j ] = static_cast< float >( mappedPoint[ j ] - point[ j ] );
+    }
+  }
+
+} // end ThreadedBake()
+
+
+/**
+ * ********************* ThreadedComputeApproximationError ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions >
+void
+BakedDisplacementFieldTransform< TScalarType, NDimensions >
+::ThreadedComputeApproximationError( ThreadIdType threadId, ThreadIdType numberOfThreads )
+{
+  /** Determine the contiguous range of cell centres of this thread. */
+  SizeValueType numberOfSamples = 1;
+  for( unsigned int d = 0; d < SpaceDimension; ++d )
+  {
+    numberOfSamples *= this->m_ErrorSampleSize[ d ];
+  }
+  const SizeValueType chunkSize
+    = ( numberOfSamples + numberOfThreads - 1 ) / numberOfThreads;
+  const SizeValueType pos_begin = std::min( threadId * chunkSize, numberOfSamples );
+  const SizeValueType pos_end   = std::min( pos_begin + chunkSize, numberOfSamples );
+
+  ApproximationErrorPerThreadStruct & threadData
+    = this->m_ApproximationErrorPerThreadVariables[ threadId ];
+  for( SizeValueType i = pos_begin; i < pos_end; ++i )
+  {
+    /** Compute the centre of the cell of sample i. */
+    SizeValueType  remainder = i;
+    InputPointType point;
+    point.Fill( 0.0 );
+    for( unsigned int k = 0; k < SpaceDimension; ++k )
+    {
+      const ScalarType index = static_cast< ScalarType >(
+        ( remainder % this->m_ErrorSampleSize[ k ] ) * this->m_ErrorSampleStride ) + 0.5;
+      remainder /= this->m_ErrorSampleSize[ k ];
+      for( unsigned int j = 0; j < SpaceDimension; ++j )
+      {
+        point[ j ] += this->m_IndexToPhysicalPoint[ j ][ k ] * index;
+      }
+    }
+    for( unsigned int j = 0; j < SpaceDimension; ++j )
+    {
+      point[ j ] += this->m_Origin[ j ];
+    }
+
+    const OutputPointType bakedPoint  = this->TransformPoint( point );
+    const OutputPointType sourcePoint = this->m_SourceTransform->TransformPoint( point );
+    const double          error       = bakedPoint.EuclideanDistanceTo( sourcePoint );
+
+    threadData.st_SumOfErrors += error;
+    threadData.st_MaximumError = std::max( threadData.st_MaximumError, error );
+    ++threadData.st_NumberOfSamples;
+  }
+
+} // end ThreadedComputeApproximationError()
+
+
+/**
+ * ********************* BakeThreaderCallback ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions >
+ITK_THREAD_RETURN_TYPE
+BakedDisplacementFieldTransform< TScalarType, NDimensions >
+::BakeThreaderCallback( void * arg )
+{
+  ThreadInfoType * infoStruct  = static_cast< ThreadInfoType * >( arg );
+  ThreadIdType     threadId    = infoStruct->ThreadID;
+  ThreadIdType     nrOfThreads = infoStruct->NumberOfThreads;
+
+  Self * temp = static_cast< Self * >( infoStruct->UserData );
+  temp->ThreadedBake( threadId, nrOfThreads );
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end BakeThreaderCallback()
+
+
+/**
+ * ********************* ComputeApproximationErrorThreaderCallback ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions >
+ITK_THREAD_RETURN_TYPE
+BakedDisplacementFieldTransform< TScalarType, NDimensions >
+::ComputeApproximationErrorThreaderCallback( void * arg )
+{
+  ThreadInfoType * infoStruct  = static_cast< ThreadInfoType * >( arg );
+  ThreadIdType     threadId    = infoStruct->ThreadID;
+  ThreadIdType     nrOfThreads = infoStruct->NumberOfThreads;
+
+  Self * temp = static_cast< Self * >( infoStruct->UserData );
+  temp->ThreadedComputeApproximationError( threadId, nrOfThreads );
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end ComputeApproximationErrorThreaderCallback()
+
+
+/**
+ * ********************* ComputeCell ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions >
+bool
+BakedDisplacementFieldTransform< TScalarType, NDimensions >
+::ComputeCell( const InputPointType & point,
+  OffsetValueType & cellOffset, ScalarType * fractions ) const
+{
+  if( this->m_DisplacementField.IsNull() )
+  {
+    return false;
+  }
+
+  /** Use the grid of the field, which may differ from the current settings. */
+  const SizeType &   size   = this->m_DisplacementField->GetLargestPossibleRegion().GetSize();
+  const OriginType & origin = this->m_DisplacementField->GetOrigin();
+
+  cellOffset = 0;
+  for( unsigned int i = 0; i < SpaceDimension; ++i )
+  {
+    ScalarType cindex = 0.0;
+    for( unsigned int j = 0; j < SpaceDimension; ++j )
+    {
+      cindex += this->m_PhysicalPointToIndex[ i ][ j ] * ( point[ j ] - origin[ j ] );
+    }
+
+    /** The negated test also rejects NaNs. */
+    const ScalarType maxIndex = static_cast< ScalarType >( size[ i ] - 1 );
+    if( !( cindex >= 0.0 && cindex <= maxIndex ) )
+    {
+      return false;
+    }
+
+    /** A point on the last grid plane belongs to the last cell. */
+    OffsetValueType base = static_cast< OffsetValueType >( cindex );
+    base           = std::min( base, static_cast< OffsetValueType >( size[ i ] ) - 2 );
+    fractions[ i ] = cindex - static_cast< ScalarType >( base );
+    cellOffset    += base * this->m_OffsetTable[ i ];
+  }
+  return true;
+
+} // end ComputeCell()
+
+
+/**
+ * ********************* TransformPoint ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions >
+typename BakedDisplacementFieldTransform< TScalarType, NDimensions >::OutputPointType
+BakedDisplacementFieldTransform< TScalarType, NDimensions >
+::TransformPoint( const InputPointType & point ) const
+{
+  /** Outside the grid, use the source transform itself. */
+  OffsetValueType cellOffset = 0;
+  ScalarType      fractions[ SpaceDimension ];
+  if( !this->ComputeCell( point, cellOffset, fractions ) )
+  {
+    if( this->m_SourceTransform.IsNotNull() )
+    {
+      return this->m_SourceTransform->TransformPoint( point );
+    }
+    return point;
+  }
+
+  /** Multilinear interpolation of the displacements at the cell corners. */
+  const DisplacementVectorType * cell
+    = this->m_DisplacementField->GetBufferPointer() + cellOffset;
+  OutputPointType opp = point;
+  for( unsigned int corner = 0; corner < ( 1u << SpaceDimension ); ++corner )
+  {
+    ScalarType weight = 1.0;
+    for( unsigned int d = 0; d < SpaceDimension; ++d )
+    {
+      weight *= ( corner & ( 1u << d ) ) ? fractions[ d ] : 1.0 - fractions[ d ];
+    }
+
+    const DisplacementVectorType & displacement = cell[ this->m_CornerOffsets[ corner ] ];
+    for( unsigned int d = 0; d < SpaceDimension; ++d )
+    {
+      opp[ d ] += weight * displacement[ d ];
+    }
+  }
+
+  return opp;
+
+} // end TransformPoint()
+
+
+/**
+ * ********************* GetSpatialJacobian ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions >
+void
+BakedDisplacementFieldTransform< TScalarType, NDimensions >
+::GetSpatialJacobian( const InputPointType & ipp, SpatialJacobianType & sj ) const
+{
+  OffsetValueType cellOffset = 0;
+  ScalarType      fractions[ SpaceDimension ];
+  if( !this->ComputeCell( ipp, cellOffset, fractions ) )
+  {
+    if( this->m_SourceTransform.IsNotNull() )
+    {
+      this->m_SourceTransform->GetSpatialJacobian( ipp, sj );
+    }
+    else
+    {
+      sj.SetIdentity();
+    }
+    return;
+  }
+
+  /** The derivatives of the displacement with respect to the index. */
+  const DisplacementVectorType * cell
+    = this->m_DisplacementField->GetBufferPointer() + cellOffset;
+  GridMatrixType dDisplacement_dIndex;
+  dDisplacement_dIndex.Fill( 0.0 );
+  for( unsigned int corner = 0; corner < ( 1u << SpaceDimension ); ++corner )
+  {
+    const DisplacementVectorType & displacement = cell[ this->m_CornerOffsets[ corner ] ];
+    for( unsigned int e = 0; e < SpaceDimension; ++e )
+    {
+      ScalarType dweight = 1.0;
+      for( unsigned int d = 0; d < SpaceDimension; ++d )
+      {
+        const bool upper = ( corner & ( 1u << d ) ) != 0;
+        if( d == e )
+        {
+          dweight *= upper ? 1.0 : -1.0;
+        }
+        else
+        {
+          dweight *= upper ? fractions[ d ] : 1.0 - fractions[ d ];
+        }
+      }
+      for( unsigned int k = 0; k < SpaceDimension; ++k )
+      {
+        dDisplacement_dIndex[ k ][ e ] += dweight * displacement[ k ];
+      }
+    }
+  }
+
+  /** Apply the chain rule, and add the identity of x. */
+  sj = dDisplacement_dIndex * this->m_PhysicalPointToIndex;
+  for( unsigned int d = 0; d < SpaceDimension; ++d )
+  {
+    sj[ d ][ d ] += 1.0;
+  }
+
+} // end GetSpatialJacobian()
+
+
+/**
+ * ********************* GetSpatialHessian ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions >
+void
+BakedDisplacementFieldTransform< TScalarType, NDimensions >
+::GetSpatialHessian( const InputPointType & ipp, SpatialHessianType & sh ) const
+{
+  /** The interpolated field is piecewise linear, so its second derivatives
+   * are not meaningful; use those of the source transform.
+   */
+  if( this->m_SourceTransform.IsNotNull() )
+  {
+    this->m_SourceTransform->GetSpatialHessian( ipp, sh );
+    return;
+  }
+  for( unsigned int d = 0; d < SpaceDimension; ++d )
+  {
+    sh[ d ].Fill( 0.0 );
+  }
+
+} // end GetSpatialHessian()
+
+
+/**
+ * ********************* PrintSelf ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions >
+void
+BakedDisplacementFieldTransform< TScalarType, NDimensions >
+::PrintSelf( std::ostream & os, Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "SourceTransform: " << this->m_SourceTransform.GetPointer() << std::endl;
+  os << indent << "DisplacementField: " << this->m_DisplacementField.GetPointer() << std::endl;
+  os << indent << "Size: " << this->m_Size << std::endl;
+  os << indent << "Spacing: " << this->m_Spacing << std::endl;
+  os << indent << "Origin: " << this->m_Origin << std::endl;
+  os << indent << "Direction: " << this->m_Direction << std::endl;
+  os << indent << "NumberOfThreads: " << this->m_NumberOfThreads << std::endl;
+  os << indent << "MaximumNumberOfErrorSamples: " << this->m_MaximumNumberOfErrorSamples << std::endl;
+  os << indent << "MeanApproximationError: " << this->m_MeanApproximationError << std::endl;
+  os << indent << "MaximumApproximationError: " << this->m_MaximumApproximationError << std::endl;
+  os << indent << "NumberOfErrorSamples: " << this->m_NumberOfErrorSamples << std::endl;
+
+} // end PrintSelf()
+
+
+} // end namespace itk
+
+#endif // end #ifndef __itkBakedDisplacementFieldTransform_hxx
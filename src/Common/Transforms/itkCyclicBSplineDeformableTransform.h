@@ -140,6 +140,11 @@ public:
     const InputPointType & ipp,
     SpatialJacobianType & sj ) const;
 
+  /** The cyclic support regions are not handled by the functions that
+   * use precomputed weights.
+   */
+  virtual bool GetSupportsPrecomputedWeights( void ) const { return false; }
+
 protected:
 
   CyclicBSplineDeformableTransform();
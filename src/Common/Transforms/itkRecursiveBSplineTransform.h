@@ -98,6 +98,7 @@ public:
   typedef typename Superclass::SpatialHessianType            SpatialHessianType;
   typedef typename Superclass::JacobianOfSpatialHessianType  JacobianOfSpatialHessianType;
   typedef typename Superclass::InternalMatrixType            InternalMatrixType;
+  typedef typename Superclass::SampleBatchType               SampleBatchType;
   typedef typename Superclass::MovingImageGradientType       MovingImageGradientType;
   typedef typename Superclass::MovingImageGradientValueType  MovingImageGradientValueType;
 
@@ -148,6 +149,25 @@ public:
     DerivativeType & imageJacobian,
     NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const;
 
+  /** Transform a block of points at once. The coefficient buffers and the
+   * grid offset table are looked up once per block.
+   */
+  virtual void TransformPointBatch(
+    const InputPointType * points,
+    SizeValueType numberOfSamples,
+    SampleBatchType & batch ) const;
+
+  /** Compute the inner products of the Jacobian with the moving image
+   * gradients and the nonzero Jacobian indices for a block of points at
+   * once. The recursive implementation writes directly into the buffers
+   * of the batch.
+   */
+  virtual void EvaluateJacobianWithImageGradientProductBatch(
+    const InputPointType * points,
+    const MovingImageGradientType * movingImageGradients,
+    SizeValueType numberOfSamples,
+    SampleBatchType & batch ) const;
+
   /** Compute the spatial Jacobian of the transformation. */
   virtual void GetSpatialJacobian(
     const InputPointType & ipp,
@@ -250,6 +250,171 @@ RecursiveBSplineTransform< TScalar, NDimensions, VSplineOrder >
 } // end EvaluateJacobianWithImageGradientProduct()
 
 
+/**
+ * ********************* TransformPointBatch ****************************
+ */
+
+template< class TScalar, unsigned int NDimensions, unsigned int VSplineOrder >
+void
+RecursiveBSplineTransform< TScalar, NDimensions, VSplineOrder >
+::TransformPointBatch(
+  const InputPointType * points,
+  SizeValueType numberOfSamples,
+  SampleBatchType & batch ) const
+{
+  this->ResizeSampleBatch( batch, numberOfSamples, false );
+
+  /** Check if the coefficient image has been set. */
+  if( !this->m_CoefficientImages[ 0 ] )
+  {
+    itkWarningMacro( << "B-spline coefficients have not been set" );
+    for( SizeValueType s = 0; s < numberOfSamples; ++s )
+    {
+      for( unsigned int j = 0; j < SpaceDimension; ++j )
+      {
+        batch.m_TransformedPoints[ j * numberOfSamples + s ] = points[ s ][ j ];
+      }
+    }
+    return;
+  }
+
+  /** Allocate weights on the stack, and get the buffers, once for all points. */
+  const unsigned int numberOfWeights = RecursiveBSplineWeightFunctionType::NumberOfWeights;
+  typename WeightsType::ValueType weightsArray1D[ numberOfWeights ];
+  WeightsType weights1D( weightsArray1D, numberOfWeights, false );
+
+  const OffsetValueType * bsplineOffsetTable = this->m_CoefficientImages[ 0 ]->GetOffsetTable();
+  ScalarType *            coefficients[ SpaceDimension ];
+  for( unsigned int j = 0; j < SpaceDimension; ++j )
+  {
+    coefficients[ j ] = this->m_CoefficientImages[ j ]->GetBufferPointer();
+  }
+
+  for( SizeValueType s = 0; s < numberOfSamples; ++s )
+  {
+    const InputPointType & point = points[ s ];
+
+    /** Convert to continuous index. */
+    ContinuousIndexType cindex;
+    this->TransformPointToContinuousGridIndex( point, cindex );
+
+    /** Outside the valid region the displacement is zero. */
+    ScalarType displacement[ SpaceDimension ];
+    if( !this->InsideValidRegion( cindex ) )
+    {
+      for( unsigned int j = 0; j < SpaceDimension; ++j )
+      {
+        displacement[ j ] = 0.0;
+      }
+    }
+    else
+    {
+      /** Compute interpolation weights and store them in weights1D. */
+      IndexType supportIndex;
+      this->m_RecursiveBSplineWeightFunction->Evaluate( cindex, weights1D, supportIndex );
+
+      OffsetValueType totalOffsetToSupportIndex = 0;
+      for( unsigned int j = 0; j < SpaceDimension; ++j )
+      {
+        totalOffsetToSupportIndex += supportIndex[ j ] * bsplineOffsetTable[ j ];
+      }
+
+      ScalarType * mu[ SpaceDimension ];
+      for( unsigned int j = 0; j < SpaceDimension; ++j )
+      {
+        mu[ j ] = coefficients[ j ] + totalOffsetToSupportIndex;
+      }
+
+      /** Call the recursive TransformPoint function. */
+      RecursiveBSplineTransformImplementation< SpaceDimension, SpaceDimension, SplineOrder, TScalar >
+        ::TransformPoint( displacement, mu, bsplineOffsetTable, weightsArray1D );
+    }
+
+    /** The output point is the start point + displacement. */
+    for( unsigned int j = 0; j < SpaceDimension; ++j )
+    {
+      batch.m_TransformedPoints[ j * numberOfSamples + s ] = displacement[ j ] + point[ j ];
+    }
+  }
+
+} // end TransformPointBatch()
+
+
+/**
+ * ********************* EvaluateJacobianWithImageGradientProductBatch ****************************
+ */
+
+template< class TScalar, unsigned int NDimensions, unsigned int VSplineOrder >
+void
+RecursiveBSplineTransform< TScalar, NDimensions, VSplineOrder >
+::EvaluateJacobianWithImageGradientProductBatch(
+  const InputPointType * points,
+  const MovingImageGradientType * movingImageGradients,
+  SizeValueType numberOfSamples,
+  SampleBatchType & batch ) const
+{
+  this->ResizeSampleBatch( batch, numberOfSamples, true );
+  const NumberOfParametersType nnzji = batch.m_NumberOfNonZeroJacobianIndices;
+  if( numberOfSamples == 0 ) { return; }
+
+  /** Allocate weights on the stack, and get the grid properties, once for all points. */
+  const unsigned int numberOfWeights = RecursiveBSplineWeightFunctionType::NumberOfWeights;
+  typename WeightsType::ValueType weightsArray1D[ numberOfWeights ];
+  WeightsType weights1D( weightsArray1D, numberOfWeights, false );
+
+  const unsigned long     parametersPerDim = this->GetNumberOfParametersPerDimension();
+  const OffsetValueType * gridOffsetTable  = this->m_CoefficientImages[ 0 ]->GetOffsetTable();
+
+  for( SizeValueType s = 0; s < numberOfSamples; ++s )
+  {
+    ParametersValueType * imageJacobianPointer = &batch.m_ImageJacobians[ s * nnzji ];
+    unsigned long *       nzjiPointer          = &batch.m_NonZeroJacobianIndices[ s * nnzji ];
+
+    /** Convert the physical point to a continuous index. */
+    ContinuousIndexType cindex;
+    this->TransformPointToContinuousGridIndex( points[ s ], cindex );
+
+    /** NOTE: if the support region does not lie totally within the grid
+     * we assume zero displacement and zero Jacobian.
+     */
+    if( !this->InsideValidRegion( cindex ) )
+    {
+      for( NumberOfParametersType i = 0; i < nnzji; ++i )
+      {
+        imageJacobianPointer[ i ] = 0.0;
+        nzjiPointer[ i ]          = i;
+      }
+      continue;
+    }
+
+    /** Compute the interpolation weights. */
+    IndexType supportIndex;
+    this->m_RecursiveBSplineWeightFunction->Evaluate( cindex, weights1D, supportIndex );
+
+    /** Recursively compute the inner product of the Jacobian and the moving image gradient. */
+    double migArray[ SpaceDimension ];
+    for( unsigned int j = 0; j < SpaceDimension; ++j )
+    {
+      migArray[ j ] = movingImageGradients[ s ][ j ];
+    }
+    RecursiveBSplineTransformImplementation< SpaceDimension, SpaceDimension, SplineOrder, TScalar >
+      ::EvaluateJacobianWithImageGradientProduct( imageJacobianPointer, migArray, weightsArray1D, 1.0 );
+
+    /** Recursively compute the nonzero Jacobian indices. */
+    OffsetValueType totalOffsetToSupportIndex = 0;
+    for( unsigned int j = 0; j < SpaceDimension; ++j )
+    {
+      totalOffsetToSupportIndex += supportIndex[ j ] * gridOffsetTable[ j ];
+    }
+    unsigned long currentIndex = totalOffsetToSupportIndex;
+    RecursiveBSplineTransformImplementation< SpaceDimension, SpaceDimension, SplineOrder, TScalar >
+      ::ComputeNonZeroJacobianIndices( nzjiPointer,
+        parametersPerDim, currentIndex, gridOffsetTable );
+  }
+
+} // end EvaluateJacobianWithImageGradientProductBatch()
+
+
 /**
  * ********************* GetSpatialJacobian ****************************
  */
@@ -48,6 +48,10 @@ namespace itk
  * image and uses bilinear interpolation to integrate each plane of
  * voxels traversed.
  *
+ * Evaluate() keeps the state of the ray on the stack, so it may be called
+ * concurrently, for example from the threaded sample loop of a metric, as
+ * long as the transform is not changed meanwhile.
+ *
  * \warning This interpolator works for 3-dimensional images only.
  *
  * \ingroup ImageFunctions
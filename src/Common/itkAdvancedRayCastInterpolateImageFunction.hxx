@@ -1414,22 +1414,111 @@ RayCastHelper< TInputImage, TCoordRep >
   {
     return false;
   }
+  /* Determine the two axes within the planes of voxels being traversed,
+     so that the loop below does not depend on the traversal direction. */
+
+  unsigned int yAxis = 0;
+  unsigned int zAxis = 1;
+  switch( m_TraversalDirection )
+  {
+    case TRANSVERSE_IN_X:
+      yAxis = 1; zAxis = 2;
+      break;
+    case TRANSVERSE_IN_Y:
+      yAxis = 0; zAxis = 2;
+      break;
+    case TRANSVERSE_IN_Z:
+      yAxis = 0; zAxis = 1;
+      break;
+    default:
+    {
+      itk::ExceptionObject err( __FILE__, __LINE__ );
+      err.SetLocation( ITK_LOCATION );
+      err.SetDescription( "The ray traversal direction is unset "
+        "- IntegrateAboveThreshold()." );
+      throw err;
+      return false;
+    }
+  }
+
   /* Step along the ray as quickly as possible
-     integrating the interpolated intensities. */
+     integrating the interpolated intensities.
+     The state of the ray is kept in local variables, which is equivalent
+     to calling GetCurrentIntensity() and IncrementVoxelPointers(), but
+     allows the compiler to keep it in registers. */
+
+  const int         strideY    = m_NumberOfVoxelsInX;
+  const int         strideZ    = m_NumberOfVoxelsInX * m_NumberOfVoxelsInY;
+  const double      incrementX = m_VoxelIncrement[ 0 ];
+  const double      incrementY = m_VoxelIncrement[ 1 ];
+  const double      incrementZ = m_VoxelIncrement[ 2 ];
+  double            position[ 3 ];
+  const PixelType * voxel0 = m_RayIntersectionVoxels[ 0 ];
+  const PixelType * voxel1 = m_RayIntersectionVoxels[ 1 ];
+  const PixelType * voxel2 = m_RayIntersectionVoxels[ 2 ];
+  const PixelType * voxel3 = m_RayIntersectionVoxels[ 3 ];
+
+  position[ 0 ] = m_Position3Dvox[ 0 ];
+  position[ 1 ] = m_Position3Dvox[ 1 ];
+  position[ 2 ] = m_Position3Dvox[ 2 ];
+
+  const int xStart = (int)position[ 0 ];
+  const int yStart = (int)position[ 1 ];
+  const int zStart = (int)position[ 2 ];
 
   for( m_NumVoxelPlanesTraversed = 0;
     m_NumVoxelPlanesTraversed < m_TotalRayVoxelPlanes;
     m_NumVoxelPlanesTraversed++ )
   {
-    intensity = this->GetCurrentIntensity();
+    /* Bilinear interpolation within the plane of voxels. */
+    const double a = (double)( *voxel0 );
+    const double b = (double)( *voxel1 - a );
+    const double c = (double)( *voxel2 - a );
+    const double d = (double)( *voxel3 - a - b - c );
+    const double y = position[ yAxis ] - vcl_floor( position[ yAxis ] );
+    const double z = position[ zAxis ] - vcl_floor( position[ zAxis ] );
+
+    intensity = a + b * y + c * z + d * y * z;
 
     if( intensity > threshold )
     {
       integral += intensity - threshold;
     }
-    this->IncrementVoxelPointers();
+
+    /* Move the voxel pointers to the next plane. */
+    const int xBefore = (int)position[ 0 ];
+    const int yBefore = (int)position[ 1 ];
+    const int zBefore = (int)position[ 2 ];
+
+    position[ 0 ] += incrementX;
+    position[ 1 ] += incrementY;
+    position[ 2 ] += incrementZ;
+
+    const int offset = ( (int)position[ 0 ] - xBefore )
+      + ( (int)position[ 1 ] - yBefore ) * strideY
+      + ( (int)position[ 2 ] - zBefore ) * strideZ;
+
+    voxel0 += offset;
+    voxel1 += offset;
+    voxel2 += offset;
+    voxel3 += offset;
   }
 
+  /* Store the final state of the ray. */
+
+  m_Position3Dvox[ 0 ] = position[ 0 ];
+  m_Position3Dvox[ 1 ] = position[ 1 ];
+  m_Position3Dvox[ 2 ] = position[ 2 ];
+
+  m_RayIntersectionVoxelIndex[ 0 ] += (int)position[ 0 ] - xStart;
+  m_RayIntersectionVoxelIndex[ 1 ] += (int)position[ 1 ] - yStart;
+  m_RayIntersectionVoxelIndex[ 2 ] += (int)position[ 2 ] - zStart;
+
+  m_RayIntersectionVoxels[ 0 ] = voxel0;
+  m_RayIntersectionVoxels[ 1 ] = voxel1;
+  m_RayIntersectionVoxels[ 2 ] = voxel2;
+  m_RayIntersectionVoxels[ 3 ] = voxel3;
+
   /* The ray passes through the volume one plane of voxels at a time,
      however, if its moving diagonally the ray points will be further
      apart so account for this by scaling by the distance moved. */
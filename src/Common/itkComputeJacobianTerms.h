@@ -22,6 +22,10 @@
 #include "itkImageRandomSamplerBase.h"
 #include "itkImageRandomCoordinateSampler.h"
 #include "itkScaledSingleValuedNonLinearOptimizer.h"
+#include "itkMultiThreader.h"
+
+#include "vnl/vnl_sparse_matrix.h"
+#include <vector>
 
 namespace itk
 {
@@ -31,6 +35,14 @@ namespace itk
  * More specifically this class computes the Jacobian terms related to the automatic
  * parameter estimation for the adaptive stochastic gradient descent optimizer.
  * Details can be found in the paper.
+ *
+ * The covariance matrix C is stored in a sparse row format, holding only the
+ * upper triangle, so its memory scales with the number of parameters times
+ * the size of the overlap of the B-spline supports, and not with the square
+ * of the number of parameters. The Jacobians are evaluated multi-threaded,
+ * with each thread handling a contiguous range of samples and accumulating
+ * its own sparse C. These are then added row by row in the order of the
+ * threads, so that the result does not depend on the timing of the threads.
  */
 
 template< class TFixedImage, class TTransform >
@@ -86,9 +98,20 @@ public:
   /** Set some parameters. */
   itkSetMacro( Scales, ScalesType );
   itkSetMacro( UseScales, bool );
+  itkSetMacro( NumberOfJacobianMeasurements, SizeValueType );
+
+  /** Set the parameters of the former band matrix storage of C. They are
+   * not used anymore, since C is always stored in sparse row format, and are
+   * only kept for backward compatibility.
+   */
   itkSetMacro( MaxBandCovSize, unsigned int );
   itkSetMacro( NumberOfBandStructureSamples, unsigned int );
-  itkSetMacro( NumberOfJacobianMeasurements, SizeValueType );
+
+  /** Set the number of threads. */
+  void SetNumberOfThreads( ThreadIdType numberOfThreads )
+  {
+    this->m_Threader->SetNumberOfThreads( numberOfThreads );
+  }
 
   /** Set the region over which the metric will be computed. */
   void SetFixedImageRegion( const FixedImageRegionType & region )
@@ -110,7 +133,7 @@ public:
 protected:
 
   ComputeJacobianTerms();
-  virtual ~ComputeJacobianTerms() {}
+  virtual ~ComputeJacobianTerms();
 
   typename FixedImageType::ConstPointer m_FixedImage;
   FixedImageRegionType       m_FixedImageRegion;
@@ -151,6 +174,61 @@ protected:
   virtual void SampleFixedImageForJacobianTerms(
     ImageSampleContainerPointer & sampleContainer );
 
+  /** Typedefs for the sparse covariance matrix. */
+  typedef double                                   CovarianceValueType;
+  typedef vnl_sparse_matrix< CovarianceValueType > SparseCovarianceMatrixType;
+  typedef SparseCovarianceMatrixType::row          SparseRowType;
+  typedef SparseCovarianceMatrixType::pair_t       SparseEntryType;
+  typedef std::vector< CovarianceValueType >       DiagCovarianceType;
+  typedef MultiThreader                            ThreaderType;
+  typedef ThreaderType::ThreadInfoStruct           ThreadInfoType;
+
+  /** Add the sorted entries to a row of a covariance matrix. */
+  static void AddEntriesToRow( SparseRowType & row,
+    const std::vector< SparseEntryType > & entries );
+
+  /** The threaded parts of Compute(): the accumulation of C over the
+   * samples, the merging, scaling and the traces of C over its rows, and
+   * the maxima over the samples.
+   */
+  void ThreadedComputeCovariance( ThreadIdType threadId, ThreadIdType numberOfThreads );
+  void ThreadedComputeTraces( ThreadIdType threadId, ThreadIdType numberOfThreads );
+  void ThreadedComputeMaxima( ThreadIdType threadId, ThreadIdType numberOfThreads );
+
+  /** The threader callbacks of the threaded parts. */
+  static ITK_THREAD_RETURN_TYPE ComputeCovarianceThreaderCallback( void * arg );
+  static ITK_THREAD_RETURN_TYPE ComputeTracesThreaderCallback( void * arg );
+  static ITK_THREAD_RETURN_TYPE ComputeMaximaThreaderCallback( void * arg );
+
+  /** Initialize the per-thread variables. */
+  void InitializeThreadingParameters( void );
+
+  /** Per-thread partial results, padded to avoid false sharing. */
+  struct ComputePerThreadStruct
+  {
+    double st_TrC;
+    double st_TrCC;
+    double st_DiagSquared;
+    double st_MaxJJ;
+    double st_MaxJCJ;
+  };
+  itkPadStruct( ITK_CACHE_LINE_ALIGNMENT, ComputePerThreadStruct,
+    PaddedComputePerThreadStruct );
+  itkAlignedTypedef( ITK_CACHE_LINE_ALIGNMENT, PaddedComputePerThreadStruct,
+    AlignedComputePerThreadStruct );
+  AlignedComputePerThreadStruct * m_ComputePerThreadVariables;
+  ThreadIdType                    m_ComputePerThreadVariablesSize;
+
+  /** The data shared by the threads during Compute(). Thread 0 accumulates
+   * its part of C in m_Covariance, thread t > 0 in m_ThreadCovariances[ t - 1 ].
+   */
+  ImageSampleContainerPointer               m_SampleContainer;
+  SparseCovarianceMatrixType                m_Covariance;
+  std::vector< SparseCovarianceMatrixType > m_ThreadCovariances;
+  DiagCovarianceType                        m_DiagCovariance;
+  std::vector< unsigned int >               m_JacobianIndicesExpanded;
+  ThreaderType::Pointer                     m_Threader;
+
 private:
 
   ComputeJacobianTerms( const Self & ); // purposely not implemented
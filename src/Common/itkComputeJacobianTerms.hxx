@@ -19,11 +19,12 @@
 #define __itkComputeJacobianTerms_hxx
 
 #include "itkComputeJacobianTerms.h"
+#include "itkPersistentThreadPool.h"
 
 #include "vnl/vnl_math.h"
 #include "vnl/vnl_fastops.h"
 #include "vnl/vnl_diag_matrix.h"
-#include "vnl/vnl_sparse_matrix.h"
+#include <algorithm>
 
 namespace itk
 {
@@ -45,9 +46,59 @@ ComputeJacobianTerms< TFixedImage, TTransform >
   this->m_NumberOfBandStructureSamples = 0;
   this->m_NumberOfJacobianMeasurements = 0;
 
+  this->m_ComputePerThreadVariables     = NULL;
+  this->m_ComputePerThreadVariablesSize = 0;
+
+  this->m_Threader = ThreaderType::New();
+
 } // end Constructor
 
 
+/**
+ * ************************* Destructor ************************
+ */
+
+template< class TFixedImage, class TTransform >
+ComputeJacobianTerms< TFixedImage, TTransform >
+::~ComputeJacobianTerms()
+{
+  delete[] this->m_ComputePerThreadVariables;
+
+} // end Destructor
+
+
+/**
+ * ************************* InitializeThreadingParameters ************************
+ */
+
+template< class TFixedImage, class TTransform >
+void
+ComputeJacobianTerms< TFixedImage, TTransform >
+::InitializeThreadingParameters( void )
+{
+  const ThreadIdType numberOfThreads = this->m_Threader->GetNumberOfThreads();
+
+  /** Only resize the array of structs when needed. */
+  if( this->m_ComputePerThreadVariablesSize != numberOfThreads )
+  {
+    delete[] this->m_ComputePerThreadVariables;
+    this->m_ComputePerThreadVariables     = new AlignedComputePerThreadStruct[ numberOfThreads ];
+    this->m_ComputePerThreadVariablesSize = numberOfThreads;
+  }
+
+  /** Some initialization. */
+  for( ThreadIdType i = 0; i < numberOfThreads; ++i )
+  {
+    this->m_ComputePerThreadVariables[ i ].st_TrC         = 0.0;
+    this->m_ComputePerThreadVariables[ i ].st_TrCC        = 0.0;
+    this->m_ComputePerThreadVariables[ i ].st_DiagSquared = 0.0;
+    this->m_ComputePerThreadVariables[ i ].st_MaxJJ       = 0.0;
+    this->m_ComputePerThreadVariables[ i ].st_MaxJCJ      = 0.0;
+  }
+
+} // end InitializeThreadingParameters()
+
+
 /**
  * ************************* Compute ************************
  */
@@ -73,341 +124,367 @@ ComputeJacobianTerms< TFixedImage, TTransform >
    * Term 4: maxJCJ, see (54)
    */
 
-  typedef double                                   CovarianceValueType;
-  typedef itk::Array2D< CovarianceValueType >      CovarianceMatrixType;
-  typedef vnl_sparse_matrix< CovarianceValueType > SparseCovarianceMatrixType;
-  typedef SparseCovarianceMatrixType::row          SparseRowType;
-  typedef itk::Array< SizeValueType >              NonZeroJacobianIndicesExpandedType;
-  typedef vnl_diag_matrix< CovarianceValueType >   DiagCovarianceMatrixType;
-
   /** Initialize. */
   TrC = TrCC = maxJJ = maxJCJ = 0.0;
 
   /** Get samples. */
   ImageSampleContainerPointer sampleContainer = 0;
-  SampleFixedImageForJacobianTerms( sampleContainer );
-  const SizeValueType nrofsamples = sampleContainer->Size();
-  const double        n           = static_cast< double >( nrofsamples );
+  this->SampleFixedImageForJacobianTerms( sampleContainer );
+  this->m_SampleContainer = sampleContainer;
 
   /** Get the number of parameters. */
   const unsigned int P = static_cast< unsigned int >(
     this->m_Transform->GetNumberOfParameters() );
 
-  /** Get transform and set current position. */
-  typename TransformType::Pointer transform
-    = this->m_Transform;
-  const unsigned int outdim = this->m_Transform->GetOutputSpaceDimension();
-
-  /** Get scales vector */
-  const ScalesType & scales = this->m_Scales;
+  this->InitializeThreadingParameters();
+  const ThreadIdType numberOfThreads = this->m_Threader->GetNumberOfThreads();
 
-  /** Create iterator over the sample container. */
-  typename ImageSampleContainerType::ConstIterator iter;
-  typename ImageSampleContainerType::ConstIterator begin = sampleContainer->Begin();
-  typename ImageSampleContainerType::ConstIterator end   = sampleContainer->End();
-  unsigned int samplenr = 0;
+  /** Initialize the covariance matrix, of which only the upper triangular
+   * part is stored, the ones of the other threads, and its diagonal.
+   */
+  this->m_Covariance = SparseCovarianceMatrixType( P, P );
+  this->m_ThreadCovariances.assign( numberOfThreads - 1, SparseCovarianceMatrixType( P, P ) );
+  this->m_DiagCovariance.assign( P, 0.0 );
 
-  /** Variables for nonzerojacobian indices and the Jacobian. */
-  NumberOfParametersType sizejacind
-    = this->m_Transform->GetNumberOfNonZeroJacobianIndices();
-  JacobianType jacj( outdim, sizejacind );
-  jacj.Fill( 0.0 );
-  NonZeroJacobianIndicesType jacind( sizejacind );
-  jacind[ 0 ] = 0;
-  if( sizejacind > 1 ) { jacind[ 1 ] = 0; }
-  NonZeroJacobianIndicesType prevjacind = jacind;
+  /**
+   *    TERM 1
+   *
+   * Loop over image and compute Jacobian.
+   * Compute C = 1/n \sum_i J_i^T J_i
+   * Possibly apply scaling afterwards.
+   */
+  PersistentThreadPool::SingleMethodExecute( this->m_Threader,
+    this->ComputeCovarianceThreaderCallback, this );
 
-  /** Initialize covariance matrix. Sparse, diagonal, and band form. */
-  SparseCovarianceMatrixType cov( P, P );
-  DiagCovarianceMatrixType   diagcov( P, 0.0 );
-  CovarianceMatrixType       bandcov;
+  /** Add the parts of the other threads to C, apply scales, and compute
+   * TrC = trace(C) and diagcov.
+   */
+  PersistentThreadPool::SingleMethodExecute( this->m_Threader,
+    this->ComputeTracesThreaderCallback, this );
+  std::vector< SparseCovarianceMatrixType >().swap( this->m_ThreadCovariances );
 
-  /** For temporary storage of J'J. */
-  CovarianceMatrixType jactjac( sizejacind, sizejacind );
-  jactjac.Fill( 0.0 );
+  /**
+   *    TERM 2
+   *
+   * Compute TrCC = ||C||_F^2.
+   */
+  double diagSquared = 0.0;
+  for( ThreadIdType i = 0; i < numberOfThreads; ++i )
+  {
+    TrC         += this->m_ComputePerThreadVariables[ i ].st_TrC;
+    TrCC        += this->m_ComputePerThreadVariables[ i ].st_TrCC;
+    diagSquared += this->m_ComputePerThreadVariables[ i ].st_DiagSquared;
+  }
 
-  typedef std::vector< unsigned int >             DifHistType;
-  typedef std::pair< unsigned int, unsigned int > FreqPairType;
-  typedef std::vector< FreqPairType >             DifHist2Type;
-  DifHist2Type difHist2;
+  /** Symmetry: multiply by 2 and subtract sumsqr(diagcov). */
+  TrCC *= 2.0;
+  TrCC -= diagSquared;
 
-  /** DifHist is a histogram of absolute parameterNrDifferences that
-   * occur in the nonzerojacobianindex vectors.
-   * DifHist2 is another way of storing the histogram, as a vector
-   * of pairs. pair.first = Frequency, pair.second = parameterNrDifference.
-   * This is useful for sorting.
-   */
-  DifHistType difHist( P, 0 );
-
-  /** Try to guess the band structure of the covariance matrix.
-   * A 'band' is a series of elements cov(p,q) with constant q-p.
-   * In the loop below, on a few positions in the image the Jacobian
-   * is computed. The nonzerojacobianindices are inspected to figure out
-   * which values of q-p occur often. This is done by making a histogram.
-   * The histogram is then sorted and the most occurring bands
-   * are determined. The covariance elements in these bands will not
-   * be stored in the sparse matrix structure 'cov', but in the band
-   * matrix 'bandcov', which is much faster.
-   * Only after the bandcov and cov have been filled (by looping over
-   * all Jacobian measurements in the sample container, the bandcov
-   * matrix is injected in the cov matrix, for easy further calculations,
-   * and the bandcov matrix is deleted.
+  /**
+   *    TERM 3 and 4
+   *
+   * Compute maxJJ and maxJCJ
+   * \li maxJJ = max_j [ ||J_j||_F^2 + 2\sqrt{2} || J_j J_j^T ||_F ]
+   * \li maxJCJ = max_j [ Tr( J_j C J_j^T ) + 2\sqrt{2} || J_j C J_j^T ||_F ]
+   *
+   * The maps of the parameter numbers to the nonzero Jacobian indices of
+   * a sample are allocated and initialized here once, one per thread.
    */
-  unsigned int onezero = 0;
-  for( unsigned int s = 0; s < this->m_NumberOfBandStructureSamples; ++s )
+  this->m_JacobianIndicesExpanded.assign( numberOfThreads * P,
+    static_cast< unsigned int >( this->m_Transform->GetNumberOfNonZeroJacobianIndices() ) );
+  PersistentThreadPool::SingleMethodExecute( this->m_Threader,
+    this->ComputeMaximaThreaderCallback, this );
+
+  for( ThreadIdType i = 0; i < numberOfThreads; ++i )
   {
-    /** Semi-randomly get some samples from the sample container. */
-    const unsigned int samplenr = ( s + 1 ) * nrofsamples
-      / ( this->m_NumberOfBandStructureSamples + 2 + onezero );
-    onezero = 1 - onezero; // introduces semi-randomness
+    maxJJ  = vnl_math_max( maxJJ, this->m_ComputePerThreadVariables[ i ].st_MaxJJ );
+    maxJCJ = vnl_math_max( maxJCJ, this->m_ComputePerThreadVariables[ i ].st_MaxJCJ );
+  }
 
-    /** Read fixed coordinates and get Jacobian J_j. */
-    const FixedImagePointType & point
-      = sampleContainer->GetElement( samplenr ).m_ImageCoordinates;
-    this->m_Transform->GetJacobian( point, jacj, jacind );
+  /** Release the memory. */
+  this->m_Covariance = SparseCovarianceMatrixType();
+  DiagCovarianceType().swap( this->m_DiagCovariance );
+  std::vector< unsigned int >().swap( this->m_JacobianIndicesExpanded );
+  this->m_SampleContainer = 0;
 
-    /** Skip invalid Jacobians in the beginning, if any. */
-    if( sizejacind > 1 )
-    {
-      if( jacind[ 0 ] == jacind[ 1 ] ) { continue; }
-    }
+} // end Compute()
 
-    /** Fill the histogram of parameter nr differences. */
-    for( unsigned int i = 0; i < sizejacind; ++i )
-    {
-      const int jacindi = static_cast< int >( jacind[ i ] );
-      for( unsigned int j = i; j < sizejacind; ++j )
-      {
-        const int jacindj = static_cast< int >( jacind[ j ] );
-        difHist[ static_cast< unsigned int >( vcl_abs( jacindj - jacindi ) ) ]++;
-      }
-    }
+
+/**
+ * ************************* AddEntriesToRow ************************
+ */
+
+template< class TFixedImage, class TTransform >
+void
+ComputeJacobianTerms< TFixedImage, TTransform >
+::AddEntriesToRow( SparseRowType & row,
+  const std::vector< SparseEntryType > & entries )
+{
+  /** Both the row and the entries are sorted on the column number. Usually
+   * all columns are already present, so first try to update in place.
+   */
+  typename SparseRowType::iterator rowIt = row.begin();
+  typename std::vector< SparseEntryType >::const_iterator entryIt = entries.begin();
+  while( entryIt != entries.end() )
+  {
+    while( rowIt != row.end() && rowIt->first < entryIt->first ) { ++rowIt; }
+    if( rowIt == row.end() || rowIt->first != entryIt->first ) { break; }
+    rowIt->second += entryIt->second;
+    ++rowIt; ++entryIt;
   }
+  if( entryIt == entries.end() ) { return; }
 
-  /** Copy the nonzero elements of the difHist to a vector pairs. */
-  for( unsigned int p = 0; p < P; ++p )
+  /** Merge the remaining entries into a new row. */
+  SparseRowType merged;
+  merged.reserve( row.size() + ( entries.end() - entryIt ) );
+  merged.insert( merged.end(), row.begin(), rowIt );
+  while( rowIt != row.end() && entryIt != entries.end() )
   {
-    const unsigned int freq = difHist[ p ];
-    if( freq != 0 )
+    if( rowIt->first < entryIt->first )
+    {
+      merged.push_back( *rowIt ); ++rowIt;
+    }
+    else if( entryIt->first < rowIt->first )
     {
-      difHist2.push_back( FreqPairType( freq, p ) );
+      merged.push_back( *entryIt ); ++entryIt;
+    }
+    else
+    {
+      merged.push_back( SparseEntryType( rowIt->first, rowIt->second + entryIt->second ) );
+      ++rowIt; ++entryIt;
     }
   }
-  difHist.resize( 0 );
+  merged.insert( merged.end(), rowIt, row.end() );
+  merged.insert( merged.end(), entryIt, entries.end() );
+  row.swap( merged );
 
-  /** Compute the number of bands. */
-  const unsigned int bandcovsize = vnl_math_min( this->m_MaxBandCovSize,
-    static_cast< unsigned int >( difHist2.size() ) );
+} // end AddEntriesToRow()
 
-  /** Maps parameterNrDifference (q-p) to colnr in bandcov. */
-  std::vector< unsigned int > bandcovMap( P, bandcovsize );
-  /** Maps colnr in bandcov to parameterNrDifference (q-p). */
-  std::vector< unsigned int > bandcovMap2( bandcovsize, P );
 
-  /** Sort the difHist2 based on the frequencies. */
-  std::sort( difHist2.begin(), difHist2.end() );
+/**
+ * ************************* ThreadedComputeCovariance ************************
+ */
 
-  /** Determine the bands that are expected to be most dominant. */
-  DifHist2Type::iterator difHist2It = difHist2.end();
-  for( unsigned int b = 0; b < bandcovsize; ++b )
-  {
-    --difHist2It;
-    bandcovMap[ difHist2It->second ] = b;
-    bandcovMap2[ b ]                 = difHist2It->second;
-  }
+template< class TFixedImage, class TTransform >
+void
+ComputeJacobianTerms< TFixedImage, TTransform >
+::ThreadedComputeCovariance( ThreadIdType threadId, ThreadIdType numberOfThreads )
+{
+  typedef Array2D< CovarianceValueType >          CovarianceMatrixType;
+  typedef std::pair< SizeValueType, unsigned int > SortPairType;
 
-  /** Initialize band matrix. */
-  bandcov = CovarianceMatrixType( P, bandcovsize );
-  bandcov.Fill( 0.0 );
+  /** Determine the contiguous range of samples of this thread. */
+  const SizeValueType nrofsamples = this->m_SampleContainer->Size();
+  const double        n           = static_cast< double >( nrofsamples );
+  const SizeValueType chunkSize
+    = ( nrofsamples + numberOfThreads - 1 ) / numberOfThreads;
+  const SizeValueType pos_begin = std::min( threadId * chunkSize, nrofsamples );
+  const SizeValueType pos_end   = std::min( pos_begin + chunkSize, nrofsamples );
 
-  /**
-   *    TERM 1
-   *
-   * Loop over image and compute Jacobian.
-   * Compute C = 1/n \sum_i J_i^T J_i
-   * Possibly apply scaling afterwards.
+  /** The part of C of this thread. */
+  SparseCovarianceMatrixType & covariance = threadId == 0
+    ? this->m_Covariance : this->m_ThreadCovariances[ threadId - 1 ];
+
+  /** Variables for nonzerojacobian indices and the Jacobian. */
+  const unsigned int           outdim = this->m_Transform->GetOutputSpaceDimension();
+  const NumberOfParametersType sizejacind
+    = this->m_Transform->GetNumberOfNonZeroJacobianIndices();
+  JacobianType jacj( outdim, sizejacind );
+  jacj.Fill( 0.0 );
+  NonZeroJacobianIndicesType jacind( sizejacind );
+  NonZeroJacobianIndicesType prevjacind( sizejacind );
+
+  /** For temporary storage of J'J, summed over a run of samples with the
+   * same nonzero Jacobian indices, and of the entries of one row of C.
    */
-  jacind[ 0 ] = 0;
-  if( sizejacind > 1 ) { jacind[ 1 ] = 0; }
-  for( iter = begin; iter != end; ++iter )
-  {
-    /** Print progress 0-50%.
-     *progressObserver->UpdateAndPrintProgress( samplenr );*/
-    ++samplenr;
+  CovarianceMatrixType jactjac( sizejacind, sizejacind );
+  jactjac.Fill( 0.0 );
+  std::vector< SortPairType >    sortedjacind( sizejacind );
+  std::vector< SparseEntryType > entries;
+  entries.reserve( sizejacind );
 
+  bool runStarted = false;
+  for( SizeValueType i = pos_begin; i <= pos_end; ++i )
+  {
     /** Read fixed coordinates and get Jacobian J_j. */
-    const FixedImagePointType & point = ( *iter ).Value().m_ImageCoordinates;
-    this->m_Transform->GetJacobian( point, jacj, jacind  );
-
-    /** Skip invalid Jacobians in the beginning, if any. */
-    if( sizejacind > 1 )
+    if( i < pos_end )
     {
-      if( jacind[ 0 ] == jacind[ 1 ] ) { continue; }
-    }
+      const FixedImagePointType & point
+        = this->m_SampleContainer->ElementAt( i ).m_ImageCoordinates;
+      this->m_Transform->GetJacobian( point, jacj, jacind );
 
-    if( jacind == prevjacind )
-    {
-      /** Update sum of J_j^T J_j. */
-      vnl_fastops::inc_X_by_AtA( jactjac, jacj );
-    }
-    else
-    {
-      /** The following should only be done after the first sample. */
-      if( iter != begin )
+      /** Skip invalid Jacobians in the beginning, if any. */
+      if( sizejacind > 1 )
       {
-        /** Update covariance matrix. */
-        for( unsigned int pi = 0; pi < sizejacind; ++pi )
-        {
-          const unsigned int p = prevjacind[ pi ];
-          for( unsigned int qi = 0; qi < sizejacind; ++qi )
-          {
-            const unsigned int q = prevjacind[ qi ];
-            if( q >= p )
-            {
-              const double tempval = jactjac( pi, qi ) / n;
-              if( vcl_abs( tempval ) > 1e-14 )
-              {
-                const unsigned int bandindex = bandcovMap[ q - p ];
-                if( bandindex < bandcovsize )
-                {
-                  bandcov( p, bandindex ) += tempval;
-                }
-                else
-                {
-                  cov( p, q ) += tempval;
-                }
-              }
-            }
-          } // qi
-        }   // pi
-      }     // end if
-
-      /** Initialize jactjac by J_j^T J_j. */
-      vnl_fastops::AtA( jactjac, jacj );
-
-      /** Remember nonzerojacobian indices. */
-      prevjacind = jacind;
-    } // end else
+        if( jacind[ 0 ] == jacind[ 1 ] ) { continue; }
+      }
 
-  } // end iter loop: end computation of covariance matrix
+      if( runStarted && jacind == prevjacind )
+      {
+        /** Update sum of J_j^T J_j. */
+        vnl_fastops::inc_X_by_AtA( jactjac, jacj );
+        continue;
+      }
+    }
 
-  /** Update covariance matrix once again to include last jactjac updates
-   * \todo: a bit ugly that this loop is copied from above.
-   */
-  for( unsigned int pi = 0; pi < sizejacind; ++pi )
-  {
-    const unsigned int p = prevjacind[ pi ];
-    for( unsigned int qi = 0; qi < sizejacind; ++qi )
+    /** Add the J'J of the finished run to the covariance matrix, row by
+     * row in the order of the parameter numbers, so that each row only
+     * needs a merge of two sorted lists.
+     */
+    if( runStarted )
     {
-      const unsigned int q = prevjacind[ qi ];
-      if( q >= p )
+      for( unsigned int k = 0; k < sizejacind; ++k )
+      {
+        sortedjacind[ k ] = SortPairType( prevjacind[ k ], k );
+      }
+      std::sort( sortedjacind.begin(), sortedjacind.end() );
+
+      for( unsigned int k = 0; k < sizejacind; ++k )
       {
-        const double tempval = jactjac( pi, qi ) / n;
-        if( vcl_abs( tempval ) > 1e-14 )
+        const unsigned int p  = static_cast< unsigned int >( sortedjacind[ k ].first );
+        const unsigned int pi = sortedjacind[ k ].second;
+        entries.clear();
+        for( unsigned int l = k; l < sizejacind; ++l )
         {
-          const unsigned int bandindex = bandcovMap[ q - p ];
-          if( bandindex < bandcovsize )
+          const double tempval = jactjac( pi, sortedjacind[ l ].second ) / n;
+          if( vcl_abs( tempval ) > 1e-14 )
           {
-            bandcov( p, bandindex ) += tempval;
-          }
-          else
-          {
-            cov( p, q ) += tempval;
+            entries.push_back( SparseEntryType(
+              static_cast< unsigned int >( sortedjacind[ l ].first ), tempval ) );
           }
         }
+        if( entries.empty() ) { continue; }
+
+        AddEntriesToRow( covariance.get_row( p ), entries );
       }
-    } // qi
-  }   // pi
+    }
 
-  /** Copy the bandmatrix into the sparse matrix and empty the bandcov matrix.
-   * \todo: perhaps work further with this bandmatrix instead.
-   */
-  for( unsigned int p = 0; p < P; ++p )
-  {
-    for( unsigned int b = 0; b < bandcovsize; ++b )
+    /** Initialize jactjac by J_j^T J_j, and remember the nonzerojacobian indices. */
+    if( i < pos_end )
     {
-      const double tempval = bandcov( p, b );
-      if( vcl_abs( tempval ) > 1e-14 )
-      {
-        const unsigned int q = p + bandcovMap2[ b ];
-        cov( p, q ) = tempval;
-      }
+      vnl_fastops::AtA( jactjac, jacj );
+      prevjacind = jacind;
+      runStarted = true;
     }
-  }
-  bandcov.set_size( 0, 0 );
 
-  /** Apply scales. the use of m_Scales maybe something wrong. */
-  if( this->m_UseScales )
+  } // end loop over the samples of this thread
+
+} // end ThreadedComputeCovariance()
+
+
+/**
+ * ************************* ThreadedComputeTraces ************************
+ */
+
+template< class TFixedImage, class TTransform >
+void
+ComputeJacobianTerms< TFixedImage, TTransform >
+::ThreadedComputeTraces( ThreadIdType threadId, ThreadIdType numberOfThreads )
+{
+  /** Determine the contiguous range of rows of this thread. */
+  const unsigned int P         = this->m_Covariance.rows();
+  const unsigned int chunkSize = ( P + numberOfThreads - 1 ) / numberOfThreads;
+  const unsigned int p_begin   = std::min( threadId * chunkSize, P );
+  const unsigned int p_end     = std::min( p_begin + chunkSize, P );
+
+  const ScalesType & scales = this->m_Scales;
+  double             TrC = 0.0, TrCC = 0.0, diagSquared = 0.0;
+  for( unsigned int p = p_begin; p < p_end; ++p )
   {
-    for( unsigned int p = 0; p < P; ++p )
+    /** Add row p of the other threads, in the order of the threads, and
+     * release it.
+     */
+    SparseRowType & covrowp = this->m_Covariance.get_row( p );
+    for( std::size_t t = 0; t < this->m_ThreadCovariances.size(); ++t )
     {
-      cov.scale_row( p, 1.0 / this->m_Scales[ p ] );
+      SparseRowType & threadrowp = this->m_ThreadCovariances[ t ].get_row( p );
+      if( threadrowp.empty() ) { continue; }
+      AddEntriesToRow( covrowp, threadrowp );
+      SparseRowType().swap( threadrowp );
     }
-    /**  \todo: this might be faster with get_row instead of the iterator */
-    cov.reset();
-    bool notfinished = cov.next();
-    while( notfinished )
+    if( covrowp.empty() ) { continue; }
+
+    /** Apply scales. */
+    typename SparseRowType::iterator covrowpit;
+    if( this->m_UseScales )
     {
-      const int col = cov.getcolumn();
-      cov( cov.getrow(), col ) /= scales[ col ];
-      notfinished               = cov.next();
+      for( covrowpit = covrowp.begin(); covrowpit != covrowp.end(); ++covrowpit )
+      {
+        ( *covrowpit ).second /= scales[ p ] * scales[ ( *covrowpit ).first ];
+      }
     }
-  }
 
-  /** Compute TrC = trace(C), and diagcov. */
-  for( unsigned int p = 0; p < P; ++p )
-  {
-    if( !cov.empty_row( p ) )
+    /** The diagonal element is the first element of the row, if present. */
+    if( covrowp.front().first == p )
     {
-      //avoid creation of element if the row is empty
-      CovarianceValueType & covpp = cov( p, p );
+      const CovarianceValueType covpp = covrowp.front().second;
+      this->m_DiagCovariance[ p ] = covpp;
       TrC         += covpp;
-      diagcov[ p ] = covpp;
+      diagSquared += vnl_math_sqr( covpp );
     }
-  }
 
-  /**
-   *    TERM 2
-   *
-   * Compute TrCC = ||C||_F^2.
-   */
-  cov.reset();
-  bool notfinished2 = cov.next();
-  while( notfinished2 )
-  {
-    TrCC        += vnl_math_sqr( cov.value() );
-    notfinished2 = cov.next();
+    for( covrowpit = covrowp.begin(); covrowpit != covrowp.end(); ++covrowpit )
+    {
+      TrCC += vnl_math_sqr( ( *covrowpit ).second );
+    }
   }
 
-  /** Symmetry: multiply by 2 and subtract sumsqr(diagcov). */
-  TrCC *= 2.0;
-  TrCC -= diagcov.diagonal().squared_magnitude();
+  this->m_ComputePerThreadVariables[ threadId ].st_TrC         = TrC;
+  this->m_ComputePerThreadVariables[ threadId ].st_TrCC        = TrCC;
+  this->m_ComputePerThreadVariables[ threadId ].st_DiagSquared = diagSquared;
 
-  /**
-   *    TERM 3 and 4
-   *
-   * Compute maxJJ and maxJCJ
-   * \li maxJJ = max_j [ ||J_j||_F^2 + 2\sqrt{2} || J_j J_j^T ||_F ]
-   * \li maxJCJ = max_j [ Tr( J_j C J_j^T ) + 2\sqrt{2} || J_j C J_j^T ||_F ]
+} // end ThreadedComputeTraces()
+
+
+/**
+ * ************************* ThreadedComputeMaxima ************************
+ */
+
+template< class TFixedImage, class TTransform >
+void
+ComputeJacobianTerms< TFixedImage, TTransform >
+::ThreadedComputeMaxima( ThreadIdType threadId, ThreadIdType numberOfThreads )
+{
+  typedef vnl_diag_matrix< CovarianceValueType > DiagCovarianceMatrixType;
+
+  /** Determine the contiguous range of samples of this thread. */
+  const SizeValueType nrofsamples = this->m_SampleContainer->Size();
+  const SizeValueType chunkSize
+    = ( nrofsamples + numberOfThreads - 1 ) / numberOfThreads;
+  const SizeValueType pos_begin = std::min( threadId * chunkSize, nrofsamples );
+  const SizeValueType pos_end   = std::min( pos_begin + chunkSize, nrofsamples );
+
+  /** Variables for nonzerojacobian indices and the Jacobian. */
+  const unsigned int           P      = this->m_Covariance.rows();
+  const unsigned int           outdim = this->m_Transform->GetOutputSpaceDimension();
+  const NumberOfParametersType sizejacind
+    = this->m_Transform->GetNumberOfNonZeroJacobianIndices();
+  const ScalesType & scales = this->m_Scales;
+  const double       sqrt2  = vcl_sqrt( static_cast< double >( 2.0 ) );
+
+  JacobianType jacj( outdim, sizejacind );
+  jacj.Fill( 0.0 );
+  NonZeroJacobianIndicesType jacind( sizejacind );
+  JacobianType               jacjjacj( outdim, outdim );
+  JacobianType               jacjcov( outdim, sizejacind );
+  DiagCovarianceMatrixType   diagcovsparse( sizejacind );
+  JacobianType               jacjdiagcov( outdim, sizejacind );
+  JacobianType               jacjdiagcovjacj( outdim, outdim );
+  JacobianType               jacjcovjacj( outdim, outdim );
+
+  /** Maps a parameter number to its position in jacind, or to sizejacind
+   * when it is not a nonzero Jacobian index of the current sample. This
+   * thread's part of the map is initialized by Compute().
    */
-  maxJJ  = 0.0;
-  maxJCJ = 0.0;
-  const double sqrt2 = vcl_sqrt( static_cast< double >( 2.0 ) );
-
-  JacobianType                       jacjjacj( outdim, outdim );
-  JacobianType                       jacjcov( outdim, sizejacind );
-  DiagCovarianceMatrixType           diagcovsparse( sizejacind );
-  JacobianType                       jacjdiagcov( outdim, sizejacind );
-  JacobianType                       jacjdiagcovjacj( outdim, outdim );
-  JacobianType                       jacjcovjacj( outdim, outdim );
-  NonZeroJacobianIndicesExpandedType jacindExpanded( P );
-
-  samplenr = 0;
-  for( iter = begin; iter != end; ++iter )
+  unsigned int * jacindExpanded = &this->m_JacobianIndicesExpanded[ threadId * P ];
+
+  double maxJJ = 0.0, maxJCJ = 0.0;
+  for( SizeValueType i = pos_begin; i < pos_end; ++i )
   {
     /** Read fixed coordinates and get Jacobian. */
-    const FixedImagePointType & point = ( *iter ).Value().m_ImageCoordinates;
-    this->m_Transform->GetJacobian( point, jacj, jacind  );
+    const FixedImagePointType & point
+      = this->m_SampleContainer->ElementAt( i ).m_ImageCoordinates;
+    this->m_Transform->GetJacobian( point, jacj, jacind );
 
     /** Apply scales, if necessary. */
     if( this->m_UseScales )
@@ -438,12 +515,11 @@ ComputeJacobianTerms< TFixedImage, TTransform >
     /** Store the nonzero Jacobian indices in a different format
      * and create the sparse diagcov.
      */
-    jacindExpanded.Fill( sizejacind );
     for( unsigned int pi = 0; pi < sizejacind; ++pi )
     {
       const unsigned int p = jacind[ pi ];
       jacindExpanded[ p ] = pi;
-      diagcovsparse[ pi ] = diagcov[ p ];
+      diagcovsparse[ pi ] = this->m_DiagCovariance[ p ];
     }
 
     /** We below calculate jacjC = J_j cov^T, but later we will correct
@@ -453,31 +529,33 @@ ComputeJacobianTerms< TFixedImage, TTransform >
      */
     for( unsigned int pi = 0; pi < sizejacind; ++pi )
     {
-      const unsigned int p = jacind[ pi ];
-      if( !cov.empty_row( p ) )
+      const unsigned int    p       = jacind[ pi ];
+      const SparseRowType & covrowp = this->m_Covariance.get_row( p );
+      typename SparseRowType::const_iterator covrowpit;
+
+      /** Loop over row p of the sparse cov matrix. */
+      for( covrowpit = covrowp.begin(); covrowpit != covrowp.end(); ++covrowpit )
       {
-        SparseRowType & covrowp = cov.get_row( p );
-        typename SparseRowType::iterator covrowpit;
+        const unsigned int q  = ( *covrowpit ).first;
+        const unsigned int qi = jacindExpanded[ q ];
 
-        /** Loop over row p of the sparse cov matrix. */
-        for( covrowpit = covrowp.begin(); covrowpit != covrowp.end(); ++covrowpit )
+        if( qi < sizejacind )
         {
-          const unsigned int q  = ( *covrowpit ).first;
-          const unsigned int qi = jacindExpanded[ q ];
-
-          if( qi < sizejacind )
+          /** If found, update the jacjC matrix. */
+          const CovarianceValueType covElement = ( *covrowpit ).second;
+          for( unsigned int dx = 0; dx < outdim; ++dx )
           {
-            /** If found, update the jacjC matrix. */
-            const CovarianceValueType covElement = ( *covrowpit ).second;
-            for( unsigned int dx = 0; dx < outdim; ++dx )
-            {
-              jacjcov[ dx ][ pi ] += jacj[ dx ][ qi ] * covElement;
-            } //dx
-          }   // if qi < sizejacind
-        }     // for covrow
-
-      } // if not empty row
-    }   // pi
+            jacjcov[ dx ][ pi ] += jacj[ dx ][ qi ] * covElement;
+          } //dx
+        }   // if qi < sizejacind
+      }     // for covrow
+    }       // pi
+
+    /** Reset only the entries of jacindExpanded that were set. */
+    for( unsigned int pi = 0; pi < sizejacind; ++pi )
+    {
+      jacindExpanded[ jacind[ pi ] ] = sizejacind;
+    }
 
     /** J_j C J_j^T  = jacjCjacj.
      * But note that we actually compute J_j cov' J_j^T
@@ -502,16 +580,66 @@ ComputeJacobianTerms< TFixedImage, TTransform >
     /** Max_j [JCJ_j]. */
     maxJCJ = vnl_math_max( maxJCJ, JCJ_j );
 
-    /** Show progress 50-100%. */
-    //progressObserver->UpdateAndPrintProgress( samplenr + nrofsamples );
-    ++samplenr;
+  } // end loop over the samples of this thread
 
-  } // end loop over sample container
+  this->m_ComputePerThreadVariables[ threadId ].st_MaxJJ  = maxJJ;
+  this->m_ComputePerThreadVariables[ threadId ].st_MaxJCJ = maxJCJ;
 
-  /** Finalize progress information. */
-  //progressObserver->PrintProgress( 1.0 );
+} // end ThreadedComputeMaxima()
 
-} // end Compute()
+
+/**
+ * ************************* ComputeCovarianceThreaderCallback ************************
+ */
+
+template< class TFixedImage, class TTransform >
+ITK_THREAD_RETURN_TYPE
+ComputeJacobianTerms< TFixedImage, TTransform >
+::ComputeCovarianceThreaderCallback( void * arg )
+{
+  ThreadInfoType * infoStruct = static_cast< ThreadInfoType * >( arg );
+  Self *           temp       = static_cast< Self * >( infoStruct->UserData );
+  temp->ThreadedComputeCovariance( infoStruct->ThreadID, infoStruct->NumberOfThreads );
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end ComputeCovarianceThreaderCallback()
+
+
+/**
+ * ************************* ComputeTracesThreaderCallback ************************
+ */
+
+template< class TFixedImage, class TTransform >
+ITK_THREAD_RETURN_TYPE
+ComputeJacobianTerms< TFixedImage, TTransform >
+::ComputeTracesThreaderCallback( void * arg )
+{
+  ThreadInfoType * infoStruct = static_cast< ThreadInfoType * >( arg );
+  Self *           temp       = static_cast< Self * >( infoStruct->UserData );
+  temp->ThreadedComputeTraces( infoStruct->ThreadID, infoStruct->NumberOfThreads );
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end ComputeTracesThreaderCallback()
+
+
+/**
+ * ************************* ComputeMaximaThreaderCallback ************************
+ */
+
+template< class TFixedImage, class TTransform >
+ITK_THREAD_RETURN_TYPE
+ComputeJacobianTerms< TFixedImage, TTransform >
+::ComputeMaximaThreaderCallback( void * arg )
+{
+  ThreadInfoType * infoStruct = static_cast< ThreadInfoType * >( arg );
+  Self *           temp       = static_cast< Self * >( infoStruct->UserData );
+  temp->ThreadedComputeMaxima( infoStruct->ThreadID, infoStruct->NumberOfThreads );
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end ComputeMaximaThreaderCallback()
 
 
 /**
@@ -98,6 +98,19 @@ namespace itk
  * compute only single level of the pyramid via SetCurrentLevel() and
  * SetComputeOnlyForCurrentLevel() methods.
  *
+ * With SetComputeFromPreviousLevel() the levels are computed from fine to
+ * coarse, and each level is computed from the next finer level instead of
+ * from the input, whenever the schedules allow it: the sigmas may not
+ * decrease, and for the shrinker the shrink factors must be multiples of
+ * those of the finer level. The finer level is then smoothed with
+ * sqrt( sigma_coarse^2 - sigma_fine^2 ), which by the semigroup property of
+ * the Gaussian approximates smoothing the input with sigma_coarse. Only the
+ * finest level reads the full resolution input, which makes building the
+ * pyramid of a large image much faster, at the cost of small differences
+ * with the direct computation. This option should be used with a floating
+ * point output pixel type, and is ignored when ComputeOnlyForCurrentLevel
+ * is set.
+ *
  * \author Denis P. Shamonin and Marius Staring. Division of Image Processing,
  * Department of Radiology, Leiden, The Netherlands
  *
@@ -220,6 +233,13 @@ public:
   itkGetConstMacro( ComputeOnlyForCurrentLevel, bool );
   itkBooleanMacro( ComputeOnlyForCurrentLevel );
 
+  /** Set/Get whether a level is computed from the next finer level instead
+   * of from the input, when possible. Default: false.
+   */
+  itkSetMacro( ComputeFromPreviousLevel, bool );
+  itkGetConstMacro( ComputeFromPreviousLevel, bool );
+  itkBooleanMacro( ComputeFromPreviousLevel );
+
 #ifdef ITK_USE_CONCEPT_CHECKING
   /** Begin concept checking */
   itkConceptMacro( SameDimensionCheck,
@@ -265,6 +285,7 @@ protected:
   SmoothingScheduleType m_SmoothingSchedule;
   unsigned int          m_CurrentLevel;
   bool                  m_ComputeOnlyForCurrentLevel;
+  bool                  m_ComputeFromPreviousLevel;
   bool                  m_SmoothingScheduleDefined;
 
 private:
@@ -284,6 +305,10 @@ private:
   typedef ImageToImageFilter< InputImageType, OutputImageType >
     ImageToImageFilterDifferentTypes;
 
+  /** Typedef for the smoother that computes a level from the finer level. */
+  typedef SmoothingRecursiveGaussianImageFilter<
+    OutputImageType, OutputImageType > SmootherSameTypesType;
+
   /** Smooth image at current level. Returns true if performed.
    * This method does not perform execution.
    */
@@ -310,6 +335,19 @@ private:
     typename ImageToImageFilterSameTypes::Pointer & rescaleSameTypes,
     typename ImageToImageFilterDifferentTypes::Pointer & rescaleDifferentTypes );
 
+  /** Returns true if the level can be computed from level + 1, see
+   * SetComputeFromPreviousLevel().
+   */
+  bool CanComputeFromPreviousLevel( const unsigned int level ) const;
+
+  /** Compute the level from the output of level + 1, into the allocated
+   * output. This method performs execution.
+   */
+  void GenerateLevelFromPreviousLevel( const unsigned int level,
+    const OutputImagePointer & outputPtr,
+    typename ImageToImageFilterSameTypes::Pointer & rescaleSameTypes,
+    typename ImageToImageFilterDifferentTypes::Pointer & rescaleDifferentTypes );
+
   /** Initialize m_SmoothingSchedule to default values for backward compatibility. */
   void SetSmoothingScheduleToDefault( void );
 
@@ -61,6 +61,7 @@ GenericMultiResolutionPyramidImageFilter< TInputImage, TOutputImage, TPrecisionT
 {
   this->m_CurrentLevel               = 0;
   this->m_ComputeOnlyForCurrentLevel = false;
+  this->m_ComputeFromPreviousLevel   = false;
   SmoothingScheduleType temp( this->GetNumberOfLevels(), ImageDimension );
   temp.Fill( NumericTraits< ScalarRealType >::ZeroValue() );
   this->m_SmoothingSchedule        = temp;
@@ -333,11 +334,18 @@ GenericMultiResolutionPyramidImageFilter< TInputImage, TOutputImage, TPrecisionT
   typename ImageToImageFilterSameTypes::Pointer rescaleSameTypes;
   typename ImageToImageFilterDifferentTypes::Pointer rescaleDifferentTypes;
 
-  for( unsigned int level = 0; level < this->m_NumberOfLevels; ++level )
+  // When computing from the previous level, start at the finest level
+  const bool fromPreviousLevel
+    = this->m_ComputeFromPreviousLevel && !this->m_ComputeOnlyForCurrentLevel;
+
+  for( unsigned int i = 0; i < this->m_NumberOfLevels; ++i )
   {
+    const unsigned int level = fromPreviousLevel
+      ? this->m_NumberOfLevels - 1 - i : i;
+
     if( !this->m_ComputeOnlyForCurrentLevel )
     {
-      this->UpdateProgress( static_cast< float >( level )
+      this->UpdateProgress( static_cast< float >( i )
         / static_cast< float >( this->m_NumberOfLevels ) );
     }
 
@@ -348,6 +356,14 @@ GenericMultiResolutionPyramidImageFilter< TInputImage, TOutputImage, TPrecisionT
       outputPtr->SetBufferedRegion( outputPtr->GetRequestedRegion() );
       outputPtr->Allocate();
 
+      // Compute from the finer level, which is already available
+      if( fromPreviousLevel && this->CanComputeFromPreviousLevel( level ) )
+      {
+        this->GenerateLevelFromPreviousLevel( level, outputPtr,
+          rescaleSameTypes, rescaleDifferentTypes );
+        continue;
+      }
+
       // Setup the smoother
       const bool smootherIsUsed = this->SetupSmoother( level, smoother, input );
 
@@ -371,6 +387,9 @@ GenericMultiResolutionPyramidImageFilter< TInputImage, TOutputImage, TPrecisionT
       {
         UpdateAndGraft< Self, ImageToImageFilterSameTypes, OutputImageType >(
           this, rescaleSameTypes, outputPtr, level );
+
+        // Release the smoothed full resolution image as early as possible
+        smoother->GetOutput()->ReleaseData();
       }
       else if( shrinkerOrResamplerIsUsed == 2 )
       {
@@ -384,6 +403,107 @@ GenericMultiResolutionPyramidImageFilter< TInputImage, TOutputImage, TPrecisionT
 }   // end GenerateData()
 
 
+/**
+ * ******************* CanComputeFromPreviousLevel ***********************
+ */
+
+template< class TInputImage, class TOutputImage, class TPrecisionType >
+bool
+GenericMultiResolutionPyramidImageFilter< TInputImage, TOutputImage, TPrecisionType >
+::CanComputeFromPreviousLevel( const unsigned int level ) const
+{
+  if( level + 1 >= this->m_NumberOfLevels ) { return false; }
+
+  for( unsigned int dim = 0; dim < ImageDimension; dim++ )
+  {
+    // The finer level may not be smoothed more
+    if( this->m_SmoothingSchedule[ level + 1 ][ dim ]
+      > this->m_SmoothingSchedule[ level ][ dim ] )
+    {
+      return false;
+    }
+
+    // The shrinker needs integer relative shrink factors
+    const unsigned int fineFactor   = this->m_Schedule[ level + 1 ][ dim ];
+    const unsigned int coarseFactor = this->m_Schedule[ level ][ dim ];
+    if( this->GetUseShrinkImageFilter()
+      && ( fineFactor == 0 || coarseFactor % fineFactor != 0 ) )
+    {
+      return false;
+    }
+  }
+
+  return true;
+
+} // end CanComputeFromPreviousLevel()
+
+
+/**
+ * ******************* GenerateLevelFromPreviousLevel ***********************
+ */
+
+template< class TInputImage, class TOutputImage, class TPrecisionType >
+void
+GenericMultiResolutionPyramidImageFilter< TInputImage, TOutputImage, TPrecisionType >
+::GenerateLevelFromPreviousLevel( const unsigned int level,
+  const OutputImagePointer & outputPtr,
+  typename ImageToImageFilterSameTypes::Pointer & rescaleSameTypes,
+  typename ImageToImageFilterDifferentTypes::Pointer & rescaleDifferentTypes )
+{
+  // Use the buffer of the finer level, without connecting it to this filter,
+  // to avoid that updating the inner filters updates this filter.
+  OutputImagePointer finer = OutputImageType::New();
+  finer->Graft( this->GetOutput( level + 1 ) );
+
+  // The remaining smoothing and the relative shrink factors. The latter are
+  // integers for the shrinker; the resampler uses the output geometry.
+  SigmaArrayType         sigmaArray;
+  RescaleFactorArrayType shrinkFactors;
+  for( unsigned int dim = 0; dim < ImageDimension; dim++ )
+  {
+    const ScalarRealType fineSigma   = this->m_SmoothingSchedule[ level + 1 ][ dim ];
+    const ScalarRealType coarseSigma = this->m_SmoothingSchedule[ level ][ dim ];
+    sigmaArray[ dim ] = vcl_sqrt( coarseSigma * coarseSigma - fineSigma * fineSigma );
+
+    shrinkFactors[ dim ] = static_cast< ScalarRealType >( this->m_Schedule[ level ][ dim ] )
+      / static_cast< ScalarRealType >( this->m_Schedule[ level + 1 ][ dim ] );
+  }
+
+  typename SmootherSameTypesType::Pointer smoother;
+  OutputImagePointer smoothed = finer;
+  if( !this->AreSigmasAllZeros( sigmaArray ) )
+  {
+    smoother = SmootherSameTypesType::New();
+    smoother->SetInput( finer );
+    smoother->SetSigmaArray( sigmaArray );
+    smoothed = smoother->GetOutput();
+  }
+
+  if( this->AreRescaleFactorsAllOnes( shrinkFactors ) )
+  {
+    if( smoother.IsNull() )
+    {
+      ImageAlgorithm::Copy( finer.GetPointer(), outputPtr.GetPointer(),
+        finer->GetLargestPossibleRegion(), outputPtr->GetLargestPossibleRegion() );
+      return;
+    }
+    UpdateAndGraft< Self, SmootherSameTypesType, OutputImageType >(
+      this, smoother, outputPtr, level );
+    return;
+  }
+
+  this->DefineShrinkerOrResampler( true, shrinkFactors, outputPtr,
+    rescaleSameTypes, rescaleDifferentTypes );
+  rescaleSameTypes->SetInput( smoothed );
+  UpdateAndGraft< Self, ImageToImageFilterSameTypes, OutputImageType >(
+    this, rescaleSameTypes, outputPtr, level );
+
+  // Release the smoothed image of the finer level as early as possible
+  rescaleSameTypes->SetInput( NULL );
+
+} // end GenerateLevelFromPreviousLevel()
+
+
 /**
  * ******************* SetupSmoother ***********************
  */
@@ -914,6 +1034,8 @@ GenericMultiResolutionPyramidImageFilter< TInputImage, TOutputImage, TPrecisionT
      << this->m_CurrentLevel << std::endl;
   os << indent << "ComputeOnlyForCurrentLevel: "
      << ( this->m_ComputeOnlyForCurrentLevel ? "true" : "false" ) << std::endl;
+  os << indent << "ComputeFromPreviousLevel: "
+     << ( this->m_ComputeFromPreviousLevel ? "true" : "false" ) << std::endl;
   os << indent << "SmoothingScheduleDefined: "
      << ( this->m_SmoothingScheduleDefined ? "true" : "false" ) << std::endl;
   os << indent << "Smoothing Schedule: ";
@@ -45,6 +45,8 @@
 #include "itkMultiResolutionPyramidImageFilter.h"
 #include "itkNumericTraits.h"
 #include "itkDataObjectDecorator.h"
+#include "itkSharedObjectCache.h"
+#include "itkVectorContainer.h"
 
 namespace itk
 {
@@ -223,6 +225,14 @@ public:
   itkSetMacro( InitialTransformParametersOfNextLevel, ParametersType );
   itkGetConstReferenceMacro( InitialTransformParametersOfNextLevel, ParametersType );
 
+  /** Set/Get the cache in which the outputs of the fixed image pyramid are
+   * shared with other registrations to the same fixed image. The pyramid
+   * must then compute all levels at once, and its outputs must depend on
+   * its class, its schedule and the fixed image only. Default: NULL.
+   */
+  itkSetObjectMacro( FixedSideCache, SharedObjectCache );
+  itkGetObjectMacro( FixedSideCache, SharedObjectCache );
+
   /** Get the last transformation parameters visited by
    * the optimizer.
    */
@@ -266,6 +276,11 @@ protected:
   /** Compute the size of the fixed region for each level of the pyramid. */
   virtual void PreparePyramids( void );
 
+  /** Get the fixed image at a level: the output of the fixed image pyramid,
+   * or the shared one when a FixedSideCache is set.
+   */
+  const FixedImageType * GetFixedImageAtLevel( unsigned long level ) const;
+
   /** Set the current level to be processed. */
   itkSetMacro( CurrentLevel, unsigned long );
 
@@ -301,6 +316,11 @@ private:
   unsigned long m_NumberOfLevels;
   unsigned long m_CurrentLevel;
 
+  /** The shared fixed images of all levels, if a FixedSideCache is set. */
+  typedef VectorContainer< unsigned long, FixedImageConstPointer > FixedImageContainerType;
+  SharedObjectCache::Pointer                     m_FixedSideCache;
+  typename FixedImageContainerType::ConstPointer m_SharedFixedImages;
+
 };
 
 } // end namespace itk
@@ -71,6 +71,9 @@ MultiResolutionImageRegistrationMethod2< TFixedImage, TMovingImage >
   this->m_NumberOfLevels = 1;
   this->m_CurrentLevel   = 0;
 
+  this->m_FixedSideCache    = 0;
+  this->m_SharedFixedImages = 0;
+
   this->m_Stop = false;
 
   this->m_InitialTransformParameters            = ParametersType( 0 );
@@ -122,7 +125,7 @@ MultiResolutionImageRegistrationMethod2< TFixedImage, TMovingImage >
 
   // Setup the metric
   this->m_Metric->SetMovingImage( this->m_MovingImagePyramid->GetOutput( this->m_CurrentLevel ) );
-  this->m_Metric->SetFixedImage( this->m_FixedImagePyramid->GetOutput( this->m_CurrentLevel ) );
+  this->m_Metric->SetFixedImage( this->GetFixedImageAtLevel( this->m_CurrentLevel ) );
   this->m_Metric->SetTransform( this->m_Transform );
   this->m_Metric->SetInterpolator( this->m_Interpolator );
   this->m_Metric->SetFixedImageRegion( this->m_FixedImageRegionPyramid[ this->m_CurrentLevel ] );
@@ -202,7 +205,60 @@ MultiResolutionImageRegistrationMethod2< TFixedImage, TMovingImage >
   // Setup the fixed image pyramid
   this->m_FixedImagePyramid->SetNumberOfLevels( this->m_NumberOfLevels );
   this->m_FixedImagePyramid->SetInput( this->m_FixedImage );
-  this->m_FixedImagePyramid->UpdateLargestPossibleRegion();
+
+  // The pyramid outputs depend on its class, its schedule and the fixed
+  // image only, so registrations to the same fixed image may share them.
+  // While one registration computes them, the others wait.
+  this->m_SharedFixedImages = 0;
+  std::ostringstream             key;
+  SharedObjectCache::Reservation reservation;
+  if( this->m_FixedSideCache )
+  {
+    key << "FixedImagePyramid " << this->m_FixedImagePyramid->GetNameOfClass();
+    SharedObjectCache::AppendToKey( key, this->m_FixedImage );
+    const typename FixedImagePyramidType::ScheduleType & schedule
+      = this->m_FixedImagePyramid->GetSchedule();
+    for( unsigned int i = 0; i < schedule.rows(); ++i )
+    {
+      for( unsigned int j = 0; j < schedule.cols(); ++j )
+      {
+        key << " " << schedule[ i ][ j ];
+      }
+    }
+    this->m_SharedFixedImages = dynamic_cast< const FixedImageContainerType * >(
+      this->m_FixedSideCache->FindOrReserve( key.str(), reservation ) );
+  }
+
+  if( !this->m_SharedFixedImages )
+  {
+    // The fixed image is shared with the other registrations, and updating
+    // the pyramid sets the requested region of its input, so let the
+    // pyramid read a view of the fixed image.
+    if( this->m_FixedSideCache )
+    {
+      typename FixedImageType::Pointer fixedImageView = FixedImageType::New();
+      fixedImageView->Graft( this->m_FixedImage );
+      this->m_FixedImagePyramid->SetInput( fixedImageView );
+    }
+    this->m_FixedImagePyramid->UpdateLargestPossibleRegion();
+
+    // Take the outputs out of the pipeline, so that they are never
+    // overwritten, and share them.
+    if( this->m_FixedSideCache )
+    {
+      typename FixedImageContainerType::Pointer fixedImages = FixedImageContainerType::New();
+      fixedImages->Reserve( this->m_NumberOfLevels );
+      for( unsigned int level = 0; level < this->m_NumberOfLevels; level++ )
+      {
+        typename FixedImageType::Pointer fixedImageAtLevel
+          = this->m_FixedImagePyramid->GetOutput( level );
+        fixedImageAtLevel->DisconnectPipeline();
+        fixedImages->SetElement( level, fixedImageAtLevel.GetPointer() );
+      }
+      this->m_SharedFixedImages = static_cast< const FixedImageContainerType * >(
+        reservation.Insert( fixedImages ) );
+    }
+  }
 
   // Setup the moving image pyramid
   this->m_MovingImagePyramid->SetNumberOfLevels( this->m_NumberOfLevels );
@@ -251,7 +307,7 @@ MultiResolutionImageRegistrationMethod2< TFixedImage, TMovingImage >
     IndexType        start;
     CIndexType       startcindex;
     CIndexType       endcindex;
-    FixedImageType * fixedImageAtLevel = this->m_FixedImagePyramid->GetOutput( level );
+    const FixedImageType * fixedImageAtLevel = this->GetFixedImageAtLevel( level );
     /** map the original fixed image region to the image resulting from the
      * FixedImagePyramid at level l.
      * To be on the safe side, the start point is ceiled, and the end point is
@@ -273,6 +329,23 @@ MultiResolutionImageRegistrationMethod2< TFixedImage, TMovingImage >
 } // end PreparePyramids()
 
 
+/*
+ * Get the fixed image at a level
+ */
+template< typename TFixedImage, typename TMovingImage >
+const typename MultiResolutionImageRegistrationMethod2< TFixedImage, TMovingImage >::FixedImageType
+* MultiResolutionImageRegistrationMethod2< TFixedImage, TMovingImage >
+::GetFixedImageAtLevel( unsigned long level ) const
+{
+  if( this->m_SharedFixedImages )
+  {
+    return this->m_SharedFixedImages->ElementAt( level ).GetPointer();
+  }
+  return this->m_FixedImagePyramid->GetOutput( level );
+
+} // end GetFixedImageAtLevel()
+
+
 /*
  * Starts the Registration Process
  */
@@ -0,0 +1,467 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef __itkPersistentThreadPool_cxx
+#define __itkPersistentThreadPool_cxx
+
+#include "itkPersistentThreadPool.h"
+
+/** Thread-local storage; a plain pointer needs no construction. */
+#if defined( _MSC_VER )
+#define ITK_PERSISTENT_THREAD_POOL_THREAD_LOCAL __declspec( thread )
+#else
+#define ITK_PERSISTENT_THREAD_POOL_THREAD_LOCAL __thread
+#endif
+
+namespace itk
+{
+
+PersistentThreadPool * PersistentThreadPool::m_GlobalInstance = NULL;
+
+/** The pool of the calling thread, see SetThreadInstance(). */
+static ITK_PERSISTENT_THREAD_POOL_THREAD_LOCAL PersistentThreadPool * s_ThreadInstance = NULL;
+
+/**
+ * ****************** Constructor *********************************
+ */
+
+PersistentThreadPool
+::PersistentThreadPool()
+{
+  this->m_NumberOfThreads         = 1;
+  this->m_SpawnThreader           = ThreaderType::New();
+  this->m_JobAvailable            = ConditionVariable::New();
+  this->m_JobFinished             = ConditionVariable::New();
+  this->m_Busy                    = false;
+  this->m_Shutdown                = false;
+  this->m_JobGeneration           = 0;
+  this->m_NumberOfFinishedWorkers = 0;
+  this->m_NumberOfExecutedJobs    = 0;
+  this->m_JobFunction             = NULL;
+  this->m_JobNumberOfThreads      = 0;
+
+} // end Constructor
+
+
+/**
+ * ****************** Destructor *********************************
+ */
+
+PersistentThreadPool
+::~PersistentThreadPool()
+{
+  this->StopWorkers();
+  if( m_GlobalInstance == this )
+  {
+    m_GlobalInstance = NULL;
+  }
+  if( s_ThreadInstance == this )
+  {
+    s_ThreadInstance = NULL;
+  }
+
+} // end Destructor
+
+
+/**
+ * ****************** SetNumberOfThreads *********************************
+ */
+
+void
+PersistentThreadPool
+::SetNumberOfThreads( ThreadIdType numberOfThreads )
+{
+  if( numberOfThreads == 0 ) { numberOfThreads = 1; }
+  if( numberOfThreads == this->m_NumberOfThreads ) { return; }
+
+  this->StopWorkers();
+  this->m_NumberOfThreads = numberOfThreads;
+  this->StartWorkers();
+  this->Modified();
+
+} // end SetNumberOfThreads()
+
+
+/**
+ * ****************** StartWorkers *********************************
+ */
+
+void
+PersistentThreadPool
+::StartWorkers( void )
+{
+  const ThreadIdType numberOfWorkers = this->m_NumberOfThreads - 1;
+
+  /** The workers wait for the first job after the current generation. A
+   * worker that reads the generation itself, once it runs, could miss a job
+   * that is started before that.
+   */
+  this->m_Mutex.Lock();
+  this->m_Shutdown = false;
+  const SizeValueType startGeneration = this->m_JobGeneration;
+  this->m_Mutex.Unlock();
+
+  this->m_WorkerInfos.resize( numberOfWorkers );
+  this->m_SpawnedThreadIds.resize( numberOfWorkers );
+  for( ThreadIdType i = 0; i < numberOfWorkers; ++i )
+  {
+    this->m_WorkerInfos[ i ].m_Pool            = this;
+    this->m_WorkerInfos[ i ].m_WorkerId        = i;
+    this->m_WorkerInfos[ i ].m_StartGeneration = startGeneration;
+    this->m_SpawnedThreadIds[ i ]              = this->m_SpawnThreader->SpawnThread(
+      WorkerThreaderCallback, &this->m_WorkerInfos[ i ] );
+  }
+
+} // end StartWorkers()
+
+
+/**
+ * ****************** StopWorkers *********************************
+ */
+
+void
+PersistentThreadPool
+::StopWorkers( void )
+{
+  /** Wake up all workers and let them leave their loop. */
+  this->m_Mutex.Lock();
+  this->m_Shutdown = true;
+  this->m_JobAvailable->Broadcast();
+  this->m_Mutex.Unlock();
+
+  /** Join them. */
+  for( std::size_t i = 0; i < this->m_SpawnedThreadIds.size(); ++i )
+  {
+    this->m_SpawnThreader->TerminateThread( this->m_SpawnedThreadIds[ i ] );
+  }
+  this->m_SpawnedThreadIds.clear();
+  this->m_WorkerInfos.clear();
+
+} // end StopWorkers()
+
+
+/**
+ * ****************** WorkerThreaderCallback *********************************
+ */
+
+ITK_THREAD_RETURN_TYPE
+PersistentThreadPool
+::WorkerThreaderCallback( void * arg )
+{
+  ThreadInfoType * infoStruct = static_cast< ThreadInfoType * >( arg );
+  WorkerInfoType * workerInfo = static_cast< WorkerInfoType * >( infoStruct->UserData );
+
+  workerInfo->m_Pool->WorkerLoop( workerInfo->m_WorkerId, workerInfo->m_StartGeneration );
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end WorkerThreaderCallback()
+
+
+/**
+ * ****************** WorkerLoop *********************************
+ */
+
+void
+PersistentThreadPool
+::WorkerLoop( ThreadIdType workerId, SizeValueType seenGeneration )
+{
+  const ThreadIdType numberOfWorkers = this->m_NumberOfThreads - 1;
+
+  this->m_Mutex.Lock();
+  while( true )
+  {
+    /** Sleep until there is a new job or the pool shuts down. */
+    while( !this->m_Shutdown && this->m_JobGeneration == seenGeneration )
+    {
+      this->m_JobAvailable->Wait( &this->m_Mutex );
+    }
+    if( this->m_Shutdown ) { break; }
+    seenGeneration = this->m_JobGeneration;
+    this->m_Mutex.Unlock();
+
+    /** Worker i executes thread ids i + 1, i + 1 + NumberOfThreads, ... */
+    this->ExecuteJobPart( workerId + 1 );
+
+    /** Report back to the calling thread. */
+    this->m_Mutex.Lock();
+    ++this->m_NumberOfFinishedWorkers;
+    if( this->m_NumberOfFinishedWorkers == numberOfWorkers )
+    {
+      this->m_JobFinished->Signal();
+    }
+  }
+  this->m_Mutex.Unlock();
+
+} // end WorkerLoop()
+
+
+/**
+ * ****************** ExecuteJobPart *********************************
+ */
+
+void
+PersistentThreadPool
+::ExecuteJobPart( ThreadIdType first )
+{
+  for( ThreadIdType i = first; i < this->m_JobNumberOfThreads; i += this->m_NumberOfThreads )
+  {
+    try
+    {
+      ( *this->m_JobFunction )( &this->m_JobThreadInfos[ i ] );
+    }
+    catch( ExceptionObject & excp )
+    {
+      this->m_Mutex.Lock();
+      if( this->m_ExceptionMessage.empty() )
+      {
+        this->m_ExceptionMessage = excp.GetDescription();
+      }
+      this->m_Mutex.Unlock();
+    }
+    catch( std::exception & excp )
+    {
+      this->m_Mutex.Lock();
+      if( this->m_ExceptionMessage.empty() )
+      {
+        this->m_ExceptionMessage = excp.what();
+      }
+      this->m_Mutex.Unlock();
+    }
+    catch( ... )
+    {
+      this->m_Mutex.Lock();
+      if( this->m_ExceptionMessage.empty() )
+      {
+        this->m_ExceptionMessage = "Unknown exception thrown in a thread of the PersistentThreadPool.";
+      }
+      this->m_Mutex.Unlock();
+    }
+  }
+
+} // end ExecuteJobPart()
+
+
+/**
+ * ****************** Execute *********************************
+ */
+
+bool
+PersistentThreadPool
+::Execute( ThreadFunctionType func, void * userData,
+  ThreadIdType numberOfThreads )
+{
+  if( numberOfThreads == 0 ) { numberOfThreads = 1; }
+
+  /** Claim the pool. */
+  this->m_Mutex.Lock();
+  if( this->m_Busy )
+  {
+    this->m_Mutex.Unlock();
+    return false;
+  }
+  this->m_Busy = true;
+  this->m_Mutex.Unlock();
+
+  /** Set up the job. Only reallocate when the number of threads grows. */
+  if( this->m_JobThreadInfos.size() < numberOfThreads )
+  {
+    this->m_JobThreadInfos.resize( numberOfThreads );
+  }
+  for( ThreadIdType i = 0; i < numberOfThreads; ++i )
+  {
+    ThreadInfoType & info = this->m_JobThreadInfos[ i ];
+    info.ThreadID        = i;
+    info.NumberOfThreads = numberOfThreads;
+    info.ActiveFlag      = NULL;
+    info.UserData        = userData;
+    info.ThreadFunction  = func;
+  }
+  this->m_JobFunction        = func;
+  this->m_JobNumberOfThreads = numberOfThreads;
+  this->m_ExceptionMessage.clear();
+
+  /** Wake up the workers. */
+  const ThreadIdType numberOfWorkers = this->m_NumberOfThreads - 1;
+  if( numberOfWorkers > 0 )
+  {
+    this->m_Mutex.Lock();
+    this->m_NumberOfFinishedWorkers = 0;
+    ++this->m_JobGeneration;
+    this->m_JobAvailable->Broadcast();
+    this->m_Mutex.Unlock();
+  }
+
+  /** The calling thread does its own part. */
+  this->ExecuteJobPart( 0 );
+
+  /** Wait for the workers and release the pool. */
+  this->m_Mutex.Lock();
+  while( this->m_NumberOfFinishedWorkers < numberOfWorkers )
+  {
+    this->m_JobFinished->Wait( &this->m_Mutex );
+  }
+  const std::string message = this->m_ExceptionMessage;
+  ++this->m_NumberOfExecutedJobs;
+  this->m_Busy = false;
+  this->m_Mutex.Unlock();
+
+  if( !message.empty() )
+  {
+    itkExceptionMacro( << message );
+  }
+
+  return true;
+
+} // end Execute()
+
+
+/**
+ * ****************** SetGlobalInstance *********************************
+ */
+
+void
+PersistentThreadPool
+::SetGlobalInstance( Self * pool )
+{
+  m_GlobalInstance = pool;
+
+} // end SetGlobalInstance()
+
+
+/**
+ * ****************** GetGlobalInstance *********************************
+ */
+
+PersistentThreadPool *
+PersistentThreadPool
+::GetGlobalInstance( void )
+{
+  return m_GlobalInstance;
+
+} // end GetGlobalInstance()
+
+
+/**
+ * ****************** SetThreadInstance *********************************
+ */
+
+void
+PersistentThreadPool
+::SetThreadInstance( Self * pool )
+{
+  s_ThreadInstance = pool;
+
+} // end SetThreadInstance()
+
+
+/**
+ * ****************** GetThreadInstance *********************************
+ */
+
+PersistentThreadPool *
+PersistentThreadPool
+::GetThreadInstance( void )
+{
+  return s_ThreadInstance;
+
+} // end GetThreadInstance()
+
+
+/**
+ * ****************** SingleMethodExecute *********************************
+ */
+
+void
+PersistentThreadPool
+::SingleMethodExecute( ThreaderType * threader,
+  ThreadFunctionType func, void * userData )
+{
+  const ThreadIdType numberOfThreads = threader->GetNumberOfThreads();
+
+  /** The pool of this thread is a budget: when it is busy, for example
+   * because this job is launched from within one of its jobs, spawning
+   * more threads would exceed it.
+   */
+  Self * pool = s_ThreadInstance;
+  if( pool != NULL )
+  {
+    if( !pool->Execute( func, userData, numberOfThreads ) )
+    {
+      SerialExecute( func, userData, numberOfThreads );
+    }
+    return;
+  }
+
+  pool = m_GlobalInstance;
+  if( pool != NULL && pool->Execute( func, userData, numberOfThreads ) )
+  {
+    return;
+  }
+
+  /** No pool, or the pool is busy: spawn threads the classic way. */
+  threader->SetSingleMethod( func, userData );
+  threader->SingleMethodExecute();
+
+} // end SingleMethodExecute()
+
+
+/**
+ * ****************** SerialExecute *********************************
+ */
+
+void
+PersistentThreadPool
+::SerialExecute( ThreadFunctionType func, void * userData,
+  ThreadIdType numberOfThreads )
+{
+  if( numberOfThreads == 0 ) { numberOfThreads = 1; }
+
+  ThreadInfoType info;
+  info.NumberOfThreads = numberOfThreads;
+  info.ActiveFlag      = NULL;
+  info.UserData        = userData;
+  info.ThreadFunction  = func;
+  for( ThreadIdType i = 0; i < numberOfThreads; ++i )
+  {
+    info.ThreadID = i;
+    ( *func )( &info );
+  }
+
+} // end SerialExecute()
+
+
+/**
+ * ****************** PrintSelf *********************************
+ */
+
+void
+PersistentThreadPool
+::PrintSelf( std::ostream & os, Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "NumberOfThreads: " << this->m_NumberOfThreads << std::endl;
+  os << indent << "NumberOfExecutedJobs: " << this->m_NumberOfExecutedJobs << std::endl;
+
+} // end PrintSelf()
+
+
+} // end namespace itk
+
+#endif // end #ifndef __itkPersistentThreadPool_cxx
@@ -0,0 +1,191 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkPersistentThreadPool_h
+#define __itkPersistentThreadPool_h
+
+#include "itkObject.h"
+#include "itkObjectFactory.h"
+#include "itkMultiThreader.h"
+#include "itkSimpleMutexLock.h"
+#include "itkConditionVariable.h"
+
+#include <vector>
+#include <string>
+
+namespace itk
+{
+
+/** \class PersistentThreadPool
+ *
+ * \brief A set of long-lived worker threads that execute single methods.
+ *
+ * itk::MultiThreader creates and joins its threads on every call of
+ * SingleMethodExecute(). In a registration with thousands of iterations,
+ * in which the metric, the derivative accumulation, the optimizer and the
+ * penalty terms each launch threads every iteration, this overhead adds up.
+ * This class creates NumberOfThreads - 1 workers once, and lets them sleep
+ * on a condition variable between jobs. The calling thread always executes
+ * thread id 0 itself.
+ *
+ * A job has the same signature as a MultiThreader single method: it gets a
+ * MultiThreader::ThreadInfoStruct with the ThreadID, NumberOfThreads and
+ * UserData filled in. When a job asks for more threads than the pool has,
+ * the workers execute several thread ids one after the other.
+ *
+ * The pool runs one job at a time. Execute() returns false when the pool
+ * is busy, for example when a job itself launches threads. The static
+ * SingleMethodExecute() then falls back to the given MultiThreader, so
+ * components can use it without knowing whether a pool exists.
+ *
+ * elastix::ElastixMain creates a pool sized by the -threads command line
+ * argument and registers it as the global instance.
+ *
+ * A pool can also be made the thread instance of some threads only, as
+ * elastix::ElastixContext does for registrations that run concurrently in
+ * one process. SingleMethodExecute() prefers the thread instance over the
+ * global one, and when the thread instance is busy it executes the thread
+ * ids one after the other in the calling thread, so that the number of
+ * threads of the pool is a budget that is never exceeded.
+ *
+ * \ingroup ITKSystemObjects
+ */
+
+class PersistentThreadPool : public Object
+{
+public:
+
+  /** Standard class typedefs. */
+  typedef PersistentThreadPool       Self;
+  typedef Object                     Superclass;
+  typedef SmartPointer< Self >       Pointer;
+  typedef SmartPointer< const Self > ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( PersistentThreadPool, Object );
+
+  /** Typedefs. */
+  typedef MultiThreader                  ThreaderType;
+  typedef ThreaderType::ThreadInfoStruct ThreadInfoType;
+
+  /** Set the number of threads, including the calling thread. Stops
+   * and restarts the workers if the number changes. Default: 1.
+   */
+  void SetNumberOfThreads( ThreadIdType numberOfThreads );
+  itkGetConstMacro( NumberOfThreads, ThreadIdType );
+
+  /** Execute func( ThreadInfoStruct * ) for thread ids
+   * 0, .., numberOfThreads - 1 and wait until all have finished.
+   * Returns false, without executing anything, when the pool is
+   * already running a job. Exceptions thrown in a job are rethrown
+   * in the calling thread.
+   */
+  bool Execute( ThreadFunctionType func, void * userData,
+    ThreadIdType numberOfThreads );
+
+  /** Get the number of jobs executed by the pool. */
+  itkGetConstMacro( NumberOfExecutedJobs, SizeValueType );
+
+  /** Set/Get the global pool. The caller keeps ownership. */
+  static void SetGlobalInstance( Self * pool );
+  static Self * GetGlobalInstance( void );
+
+  /** Set/Get the pool of the calling thread, which overrides the global
+   * pool in that thread. The caller keeps ownership; pass NULL to use the
+   * global pool again.
+   */
+  static void SetThreadInstance( Self * pool );
+  static Self * GetThreadInstance( void );
+
+  /** Execute func with threader->GetNumberOfThreads() threads on the
+   * thread instance or, when there is none, the global pool. When the pool
+   * is busy, the thread ids are executed in the calling thread if it is a
+   * thread instance, and with the threader otherwise.
+   */
+  static void SingleMethodExecute( ThreaderType * threader,
+    ThreadFunctionType func, void * userData );
+
+  /** Execute func for thread ids 0, .., numberOfThreads - 1, one after
+   * the other, in the calling thread.
+   */
+  static void SerialExecute( ThreadFunctionType func, void * userData,
+    ThreadIdType numberOfThreads );
+
+protected:
+
+  PersistentThreadPool();
+  virtual ~PersistentThreadPool();
+
+  /** PrintSelf. */
+  void PrintSelf( std::ostream & os, Indent indent ) const;
+
+private:
+
+  PersistentThreadPool( const Self & ); // purposely not implemented
+  void operator=( const Self & );       // purposely not implemented
+
+  /** Start and stop the worker threads. */
+  void StartWorkers( void );
+  void StopWorkers( void );
+
+  /** The function executed by the worker threads. */
+  static ITK_THREAD_RETURN_TYPE WorkerThreaderCallback( void * arg );
+
+  /** Wait for jobs after seenGeneration until the pool shuts down. */
+  void WorkerLoop( ThreadIdType workerId, SizeValueType seenGeneration );
+
+  /** Execute the thread ids first, first + stride, ... of the current job. */
+  void ExecuteJobPart( ThreadIdType first );
+
+  struct WorkerInfoType
+  {
+    Self *        m_Pool;
+    ThreadIdType  m_WorkerId;
+    SizeValueType m_StartGeneration;
+  };
+
+  ThreadIdType                  m_NumberOfThreads;
+  ThreaderType::Pointer         m_SpawnThreader;
+  std::vector< ThreadIdType >   m_SpawnedThreadIds;
+  std::vector< WorkerInfoType > m_WorkerInfos;
+
+  /** The state of the pool, protected by m_Mutex. */
+  SimpleMutexLock              m_Mutex;
+  ConditionVariable::Pointer   m_JobAvailable;
+  ConditionVariable::Pointer   m_JobFinished;
+  bool                         m_Busy;
+  bool                         m_Shutdown;
+  SizeValueType                m_JobGeneration;
+  ThreadIdType                 m_NumberOfFinishedWorkers;
+  std::string                  m_ExceptionMessage;
+  SizeValueType                m_NumberOfExecutedJobs;
+
+  /** The current job. */
+  ThreadFunctionType            m_JobFunction;
+  ThreadIdType                  m_JobNumberOfThreads;
+  std::vector< ThreadInfoType > m_JobThreadInfos;
+
+  static Self * m_GlobalInstance;
+
+};
+
+} // end namespace itk
+
+#endif // end #ifndef __itkPersistentThreadPool_h
@@ -0,0 +1,268 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef __itkSampleBlockScheduler_cxx
+#define __itkSampleBlockScheduler_cxx
+
+#include "itkSampleBlockScheduler.h"
+
+namespace itk
+{
+
+/**
+ * ****************** Constructor *********************************
+ */
+
+SampleBlockScheduler
+::SampleBlockScheduler()
+{
+  this->m_SchedulingMode   = Static;
+  this->m_BlockSize        = 256;
+  this->m_NumberOfSamples  = 0;
+  this->m_CurrentBlockSize = 1;
+  this->m_NumberOfBlocks   = 0;
+  this->m_NumberOfThreads  = 0;
+  this->m_BlockQueues      = NULL;
+  this->m_BlockQueuesSize  = 0;
+
+} // end Constructor
+
+
+/**
+ * ****************** Destructor *********************************
+ */
+
+SampleBlockScheduler
+::~SampleBlockScheduler()
+{
+  delete[] this->m_BlockQueues;
+
+} // end Destructor
+
+
+/**
+ * ****************** Initialize *********************************
+ */
+
+void
+SampleBlockScheduler
+::Initialize( SizeValueType numberOfSamples, ThreadIdType numberOfThreads )
+{
+  if( numberOfThreads == 0 ) { numberOfThreads = 1; }
+
+  this->m_NumberOfSamples = numberOfSamples;
+  this->m_NumberOfThreads = numberOfThreads;
+
+  /** Only reallocate the queues when the number of threads changed. */
+  if( this->m_BlockQueuesSize != numberOfThreads )
+  {
+    delete[] this->m_BlockQueues;
+    this->m_BlockQueues     = new PaddedBlockQueueStruct[ numberOfThreads ];
+    this->m_BlockQueuesSize = numberOfThreads;
+  }
+
+  /** Determine the block size. In static mode each thread gets a single
+   * block, which gives the same partitioning as the classic code.
+   */
+  if( this->m_SchedulingMode == WorkStealing )
+  {
+    this->m_CurrentBlockSize = this->m_BlockSize;
+  }
+  else
+  {
+    this->m_CurrentBlockSize = ( numberOfSamples + numberOfThreads - 1 ) / numberOfThreads;
+  }
+  if( this->m_CurrentBlockSize == 0 ) { this->m_CurrentBlockSize = 1; }
+  this->m_NumberOfBlocks = ( numberOfSamples + this->m_CurrentBlockSize - 1 )
+    / this->m_CurrentBlockSize;
+
+  /** Give each thread a contiguous part of the blocks. */
+  const SizeValueType blocksPerThread
+    = ( this->m_NumberOfBlocks + numberOfThreads - 1 ) / numberOfThreads;
+  for( ThreadIdType i = 0; i < numberOfThreads; ++i )
+  {
+    SizeValueType front = blocksPerThread * i;
+    SizeValueType back  = blocksPerThread * ( i + 1 );
+    front = ( front > this->m_NumberOfBlocks ) ? this->m_NumberOfBlocks : front;
+    back  = ( back > this->m_NumberOfBlocks ) ? this->m_NumberOfBlocks : back;
+
+    this->m_BlockQueues[ i ].st_Front          = front;
+    this->m_BlockQueues[ i ].st_Back           = back;
+    this->m_BlockQueues[ i ].st_NumberOfSteals = 0;
+  }
+
+} // end Initialize()
+
+
+/**
+ * ****************** GetNextBlock *********************************
+ */
+
+bool
+SampleBlockScheduler
+::GetNextBlock( ThreadIdType threadId,
+  SizeValueType & begin, SizeValueType & end )
+{
+  if( threadId >= this->m_NumberOfThreads ) { return false; }
+
+  BlockQueueStruct & queue = this->m_BlockQueues[ threadId ];
+  SizeValueType      block = 0;
+  bool               found = false;
+
+  /** Pop a block from the front of the own queue. */
+  if( this->m_SchedulingMode == WorkStealing )
+  {
+    queue.st_Lock.Lock();
+    if( queue.st_Front < queue.st_Back )
+    {
+      block = queue.st_Front;
+      ++queue.st_Front;
+      found = true;
+    }
+    queue.st_Lock.Unlock();
+
+    /** Steal from other threads when the own queue is empty. */
+    if( !found )
+    {
+      found = this->StealBlock( threadId, block );
+    }
+  }
+  else
+  {
+    /** In static mode no other thread touches this queue. */
+    if( queue.st_Front < queue.st_Back )
+    {
+      block = queue.st_Front;
+      ++queue.st_Front;
+      found = true;
+    }
+  }
+
+  if( found )
+  {
+    this->BlockToRange( block, begin, end );
+  }
+  return found;
+
+} // end GetNextBlock()
+
+
+/**
+ * ****************** StealBlock *********************************
+ */
+
+bool
+SampleBlockScheduler
+::StealBlock( ThreadIdType threadId, SizeValueType & block )
+{
+  BlockQueueStruct & ownQueue = this->m_BlockQueues[ threadId ];
+
+  /** Visit the other threads round-robin, starting at the next one. */
+  for( ThreadIdType k = 1; k < this->m_NumberOfThreads; ++k )
+  {
+    const ThreadIdType victimId = ( threadId + k ) % this->m_NumberOfThreads;
+    BlockQueueStruct & victim   = this->m_BlockQueues[ victimId ];
+
+    /** Take the back half of the victim's queue. */
+    victim.st_Lock.Lock();
+    const SizeValueType remaining = victim.st_Back - victim.st_Front;
+    if( remaining == 0 )
+    {
+      victim.st_Lock.Unlock();
+      continue;
+    }
+    const SizeValueType stolenBack  = victim.st_Back;
+    const SizeValueType stolenFront = victim.st_Back - ( remaining + 1 ) / 2;
+    victim.st_Back = stolenFront;
+    victim.st_Lock.Unlock();
+
+    /** Process the first stolen block now, and put the rest in the own queue,
+     * where it can in turn be stolen by other threads.
+     */
+    block = stolenFront;
+    ownQueue.st_Lock.Lock();
+    ownQueue.st_Front = stolenFront + 1;
+    ownQueue.st_Back  = stolenBack;
+    ++ownQueue.st_NumberOfSteals;
+    ownQueue.st_Lock.Unlock();
+
+    return true;
+  }
+
+  return false;
+
+} // end StealBlock()
+
+
+/**
+ * ****************** BlockToRange *********************************
+ */
+
+void
+SampleBlockScheduler
+::BlockToRange( SizeValueType block,
+  SizeValueType & begin, SizeValueType & end ) const
+{
+  begin = block * this->m_CurrentBlockSize;
+  end   = begin + this->m_CurrentBlockSize;
+  begin = ( begin > this->m_NumberOfSamples ) ? this->m_NumberOfSamples : begin;
+  end   = ( end > this->m_NumberOfSamples ) ? this->m_NumberOfSamples : end;
+
+} // end BlockToRange()
+
+
+/**
+ * ****************** GetNumberOfSteals *********************************
+ */
+
+SizeValueType
+SampleBlockScheduler
+::GetNumberOfSteals( void ) const
+{
+  SizeValueType steals = 0;
+  for( ThreadIdType i = 0; i < this->m_NumberOfThreads; ++i )
+  {
+    steals += this->m_BlockQueues[ i ].st_NumberOfSteals;
+  }
+  return steals;
+
+} // end GetNumberOfSteals()
+
+
+/**
+ * ****************** PrintSelf *********************************
+ */
+
+void
+SampleBlockScheduler
+::PrintSelf( std::ostream & os, Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "SchedulingMode: " << this->m_SchedulingMode << std::endl;
+  os << indent << "BlockSize: " << this->m_BlockSize << std::endl;
+  os << indent << "NumberOfSamples: " << this->m_NumberOfSamples << std::endl;
+  os << indent << "NumberOfBlocks: " << this->m_NumberOfBlocks << std::endl;
+  os << indent << "NumberOfThreads: " << this->m_NumberOfThreads << std::endl;
+
+} // end PrintSelf()
+
+
+} // end namespace itk
+
+#endif // end #ifndef __itkSampleBlockScheduler_cxx
@@ -0,0 +1,148 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkSampleBlockScheduler_h
+#define __itkSampleBlockScheduler_h
+
+#include "itkObject.h"
+#include "itkObjectFactory.h"
+#include "itkIntTypes.h"
+#include "itkNumericTraits.h"
+#include "itkSimpleFastMutexLock.h"
+
+namespace itk
+{
+
+/** \class SampleBlockScheduler
+ *
+ * \brief Distributes the samples of a metric over the threads.
+ *
+ * The threaded metric functions ask this class for the next range
+ * [ begin, end [ of samples to process, until it returns false.
+ * Two scheduling modes are supported:
+ * \li Static: each thread gets one contiguous chunk of
+ *   ceil( numberOfSamples / numberOfThreads ) samples. This is
+ *   identical to the classic elastix partitioning.
+ * \li WorkStealing: the samples are split in small blocks of
+ *   BlockSize samples. Each thread owns a double-ended queue of
+ *   blocks, initially a contiguous part of all blocks. A thread pops
+ *   blocks from the front of its own queue; when its queue is empty
+ *   it steals the back half of the queue of another thread. This
+ *   balances the load when the cost per sample varies, for example
+ *   with masks or B-spline transforms.
+ *
+ * Since a thread may process several ranges, the per-thread results
+ * should be accumulated over all ranges before they are stored in
+ * the per-thread structs of the metric.
+ *
+ * \ingroup RegistrationMetrics
+ */
+
+class SampleBlockScheduler : public Object
+{
+public:
+
+  /** Standard class typedefs. */
+  typedef SampleBlockScheduler       Self;
+  typedef Object                     Superclass;
+  typedef SmartPointer< Self >       Pointer;
+  typedef SmartPointer< const Self > ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( SampleBlockScheduler, Object );
+
+  /** The supported scheduling modes. */
+  typedef enum {
+    Static       = 0,
+    WorkStealing = 1
+  } SchedulingModeType;
+
+  /** Set/Get the scheduling mode. Default: Static. */
+  itkSetMacro( SchedulingMode, SchedulingModeType );
+  itkGetConstMacro( SchedulingMode, SchedulingModeType );
+
+  /** Set/Get the number of samples per block, used by the
+   * WorkStealing mode. Default: 256.
+   */
+  itkSetClampMacro( BlockSize, SizeValueType, 1, NumericTraits< SizeValueType >::max() );
+  itkGetConstMacro( BlockSize, SizeValueType );
+
+  /** Prepare the scheduler for a new threaded loop over numberOfSamples
+   * samples with numberOfThreads threads. Not thread-safe; call this
+   * before launching the threads.
+   */
+  void Initialize( SizeValueType numberOfSamples, ThreadIdType numberOfThreads );
+
+  /** Get the next range [ begin, end [ of samples for this thread.
+   * Returns false when all samples have been handed out. Thread-safe.
+   */
+  bool GetNextBlock( ThreadIdType threadId,
+    SizeValueType & begin, SizeValueType & end );
+
+  /** Get the number of successful steals during the last loop. */
+  SizeValueType GetNumberOfSteals( void ) const;
+
+protected:
+
+  SampleBlockScheduler();
+  virtual ~SampleBlockScheduler();
+
+  /** PrintSelf. */
+  void PrintSelf( std::ostream & os, Indent indent ) const;
+
+private:
+
+  SampleBlockScheduler( const Self & ); // purposely not implemented
+  void operator=( const Self & );       // purposely not implemented
+
+  /** Try to steal blocks for this thread from another thread. */
+  bool StealBlock( ThreadIdType threadId, SizeValueType & block );
+
+  /** Convert a block number to a sample range. */
+  void BlockToRange( SizeValueType block,
+    SizeValueType & begin, SizeValueType & end ) const;
+
+  /** The queue of one thread: the blocks [ st_Front, st_Back [.
+   * Padded to avoid false sharing between the threads.
+   */
+  struct BlockQueueStruct
+  {
+    SimpleFastMutexLock st_Lock;
+    SizeValueType       st_Front;
+    SizeValueType       st_Back;
+    SizeValueType       st_NumberOfSteals;
+  };
+  itkPadStruct( ITK_CACHE_LINE_ALIGNMENT, BlockQueueStruct,
+    PaddedBlockQueueStruct );
+
+  SchedulingModeType       m_SchedulingMode;
+  SizeValueType            m_BlockSize;
+  SizeValueType            m_NumberOfSamples;
+  SizeValueType            m_CurrentBlockSize;
+  SizeValueType            m_NumberOfBlocks;
+  ThreadIdType             m_NumberOfThreads;
+  PaddedBlockQueueStruct * m_BlockQueues;
+  ThreadIdType             m_BlockQueuesSize;
+
+};
+
+} // end namespace itk
+
+#endif // end #ifndef __itkSampleBlockScheduler_h
@@ -0,0 +1,287 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkSharedObjectCache_cxx
+#define __itkSharedObjectCache_cxx
+
+#include "itkSharedObjectCache.h"
+
+namespace itk
+{
+
+/**
+ * ****************** Constructor *********************************
+ */
+
+SharedObjectCache
+::SharedObjectCache()
+{
+  this->m_NumberOfHits   = 0;
+  this->m_NumberOfMisses = 0;
+  this->m_KeyReleased    = ConditionVariable::New();
+
+} // end Constructor
+
+
+/**
+ * ****************** Find *********************************
+ */
+
+LightObject *
+SharedObjectCache
+::Find( const KeyType & key ) const
+{
+  this->m_Mutex.Lock();
+  MapType::const_iterator it     = this->m_Map.find( key );
+  LightObject *           object = NULL;
+  if( it != this->m_Map.end() )
+  {
+    object = it->second.GetPointer();
+    ++this->m_NumberOfHits;
+  }
+  else
+  {
+    ++this->m_NumberOfMisses;
+  }
+  this->m_Mutex.Unlock();
+
+  return object;
+
+} // end Find()
+
+
+/**
+ * ****************** FindOrReserve *********************************
+ */
+
+LightObject *
+SharedObjectCache
+::FindOrReserve( const KeyType & key, Reservation & reservation )
+{
+  reservation.Release();
+
+  this->m_Mutex.Lock();
+  while( this->m_ReservedKeys.count( key ) > 0 )
+  {
+    this->m_KeyReleased->Wait( &this->m_Mutex );
+  }
+
+  MapType::const_iterator it     = this->m_Map.find( key );
+  LightObject *           object = NULL;
+  if( it != this->m_Map.end() )
+  {
+    object = it->second.GetPointer();
+    ++this->m_NumberOfHits;
+  }
+  else
+  {
+    ++this->m_NumberOfMisses;
+    this->m_ReservedKeys.insert( key );
+    reservation.m_Cache = this;
+    reservation.m_Key   = key;
+  }
+  this->m_Mutex.Unlock();
+
+  return object;
+
+} // end FindOrReserve()
+
+
+/**
+ * ****************** Insert *********************************
+ */
+
+LightObject *
+SharedObjectCache
+::Insert( const KeyType & key, LightObject * object )
+{
+  this->m_Mutex.Lock();
+  std::pair< MapType::iterator, bool > result
+    = this->m_Map.insert( MapType::value_type( key, object ) );
+  LightObject * stored      = result.first->second.GetPointer();
+  const bool    wasReserved = this->m_ReservedKeys.erase( key ) > 0;
+  this->m_Mutex.Unlock();
+
+  if( wasReserved )
+  {
+    this->m_KeyReleased->Broadcast();
+  }
+  return stored;
+
+} // end Insert()
+
+
+/**
+ * ****************** ReleaseKey *********************************
+ */
+
+void
+SharedObjectCache
+::ReleaseKey( const KeyType & key )
+{
+  this->m_Mutex.Lock();
+  this->m_ReservedKeys.erase( key );
+  this->m_Mutex.Unlock();
+  this->m_KeyReleased->Broadcast();
+
+} // end ReleaseKey()
+
+
+/**
+ * ****************** Reservation::Insert *********************************
+ */
+
+LightObject *
+SharedObjectCache::Reservation
+::Insert( LightObject * object )
+{
+  if( this->m_Cache == NULL )
+  {
+    return object;
+  }
+  SharedObjectCache * cache = this->m_Cache;
+  this->m_Cache = NULL;
+  return cache->Insert( this->m_Key, object );
+
+} // end Reservation::Insert()
+
+
+/**
+ * ****************** Reservation::Release *********************************
+ */
+
+void
+SharedObjectCache::Reservation
+::Release( void )
+{
+  if( this->m_Cache == NULL )
+  {
+    return;
+  }
+  SharedObjectCache * cache = this->m_Cache;
+  this->m_Cache = NULL;
+  cache->ReleaseKey( this->m_Key );
+
+} // end Reservation::Release()
+
+
+/**
+ * ****************** Clear *********************************
+ */
+
+void
+SharedObjectCache
+::Clear( void )
+{
+  this->m_Mutex.Lock();
+  this->m_Map.clear();
+  this->m_NumberOfHits   = 0;
+  this->m_NumberOfMisses = 0;
+  this->m_Mutex.Unlock();
+
+} // end Clear()
+
+
+/**
+ * ****************** GetNumberOfObjects *********************************
+ */
+
+SizeValueType
+SharedObjectCache
+::GetNumberOfObjects( void ) const
+{
+  this->m_Mutex.Lock();
+  const SizeValueType numberOfObjects = this->m_Map.size();
+  this->m_Mutex.Unlock();
+
+  return numberOfObjects;
+
+} // end GetNumberOfObjects()
+
+
+/**
+ * ****************** GetNumberOfHits *********************************
+ */
+
+SizeValueType
+SharedObjectCache
+::GetNumberOfHits( void ) const
+{
+  this->m_Mutex.Lock();
+  const SizeValueType numberOfHits = this->m_NumberOfHits;
+  this->m_Mutex.Unlock();
+
+  return numberOfHits;
+
+} // end GetNumberOfHits()
+
+
+/**
+ * ****************** GetNumberOfMisses *********************************
+ */
+
+SizeValueType
+SharedObjectCache
+::GetNumberOfMisses( void ) const
+{
+  this->m_Mutex.Lock();
+  const SizeValueType numberOfMisses = this->m_NumberOfMisses;
+  this->m_Mutex.Unlock();
+
+  return numberOfMisses;
+
+} // end GetNumberOfMisses()
+
+
+/**
+ * ****************** AppendToKey *********************************
+ */
+
+void
+SharedObjectCache
+::AppendToKey( std::ostringstream & key, const Object * object )
+{
+  key << "[" << static_cast< const void * >( object );
+  if( object )
+  {
+    key << "@" << object->GetMTime();
+  }
+  key << "]";
+
+} // end AppendToKey()
+
+
+/**
+ * ****************** PrintSelf *********************************
+ */
+
+void
+SharedObjectCache
+::PrintSelf( std::ostream & os, Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "NumberOfObjects: " << this->GetNumberOfObjects() << std::endl;
+  os << indent << "NumberOfHits: " << this->GetNumberOfHits() << std::endl;
+  os << indent << "NumberOfMisses: " << this->GetNumberOfMisses() << std::endl;
+
+} // end PrintSelf()
+
+
+} // end namespace itk
+
+#endif // end #ifndef __itkSharedObjectCache_cxx
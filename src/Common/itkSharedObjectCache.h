@@ -0,0 +1,168 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkSharedObjectCache_h
+#define __itkSharedObjectCache_h
+
+#include "itkObject.h"
+#include "itkObjectFactory.h"
+#include "itkSimpleMutexLock.h"
+#include "itkConditionVariable.h"
+
+#include <map>
+#include <set>
+#include <string>
+#include <sstream>
+
+namespace itk
+{
+
+/** \class SharedObjectCache
+ *
+ * \brief A thread-safe map from keys to objects, to share results that
+ * several registrations would otherwise all compute.
+ *
+ * When many moving images are registered to the same fixed image, the
+ * fixed image pyramid, the eroded fixed masks, the samples of the fixed
+ * image and the fixed image extrema are the same in every registration.
+ * Components that compute such a result look it up with FindOrReserve().
+ * When it is not there, the key is reserved for the calling thread, which
+ * computes the result and inserts it through the Reservation. Other threads
+ * that look up a reserved key wait until the result is inserted, so that it
+ * is computed once. When the computation fails, the Reservation releases the
+ * key on destruction, and one of the waiting threads computes it instead.
+ *
+ * The key must describe everything the result depends on. AppendToKey()
+ * helps to build keys that include the address and the modification time
+ * of the input objects, so the inputs must stay alive while the cache is
+ * in use. The cached objects are shared by registrations that may run
+ * concurrently, so they must not be modified after Insert().
+ *
+ * A thread must not look up a key that it has reserved itself.
+ *
+ * \ingroup ITKSystemObjects
+ */
+
+class SharedObjectCache : public Object
+{
+public:
+
+  /** Standard class typedefs. */
+  typedef SharedObjectCache          Self;
+  typedef Object                     Superclass;
+  typedef SmartPointer< Self >       Pointer;
+  typedef SmartPointer< const Self > ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( SharedObjectCache, Object );
+
+  /** Typedefs. */
+  typedef std::string          KeyType;
+  typedef LightObject::Pointer ObjectPointer;
+
+  /** A key reserved by FindOrReserve(). The key is released when the
+   * reservation is destroyed before an object was inserted.
+   */
+  class Reservation
+  {
+public:
+
+    Reservation() : m_Cache( NULL ) {}
+    ~Reservation() { this->Release(); }
+
+    /** Whether the calling thread should compute the object. */
+    bool IsActive( void ) const { return this->m_Cache != NULL; }
+
+    /** Store object under the reserved key, and wake the waiting threads.
+     * Returns the stored object.
+     */
+    LightObject * Insert( LightObject * object );
+
+    /** Release the key without inserting an object. */
+    void Release( void );
+
+private:
+
+    Reservation( const Reservation & );    // purposely not implemented
+    void operator=( const Reservation & ); // purposely not implemented
+
+    friend class SharedObjectCache;
+    SharedObjectCache * m_Cache;
+    KeyType             m_Key;
+  };
+
+  /** Find the object stored under key, or NULL. Counts a hit or a miss. */
+  LightObject * Find( const KeyType & key ) const;
+
+  /** Find the object stored under key. When another thread has reserved
+   * the key, wait until it inserts or releases it. When there is no object,
+   * reserve the key in reservation and return NULL. Counts a hit or a miss.
+   */
+  LightObject * FindOrReserve( const KeyType & key, Reservation & reservation );
+
+  /** Store object under key, unless another object is stored there
+   * already. Returns the object that is stored under key afterwards.
+   */
+  LightObject * Insert( const KeyType & key, LightObject * object );
+
+  /** Remove all objects. Reserved keys stay reserved. */
+  void Clear( void );
+
+  /** Get the number of stored objects, and the lookup statistics. */
+  SizeValueType GetNumberOfObjects( void ) const;
+  SizeValueType GetNumberOfHits( void ) const;
+  SizeValueType GetNumberOfMisses( void ) const;
+
+  /** Append the identity of an input object to a key: its address and,
+   * to detect modifications, its modification time.
+   */
+  static void AppendToKey( std::ostringstream & key, const Object * object );
+
+protected:
+
+  SharedObjectCache();
+  virtual ~SharedObjectCache() {}
+
+  /** PrintSelf. */
+  void PrintSelf( std::ostream & os, Indent indent ) const;
+
+private:
+
+  SharedObjectCache( const Self & ); // purposely not implemented
+  void operator=( const Self & );    // purposely not implemented
+
+  /** Remove the reservation of key, and wake the waiting threads. */
+  void ReleaseKey( const KeyType & key );
+
+  typedef std::map< KeyType, ObjectPointer > MapType;
+  typedef std::set< KeyType >                KeySetType;
+
+  MapType                    m_Map;
+  KeySetType                 m_ReservedKeys;
+  mutable SizeValueType      m_NumberOfHits;
+  mutable SizeValueType      m_NumberOfMisses;
+  mutable SimpleMutexLock    m_Mutex;
+  ConditionVariable::Pointer m_KeyReleased;
+
+};
+
+} // end namespace itk
+
+#endif // end #ifndef __itkSharedObjectCache_h
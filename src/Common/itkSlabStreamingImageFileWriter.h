@@ -0,0 +1,166 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkSlabStreamingImageFileWriter_h
+#define __itkSlabStreamingImageFileWriter_h
+
+#include "itkProcessObject.h"
+#include "itkImageIOBase.h"
+#include "itkImageIORegion.h"
+#include "itkMultiThreader.h"
+#include <vector>
+#include <string>
+
+namespace itk
+{
+
+/** \class SlabStreamingImageFileWriter
+ * \brief Writes an image in slabs, computing the next slab while the
+ * previous one is being written.
+ *
+ * The upstream pipeline is updated for one slab at a time, so the peak
+ * memory scales with the slab size instead of with the image size. Each
+ * slab is copied to one of two buffers and written by a separate thread
+ * through the ImageIO, while the main thread already generates the next
+ * slab. The ImageIO must support streamed writing (e.g. MetaImage, NIfTI,
+ * NRRD); otherwise the image is written in one piece.
+ *
+ * The split into slabs is determined by the ImageIO, just as in the
+ * itk::ImageFileWriter, and is at most NumberOfSlabs pieces.
+ *
+ * \ingroup IOFilters
+ */
+template< class TInputImage >
+class SlabStreamingImageFileWriter : public ProcessObject
+{
+public:
+
+  /** Standard class typedefs. */
+  typedef SlabStreamingImageFileWriter Self;
+  typedef ProcessObject                Superclass;
+  typedef SmartPointer< Self >         Pointer;
+  typedef SmartPointer< const Self >   ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( SlabStreamingImageFileWriter, ProcessObject );
+
+  /** Some convenient typedefs. */
+  typedef TInputImage                          InputImageType;
+  typedef typename InputImageType::Pointer     InputImagePointer;
+  typedef typename InputImageType::RegionType  InputImageRegionType;
+  typedef typename InputImageType::PixelType   InputImagePixelType;
+  typedef typename InputImageType::IndexType   InputImageIndexType;
+  typedef typename InputImageType::PointType   InputImagePointType;
+
+  itkStaticConstMacro( InputImageDimension, unsigned int, InputImageType::ImageDimension );
+
+  /** Set/Get the image input of this writer. */
+  void SetInput( const InputImageType * input );
+  const InputImageType * GetInput( void );
+
+  /** Set/Get the name of the file to be written. */
+  itkSetStringMacro( FileName );
+  itkGetStringMacro( FileName );
+
+  /** Set/Get the ImageIO. If not set, it is created by the ImageIOFactory
+   * for each Write().
+   */
+  itkSetObjectMacro( ImageIO, ImageIOBase );
+  itkGetObjectMacro( ImageIO, ImageIOBase );
+
+  /** Set/Get the requested number of slabs. Default: 8. */
+  itkSetClampMacro( NumberOfSlabs, unsigned int, 1, NumericTraits< unsigned int >::max() );
+  itkGetConstMacro( NumberOfSlabs, unsigned int );
+
+  /** Set/Get compression, if supported by the ImageIO. Note that most
+   * ImageIOs do not support streamed writing of compressed files.
+   */
+  itkSetMacro( UseCompression, bool );
+  itkGetConstReferenceMacro( UseCompression, bool );
+  itkBooleanMacro( UseCompression );
+
+  /** Get the number of slabs of the last Write(). */
+  itkGetConstMacro( NumberOfWrittenSlabs, unsigned int );
+
+  /** Compute and write the image. Throws a ProcessAborted exception if the
+   * writing is stopped by SetAbortGenerateData(), since the file is then
+   * incomplete.
+   */
+  virtual void Write( void );
+
+  /** Aliased to the Write() method to be consistent with the rest of the
+   * pipeline.
+   */
+  virtual void Update( void ) { this->Write(); }
+
+protected:
+
+  SlabStreamingImageFileWriter();
+  virtual ~SlabStreamingImageFileWriter() {}
+
+  /** PrintSelf. */
+  void PrintSelf( std::ostream & os, Indent indent ) const;
+
+  /** Does nothing; the work is done in Write(). */
+  void GenerateData( void ) {}
+
+  /** Set up the ImageIO for the image information of the input. */
+  virtual void InitializeImageIO( ImageIOBase * imageIO,
+    const InputImageType * input ) const;
+
+  /** Copy a slab of the input to a buffer. */
+  virtual void CopySlabToBuffer( const InputImageType * input,
+    const InputImageRegionType & slab,
+    std::vector< InputImagePixelType > & buffer ) const;
+
+  /** The threader callback that writes one slab. */
+  static ITK_THREAD_RETURN_TYPE WriteSlabThreaderCallback( void * arg );
+
+  /** The slab that is written by the writer thread. */
+  struct WriteSlabStruct
+  {
+    ImageIOBase *                              st_ImageIO;
+    ImageIORegion                              st_IORegion;
+    const std::vector< InputImagePixelType > * st_Buffer;
+    bool                                       st_Failed;
+    std::string                                st_ErrorMessage;
+  };
+
+private:
+
+  SlabStreamingImageFileWriter( const Self & ); // purposely not implemented
+  void operator=( const Self & );               // purposely not implemented
+
+  std::string            m_FileName;
+  ImageIOBase::Pointer   m_ImageIO;
+  unsigned int           m_NumberOfSlabs;
+  unsigned int           m_NumberOfWrittenSlabs;
+  bool                   m_UseCompression;
+  MultiThreader::Pointer m_WriterThreader;
+
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkSlabStreamingImageFileWriter.hxx"
+#endif
+
+#endif // end #ifndef __itkSlabStreamingImageFileWriter_h
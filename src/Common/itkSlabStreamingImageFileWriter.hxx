@@ -0,0 +1,371 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef _itkSlabStreamingImageFileWriter_hxx
+#define _itkSlabStreamingImageFileWriter_hxx
+
+#include "itkSlabStreamingImageFileWriter.h"
+#include "itkImageIOFactory.h"
+#include "itkImageRegionConstIterator.h"
+#include "vnl/vnl_vector.h"
+#include <algorithm>
+#include <sstream>
+
+namespace itk
+{
+
+/**
+ * ********************* Constructor ****************************
+ */
+
+template< class TInputImage >
+SlabStreamingImageFileWriter< TInputImage >
+::SlabStreamingImageFileWriter()
+{
+  this->m_FileName             = "";
+  this->m_ImageIO              = 0;
+  this->m_NumberOfSlabs        = 8;
+  this->m_NumberOfWrittenSlabs = 0;
+  this->m_UseCompression       = false;
+  this->m_WriterThreader       = MultiThreader::New();
+
+  this->SetNumberOfRequiredInputs( 1 );
+
+} // end Constructor
+
+
+/**
+ * ********************* SetInput ****************************
+ */
+
+template< class TInputImage >
+void
+SlabStreamingImageFileWriter< TInputImage >
+::SetInput( const InputImageType * input )
+{
+  this->ProcessObject::SetNthInput( 0, const_cast< InputImageType * >( input ) );
+
+} // end SetInput()
+
+
+/**
+ * ********************* GetInput ****************************
+ */
+
+template< class TInputImage >
+const typename SlabStreamingImageFileWriter< TInputImage >::InputImageType *
+SlabStreamingImageFileWriter< TInputImage >
+::GetInput( void )
+{
+  return static_cast< const InputImageType * >( this->ProcessObject::GetInput( 0 ) );
+
+} // end GetInput()
+
+
+/**
+ * ********************* Write ****************************
+ */
+
+template< class TInputImage >
+void
+SlabStreamingImageFileWriter< TInputImage >
+::Write( void )
+{
+  /** Sanity checks. */
+  const InputImageType * input = this->GetInput();
+  if( input == NULL )
+  {
+    itkExceptionMacro( << "No input to writer!" );
+  }
+  if( this->m_FileName == "" )
+  {
+    itkExceptionMacro( << "No filename was specified" );
+  }
+
+  /** Create the ImageIO, if the user did not specify one. */
+  ImageIOBase::Pointer imageIO = this->m_ImageIO;
+  if( imageIO.IsNull() )
+  {
+    imageIO = ImageIOFactory::CreateImageIO(
+      this->m_FileName.c_str(), ImageIOFactory::WriteMode );
+  }
+  if( imageIO.IsNull() )
+  {
+    itkExceptionMacro( << "Could not create IO object for writing file "
+                       << this->m_FileName );
+  }
+
+  this->InvokeEvent( StartEvent() );
+  this->UpdateProgress( 0.0f );
+
+  /** Set up the ImageIO with the image information of the input. */
+  InputImageType * nonConstInput = const_cast< InputImageType * >( input );
+  nonConstInput->UpdateOutputInformation();
+  const InputImageRegionType largestRegion = input->GetLargestPossibleRegion();
+  this->InitializeImageIO( imageIO, input );
+
+  ImageIORegion largestIORegion( InputImageDimension );
+  ImageIORegionAdaptor< InputImageDimension >::Convert(
+    largestRegion, largestIORegion, largestRegion.GetIndex() );
+
+  /** Let the ImageIO determine the slabs, like the ImageFileWriter does. */
+  unsigned int numberOfSlabs = 1;
+  if( this->m_NumberOfSlabs > 1 && imageIO->CanStreamWrite() )
+  {
+    imageIO->SetUseStreamedWriting( true );
+    numberOfSlabs = imageIO->GetActualNumberOfSplitsForWriting(
+      this->m_NumberOfSlabs, largestIORegion, largestIORegion );
+  }
+  else
+  {
+    imageIO->SetUseStreamedWriting( false );
+  }
+  imageIO->SetIORegion( largestIORegion );
+
+  std::vector< ImageIORegion > ioRegions( numberOfSlabs, largestIORegion );
+  if( numberOfSlabs > 1 )
+  {
+    for( unsigned int slab = 0; slab < numberOfSlabs; ++slab )
+    {
+      ioRegions[ slab ] = imageIO->GetSplitRegionForWriting(
+        slab, numberOfSlabs, largestIORegion, largestIORegion );
+    }
+  }
+
+  /** Generate the slabs in the main thread, and write them in a separate
+   * thread. Two buffers are used, so that slab i + 1 can be generated and
+   * copied while slab i is being written.
+   */
+  std::vector< InputImagePixelType > buffers[ 2 ];
+  WriteSlabStruct                    writeSlab;
+  writeSlab.st_ImageIO = imageIO.GetPointer();
+  writeSlab.st_Buffer  = NULL;
+  writeSlab.st_Failed  = false;
+
+  bool         writerIsRunning = false;
+  ThreadIdType writerThreadId  = 0;
+  unsigned int slab            = 0;
+  try
+  {
+    for( slab = 0; slab < numberOfSlabs && !this->GetAbortGenerateData(); ++slab )
+    {
+      /** Update the upstream pipeline for this slab only. */
+      InputImageRegionType slabRegion;
+      ImageIORegionAdaptor< InputImageDimension >::Convert(
+        ioRegions[ slab ], slabRegion, largestRegion.GetIndex() );
+      nonConstInput->SetRequestedRegion( slabRegion );
+      nonConstInput->PropagateRequestedRegion();
+      nonConstInput->UpdateOutputData();
+
+      std::vector< InputImagePixelType > & buffer = buffers[ slab % 2 ];
+      this->CopySlabToBuffer( input, slabRegion, buffer );
+
+      /** Wait until the previous slab is written. */
+      if( writerIsRunning )
+      {
+        this->m_WriterThreader->TerminateThread( writerThreadId );
+        writerIsRunning = false;
+        if( writeSlab.st_Failed ) { break; }
+        this->UpdateProgress( static_cast< float >( slab )
+          / static_cast< float >( numberOfSlabs ) );
+      }
+
+      /** Write this slab in the background. */
+      writeSlab.st_IORegion = ioRegions[ slab ];
+      writeSlab.st_Buffer   = &buffer;
+      writerThreadId        = this->m_WriterThreader->SpawnThread(
+        this->WriteSlabThreaderCallback, &writeSlab );
+      writerIsRunning = true;
+    }
+  }
+  catch( ... )
+  {
+    /** Do not leave the writer thread behind. */
+    if( writerIsRunning )
+    {
+      this->m_WriterThreader->TerminateThread( writerThreadId );
+    }
+    throw;
+  }
+
+  /** Wait for the last slab. */
+  if( writerIsRunning )
+  {
+    this->m_WriterThreader->TerminateThread( writerThreadId );
+  }
+  this->m_NumberOfWrittenSlabs = slab;
+
+  if( writeSlab.st_Failed )
+  {
+    itkExceptionMacro( << "Error while writing " << this->m_FileName
+                       << ":\n" << writeSlab.st_ErrorMessage );
+  }
+
+  /** Stopped on an abort request: the file is incomplete, so do not
+   * report success, but throw like ProcessObject::UpdateOutputData does.
+   */
+  if( slab < numberOfSlabs )
+  {
+    this->SetAbortGenerateData( false );
+    ProcessAborted e( __FILE__, __LINE__ );
+    std::ostringstream message;
+    message << "Writing " << this->m_FileName << " was aborted after "
+            << slab << " of " << numberOfSlabs << " slabs; the file is incomplete.";
+    e.SetDescription( message.str() );
+    e.SetLocation( ITK_LOCATION );
+    throw e;
+  }
+
+  this->UpdateProgress( 1.0f );
+  this->InvokeEvent( EndEvent() );
+
+  /** Release upstream data if requested. */
+  if( input->ShouldIReleaseData() )
+  {
+    nonConstInput->ReleaseData();
+  }
+
+} // end Write()
+
+
+/**
+ * ********************* InitializeImageIO ****************************
+ */
+
+template< class TInputImage >
+void
+SlabStreamingImageFileWriter< TInputImage >
+::InitializeImageIO( ImageIOBase * imageIO, const InputImageType * input ) const
+{
+  /** The origin is the physical point of the start of the largest region. */
+  const InputImageRegionType largestRegion = input->GetLargestPossibleRegion();
+  InputImagePointType        origin;
+  input->TransformIndexToPhysicalPoint( largestRegion.GetIndex(), origin );
+
+  imageIO->SetNumberOfDimensions( InputImageDimension );
+  for( unsigned int i = 0; i < InputImageDimension; ++i )
+  {
+    imageIO->SetDimensions( i, largestRegion.GetSize( i ) );
+    imageIO->SetSpacing( i, input->GetSpacing()[ i ] );
+    imageIO->SetOrigin( i, origin[ i ] );
+
+    vnl_vector< double > axisDirection( InputImageDimension );
+    for( unsigned int j = 0; j < InputImageDimension; ++j )
+    {
+      axisDirection[ j ] = input->GetDirection()[ j ][ i ];
+    }
+    imageIO->SetDirection( i, axisDirection );
+  }
+
+  imageIO->SetPixelTypeInfo( static_cast< const InputImagePixelType * >( 0 ) );
+  imageIO->SetUseCompression( this->m_UseCompression );
+  imageIO->SetFileName( this->m_FileName.c_str() );
+  imageIO->SetMetaDataDictionary( input->GetMetaDataDictionary() );
+
+} // end InitializeImageIO()
+
+
+/**
+ * ********************* CopySlabToBuffer ****************************
+ */
+
+template< class TInputImage >
+void
+SlabStreamingImageFileWriter< TInputImage >
+::CopySlabToBuffer( const InputImageType * input,
+  const InputImageRegionType & slab,
+  std::vector< InputImagePixelType > & buffer ) const
+{
+  buffer.resize( slab.GetNumberOfPixels() );
+
+  /** Usually the pipeline generated exactly the slab. */
+  if( input->GetBufferedRegion() == slab )
+  {
+    const InputImagePixelType * begin = input->GetBufferPointer();
+    std::copy( begin, begin + buffer.size(), buffer.begin() );
+    return;
+  }
+
+  /** Otherwise, extract the slab from the buffered region. */
+  ImageRegionConstIterator< InputImageType > it( input, slab );
+  typename std::vector< InputImagePixelType >::iterator out = buffer.begin();
+  for( it.GoToBegin(); !it.IsAtEnd(); ++it, ++out )
+  {
+    *out = it.Get();
+  }
+
+} // end CopySlabToBuffer()
+
+
+/**
+ * ********************* WriteSlabThreaderCallback ****************************
+ */
+
+template< class TInputImage >
+ITK_THREAD_RETURN_TYPE
+SlabStreamingImageFileWriter< TInputImage >
+::WriteSlabThreaderCallback( void * arg )
+{
+  MultiThreader::ThreadInfoStruct * infoStruct
+    = static_cast< MultiThreader::ThreadInfoStruct * >( arg );
+  WriteSlabStruct * writeSlab = static_cast< WriteSlabStruct * >( infoStruct->UserData );
+
+  /** Exceptions can not cross the thread boundary, so store the message. */
+  try
+  {
+    writeSlab->st_ImageIO->SetIORegion( writeSlab->st_IORegion );
+    writeSlab->st_ImageIO->Write( &( *writeSlab->st_Buffer )[ 0 ] );
+  }
+  catch( ExceptionObject & excp )
+  {
+    writeSlab->st_Failed       = true;
+    writeSlab->st_ErrorMessage = excp.GetDescription();
+  }
+  catch( std::exception & excp )
+  {
+    writeSlab->st_Failed       = true;
+    writeSlab->st_ErrorMessage = excp.what();
+  }
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end WriteSlabThreaderCallback()
+
+
+/**
+ * ********************* PrintSelf ****************************
+ */
+
+template< class TInputImage >
+void
+SlabStreamingImageFileWriter< TInputImage >
+::PrintSelf( std::ostream & os, Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "FileName: " << this->m_FileName << std::endl;
+  os << indent << "ImageIO: " << this->m_ImageIO.GetPointer() << std::endl;
+  os << indent << "NumberOfSlabs: " << this->m_NumberOfSlabs << std::endl;
+  os << indent << "NumberOfWrittenSlabs: " << this->m_NumberOfWrittenSlabs << std::endl;
+  os << indent << "UseCompression: " << this->m_UseCompression << std::endl;
+
+} // end PrintSelf()
+
+
+} // end namespace itk
+
+#endif // end #ifndef _itkSlabStreamingImageFileWriter_hxx
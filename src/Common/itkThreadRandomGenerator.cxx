@@ -0,0 +1,102 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkThreadRandomGenerator_cxx
+#define __itkThreadRandomGenerator_cxx
+
+#include "itkThreadRandomGenerator.h"
+#include "itkSimpleFastMutexLock.h"
+
+/** Thread-local storage; a plain pointer needs no construction. */
+#if defined( _MSC_VER )
+#define ITK_THREAD_RANDOM_GENERATOR_THREAD_LOCAL __declspec( thread )
+#else
+#define ITK_THREAD_RANDOM_GENERATOR_THREAD_LOCAL __thread
+#endif
+
+namespace itk
+{
+
+/** The generator of the calling thread, see SetThreadInstance(). */
+static ITK_THREAD_RANDOM_GENERATOR_THREAD_LOCAL
+ThreadRandomGenerator::GeneratorType * s_ThreadInstance = NULL;
+
+/** Serialises the creation of generators, see New(). */
+static SimpleFastMutexLock s_NewMutex;
+
+/**
+ * ****************** SetThreadInstance *********************************
+ */
+
+void
+ThreadRandomGenerator
+::SetThreadInstance( GeneratorType * generator )
+{
+  s_ThreadInstance = generator;
+
+} // end SetThreadInstance()
+
+
+/**
+ * ****************** GetThreadInstance *********************************
+ */
+
+ThreadRandomGenerator::GeneratorType *
+ThreadRandomGenerator
+::GetThreadInstance( void )
+{
+  return s_ThreadInstance;
+
+} // end GetThreadInstance()
+
+
+/**
+ * ****************** GetInstance *********************************
+ */
+
+ThreadRandomGenerator::GeneratorPointer
+ThreadRandomGenerator
+::GetInstance( void )
+{
+  if( s_ThreadInstance != NULL )
+  {
+    return s_ThreadInstance;
+  }
+  return GeneratorType::GetInstance();
+
+} // end GetInstance()
+
+
+/**
+ * ****************** New *********************************
+ */
+
+ThreadRandomGenerator::GeneratorPointer
+ThreadRandomGenerator
+::New( void )
+{
+  s_NewMutex.Lock();
+  GeneratorPointer generator = GeneratorType::New();
+  s_NewMutex.Unlock();
+  return generator;
+
+} // end New()
+
+
+} // end namespace itk
+
+#endif // end #ifndef __itkThreadRandomGenerator_cxx
@@ -0,0 +1,83 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkThreadRandomGenerator_h
+#define __itkThreadRandomGenerator_h
+
+#include "itkMersenneTwisterRandomVariateGenerator.h"
+
+namespace itk
+{
+
+/** \class ThreadRandomGenerator
+ *
+ * \brief Gives the random generator of the calling thread.
+ *
+ * The samplers, the optimizers and some metrics draw their random numbers
+ * from the global MersenneTwisterRandomVariateGenerator, which elastix seeds
+ * with the RandomSeed parameter. Registrations that run concurrently in one
+ * process would share, and re-seed, that one generator, so that their
+ * results would depend on each other and on the timing of the threads.
+ *
+ * A generator that is set as the thread instance overrides the global one
+ * in that thread. elastix::ElastixContext::Activate() installs the generator
+ * of the context in the calling thread and in the workers of its pool.
+ * Components call GetInstance() of this class instead of the one of the
+ * MersenneTwister, and then draw from the generator of their registration.
+ *
+ * \ingroup Common
+ */
+
+class ThreadRandomGenerator
+{
+public:
+
+  /** Typedefs. */
+  typedef ThreadRandomGenerator                             Self;
+  typedef Statistics::MersenneTwisterRandomVariateGenerator GeneratorType;
+  typedef GeneratorType::Pointer                            GeneratorPointer;
+
+  /** Set/Get the generator of the calling thread. The caller keeps
+   * ownership; pass NULL to use the global generator again.
+   */
+  static void SetThreadInstance( GeneratorType * generator );
+  static GeneratorType * GetThreadInstance( void );
+
+  /** Get the thread instance or, when there is none, the global instance
+   * of the MersenneTwisterRandomVariateGenerator.
+   */
+  static GeneratorPointer GetInstance( void );
+
+  /** Create a new generator. MersenneTwisterRandomVariateGenerator::New()
+   * draws the seed of the new generator from the global instance; this
+   * method serialises that access, so that registrations in several threads
+   * can create generators. Seed the result with Initialize() to make it
+   * independent of the global instance.
+   */
+  static GeneratorPointer New( void );
+
+private:
+
+  ThreadRandomGenerator();               // purposely not implemented
+  ThreadRandomGenerator( const Self & ); // purposely not implemented
+  void operator=( const Self & );        // purposely not implemented
+
+};
+
+} // end namespace itk
+
+#endif // end #ifndef __itkThreadRandomGenerator_h
@@ -20,6 +20,7 @@
 #define __itkTransformixInputPointFileReader_h
 
 #include "itkMeshFileReaderBase.h"
+#include "itkIntTypes.h"
 
 #include <fstream>
 
@@ -40,6 +41,13 @@ namespace itk
  *
  * The second word in the text file represents the number of points that
  * should be read.
+ *
+ * For large point sets the file may also be in a binary format, which is
+ * recognised by its signature. It consists of the 8 characters "ELXPOINT",
+ * followed by the point dimension (uint32), a flag that indicates whether
+ * the points are indices (uint32, 0 or 1), the number of points (uint64),
+ * and then the coordinates of all points as doubles, point after point.
+ * All numbers are stored in the native byte order.
  **/
 
 template< class TOutputMesh >
@@ -69,6 +77,12 @@ public:
    */
   itkGetConstMacro( PointsAreIndices, bool );
 
+  /** Get whether the file is in the binary point format. */
+  itkGetConstMacro( PointsAreBinary, bool );
+
+  /** Get the signature at the start of a binary point file. */
+  static const char * GetBinaryPointFileSignature( void ) { return "ELXPOINT"; }
+
   /** Get the number of points that are defined in the file.
    * In fact we also should store this somehow in the output dataobject,
    * but that would mean resizing the point container, while still filled with
@@ -97,6 +111,7 @@ protected:
 
   unsigned long m_NumberOfPoints;
   bool          m_PointsAreIndices;
+  bool          m_PointsAreBinary;
 
   std::ifstream m_Reader;
 
@@ -20,6 +20,8 @@
 #define __itkTransformixInputPointFileReader_hxx
 
 #include "itkTransformixInputPointFileReader.h"
+#include <algorithm>
+#include <vector>
 
 namespace itk
 {
@@ -34,6 +36,7 @@ TransformixInputPointFileReader< TOutputMesh >
 {
   this->m_NumberOfPoints   = 0;
   this->m_PointsAreIndices = false;
+  this->m_PointsAreBinary  = false;
 } // end constructor
 
 
@@ -69,7 +72,41 @@ TransformixInputPointFileReader< TOutputMesh >
   {
     this->m_Reader.close();
   }
-  this->m_Reader.open( this->m_FileName.c_str() );
+  this->m_Reader.open( this->m_FileName.c_str(), std::ios::in | std::ios::binary );
+
+  /** Check for the signature of the binary format. */
+  const std::string signature = GetBinaryPointFileSignature();
+  std::string       firstBytes( signature.size(), ' ' );
+  this->m_Reader.read( &firstBytes[ 0 ], signature.size() );
+  if( this->m_Reader.gcount() == static_cast< std::streamsize >( signature.size() )
+    && firstBytes == signature )
+  {
+    uint32_t dimension        = 0;
+    uint32_t pointsAreIndices = 0;
+    uint64_t numberOfPoints   = 0;
+    this->m_Reader.read( reinterpret_cast< char * >( &dimension ), sizeof( dimension ) );
+    this->m_Reader.read( reinterpret_cast< char * >( &pointsAreIndices ), sizeof( pointsAreIndices ) );
+    this->m_Reader.read( reinterpret_cast< char * >( &numberOfPoints ), sizeof( numberOfPoints ) );
+    if( !this->m_Reader || dimension != OutputMeshType::PointDimension )
+    {
+      std::ostringstream msg;
+      msg << "The header of the binary point file is invalid, or the "
+          << "dimension of the points is not " << OutputMeshType::PointDimension
+          << "." << std::endl << "Filename: " << this->m_FileName << std::endl;
+      MeshFileReaderException e( __FILE__, __LINE__, msg.str().c_str(), ITK_LOCATION );
+      throw e;
+    }
+
+    this->m_PointsAreBinary  = true;
+    this->m_PointsAreIndices = ( pointsAreIndices != 0 );
+    this->m_NumberOfPoints   = static_cast< unsigned long >( numberOfPoints );
+    return;
+  }
+
+  /** It is a text file, so start again. */
+  this->m_PointsAreBinary = false;
+  this->m_Reader.clear();
+  this->m_Reader.seekg( 0 );
 
   /** Read the first entry */
   std::string indexOrPoint;
@@ -118,7 +155,42 @@ TransformixInputPointFileReader< TOutputMesh >
   PointsContainerPointer points = PointsContainerType::New();
 
   /** Read the file */
-  if( this->m_Reader.is_open() )
+  if( this->m_Reader.is_open() && this->m_PointsAreBinary )
+  {
+    /** Read the coordinates in chunks of points. */
+    const unsigned long  chunkSize = 4096;
+    std::vector< double > buffer( chunkSize * dimension );
+    if( this->m_NumberOfPoints > 0 )
+    {
+      points->Reserve( this->m_NumberOfPoints );
+    }
+    for( unsigned long first = 0; first < this->m_NumberOfPoints; first += chunkSize )
+    {
+      const unsigned long n = std::min( chunkSize, this->m_NumberOfPoints - first );
+      this->m_Reader.read( reinterpret_cast< char * >( &buffer[ 0 ] ),
+        n * dimension * sizeof( double ) );
+      if( !this->m_Reader )
+      {
+        std::ostringstream msg;
+        msg << "The file is not large enough. "
+            << std::endl << "Filename: " << this->m_FileName
+            << std::endl;
+        MeshFileReaderException e( __FILE__, __LINE__, msg.str().c_str(), ITK_LOCATION );
+        throw e;
+      }
+
+      for( unsigned long i = 0; i < n; ++i )
+      {
+        PointType point;
+        for( unsigned int j = 0; j < dimension; j++ )
+        {
+          point[ j ] = buffer[ i * dimension + j ];
+        }
+        points->SetElement( first + i, point );
+      }
+    }
+  }
+  else if( this->m_Reader.is_open() )
   {
     for( unsigned int i = 0; i < this->m_NumberOfPoints; ++i )
     {
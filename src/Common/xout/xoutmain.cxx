@@ -20,14 +20,22 @@
 
 #include "xoutmain.h"
 
+/** Thread-local storage; a plain pointer needs no construction. */
+#if defined( _MSC_VER )
+#define XOUT_THREAD_LOCAL __declspec( thread )
+#else
+#define XOUT_THREAD_LOCAL __thread
+#endif
+
 namespace xoutlibrary
 {
-static xoutbase_type * local_xout = 0;
+static xoutbase_type *                   local_xout  = 0;
+static XOUT_THREAD_LOCAL xoutbase_type * thread_xout = 0;
 
 xoutbase_type &
 get_xout( void )
 {
-  return *local_xout;
+  return thread_xout ? *thread_xout : *local_xout;
 }
 
 
@@ -38,6 +46,20 @@ set_xout( xoutbase_type * arg )
 }
 
 
+void
+set_thread_xout( xoutbase_type * arg )
+{
+  thread_xout = arg;
+}
+
+
+xoutbase_type *
+get_thread_xout( void )
+{
+  return thread_xout;
+}
+
+
 } // end namespace
 
 #endif // end #ifndef __xoutmain_cxx
@@ -37,10 +37,23 @@ typedef xoutsimple< char > xoutsimple_type;
 typedef xoutrow< char >    xoutrow_type;
 typedef xoutcell< char >   xoutcell_type;
 
+/** Get the xout of the calling thread; that is the one set by
+ * set_thread_xout(), or else the one set by set_xout().
+ */
 xoutbase_type & get_xout( void );
 
+/** Set the process-wide xout. */
 void set_xout( xoutbase_type * arg );
 
+/** Set the xout of the calling thread only, so that registrations that run
+ * concurrently in different threads can log to different outputs. Pass 0
+ * to use the process-wide xout again.
+ */
+void set_thread_xout( xoutbase_type * arg );
+
+/** Get the xout set by set_thread_xout() in the calling thread, or 0. */
+xoutbase_type * get_thread_xout( void );
+
 } // end namespace xoutlibrary
 
 #endif // end #ifndef __xoutmain_h
@@ -65,6 +65,12 @@ namespace elastix
  *    for rescaling the image, or the ResampleImageFilter. Skrinker is faster.\n
  *    example: <tt>(ImagePyramidUseShrinkImageFilter "true")</tt>\n
  *    Default false, so by default the resampler is used.
+ * \parameter ImagePyramidComputeFromPreviousLevel: Flag to specify if each resolution level is
+ *    computed from the next finer level instead of from the full resolution image, when the
+ *    schedules allow it. Faster for large images, but gives slightly different pyramid images.
+ *    Ignored if ComputePyramidImagesPerResolution is true.\n
+ *    example: <tt>(ImagePyramidComputeFromPreviousLevel "true")</tt>\n
+ *    Default false.
  *
  * \ingroup ImagePyramids
  */
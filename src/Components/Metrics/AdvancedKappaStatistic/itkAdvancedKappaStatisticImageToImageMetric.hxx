@@ -643,8 +643,8 @@ AdvancedKappaStatisticImageToImageMetric< TFixedImage, TMovingImage >
     temp->st_Coefficient2      = tmp2;
     temp->st_DerivativePointer = derivative.begin();
 
-    this->m_Threader->SetSingleMethod( AccumulateDerivativesThreaderCallback, temp );
-    this->m_Threader->SingleMethodExecute();
+    PersistentThreadPool::SingleMethodExecute( this->m_Threader,
+      AccumulateDerivativesThreaderCallback, temp );
 
     delete temp;
   }
@@ -91,6 +91,12 @@ namespace elastix
  *    B-spline grids.
  *    example: <tt>(UseFastAndLowMemoryVersion "false")</tt> \n
  *    The default is "true".
+ * \parameter UseSparsePerThreadJointPDFs: Whether each thread only clears and
+ *    merges the joint histogram bins it actually used. This makes the merge of
+ *    the per-thread joint histograms cheaper for large histograms, many threads
+ *    and few samples.\n
+ *    example: <tt>(UseSparsePerThreadJointPDFs "true")</tt> \n
+ *    The default is "false". Can be given for each resolution, or for all resolutions at once.
  *
  * \sa ParzenWindowMutualInformationImageToImageMetric
  * \ingroup Metrics
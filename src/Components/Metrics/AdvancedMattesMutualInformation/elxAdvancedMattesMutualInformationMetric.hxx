@@ -125,6 +125,12 @@ AdvancedMattesMutualInformationMetric< TElastix >
     "UseFastAndLowMemoryVersion", this->GetComponentLabel(), level, 0 );
   this->SetUseExplicitPDFDerivatives( !useFastAndLowMemoryVersion );
 
+  /** Set whether the threads should only clear and merge the touched bins. */
+  bool useSparsePerThreadJointPDFs = false;
+  this->GetConfiguration()->ReadParameter( useSparsePerThreadJointPDFs,
+    "UseSparsePerThreadJointPDFs", this->GetComponentLabel(), level, 0 );
+  this->SetUseSparsePerThreadJointPDFs( useSparsePerThreadJointPDFs );
+
   /** Set whether to use Nick Tustison's preconditioning technique. */
   bool useJacobianPreconditioning = false;
   this->GetConfiguration()->ReadParameter( useJacobianPreconditioning,
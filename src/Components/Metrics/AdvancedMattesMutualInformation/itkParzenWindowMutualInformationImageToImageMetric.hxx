@@ -465,104 +465,104 @@ ParzenWindowMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
   }
 
   /** Get a handle to the sample container. */
-  ImageSampleContainerPointer sampleContainer     = this->GetImageSampler()->GetOutput();
-  const unsigned long         sampleContainerSize = sampleContainer->Size();
-
-  /** Get the samples for this thread. */
-  const unsigned long nrOfSamplesPerThreads
-    = static_cast< unsigned long >( vcl_ceil( static_cast< double >( sampleContainerSize )
-    / static_cast< double >( this->m_NumberOfThreads ) ) );
-
-  unsigned long pos_begin = nrOfSamplesPerThreads * threadId;
-  unsigned long pos_end   = nrOfSamplesPerThreads * ( threadId + 1 );
-  pos_begin = ( pos_begin > sampleContainerSize ) ? sampleContainerSize : pos_begin;
-  pos_end   = ( pos_end > sampleContainerSize ) ? sampleContainerSize : pos_end;
-
-  /** Create iterator over the sample container. */
-  typename ImageSampleContainerType::ConstIterator fiter;
-  typename ImageSampleContainerType::ConstIterator fbegin = sampleContainer->Begin();
-  typename ImageSampleContainerType::ConstIterator fend   = sampleContainer->Begin();
-  fbegin                                                 += (int)pos_begin;
-  fend                                                   += (int)pos_end;
+  ImageSampleContainerPointer sampleContainer = this->GetImageSampler()->GetOutput();
 
-  /** Loop over sample container and compute contribution of each sample to pdfs. */
-  for( fiter = fbegin; fiter != fend; ++fiter )
+  /** Loop over the blocks of samples assigned to this thread. */
+  SizeValueType pos_begin = 0;
+  SizeValueType pos_end   = 0;
+  while( this->GetNextSampleBlock( threadId, pos_begin, pos_end ) )
   {
-    /** Read fixed coordinates and create some variables. */
-    const FixedImagePointType & fixedPoint = ( *fiter ).Value().m_ImageCoordinates;
-    RealType                    movingImageValue;
-    MovingImageDerivativeType   movingImageDerivative;
-    MovingImagePointType        mappedPoint;
+    /** Create iterator over the sample container. */
+    typename ImageSampleContainerType::ConstIterator fiter;
+    typename ImageSampleContainerType::ConstIterator fbegin = sampleContainer->Begin();
+    typename ImageSampleContainerType::ConstIterator fend   = sampleContainer->Begin();
+    fbegin += (int)pos_begin;
+    fend   += (int)pos_end;
+
+    /** Loop over sample container and compute contribution of each sample to pdfs. */
+    for( fiter = fbegin; fiter != fend; ++fiter )
+    {
+      /** Read fixed coordinates and create some variables. */
+      const FixedImagePointType & fixedPoint = ( *fiter ).Value().m_ImageCoordinates;
+      RealType                    movingImageValue;
+      MovingImageDerivativeType   movingImageDerivative;
+      MovingImagePointType        mappedPoint;
 
-    /** Transform point and check if it is inside the B-spline support region. */
-    bool sampleOk = this->TransformPoint( fixedPoint, mappedPoint );
+      /** Transform point and check if it is inside the B-spline support region. */
+      bool sampleOk = this->TransformPointOfSample( threadId, fiter.Index(), fixedPoint, mappedPoint );
 
-    /** Check if the point is inside the moving mask. */
-    if( sampleOk )
-    {
-      sampleOk = this->IsInsideMovingMask( mappedPoint );
-    }
+      /** Check if the point is inside the moving mask. */
+      if( sampleOk )
+      {
+        sampleOk = this->IsInsideMovingMask( mappedPoint );
+      }
 
-    /** Compute the moving image value, its derivative, and check
-     * if the point is inside the moving image buffer.
-     */
-    if( sampleOk )
-    {
-      sampleOk = this->EvaluateMovingImageValueAndDerivative(
-        mappedPoint, movingImageValue, &movingImageDerivative );
-    }
+      /** Compute the moving image value, its derivative, and check
+       * if the point is inside the moving image buffer.
+       */
+      if( sampleOk )
+      {
+        sampleOk = this->EvaluateMovingImageValueAndDerivative(
+          mappedPoint, movingImageValue, &movingImageDerivative );
+      }
 
-    if( sampleOk )
-    {
-      /** Get the fixed image value. */
-      RealType fixedImageValue = static_cast< RealType >( ( *fiter ).Value().m_ImageValue );
+      if( sampleOk )
+      {
+        /** Get the fixed image value. */
+        RealType fixedImageValue = static_cast< RealType >( ( *fiter ).Value().m_ImageValue );
 
-      /** Make sure the values fall within the histogram range. */
-      fixedImageValue  = this->GetFixedImageLimiter()->Evaluate( fixedImageValue );
-      movingImageValue = this->GetMovingImageLimiter()
-        ->Evaluate( movingImageValue, movingImageDerivative );
+        /** Make sure the values fall within the histogram range. */
+        fixedImageValue  = this->GetFixedImageLimiter()->Evaluate( fixedImageValue );
+        movingImageValue = this->GetMovingImageLimiter()
+          ->Evaluate( movingImageValue, movingImageDerivative );
 
 #if 0
-      /** Get the TransformJacobian dT/dmu. */
-      this->EvaluateTransformJacobian( fixedPoint, jacobian, nzji );
+        /** Get the TransformJacobian dT/dmu. */
+        this->EvaluateTransformJacobian( fixedPoint, jacobian, nzji );
 
-      /** Compute the inner products (dM/dx)^T (dT/dmu). */
-      this->EvaluateTransformJacobianInnerProduct(
-        jacobian, movingImageDerivative, imageJacobian );
+        /** Compute the inner products (dM/dx)^T (dT/dmu). */
+        this->EvaluateTransformJacobianInnerProduct(
+          jacobian, movingImageDerivative, imageJacobian );
 #else
-      /** Compute the inner product of the transform Jacobian dT/dmu and the moving image gradient dM/dx. */
-      this->m_AdvancedTransform->EvaluateJacobianWithImageGradientProduct(
-        fixedPoint, movingImageDerivative, imageJacobian, nzji );
+        /** Compute the inner product of the transform Jacobian dT/dmu and the moving image gradient dM/dx. */
+        if( !this->EvaluateTransformJacobianInnerProductOfSample( threadId, fiter.Index(),
+          fixedPoint, movingImageDerivative, imageJacobian, nzji ) )
+        {
+          this->m_AdvancedTransform->EvaluateJacobianWithImageGradientProduct(
+            fixedPoint, movingImageDerivative, imageJacobian, nzji );
+        }
 #endif
 
-      /** If desired, apply the technique introduced by Tustison. */
-      TransformJacobianType jacobian;
-      if( this->GetUseJacobianPreconditioning() )
-      {
-        this->EvaluateTransformJacobian( fixedPoint, jacobian, nzji );
-
-        this->ComputeJacobianPreconditioner( jacobian, nzji,
-          jacobianPreconditioner, preconditioningDivisor );
-        DerivativeValueType * imjacit   = imageJacobian.begin();
-        DerivativeValueType * jacprecit = jacobianPreconditioner.begin();
-        for( unsigned int i = 0; i < nzji.size(); ++i )
+        /** If desired, apply the technique introduced by Tustison. */
+        TransformJacobianType jacobian;
+        if( this->GetUseJacobianPreconditioning() )
         {
-          while( imjacit != imageJacobian.end() )
+          this->EvaluateTransformJacobian( fixedPoint, jacobian, nzji );
+
+          this->ComputeJacobianPreconditioner( jacobian, nzji,
+            jacobianPreconditioner, preconditioningDivisor );
+          DerivativeValueType * imjacit   = imageJacobian.begin();
+          DerivativeValueType * jacprecit = jacobianPreconditioner.begin();
+          for( unsigned int i = 0; i < nzji.size(); ++i )
           {
-            ( *imjacit ) *= ( *jacprecit );
-            ++imjacit;
-            ++jacprecit;
+            while( imjacit != imageJacobian.end() )
+            {
+              ( *imjacit ) *= ( *jacprecit );
+              ++imjacit;
+              ++jacprecit;
+            }
           }
         }
-      }
 
-      /** Compute this sample's contribution to the joint distributions. */
-      this->UpdateDerivativeLowMemory(
-        fixedImageValue, movingImageValue, imageJacobian, nzji,
-        derivative );
+        /** Compute this sample's contribution to the joint distributions. */
+        this->UpdateDerivativeLowMemory(
+          fixedImageValue, movingImageValue, imageJacobian, nzji,
+          derivative );
 
-    } // end sampleOk
-  }   // end loop over sample container
+      } // end sampleOk
+    }   // end loop over sample container
+
+  } // end while loop over the sample blocks
 
   /** If desired, apply the technique introduced by Tustison. */
   if( this->GetUseJacobianPreconditioning() )
@@ -628,9 +628,9 @@ ParzenWindowMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
     this->m_ThreaderMetricParameters.st_DerivativePointer   = derivative.begin();
     this->m_ThreaderMetricParameters.st_NormalizationFactor = 1.0;
 
-    this->m_Threader->SetSingleMethod( this->AccumulateDerivativesThreaderCallback,
+    PersistentThreadPool::SingleMethodExecute( this->m_Threader,
+      this->AccumulateDerivativesThreaderCallback,
       const_cast< void * >( static_cast< const void * >( &this->m_ThreaderMetricParameters ) ) );
-    this->m_Threader->SingleMethodExecute();
   }
 
 } // end AfterThreadedComputeDerivativeLowMemory()
@@ -667,13 +667,14 @@ void
 ParzenWindowMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
 ::LaunchComputeDerivativeLowMemoryThreaderCallback( void ) const
 {
-  /** Setup threader. */
-  this->m_Threader->SetSingleMethod( this->ComputeDerivativeLowMemoryThreaderCallback,
-    const_cast< void * >( static_cast< const void * >(
-      &this->m_ParzenWindowMutualInformationThreaderParameters ) ) );
-
-  /** Launch. */
-  this->m_Threader->SingleMethodExecute();
+  /** Distribute the samples over the threads. */
+  this->InitializeSampleBlockScheduler();
+
+  /** Launch, on the shared thread pool when available. */
+  PersistentThreadPool::SingleMethodExecute( this->m_Threader,
+    this->ComputeDerivativeLowMemoryThreaderCallback,
+    const_cast< void * >( static_cast< const void * >( &this->m_ParzenWindowMutualInformationThreaderParameters ) ) );
+  this->FinalizeSampleBlockScheduler();
 
 } // end LaunchComputeDerivativeLowMemoryThreaderCallback()
 
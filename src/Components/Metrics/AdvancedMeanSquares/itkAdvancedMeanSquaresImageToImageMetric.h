@@ -147,6 +147,9 @@ public:
   virtual void GetValueAndDerivative( const TransformParametersType & parameters,
     MeasureType & value, DerivativeType & derivative ) const;
 
+  /** All thread-unsafe work is done in BeforeThreadedGetValueAndDerivative(). */
+  virtual bool GetSupportsConcurrentEvaluation( void ) const { return true; }
+
   /** Experimental feature: compute SelfHessian */
   virtual void GetSelfHessian( const TransformParametersType & parameters, HessianType & H ) const;
 
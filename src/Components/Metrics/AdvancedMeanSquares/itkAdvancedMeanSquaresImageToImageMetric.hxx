@@ -20,7 +20,7 @@
 
 #include "itkAdvancedMeanSquaresImageToImageMetric.h"
 #include "vnl/algo/vnl_matrix_update.h"
-#include "itkMersenneTwisterRandomVariateGenerator.h"
+#include "itkThreadRandomGenerator.h"
 
 #ifdef ELASTIX_USE_OPENMP
 #include <omp.h>
@@ -267,72 +267,67 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
 ::ThreadedGetValue( ThreadIdType threadId )
 {
   /** Get a handle to the sample container. */
-  ImageSampleContainerPointer sampleContainer     = this->GetImageSampler()->GetOutput();
-  const unsigned long         sampleContainerSize = sampleContainer->Size();
-
-  /** Get the samples for this thread. */
-  const unsigned long nrOfSamplesPerThreads
-    = static_cast< unsigned long >( vcl_ceil( static_cast< double >( sampleContainerSize )
-    / static_cast< double >( this->m_NumberOfThreads ) ) );
-
-  unsigned long pos_begin = nrOfSamplesPerThreads * threadId;
-  unsigned long pos_end   = nrOfSamplesPerThreads * ( threadId + 1 );
-  pos_begin = ( pos_begin > sampleContainerSize ) ? sampleContainerSize : pos_begin;
-  pos_end   = ( pos_end > sampleContainerSize ) ? sampleContainerSize : pos_end;
-
-  /** Create iterator over the sample container. */
-  typename ImageSampleContainerType::ConstIterator threader_fiter;
-  typename ImageSampleContainerType::ConstIterator threader_fbegin = sampleContainer->Begin();
-  typename ImageSampleContainerType::ConstIterator threader_fend   = sampleContainer->Begin();
-
-  threader_fbegin += (int)pos_begin;
-  threader_fend   += (int)pos_end;
+  ImageSampleContainerPointer sampleContainer = this->GetImageSampler()->GetOutput();
 
   /** Create variables to store intermediate results. circumvent false sharing */
   unsigned long numberOfPixelsCounted = 0;
   MeasureType   measure               = NumericTraits< MeasureType >::Zero;
 
-  /** Loop over the fixed image to calculate the mean squares. */
-  for( threader_fiter = threader_fbegin; threader_fiter != threader_fend; ++threader_fiter )
+  /** Loop over the blocks of samples assigned to this thread. */
+  SizeValueType pos_begin = 0;
+  SizeValueType pos_end   = 0;
+  while( this->GetNextSampleBlock( threadId, pos_begin, pos_end ) )
   {
-    /** Read fixed coordinates and initialize some variables. */
-    const FixedImagePointType & fixedPoint = ( *threader_fiter ).Value().m_ImageCoordinates;
-    RealType                    movingImageValue;
-    MovingImagePointType        mappedPoint;
+    /** Create iterator over the sample container. */
+    typename ImageSampleContainerType::ConstIterator threader_fiter;
+    typename ImageSampleContainerType::ConstIterator threader_fbegin = sampleContainer->Begin();
+    typename ImageSampleContainerType::ConstIterator threader_fend   = sampleContainer->Begin();
+    threader_fbegin += (int)pos_begin;
+    threader_fend   += (int)pos_end;
+
+    /** Loop over the fixed image to calculate the mean squares. */
+    for( threader_fiter = threader_fbegin; threader_fiter != threader_fend; ++threader_fiter )
+    {
+      /** Read fixed coordinates and initialize some variables. */
+      const FixedImagePointType & fixedPoint = ( *threader_fiter ).Value().m_ImageCoordinates;
+      RealType                    movingImageValue;
+      MovingImagePointType        mappedPoint;
 
-    /** Transform point and check if it is inside the B-spline support region. */
-    bool sampleOk = this->TransformPoint( fixedPoint, mappedPoint );
+      /** Transform point and check if it is inside the B-spline support region. */
+      bool sampleOk = this->TransformPointOfSample( threadId, threader_fiter.Index(), fixedPoint, mappedPoint );
 
-    /** Check if point is inside mask. */
-    if( sampleOk )
-    {
-      sampleOk = this->IsInsideMovingMask( mappedPoint ); // thread-safe?
-    }
+      /** Check if point is inside mask. */
+      if( sampleOk )
+      {
+        sampleOk = this->IsInsideMovingMask( mappedPoint ); // thread-safe?
+      }
 
-    /** Compute the moving image value M(T(x)) and check if
-     * the point is inside the moving image buffer.
-     */
-    if( sampleOk )
-    {
-      sampleOk = this->EvaluateMovingImageValueAndDerivative(
-        mappedPoint, movingImageValue, 0 );
-    }
+      /** Compute the moving image value M(T(x)) and check if
+       * the point is inside the moving image buffer.
+       */
+      if( sampleOk )
+      {
+        sampleOk = this->EvaluateMovingImageValueAndDerivative(
+          mappedPoint, movingImageValue, 0 );
+      }
 
-    if( sampleOk )
-    {
-      numberOfPixelsCounted++;
+      if( sampleOk )
+      {
+        numberOfPixelsCounted++;
 
-      /** Get the fixed image value. */
-      const RealType & fixedImageValue
-        = static_cast< RealType >( ( *threader_fiter ).Value().m_ImageValue );
+        /** Get the fixed image value. */
+        const RealType & fixedImageValue
+          = static_cast< RealType >( ( *threader_fiter ).Value().m_ImageValue );
 
-      /** The difference squared. */
-      const RealType diff = movingImageValue - fixedImageValue;
-      measure += diff * diff;
+        /** The difference squared. */
+        const RealType diff = movingImageValue - fixedImageValue;
+        measure += diff * diff;
 
-    } // end if sampleOk
+      } // end if sampleOk
 
-  } // end for loop over the image sample container
+    } // end for loop over the image sample container
+
+  } // end while loop over the sample blocks
 
   /** Only update these variables at the end to prevent unnecessary "false sharing". */
   this->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_NumberOfPixelsCounted = numberOfPixelsCounted;
@@ -596,88 +591,87 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
   DerivativeType & derivative = this->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_Derivative;
 
   /** Get a handle to the sample container. */
-  ImageSampleContainerPointer sampleContainer     = this->GetImageSampler()->GetOutput();
-  const unsigned long         sampleContainerSize = sampleContainer->Size();
-
-  /** Get the samples for this thread. */
-  const unsigned long nrOfSamplesPerThreads
-    = static_cast< unsigned long >( vcl_ceil( static_cast< double >( sampleContainerSize )
-    / static_cast< double >( this->m_NumberOfThreads ) ) );
-
-  unsigned long pos_begin = nrOfSamplesPerThreads * threadId;
-  unsigned long pos_end   = nrOfSamplesPerThreads * ( threadId + 1 );
-  pos_begin = ( pos_begin > sampleContainerSize ) ? sampleContainerSize : pos_begin;
-  pos_end   = ( pos_end > sampleContainerSize ) ? sampleContainerSize : pos_end;
-
-  /** Create iterator over the sample container. */
-  typename ImageSampleContainerType::ConstIterator threader_fiter;
-  typename ImageSampleContainerType::ConstIterator threader_fbegin = sampleContainer->Begin();
-  typename ImageSampleContainerType::ConstIterator threader_fend   = sampleContainer->Begin();
-
-  threader_fbegin += (int)pos_begin;
-  threader_fend   += (int)pos_end;
+  ImageSampleContainerPointer sampleContainer = this->GetImageSampler()->GetOutput();
 
   /** Create variables to store intermediate results. circumvent false sharing */
   unsigned long numberOfPixelsCounted = 0;
   MeasureType   measure               = NumericTraits< MeasureType >::Zero;
 
-  /** Loop over the fixed image to calculate the mean squares. */
-  for( threader_fiter = threader_fbegin; threader_fiter != threader_fend; ++threader_fiter )
+  /** Loop over the blocks of samples assigned to this thread. */
+  SizeValueType pos_begin = 0;
+  SizeValueType pos_end   = 0;
+  while( this->GetNextSampleBlock( threadId, pos_begin, pos_end ) )
   {
-    /** Read fixed coordinates and initialize some variables. */
-    const FixedImagePointType & fixedPoint = ( *threader_fiter ).Value().m_ImageCoordinates;
-    RealType                    movingImageValue;
-    MovingImagePointType        mappedPoint;
-    MovingImageDerivativeType   movingImageDerivative;
+    /** Create iterator over the sample container. */
+    typename ImageSampleContainerType::ConstIterator threader_fiter;
+    typename ImageSampleContainerType::ConstIterator threader_fbegin = sampleContainer->Begin();
+    typename ImageSampleContainerType::ConstIterator threader_fend   = sampleContainer->Begin();
+    threader_fbegin += (int)pos_begin;
+    threader_fend   += (int)pos_end;
+
+    /** Loop over the fixed image to calculate the mean squares. */
+    for( threader_fiter = threader_fbegin; threader_fiter != threader_fend; ++threader_fiter )
+    {
+      /** Read fixed coordinates and initialize some variables. */
+      const FixedImagePointType & fixedPoint = ( *threader_fiter ).Value().m_ImageCoordinates;
+      RealType                    movingImageValue;
+      MovingImagePointType        mappedPoint;
+      MovingImageDerivativeType   movingImageDerivative;
 
-    /** Transform point and check if it is inside the B-spline support region. */
-    bool sampleOk = this->TransformPoint( fixedPoint, mappedPoint );
+      /** Transform point and check if it is inside the B-spline support region. */
+      bool sampleOk = this->TransformPointOfSample( threadId, threader_fiter.Index(), fixedPoint, mappedPoint );
 
-    /** Check if point is inside mask. */
-    if( sampleOk )
-    {
-      sampleOk = this->IsInsideMovingMask( mappedPoint ); // thread-safe?
-    }
+      /** Check if point is inside mask. */
+      if( sampleOk )
+      {
+        sampleOk = this->IsInsideMovingMask( mappedPoint ); // thread-safe?
+      }
 
-    /** Compute the moving image value M(T(x)) and derivative dM/dx and check if
-     * the point is inside the moving image buffer.
-     */
-    if( sampleOk )
-    {
-      sampleOk = this->EvaluateMovingImageValueAndDerivative(
-        mappedPoint, movingImageValue, &movingImageDerivative );
-    }
+      /** Compute the moving image value M(T(x)) and derivative dM/dx and check if
+       * the point is inside the moving image buffer.
+       */
+      if( sampleOk )
+      {
+        sampleOk = this->EvaluateMovingImageValueAndDerivative(
+          mappedPoint, movingImageValue, &movingImageDerivative );
+      }
 
-    if( sampleOk )
-    {
-      numberOfPixelsCounted++;
+      if( sampleOk )
+      {
+        numberOfPixelsCounted++;
 
-      /** Get the fixed image value. */
-      const RealType & fixedImageValue
-        = static_cast< RealType >( ( *threader_fiter ).Value().m_ImageValue );
+        /** Get the fixed image value. */
+        const RealType & fixedImageValue
+          = static_cast< RealType >( ( *threader_fiter ).Value().m_ImageValue );
 
 #if 0
-      /** Get the TransformJacobian dT/dmu. */
-      this->EvaluateTransformJacobian( fixedPoint, jacobian, nzji );
+        /** Get the TransformJacobian dT/dmu. */
+        this->EvaluateTransformJacobian( fixedPoint, jacobian, nzji );
 
-      /** Compute the inner products (dM/dx)^T (dT/dmu). */
-      this->EvaluateTransformJacobianInnerProduct(
-        jacobian, movingImageDerivative, imageJacobian );
+        /** Compute the inner products (dM/dx)^T (dT/dmu). */
+        this->EvaluateTransformJacobianInnerProduct(
+          jacobian, movingImageDerivative, imageJacobian );
 #else
-      /** Compute the inner product of the transform Jacobian dT/dmu and the moving image gradient dM/dx. */
-      this->m_AdvancedTransform->EvaluateJacobianWithImageGradientProduct(
-        fixedPoint, movingImageDerivative, imageJacobian, nzji );
+        /** Compute the inner product of the transform Jacobian dT/dmu and the moving image gradient dM/dx. */
+        if( !this->EvaluateTransformJacobianInnerProductOfSample( threadId, threader_fiter.Index(),
+          fixedPoint, movingImageDerivative, imageJacobian, nzji ) )
+        {
+          this->m_AdvancedTransform->EvaluateJacobianWithImageGradientProduct(
+            fixedPoint, movingImageDerivative, imageJacobian, nzji );
+        }
 #endif
 
-      /** Compute this pixel's contribution to the measure and derivatives. */
-      this->UpdateValueAndDerivativeTerms(
-        fixedImageValue, movingImageValue,
-        imageJacobian, nzji,
-        measure, derivative );
+        /** Compute this pixel's contribution to the measure and derivatives. */
+        this->UpdateValueAndDerivativeTerms(
+          fixedImageValue, movingImageValue,
+          imageJacobian, nzji,
+          measure, derivative );
 
-    } // end if sampleOk
+      } // end if sampleOk
 
-  } // end for loop over the image sample container
+    } // end for loop over the image sample container
+
+  } // end while loop over the sample blocks
 
   /** Only update these variables at the end to prevent unnecessary "false sharing". */
   this->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_NumberOfPixelsCounted = numberOfPixelsCounted;
@@ -742,9 +736,9 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
     this->m_ThreaderMetricParameters.st_DerivativePointer   = derivative.begin();
     this->m_ThreaderMetricParameters.st_NormalizationFactor = 1.0 / normal_sum;
 
-    this->m_Threader->SetSingleMethod( this->AccumulateDerivativesThreaderCallback,
+    PersistentThreadPool::SingleMethodExecute( this->m_Threader,
+      this->AccumulateDerivativesThreaderCallback,
       const_cast< void * >( static_cast< const void * >( &this->m_ThreaderMetricParameters ) ) );
-    this->m_Threader->SingleMethodExecute();
   }
 #ifdef ELASTIX_USE_OPENMP
   // compute multi-threadedly with openmp
@@ -828,7 +822,7 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
 
   /** Initialize some variables. */
   this->m_NumberOfPixelsCounted = 0;
-  RandomGeneratorType::Pointer randomGenerator = RandomGeneratorType::GetInstance();
+  RandomGeneratorType::Pointer randomGenerator = ThreadRandomGenerator::GetInstance();
   randomGenerator->Initialize();
 
   /** Array that stores dM(x)/dmu, and the sparse jacobian+indices. */
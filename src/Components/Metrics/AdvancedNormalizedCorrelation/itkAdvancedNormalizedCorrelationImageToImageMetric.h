@@ -180,6 +180,9 @@ public:
     const TransformParametersType & parameters,
     MeasureType & value, DerivativeType & derivative ) const;
 
+  /** All thread-unsafe work is done in BeforeThreadedGetValueAndDerivative(). */
+  virtual bool GetSupportsConcurrentEvaluation( void ) const { return true; }
+
   /** Set/Get SubtractMean boolean. If true, the sample mean is subtracted
    * from the sample values in the cross-correlation formula and
    * typically results in narrower valleys in the cost function.
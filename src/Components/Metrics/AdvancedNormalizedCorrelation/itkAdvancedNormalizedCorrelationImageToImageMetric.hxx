@@ -545,26 +545,7 @@ AdvancedNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
   DerivativeType & differential = this->m_CorrelationGetValueAndDerivativePerThreadVariables[ threadId ].st_Differential;
 
   /** Get a handle to the sample container. */
-  ImageSampleContainerPointer sampleContainer     = this->GetImageSampler()->GetOutput();
-  const unsigned long         sampleContainerSize = sampleContainer->Size();
-
-  /** Get the samples for this thread. */
-  const unsigned long nrOfSamplesPerThreads
-    = static_cast< unsigned long >( vcl_ceil( static_cast< double >( sampleContainerSize )
-    / static_cast< double >( this->m_NumberOfThreads ) ) );
-
-  unsigned long pos_begin = nrOfSamplesPerThreads * threadId;
-  unsigned long pos_end   = nrOfSamplesPerThreads * ( threadId + 1 );
-  pos_begin = ( pos_begin > sampleContainerSize ) ? sampleContainerSize : pos_begin;
-  pos_end   = ( pos_end > sampleContainerSize ) ? sampleContainerSize : pos_end;
-
-  /** Create iterator over the sample container. */
-  typename ImageSampleContainerType::ConstIterator threader_fiter;
-  typename ImageSampleContainerType::ConstIterator threader_fbegin = sampleContainer->Begin();
-  typename ImageSampleContainerType::ConstIterator threader_fend   = sampleContainer->Begin();
-
-  threader_fbegin += (int)pos_begin;
-  threader_fend   += (int)pos_end;
+  ImageSampleContainerPointer sampleContainer = this->GetImageSampler()->GetOutput();
 
   /** Create variables to store intermediate results. */
   AccumulateType sff                   = NumericTraits< AccumulateType >::Zero;
@@ -574,69 +555,83 @@ AdvancedNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
   AccumulateType sm                    = NumericTraits< AccumulateType >::Zero;
   unsigned long  numberOfPixelsCounted = 0;
 
-  /** Loop over the fixed image to calculate the mean squares. */
-  for( threader_fiter = threader_fbegin; threader_fiter != threader_fend; ++threader_fiter )
+  /** Loop over the blocks of samples assigned to this thread. */
+  SizeValueType pos_begin = 0;
+  SizeValueType pos_end   = 0;
+  while( this->GetNextSampleBlock( threadId, pos_begin, pos_end ) )
   {
-    /** Read fixed coordinates and initialize some variables. */
-    const FixedImagePointType & fixedPoint = ( *threader_fiter ).Value().m_ImageCoordinates;
-    RealType                    movingImageValue;
-    MovingImagePointType        mappedPoint;
-    MovingImageDerivativeType   movingImageDerivative;
+    /** Create iterator over the sample container. */
+    typename ImageSampleContainerType::ConstIterator threader_fiter;
+    typename ImageSampleContainerType::ConstIterator threader_fbegin = sampleContainer->Begin();
+    typename ImageSampleContainerType::ConstIterator threader_fend   = sampleContainer->Begin();
+    threader_fbegin += (int)pos_begin;
+    threader_fend   += (int)pos_end;
+
+    /** Loop over the fixed image to calculate the mean squares. */
+    for( threader_fiter = threader_fbegin; threader_fiter != threader_fend; ++threader_fiter )
+    {
+      /** Read fixed coordinates and initialize some variables. */
+      const FixedImagePointType & fixedPoint = ( *threader_fiter ).Value().m_ImageCoordinates;
+      RealType                    movingImageValue;
+      MovingImagePointType        mappedPoint;
+      MovingImageDerivativeType   movingImageDerivative;
 
-    /** Transform point and check if it is inside the B-spline support region. */
-    bool sampleOk = this->TransformPoint( fixedPoint, mappedPoint );
+      /** Transform point and check if it is inside the B-spline support region. */
+      bool sampleOk = this->TransformPoint( fixedPoint, mappedPoint );
 
-    /** Check if point is inside mask. */
-    if( sampleOk )
-    {
-      sampleOk = this->IsInsideMovingMask( mappedPoint );
-    }
+      /** Check if point is inside mask. */
+      if( sampleOk )
+      {
+        sampleOk = this->IsInsideMovingMask( mappedPoint );
+      }
 
-    /** Compute the moving image value M(T(x)) and derivative dM/dx and check if
-     * the point is inside the moving image buffer.
-     */
-    if( sampleOk )
-    {
-      sampleOk = this->EvaluateMovingImageValueAndDerivative(
-        mappedPoint, movingImageValue, &movingImageDerivative );
-    }
+      /** Compute the moving image value M(T(x)) and derivative dM/dx and check if
+       * the point is inside the moving image buffer.
+       */
+      if( sampleOk )
+      {
+        sampleOk = this->EvaluateMovingImageValueAndDerivative(
+          mappedPoint, movingImageValue, &movingImageDerivative );
+      }
 
-    if( sampleOk )
-    {
-      numberOfPixelsCounted++;
+      if( sampleOk )
+      {
+        numberOfPixelsCounted++;
 
-      /** Get the fixed image value. */
-      const RealType & fixedImageValue
-        = static_cast< RealType >( ( *threader_fiter ).Value().m_ImageValue );
+        /** Get the fixed image value. */
+        const RealType & fixedImageValue
+          = static_cast< RealType >( ( *threader_fiter ).Value().m_ImageValue );
 
 #if 0
-      /** Get the TransformJacobian dT/dmu. */
-      this->EvaluateTransformJacobian( fixedPoint, jacobian, nzji );
+        /** Get the TransformJacobian dT/dmu. */
+        this->EvaluateTransformJacobian( fixedPoint, jacobian, nzji );
 
-      /** Compute the inner products (dM/dx)^T (dT/dmu). */
-      this->EvaluateTransformJacobianInnerProduct(
-        jacobian, movingImageDerivative, imageJacobian );
+        /** Compute the inner products (dM/dx)^T (dT/dmu). */
+        this->EvaluateTransformJacobianInnerProduct(
+          jacobian, movingImageDerivative, imageJacobian );
 #else
-      /** Compute the inner product of the transform Jacobian dT/dmu and the moving image gradient dM/dx. */
-      this->m_AdvancedTransform->EvaluateJacobianWithImageGradientProduct(
-        fixedPoint, movingImageDerivative, imageJacobian, nzji );
+        /** Compute the inner product of the transform Jacobian dT/dmu and the moving image gradient dM/dx. */
+        this->m_AdvancedTransform->EvaluateJacobianWithImageGradientProduct(
+          fixedPoint, movingImageDerivative, imageJacobian, nzji );
 #endif
 
-      /** Update some sums needed to calculate the value of NC. */
-      sff += fixedImageValue  * fixedImageValue;
-      smm += movingImageValue * movingImageValue;
-      sfm += fixedImageValue  * movingImageValue;
-      sf  += fixedImageValue;  // Only needed when m_SubtractMean == true
-      sm  += movingImageValue; // Only needed when m_SubtractMean == true
+        /** Update some sums needed to calculate the value of NC. */
+        sff += fixedImageValue  * fixedImageValue;
+        smm += movingImageValue * movingImageValue;
+        sfm += fixedImageValue  * movingImageValue;
+        sf  += fixedImageValue;  // Only needed when m_SubtractMean == true
+        sm  += movingImageValue; // Only needed when m_SubtractMean == true
 
-      /** Compute this voxel's contribution to the derivative terms. */
-      this->UpdateDerivativeTerms(
-        fixedImageValue, movingImageValue, imageJacobian, nzji,
-        derivativeF, derivativeM, differential );
+        /** Compute this voxel's contribution to the derivative terms. */
+        this->UpdateDerivativeTerms(
+          fixedImageValue, movingImageValue, imageJacobian, nzji,
+          derivativeF, derivativeM, differential );
 
-    } // end if sampleOk
+      } // end if sampleOk
 
-  } // end for loop over the image sample container
+    } // end for loop over the image sample container
+
+  } // end while loop over the sample blocks
 
   /** Only update these variables at the end to prevent unnecessary "false sharing". */
   this->m_CorrelationGetValueAndDerivativePerThreadVariables[ threadId ].st_NumberOfPixelsCounted = numberOfPixelsCounted;
@@ -768,8 +763,8 @@ AdvancedNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
     temp->st_InvertedDenominator = 1.0 / denom;
     temp->st_DerivativePointer   = derivative.begin();
 
-    this->m_Threader->SetSingleMethod( AccumulateDerivativesThreaderCallback, temp );
-    this->m_Threader->SingleMethodExecute();
+    PersistentThreadPool::SingleMethodExecute( this->m_Threader,
+      AccumulateDerivativesThreaderCallback, temp );
 
     delete temp;
   }
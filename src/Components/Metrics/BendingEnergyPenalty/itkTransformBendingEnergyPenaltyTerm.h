@@ -146,6 +146,9 @@ public:
     MeasureType & value,
     DerivativeType & derivative ) const;
 
+  /** All thread-unsafe work is done in BeforeThreadedGetValueAndDerivative(). */
+  virtual bool GetSupportsConcurrentEvaluation( void ) const { return true; }
+
   /** Get value and derivatives for each thread. */
   inline void ThreadedGetValueAndDerivative( ThreadIdType threadID );
 
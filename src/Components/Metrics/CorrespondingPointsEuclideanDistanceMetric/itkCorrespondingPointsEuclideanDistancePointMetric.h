@@ -90,6 +90,9 @@ public:
   void GetValueAndDerivative( const TransformParametersType & parameters,
     MeasureType & Value, DerivativeType & Derivative ) const;
 
+  /** All thread-unsafe work is done in BeforeThreadedGetValueAndDerivative(). */
+  virtual bool GetSupportsConcurrentEvaluation( void ) const { return true; }
+
 protected:
 
   CorrespondingPointsEuclideanDistancePointMetric();
@@ -70,6 +70,10 @@ namespace elastix
  * \parameter AvoidDivisionBy: a small number to avoid division by zero in the implentation. \n
  *    <tt>(AvoidDivisionBy 0.000000001)</tt> \n
  *    The default is 1e-5.
+ * \parameter ReuseFixedTree: reuse the kNN tree of the fixed samples, and the distances
+ *    between them, as long as the fixed samples do not change. \n
+ *    <tt>(ReuseFixedTree "false")</tt> \n
+ *    The default is "true".
  *
  * \warning Note that we assume the FixedFeatureImageType to have the same
  * pixeltype as the FixedImageType
@@ -65,6 +65,11 @@ KNNGraphAlphaMutualInformationMetric< TElastix >
   this->m_Configuration->ReadParameter( smallNumber, "AvoidDivisionBy", 0, true );
   this->SetAvoidDivisionBy( smallNumber );
 
+  /** Reuse the tree of the fixed samples while they do not change. */
+  bool reuseFixedTree = true;
+  this->m_Configuration->ReadParameter( reuseFixedTree, "ReuseFixedTree", 0, true );
+  this->SetReuseFixedTree( reuseFixedTree );
+
 } // end BeforeRegistration()
 
 
@@ -40,6 +40,8 @@
 /** Include for the spatial derivatives. */
 #include "itkArray2D.h"
 
+#include <vector>
+
 namespace itk
 {
 /**
@@ -61,6 +63,12 @@ namespace itk
  * features, it would be better (but slower) to first apply the transform
  * on the image and then recalculate the feature.
  *
+ * The tree of the fixed samples only depends on the fixed samples. As long
+ * as these do not change, for example with a full sampler, or with a random
+ * sampler without NewSamplesEveryIteration, the tree and the distances to
+ * the fixed neighbours are reused, see SetReuseFixedTree(). With
+ * UseMultiThread on, the kNN queries are divided over the threads.
+ *
  * All the technical details can be found in:\n
  * M. Staring, U.A. van der Heide, S. Klein, M.A. Viergever and J.P.W. Pluim,
  * "Registration of Cervical MRI Using Multifeature Mutual Information,"
@@ -134,6 +142,7 @@ public:
   typedef typename
     Superclass::MovingImageLimiterOutputType MovingImageLimiterOutputType;
   typedef typename Superclass::NonZeroJacobianIndicesType NonZeroJacobianIndicesType;
+  typedef typename Superclass::ThreadInfoType             ThreadInfoType;
 
   /** Typedef's for storing multiple inputs. */
   typedef typename Superclass::FixedImageVectorType             FixedImageVectorType;
@@ -247,6 +256,17 @@ public:
   /** Avoid division by a small number. */
   itkGetConstReferenceMacro( AvoidDivisionBy, double );
 
+  /** Reuse the tree of the fixed samples, and the distances of the fixed
+   * samples to their neighbours, as long as the fixed samples do not change.
+   * Default: true.
+   */
+  itkSetMacro( ReuseFixedTree, bool );
+  itkGetConstReferenceMacro( ReuseFixedTree, bool );
+  itkBooleanMacro( ReuseFixedTree );
+
+  /** Get the number of times the tree of the fixed samples was reused. */
+  itkGetConstMacro( NumberOfFixedTreeReuses, SizeValueType );
+
 protected:
 
   /** Constructor. */
@@ -269,6 +289,7 @@ protected:
 
   double m_Alpha;
   double m_AvoidDivisionBy;
+  bool   m_ReuseFixedTree;
 
 private:
 
@@ -335,6 +356,78 @@ private:
     DerivativeType & dGamma_M,
     DerivativeType & dGamma_J ) const;
 
+  /** Generate the trees and connect them to the searchers. The tree of the
+   * fixed samples is only generated when the fixed samples changed.
+   */
+  void GenerateTrees(
+    const ListSamplePointer & listSampleFixed,
+    const ListSamplePointer & listSampleMoving,
+    const ListSamplePointer & listSampleJoint ) const;
+
+  /** Describe everything the tree of the fixed samples depends on,
+   * except for the valid samples.
+   */
+  std::string GetFixedTreeKey( void ) const;
+
+  /** Search the neighbours of all query points, on multiple threads if
+   * UseMultiThread is on, and accumulate sumG and, if desired, the
+   * contribution to the derivative.
+   */
+  void ComputeKNNContributions(
+    const ListSamplePointer & listSampleFixed,
+    const ListSamplePointer & listSampleMoving,
+    const ListSamplePointer & listSampleJoint,
+    const bool & doDerivative,
+    const TransformJacobianContainerType & jacobians,
+    const TransformJacobianIndicesContainerType & jacobiansIndices,
+    const SpatialDerivativeContainerType & spatialDerivatives,
+    double & sumG, DerivativeType & contribution ) const;
+
+  /** Search the neighbours of the query points first, .., last - 1. */
+  void ThreadedComputeKNNContributions( ThreadIdType threadId,
+    unsigned long first, unsigned long last ) const;
+
+  /** The threader callback of ComputeKNNContributions(). */
+  static ITK_THREAD_RETURN_TYPE ComputeKNNContributionsThreaderCallback( void * arg );
+
+  /** The inputs of the kNN queries, valid during ComputeKNNContributions(). */
+  struct KNNQueriesParametersType
+  {
+    ListSampleType *                              st_ListSampleFixed;
+    ListSampleType *                              st_ListSampleMoving;
+    ListSampleType *                              st_ListSampleJoint;
+    bool                                          st_DoDerivative;
+    const TransformJacobianContainerType *        st_Jacobians;
+    const TransformJacobianIndicesContainerType * st_JacobiansIndices;
+    const SpatialDerivativeContainerType *        st_SpatialDerivatives;
+  };
+  mutable KNNQueriesParametersType m_KNNQueriesParameters;
+
+  /** The results of the kNN queries of one thread. */
+  struct KNNQueriesPerThreadStruct
+  {
+    double         st_SumG;
+    DerivativeType st_Contribution;
+    DerivativeType st_dGamma_M;
+    DerivativeType st_dGamma_J;
+  };
+  mutable std::vector< KNNQueriesPerThreadStruct > m_KNNQueriesPerThreadVariables;
+
+  /** The indices in the sample container of the valid samples, set by
+   * ComputeListSampleValuesAndDerivativePlusJacobian().
+   */
+  mutable std::vector< unsigned long > m_ValidSampleIndices;
+
+  /** The state of the tree of the fixed samples: what it was generated
+   * from, and the sums of the distances of each fixed sample to its
+   * neighbours.
+   */
+  mutable std::string                  m_FixedTreeKey;
+  mutable std::vector< unsigned long > m_FixedTreeSampleIndices;
+  mutable std::vector< double >        m_FixedGammas;
+  mutable bool                         m_FixedTreeIsReused;
+  mutable SizeValueType                m_NumberOfFixedTreeReuses;
+
 };
 
 } // end namespace itk
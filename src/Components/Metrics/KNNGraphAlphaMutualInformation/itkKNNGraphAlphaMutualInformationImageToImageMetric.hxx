@@ -19,6 +19,11 @@
 #define _itkKNNGraphAlphaMutualInformationImageToImageMetric_hxx
 
 #include "itkKNNGraphAlphaMutualInformationImageToImageMetric.h"
+#include "itkSharedObjectCache.h"
+#include "itkPersistentThreadPool.h"
+
+#include <algorithm>
+#include <sstream>
 
 namespace itk
 {
@@ -44,6 +49,10 @@ KNNGraphAlphaMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
   this->m_BinaryKNNTreeSearcherMoving = 0;
   this->m_BinaryKNNTreeSearcherJoint  = 0;
 
+  this->m_ReuseFixedTree          = true;
+  this->m_FixedTreeIsReused       = false;
+  this->m_NumberOfFixedTreeReuses = 0;
+
 } // end Constructor()
 
 
@@ -289,6 +298,11 @@ KNNGraphAlphaMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
     itkExceptionMacro( << "ERROR: The kNN tree searcher is not set. " );
   }
 
+  /** Generate the tree of the fixed samples again. */
+  this->m_FixedTreeKey.clear();
+  this->m_FixedTreeSampleIndices.clear();
+  this->m_FixedGammas.clear();
+
 } // end Initialize()
 
 
@@ -336,25 +350,7 @@ KNNGraphAlphaMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
    * and connect them to the searchers.
    */
 
-  /** Generate the tree for the fixed image samples. */
-  this->m_BinaryKNNTreeFixed->SetSample( listSampleFixed );
-  this->m_BinaryKNNTreeFixed->GenerateTree();
-
-  /** Generate the tree for the moving image samples. */
-  this->m_BinaryKNNTreeMoving->SetSample( listSampleMoving );
-  this->m_BinaryKNNTreeMoving->GenerateTree();
-
-  /** Generate the tree for the joint image samples. */
-  this->m_BinaryKNNTreeJoint->SetSample( listSampleJoint );
-  this->m_BinaryKNNTreeJoint->GenerateTree();
-
-  /** Initialize tree searchers. */
-  this->m_BinaryKNNTreeSearcherFixed
-  ->SetBinaryTree( this->m_BinaryKNNTreeFixed );
-  this->m_BinaryKNNTreeSearcherMoving
-  ->SetBinaryTree( this->m_BinaryKNNTreeMoving );
-  this->m_BinaryKNNTreeSearcherJoint
-  ->SetBinaryTree( this->m_BinaryKNNTreeJoint );
+  this->GenerateTrees( listSampleFixed, listSampleMoving, listSampleJoint );
 
   /**
    * *************** Estimate the \alpha MI ******************
@@ -389,77 +385,13 @@ KNNGraphAlphaMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
    * where d1 and d2 are the possibly different dimensions of the two feature sets.
    */
 
-  /** Temporary variables. */
-  typedef typename NumericTraits< MeasureType >::AccumulateType AccumulateType;
-  MeasurementVectorType z_F, z_M, z_J;
-  IndexArrayType        indices_F, indices_M, indices_J;
-  DistanceArrayType     distances_F, distances_M, distances_J;
-
-  MeasureType    H, G;
-  AccumulateType sumG = NumericTraits< AccumulateType >::Zero;
-
-  /** Get the size of the feature vectors. */
-  unsigned int fixedSize  = this->GetNumberOfFixedImages();
-  unsigned int movingSize = this->GetNumberOfMovingImages();
-  unsigned int jointSize  = fixedSize + movingSize;
-
-  /** Get the number of neighbours and \gamma. */
-  unsigned int k        = this->m_BinaryKNNTreeSearcherFixed->GetKNearestNeighbors();
-  double       twoGamma = jointSize * ( 1.0 - this->m_Alpha );
-
-  /** Loop over all query points, i.e. all samples. */
-  for( unsigned long i = 0; i < this->m_NumberOfPixelsCounted; i++ )
-  {
-    /** Get the i-th query point. */
-    listSampleFixed->GetMeasurementVector(  i, z_F );
-    listSampleMoving->GetMeasurementVector( i, z_M );
-    listSampleJoint->GetMeasurementVector(  i, z_J );
-
-    /** Search for the K nearest neighbours of the current query point. */
-    this->m_BinaryKNNTreeSearcherFixed->Search(  z_F, indices_F, distances_F );
-    this->m_BinaryKNNTreeSearcherMoving->Search( z_M, indices_M, distances_M );
-    this->m_BinaryKNNTreeSearcherJoint->Search(  z_J, indices_J, distances_J );
-
-    /** Add the distances between the points to get the total graph length.
-     * The outcommented implementation calculates: sum J/sqrt(F*M)
-     *
-    for ( unsigned int j = 0; j < K; j++ )
-    {
-    enumerator = vcl_sqrt( distsJ[ j ] );
-    denominator = vcl_sqrt( vcl_sqrt( distsF[ j ] ) * vcl_sqrt( distsM[ j ] ) );
-    if ( denominator > 1e-14 )
-    {
-    contribution += vcl_pow( enumerator / denominator, twoGamma );
-    }
-    }*/
-
-    /** Add the distances of all neighbours of the query point,
-    * for the three graphs:
-    * sum M / sqrt( sum F * sum M)
-    */
-
-    /** Variables to compute the measure. */
-    AccumulateType Gamma_F = NumericTraits< AccumulateType >::Zero;
-    AccumulateType Gamma_M = NumericTraits< AccumulateType >::Zero;
-    AccumulateType Gamma_J = NumericTraits< AccumulateType >::Zero;
-
-    /** Loop over the neighbours. */
-    for( unsigned int p = 0; p < k; p++ )
-    {
-      Gamma_F += vcl_sqrt( distances_F[ p ] );
-      Gamma_M += vcl_sqrt( distances_M[ p ] );
-      Gamma_J += vcl_sqrt( distances_J[ p ] );
-    } // end loop over the k neighbours
-
-    /** Calculate the contribution of this query point. */
-    H = vcl_sqrt( Gamma_F * Gamma_M );
-    if( H > this->m_AvoidDivisionBy )
-    {
-      /** Compute some sums. */
-      G     = Gamma_J / H;
-      sumG += vcl_pow( G, twoGamma );
-    }
-  } // end looping over all query points
+  /** Search the neighbours of all query points, i.e. all samples. */
+  double         sumG = 0.0;
+  DerivativeType dummyContribution;
+  this->ComputeKNNContributions(
+    listSampleFixed, listSampleMoving, listSampleJoint,
+    false, dummyJacobianContainer, dummyJacobianIndicesContainer,
+    dummySpatialDerivativesContainer, sumG, dummyContribution );
 
   /**
    * *************** Finally, calculate the metric value \alpha MI ******************
@@ -561,25 +493,7 @@ KNNGraphAlphaMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
    * and connect them to the searchers.
    */
 
-  /** Generate the tree for the fixed image samples. */
-  this->m_BinaryKNNTreeFixed->SetSample( listSampleFixed );
-  this->m_BinaryKNNTreeFixed->GenerateTree();
-
-  /** Generate the tree for the moving image samples. */
-  this->m_BinaryKNNTreeMoving->SetSample( listSampleMoving );
-  this->m_BinaryKNNTreeMoving->GenerateTree();
-
-  /** Generate the tree for the joint image samples. */
-  this->m_BinaryKNNTreeJoint->SetSample( listSampleJoint );
-  this->m_BinaryKNNTreeJoint->GenerateTree();
-
-  /** Initialize tree searchers. */
-  this->m_BinaryKNNTreeSearcherFixed
-  ->SetBinaryTree( this->m_BinaryKNNTreeFixed );
-  this->m_BinaryKNNTreeSearcherMoving
-  ->SetBinaryTree( this->m_BinaryKNNTreeMoving );
-  this->m_BinaryKNNTreeSearcherJoint
-  ->SetBinaryTree( this->m_BinaryKNNTreeJoint );
+  this->GenerateTrees( listSampleFixed, listSampleMoving, listSampleJoint );
 
   /**
    * *************** Estimate the \alpha MI and its derivatives ******************
@@ -614,108 +528,19 @@ KNNGraphAlphaMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
    * where d1 and d2 are the possibly different dimensions of the two feature sets.
    */
 
-  /** Temporary variables. */
-  typedef typename NumericTraits< MeasureType >::AccumulateType AccumulateType;
-  MeasurementVectorType z_F, z_M, z_J, z_M_ip, z_J_ip, diff_M, diff_J;
-  IndexArrayType        indices_F,   indices_M,   indices_J;
-  DistanceArrayType     distances_F, distances_M, distances_J;
-  MeasureType           distance_F,  distance_M,  distance_J;
-
-  MeasureType    H, G, Gpow;
-  AccumulateType sumG = NumericTraits< AccumulateType >::Zero;
-
-  DerivativeType contribution( this->GetNumberOfParameters() );
-  contribution.Fill( NumericTraits< DerivativeValueType >::ZeroValue() );
-  DerivativeType dGamma_M( this->GetNumberOfParameters() );
-  DerivativeType dGamma_J( this->GetNumberOfParameters() );
+  /** Search the neighbours of all query points, i.e. all samples. */
+  double         sumG = 0.0;
+  DerivativeType contribution;
+  this->ComputeKNNContributions(
+    listSampleFixed, listSampleMoving, listSampleJoint,
+    true, jacobianContainer, jacobianIndicesContainer,
+    spatialDerivativesContainer, sumG, contribution );
 
   /** Get the size of the feature vectors. */
   unsigned int fixedSize  = this->GetNumberOfFixedImages();
   unsigned int movingSize = this->GetNumberOfMovingImages();
   unsigned int jointSize  = fixedSize + movingSize;
 
-  /** Get the number of neighbours and \gamma. */
-  unsigned int k        = this->m_BinaryKNNTreeSearcherFixed->GetKNearestNeighbors();
-  double       twoGamma = jointSize * ( 1.0 - this->m_Alpha );
-
-  /** Loop over all query points, i.e. all samples. */
-  for( unsigned long i = 0; i < this->m_NumberOfPixelsCounted; i++ )
-  {
-    /** Get the i-th query point. */
-    listSampleFixed->GetMeasurementVector(  i, z_F );
-    listSampleMoving->GetMeasurementVector( i, z_M );
-    listSampleJoint->GetMeasurementVector(  i, z_J );
-
-    /** Search for the k nearest neighbours of the current query point. */
-    this->m_BinaryKNNTreeSearcherFixed->Search(  z_F, indices_F, distances_F );
-    this->m_BinaryKNNTreeSearcherMoving->Search( z_M, indices_M, distances_M );
-    this->m_BinaryKNNTreeSearcherJoint->Search(  z_J, indices_J, distances_J );
-
-    /** Variables to compute the measure and its derivative. */
-    AccumulateType Gamma_F = NumericTraits< AccumulateType >::Zero;
-    AccumulateType Gamma_M = NumericTraits< AccumulateType >::Zero;
-    AccumulateType Gamma_J = NumericTraits< AccumulateType >::Zero;
-
-    SpatialDerivativeType D1sparse, D2sparse_M, D2sparse_J;
-    D1sparse = spatialDerivativesContainer[ i ] * jacobianContainer[ i ];
-
-    dGamma_M.Fill( NumericTraits< DerivativeValueType >::ZeroValue() );
-    dGamma_J.Fill( NumericTraits< DerivativeValueType >::ZeroValue() );
-
-    /** Loop over the neighbours. */
-    for( unsigned int p = 0; p < k; p++ )
-    {
-      /** Get the neighbour point z_ip^M. */
-      listSampleMoving->GetMeasurementVector( indices_M[ p ], z_M_ip );
-      listSampleMoving->GetMeasurementVector( indices_J[ p ], z_J_ip );
-
-      /** Get the distances. */
-      distance_F = vcl_sqrt( distances_F[ p ] );
-      distance_M = vcl_sqrt( distances_M[ p ] );
-      distance_J = vcl_sqrt( distances_J[ p ] );
-
-      /** Compute Gamma's. */
-      Gamma_F += distance_F;
-      Gamma_M += distance_M;
-      Gamma_J += distance_J;
-
-      /** Get the difference of z_ip^M with z_i^M. */
-      diff_M = z_M - z_M_ip;
-      diff_J = z_M - z_J_ip;
-
-      /** Compute derivatives. */
-      D2sparse_M = spatialDerivativesContainer[ indices_M[ p ] ]
-        * jacobianContainer[ indices_M[ p ] ];
-      D2sparse_J = spatialDerivativesContainer[ indices_J[ p ] ]
-        * jacobianContainer[ indices_J[ p ] ];
-
-      /** Update the dGamma's. */
-      this->UpdateDerivativeOfGammas(
-        D1sparse, D2sparse_M, D2sparse_J,
-        jacobianIndicesContainer[ i ],
-        jacobianIndicesContainer[ indices_M[ p ] ],
-        jacobianIndicesContainer[ indices_J[ p ] ],
-        diff_M, diff_J,
-        distance_M, distance_J,
-        dGamma_M, dGamma_J );
-
-    } // end loop over the k neighbours
-
-    /** Compute contributions. */
-    H = vcl_sqrt( Gamma_F * Gamma_M );
-    if( H > this->m_AvoidDivisionBy )
-    {
-      /** Compute some sums. */
-      G     = Gamma_J / H;
-      sumG += vcl_pow( G, twoGamma );
-
-      /** Compute the contribution to the derivative. */
-      Gpow          = vcl_pow( G, twoGamma - 1.0 );
-      contribution += ( Gpow / H ) * ( dGamma_J - ( 0.5 * Gamma_J / Gamma_M ) * dGamma_M );
-    }
-
-  } // end looping over all query points
-
   /**
    * *************** Finally, calculate the metric value and derivative ******************
    */
@@ -730,7 +555,7 @@ KNNGraphAlphaMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
     measure = vcl_log( sumG / number ) / ( this->m_Alpha - 1.0 );
 
     /** Compute the derivative (-2.0 * d = -jointSize). */
-    derivative = ( static_cast< AccumulateType >( jointSize ) / sumG ) * contribution;
+    derivative = ( static_cast< double >( jointSize ) / sumG ) * contribution;
   }
   value = -measure;
 
@@ -758,6 +583,7 @@ KNNGraphAlphaMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
   jacobianContainer.resize( 0 );
   jacobianIndicesContainer.resize( 0 );
   spatialDerivativesContainer.resize( 0 );
+  this->m_ValidSampleIndices.resize( 0 );
 
   /** Get a handle to the sample container. */
   ImageSampleContainerPointer sampleContainer      = this->GetImageSampler()->GetOutput();
@@ -787,6 +613,7 @@ KNNGraphAlphaMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
   jacobianContainer.reserve( nrOfRequestedSamples );
   jacobianIndicesContainer.reserve( nrOfRequestedSamples );
   spatialDerivativesContainer.reserve( nrOfRequestedSamples );
+  this->m_ValidSampleIndices.reserve( nrOfRequestedSamples );
 
   /** Create variables to store intermediate results. */
   RealType                   movingImageValue;
@@ -907,6 +734,9 @@ KNNGraphAlphaMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
 
       } // end if doDerivative
 
+      /** Remember which sample this was, to detect changes of the fixed samples. */
+      this->m_ValidSampleIndices.push_back( fiter.Index() );
+
       /** Update the NumberOfPixelsCounted. */
       this->m_NumberOfPixelsCounted++;
 
@@ -1076,6 +906,358 @@ KNNGraphAlphaMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
 } // end UpdateDerivativeOfGammas()
 
 
+/**
+ * ************************ GenerateTrees *************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+KNNGraphAlphaMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
+::GenerateTrees(
+  const ListSamplePointer & listSampleFixed,
+  const ListSamplePointer & listSampleMoving,
+  const ListSamplePointer & listSampleJoint ) const
+{
+  /** The fixed samples did not change if the same samples of the same
+   * sample container are valid, and nothing the fixed tree was generated
+   * from was modified. The previous tree, and the distances to the
+   * neighbours of the fixed samples, are then still valid.
+   */
+  this->m_FixedTreeIsReused = this->m_ReuseFixedTree
+    && !this->m_FixedTreeKey.empty()
+    && this->m_FixedTreeKey == this->GetFixedTreeKey()
+    && this->m_FixedTreeSampleIndices == this->m_ValidSampleIndices;
+
+  if( this->m_FixedTreeIsReused )
+  {
+    ++this->m_NumberOfFixedTreeReuses;
+  }
+  else
+  {
+    /** Generate the tree for the fixed image samples. */
+    this->m_BinaryKNNTreeFixed->SetSample( listSampleFixed );
+    this->m_BinaryKNNTreeFixed->GenerateTree();
+    this->m_BinaryKNNTreeSearcherFixed
+    ->SetBinaryTree( this->m_BinaryKNNTreeFixed );
+
+    /** The distances are filled in by the queries. The key is taken after
+     * generating, since that modifies the tree and the searcher.
+     */
+    this->m_FixedGammas.resize( this->m_NumberOfPixelsCounted );
+    this->m_FixedTreeSampleIndices = this->m_ValidSampleIndices;
+    this->m_FixedTreeKey           = this->GetFixedTreeKey();
+  }
+
+  /** Generate the tree for the moving image samples. */
+  this->m_BinaryKNNTreeMoving->SetSample( listSampleMoving );
+  this->m_BinaryKNNTreeMoving->GenerateTree();
+
+  /** Generate the tree for the joint image samples. */
+  this->m_BinaryKNNTreeJoint->SetSample( listSampleJoint );
+  this->m_BinaryKNNTreeJoint->GenerateTree();
+
+  /** Initialize tree searchers. */
+  this->m_BinaryKNNTreeSearcherMoving
+  ->SetBinaryTree( this->m_BinaryKNNTreeMoving );
+  this->m_BinaryKNNTreeSearcherJoint
+  ->SetBinaryTree( this->m_BinaryKNNTreeJoint );
+
+} // end GenerateTrees()
+
+
+/**
+ * ************************ GetFixedTreeKey *************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+std::string
+KNNGraphAlphaMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
+::GetFixedTreeKey( void ) const
+{
+  /** The sampler regenerates its output in place when it selects new
+   * samples, which changes the update time of the container, not its
+   * modification time.
+   */
+  const ImageSampleContainerType * sampleContainer = this->GetImageSampler()->GetOutput();
+  std::ostringstream               key;
+  key << "[" << static_cast< const void * >( sampleContainer ) << "@"
+      << std::max( sampleContainer->GetMTime(), sampleContainer->GetUpdateMTime() ) << "]";
+  for( unsigned int i = 0; i < this->GetNumberOfFixedImages(); ++i )
+  {
+    SharedObjectCache::AppendToKey( key, this->GetFixedImage( i ) );
+  }
+  SharedObjectCache::AppendToKey( key, this->m_BinaryKNNTreeFixed );
+  SharedObjectCache::AppendToKey( key, this->m_BinaryKNNTreeSearcherFixed );
+  return key.str();
+
+} // end GetFixedTreeKey()
+
+
+/**
+ * ************************ ComputeKNNContributions *************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+KNNGraphAlphaMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
+::ComputeKNNContributions(
+  const ListSamplePointer & listSampleFixed,
+  const ListSamplePointer & listSampleMoving,
+  const ListSamplePointer & listSampleJoint,
+  const bool & doDerivative,
+  const TransformJacobianContainerType & jacobianContainer,
+  const TransformJacobianIndicesContainerType & jacobianIndicesContainer,
+  const SpatialDerivativeContainerType & spatialDerivativesContainer,
+  double & sumG, DerivativeType & contribution ) const
+{
+  /** Store the inputs of the queries. */
+  this->m_KNNQueriesParameters.st_ListSampleFixed    = listSampleFixed.GetPointer();
+  this->m_KNNQueriesParameters.st_ListSampleMoving   = listSampleMoving.GetPointer();
+  this->m_KNNQueriesParameters.st_ListSampleJoint    = listSampleJoint.GetPointer();
+  this->m_KNNQueriesParameters.st_DoDerivative       = doDerivative;
+  this->m_KNNQueriesParameters.st_Jacobians          = &jacobianContainer;
+  this->m_KNNQueriesParameters.st_JacobiansIndices   = &jacobianIndicesContainer;
+  this->m_KNNQueriesParameters.st_SpatialDerivatives = &spatialDerivativesContainer;
+
+  /** Initialize the results of the threads. The searches only read the
+   * trees, and the ANN library keeps the state of a search per thread.
+   */
+  ThreadIdType nrOfThreads = 1;
+  if( this->m_UseMultiThread )
+  {
+    nrOfThreads = std::max( this->m_Threader->GetNumberOfThreads(),
+      static_cast< ThreadIdType >( 1 ) );
+  }
+  const unsigned long numberOfParameters = this->GetNumberOfParameters();
+  this->m_KNNQueriesPerThreadVariables.resize( nrOfThreads );
+  for( ThreadIdType i = 0; i < nrOfThreads; ++i )
+  {
+    KNNQueriesPerThreadStruct & threadData = this->m_KNNQueriesPerThreadVariables[ i ];
+    threadData.st_SumG = 0.0;
+    if( doDerivative )
+    {
+      if( threadData.st_Contribution.GetSize() != numberOfParameters )
+      {
+        threadData.st_Contribution.SetSize( numberOfParameters );
+        threadData.st_dGamma_M.SetSize( numberOfParameters );
+        threadData.st_dGamma_J.SetSize( numberOfParameters );
+      }
+      threadData.st_Contribution.Fill( NumericTraits< DerivativeValueType >::ZeroValue() );
+    }
+  }
+
+  /** Search the neighbours, on the shared thread pool when available. */
+  if( nrOfThreads == 1 )
+  {
+    this->ThreadedComputeKNNContributions( 0, 0, this->m_NumberOfPixelsCounted );
+  }
+  else
+  {
+    PersistentThreadPool::SingleMethodExecute( this->m_Threader,
+      this->ComputeKNNContributionsThreaderCallback,
+      const_cast< Self * >( this ) );
+  }
+
+  /** Accumulate the results of the threads. */
+  sumG = 0.0;
+  for( ThreadIdType i = 0; i < nrOfThreads; ++i )
+  {
+    sumG += this->m_KNNQueriesPerThreadVariables[ i ].st_SumG;
+  }
+  if( doDerivative )
+  {
+    contribution = this->m_KNNQueriesPerThreadVariables[ 0 ].st_Contribution;
+    for( ThreadIdType i = 1; i < nrOfThreads; ++i )
+    {
+      contribution += this->m_KNNQueriesPerThreadVariables[ i ].st_Contribution;
+    }
+  }
+
+} // end ComputeKNNContributions()
+
+
+/**
+ * ************************ ComputeKNNContributionsThreaderCallback *************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+ITK_THREAD_RETURN_TYPE
+KNNGraphAlphaMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
+::ComputeKNNContributionsThreaderCallback( void * arg )
+{
+  ThreadInfoType *   infoStruct = static_cast< ThreadInfoType * >( arg );
+  const ThreadIdType threadId   = infoStruct->ThreadID;
+  const Self *       metric     = static_cast< const Self * >( infoStruct->UserData );
+
+  /** Each thread gets a contiguous block of query points. */
+  const unsigned long nrOfThreads = metric->m_KNNQueriesPerThreadVariables.size();
+  const unsigned long n           = metric->m_NumberOfPixelsCounted;
+  const unsigned long first       = ( n * threadId ) / nrOfThreads;
+  const unsigned long last        = ( n * ( threadId + 1 ) ) / nrOfThreads;
+  metric->ThreadedComputeKNNContributions( threadId, first, last );
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end ComputeKNNContributionsThreaderCallback()
+
+
+/**
+ * ************************ ThreadedComputeKNNContributions *************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+KNNGraphAlphaMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
+::ThreadedComputeKNNContributions( ThreadIdType threadId,
+  unsigned long first, unsigned long last ) const
+{
+  typedef typename NumericTraits< MeasureType >::AccumulateType AccumulateType;
+
+  /** The inputs, and the results of this thread. */
+  const KNNQueriesParametersType & par        = this->m_KNNQueriesParameters;
+  KNNQueriesPerThreadStruct &      threadData = this->m_KNNQueriesPerThreadVariables[ threadId ];
+  const ListSampleType *           listSampleFixed  = par.st_ListSampleFixed;
+  const ListSampleType *           listSampleMoving = par.st_ListSampleMoving;
+  const ListSampleType *           listSampleJoint  = par.st_ListSampleJoint;
+  DerivativeType &                 contribution     = threadData.st_Contribution;
+  DerivativeType &                 dGamma_M         = threadData.st_dGamma_M;
+  DerivativeType &                 dGamma_J         = threadData.st_dGamma_J;
+
+  /** Temporary variables, local to this thread. */
+  MeasurementVectorType z_F, z_M, z_J, z_M_ip, z_J_ip, diff_M, diff_J;
+  IndexArrayType        indices_F,   indices_M,   indices_J;
+  DistanceArrayType     distances_F, distances_M, distances_J;
+  MeasureType           distance_M,  distance_J;
+
+  MeasureType    H, G, Gpow;
+  AccumulateType sumG = NumericTraits< AccumulateType >::Zero;
+
+  /** Get the size of the feature vectors. */
+  unsigned int fixedSize  = this->GetNumberOfFixedImages();
+  unsigned int movingSize = this->GetNumberOfMovingImages();
+  unsigned int jointSize  = fixedSize + movingSize;
+
+  /** Get the number of neighbours and \gamma. */
+  unsigned int k        = this->m_BinaryKNNTreeSearcherFixed->GetKNearestNeighbors();
+  double       twoGamma = jointSize * ( 1.0 - this->m_Alpha );
+
+  /** Loop over the query points of this thread. */
+  for( unsigned long i = first; i < last; i++ )
+  {
+    /** Variables to compute the measure and its derivative. */
+    AccumulateType Gamma_F = NumericTraits< AccumulateType >::Zero;
+    AccumulateType Gamma_M = NumericTraits< AccumulateType >::Zero;
+    AccumulateType Gamma_J = NumericTraits< AccumulateType >::Zero;
+
+    /** The fixed samples only contribute the sum of the distances to their
+     * neighbours, which does not change as long as the fixed tree is reused.
+     */
+    if( this->m_FixedTreeIsReused )
+    {
+      Gamma_F = this->m_FixedGammas[ i ];
+    }
+    else
+    {
+      listSampleFixed->GetMeasurementVector( i, z_F );
+      this->m_BinaryKNNTreeSearcherFixed->Search( z_F, indices_F, distances_F );
+      for( unsigned int p = 0; p < k; p++ )
+      {
+        Gamma_F += vcl_sqrt( distances_F[ p ] );
+      }
+      this->m_FixedGammas[ i ] = Gamma_F;
+    }
+
+    /** Search for the k nearest neighbours of the current query point. */
+    listSampleMoving->GetMeasurementVector( i, z_M );
+    listSampleJoint->GetMeasurementVector(  i, z_J );
+    this->m_BinaryKNNTreeSearcherMoving->Search( z_M, indices_M, distances_M );
+    this->m_BinaryKNNTreeSearcherJoint->Search(  z_J, indices_J, distances_J );
+
+    if( !par.st_DoDerivative )
+    {
+      /** Add the distances of all neighbours of the query point,
+       * for the three graphs:
+       * sum M / sqrt( sum F * sum M)
+       */
+      for( unsigned int p = 0; p < k; p++ )
+      {
+        Gamma_M += vcl_sqrt( distances_M[ p ] );
+        Gamma_J += vcl_sqrt( distances_J[ p ] );
+      }
+    }
+    else
+    {
+      const TransformJacobianContainerType &        jacobianContainer           = *par.st_Jacobians;
+      const TransformJacobianIndicesContainerType & jacobianIndicesContainer    = *par.st_JacobiansIndices;
+      const SpatialDerivativeContainerType &        spatialDerivativesContainer = *par.st_SpatialDerivatives;
+
+      SpatialDerivativeType D1sparse, D2sparse_M, D2sparse_J;
+      D1sparse = spatialDerivativesContainer[ i ] * jacobianContainer[ i ];
+
+      dGamma_M.Fill( NumericTraits< DerivativeValueType >::ZeroValue() );
+      dGamma_J.Fill( NumericTraits< DerivativeValueType >::ZeroValue() );
+
+      /** Loop over the neighbours. */
+      for( unsigned int p = 0; p < k; p++ )
+      {
+        /** Get the neighbour point z_ip^M. */
+        listSampleMoving->GetMeasurementVector( indices_M[ p ], z_M_ip );
+        listSampleMoving->GetMeasurementVector( indices_J[ p ], z_J_ip );
+
+        /** Get the distances. */
+        distance_M = vcl_sqrt( distances_M[ p ] );
+        distance_J = vcl_sqrt( distances_J[ p ] );
+
+        /** Compute Gamma's. */
+        Gamma_M += distance_M;
+        Gamma_J += distance_J;
+
+        /** Get the difference of z_ip^M with z_i^M. */
+        diff_M = z_M - z_M_ip;
+        diff_J = z_M - z_J_ip;
+
+        /** Compute derivatives. */
+        D2sparse_M = spatialDerivativesContainer[ indices_M[ p ] ]
+          * jacobianContainer[ indices_M[ p ] ];
+        D2sparse_J = spatialDerivativesContainer[ indices_J[ p ] ]
+          * jacobianContainer[ indices_J[ p ] ];
+
+        /** Update the dGamma's. */
+        this->UpdateDerivativeOfGammas(
+          D1sparse, D2sparse_M, D2sparse_J,
+          jacobianIndicesContainer[ i ],
+          jacobianIndicesContainer[ indices_M[ p ] ],
+          jacobianIndicesContainer[ indices_J[ p ] ],
+          diff_M, diff_J,
+          distance_M, distance_J,
+          dGamma_M, dGamma_J );
+
+      } // end loop over the k neighbours
+    }
+
+    /** Calculate the contribution of this query point. */
+    H = vcl_sqrt( Gamma_F * Gamma_M );
+    if( H > this->m_AvoidDivisionBy )
+    {
+      /** Compute some sums. */
+      G     = Gamma_J / H;
+      sumG += vcl_pow( G, twoGamma );
+
+      /** Compute the contribution to the derivative. */
+      if( par.st_DoDerivative )
+      {
+        Gpow          = vcl_pow( G, twoGamma - 1.0 );
+        contribution += ( Gpow / H ) * ( dGamma_J - ( 0.5 * Gamma_J / Gamma_M ) * dGamma_M );
+      }
+    }
+
+  } // end looping over the query points
+
+  threadData.st_SumG = sumG;
+
+} // end ThreadedComputeKNNContributions()
+
+
 /**
  * ************************ PrintSelf *************************
  */
@@ -1089,6 +1271,8 @@ KNNGraphAlphaMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
 
   os << indent << "Alpha: " << this->m_Alpha << std::endl;
   os << indent << "AvoidDivisionBy: " << this->m_AvoidDivisionBy << std::endl;
+  os << indent << "ReuseFixedTree: " << this->m_ReuseFixedTree << std::endl;
+  os << indent << "NumberOfFixedTreeReuses: " << this->m_NumberOfFixedTreeReuses << std::endl;
 
   os << indent << "BinaryKNNTreeFixed: "
      << this->m_BinaryKNNTreeFixed.GetPointer() << std::endl;
@@ -64,6 +64,12 @@ namespace elastix
  *    useful if you use high order B-spline interpolator for the moving image.\n
  *    example: <tt>(MovingLimitRangeRatio 0.001 0.01 0.01)</tt> \n
  *    The default value is 0.01. Can be given for each resolution, or for all resolutions at once.
+ * \parameter UseSparsePerThreadJointPDFs: Whether each thread only clears and
+ *    merges the joint histogram bins it actually used. This makes the merge of
+ *    the per-thread joint histograms cheaper for large histograms, many threads
+ *    and few samples.\n
+ *    example: <tt>(UseSparsePerThreadJointPDFs "true")</tt> \n
+ *    The default is "false". Can be given for each resolution, or for all resolutions at once.
  *
  * \sa ParzenWindowNormalizedMutualInformationImageToImageMetric
  * \ingroup Metrics
@@ -102,6 +102,12 @@ NormalizedMutualInformationMetric< TElastix >
   this->SetFixedKernelBSplineOrder( fixedKernelBSplineOrder );
   this->SetMovingKernelBSplineOrder( movingKernelBSplineOrder );
 
+  /** Set whether the threads should only clear and merge the touched bins. */
+  bool useSparsePerThreadJointPDFs = false;
+  this->GetConfiguration()->ReadParameter( useSparsePerThreadJointPDFs,
+    "UseSparsePerThreadJointPDFs", this->GetComponentLabel(), level, 0 );
+  this->SetUseSparsePerThreadJointPDFs( useSparsePerThreadJointPDFs );
+
 } // end BeforeEachResolution()
 
 
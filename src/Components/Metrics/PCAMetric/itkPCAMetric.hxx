@@ -20,7 +20,7 @@
 
 #include "itkPCAMetric.h"
 
-#include "itkMersenneTwisterRandomVariateGenerator.h"
+#include "itkThreadRandomGenerator.h"
 #include "vnl/algo/vnl_matrix_update.h"
 #include "itkImage.h"
 #include "vnl/algo/vnl_svd.h"
@@ -107,7 +107,7 @@ PCAMetric< TFixedImage, TMovingImage >
   numbers.clear();
 
   /** Initialize random number generator. */
-  Statistics::MersenneTwisterRandomVariateGenerator::Pointer randomGenerator = Statistics::MersenneTwisterRandomVariateGenerator::GetInstance();
+  Statistics::MersenneTwisterRandomVariateGenerator::Pointer randomGenerator = ThreadRandomGenerator::GetInstance();
 
   /** Sample additional at fixed timepoint. */
   for( unsigned int i = 0; i < m_NumAdditionalSamplesFixed; ++i )
@@ -20,7 +20,7 @@
 
 #include "itkPCAMetric2.h"
 
-#include "itkMersenneTwisterRandomVariateGenerator.h"
+#include "itkThreadRandomGenerator.h"
 #include "vnl/algo/vnl_matrix_update.h"
 #include "itkImage.h"
 #include "vnl/algo/vnl_svd.h"
@@ -93,7 +93,7 @@ PCAMetric2< TFixedImage, TMovingImage >
 
   /** Initialize random number generator. */
   Statistics::MersenneTwisterRandomVariateGenerator::Pointer randomGenerator
-    = Statistics::MersenneTwisterRandomVariateGenerator::GetInstance();
+    = ThreadRandomGenerator::GetInstance();
 
   /** Sample additional at fixed timepoint. */
   for( unsigned int i = 0; i < m_NumAdditionalSamplesFixed; ++i )
@@ -693,9 +693,9 @@ SumSquaredTissueVolumeDifferenceImageToImageMetric<TFixedImage, TMovingImage>
     this->m_ThreaderMetricParameters.st_NormalizationFactor =
       static_cast<DerivativeValueType>(this->m_NumberOfPixelsCounted);
 
-    this->m_Threader->SetSingleMethod(this->AccumulateDerivativesThreaderCallback,
+    PersistentThreadPool::SingleMethodExecute(this->m_Threader,
+      this->AccumulateDerivativesThreaderCallback,
       const_cast<void *>(static_cast<const void *>(&this->m_ThreaderMetricParameters)));
-    this->m_Threader->SingleMethodExecute();
   }
 
 #ifdef ELASTIX_USE_OPENMP
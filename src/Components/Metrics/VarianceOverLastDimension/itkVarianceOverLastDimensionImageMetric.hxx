@@ -19,7 +19,7 @@
 #define __itkVarianceOverLastDimensionImageMetric_hxx
 
 #include "itkVarianceOverLastDimensionImageMetric.h"
-#include "itkMersenneTwisterRandomVariateGenerator.h"
+#include "itkThreadRandomGenerator.h"
 #include "vnl/algo/vnl_matrix_update.h"
 #include <numeric>
 
@@ -138,7 +138,7 @@ VarianceOverLastDimensionImageMetric< TFixedImage, TMovingImage >
 
   /** Initialize random number generator. */
   Statistics::MersenneTwisterRandomVariateGenerator::Pointer randomGenerator
-    = Statistics::MersenneTwisterRandomVariateGenerator::GetInstance();
+    = ThreadRandomGenerator::GetInstance();
 
   /** Sample additional at fixed timepoint. */
   for( unsigned int i = 0; i < m_NumAdditionalSamplesFixed; ++i )
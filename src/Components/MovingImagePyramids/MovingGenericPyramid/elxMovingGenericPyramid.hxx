@@ -144,6 +144,12 @@ MovingGenericPyramid< TElastix >
     "ImagePyramidUseShrinkImageFilter", 0, false );
   this->SetUseShrinkImageFilter( useShrinkImageFilter );
 
+  /** Compute the levels from the next finer level, instead of from the input. */
+  bool computeFromPreviousLevel = false;
+  this->m_Configuration->ReadParameter( computeFromPreviousLevel,
+    "ImagePyramidComputeFromPreviousLevel", 0, false );
+  this->SetComputeFromPreviousLevel( computeFromPreviousLevel );
+
   /** Decide whether or not to compute the pyramid images only for the current
    * resolution. Setting the option to true saves memory, since only one level
    * of the pyramid gets allocated per resolution.
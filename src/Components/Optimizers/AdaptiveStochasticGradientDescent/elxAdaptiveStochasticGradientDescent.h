@@ -25,6 +25,8 @@
 #include "elxProgressCommand.h"
 #include "itkAdvancedTransform.h"
 #include "itkMersenneTwisterRandomVariateGenerator.h"
+#include "itkCostFunctionBatchEvaluator.h"
+#include <vector>
 
 namespace elastix
 {
@@ -281,6 +283,17 @@ public:
   /** Get the MaximumNumberOfSamplingAttempts. */
   itkGetConstReferenceMacro( MaximumNumberOfSamplingAttempts, SizeValueType );
 
+  /** Add an instance of the cost function that computes the same exact
+   * gradient independently of the registration metric, for example a clone
+   * of the metric with its own transform, and with a grid sampler when the
+   * metric uses a random sampler. When set, the exact gradients of the
+   * automatic parameter estimation are measured concurrently, each thread
+   * with its own instance. The scales are applied to the clones as well.
+   * Default: none, i.e. the gradients are measured one by one.
+   */
+  void AddCostFunctionClone( CostFunctionType * costFunction );
+  void RemoveAllCostFunctionClones( void );
+
 protected:
 
   /** Protected typedefs */
@@ -354,6 +367,18 @@ protected:
   /** RandomGenerator for AddRandomPerturbation. */
   RandomGeneratorPointer m_RandomGenerator;
 
+  /** The generators of the threads of AddRandomPerturbation, which are
+   * created before the threads are started.
+   */
+  std::vector< RandomGeneratorPointer > m_PerturbationGenerators;
+
+  /** The evaluator of the exact gradients in SampleGradients, with the
+   * registration metric and its clones.
+   */
+  typedef itk::CostFunctionBatchEvaluator GradientEvaluatorType;
+  GradientEvaluatorType::Pointer     m_GradientEvaluator;
+  std::vector< CostFunctionPointer > m_CostFunctionClones;
+
   double m_SigmoidScaleFactor;
 
   /** Check if the transform is an advanced transform. Called by Initialize. */
@@ -385,6 +410,10 @@ protected:
    * Gradients are measured at position mu_n, which are generated according to:
    * mu_n - mu_0 ~ N(0, perturbationSigma^2 I );
    * gg = g^T g, etc.
+   * The exact gradients are measured in batches, concurrently when clones
+   * of the cost function are set. The approximate gradients need new
+   * samples of the random samplers of the registration, so they are
+   * measured one by one.
    */
   virtual void SampleGradients( const ParametersType & mu0,
     double perturbationSigma, double & gg, double & ee );
@@ -397,9 +426,22 @@ protected:
 
   /** Helper function that adds a random perturbation delta to the input
    * parameters, with delta ~ sigma * N(0,I). Used by SampleGradients.
+   * The parameters are perturbed multi-threaded, in blocks that each have
+   * their own random generator, seeded from m_RandomGenerator. The result
+   * therefore does not depend on the number of threads.
    */
   virtual void AddRandomPerturbation( ParametersType & parameters, double sigma );
 
+  /** Helper struct and threader callback for AddRandomPerturbation. */
+  struct PerturbationThreaderParameterType
+  {
+    ParametersType *                          st_Parameters;
+    double                                    st_Sigma;
+    typename RandomGeneratorType::IntegerType st_Seed;
+    RandomGeneratorPointer *                  st_Generators;
+  };
+  static ITK_THREAD_RETURN_TYPE AddRandomPerturbationThreaderCallback( void * arg );
+
 private:
 
   AdaptiveStochasticGradientDescent( const Self & );  // purposely not implemented
@@ -28,6 +28,8 @@
 #include <utility>
 #include "itkAdvancedImageToImageMetric.h"
 #include "itkTimeProbe.h"
+#include "itkPersistentThreadPool.h"
+#include "itkThreadRandomGenerator.h"
 
 namespace elastix
 {
@@ -53,8 +55,9 @@ AdaptiveStochasticGradientDescent< TElastix >
   this->m_NumberOfSamplesForExactGradient = 100000;
   this->m_SigmoidScaleFactor              = 0.1;
 
-  this->m_RandomGenerator   = RandomGeneratorType::GetInstance();
+  this->m_RandomGenerator   = itk::ThreadRandomGenerator::GetInstance();
   this->m_AdvancedTransform = 0;
+  this->m_GradientEvaluator = GradientEvaluatorType::New();
 
   this->m_UseNoiseCompensation        = true;
   this->m_OriginalButSigmoidToDefault = false;
@@ -573,6 +576,7 @@ AdaptiveStochasticGradientDescent< TElastix >
     this->m_NumberOfBandStructureSamples );
   computeJacobianTerms->SetNumberOfJacobianMeasurements(
     this->m_NumberOfJacobianMeasurements );
+  computeJacobianTerms->SetNumberOfThreads( this->m_Threader->GetNumberOfThreads() );
 
   /** Check if use scales. */
   bool useScales = this->GetUseScales();
@@ -873,6 +877,20 @@ AdaptiveStochasticGradientDescent< TElastix >
 
         } // end if random coordinate sampler
 
+        /** Metrics that share a random sampler also share the grid sampler,
+         * so that the grid is sampled once and the metrics keep sharing
+         * their samples, e.g. for the shared transform evaluation.
+         */
+        for( unsigned int k = 0; k < m; ++k )
+        {
+          if( randomSamplerVec[ k ] == randomSamplerVec[ m ] )
+          {
+            gridSamplerVec[ m ] = gridSamplerVec[ k ];
+            break;
+          }
+        }
+        if( gridSamplerVec[ m ].IsNotNull() ) { continue; }
+
         /** Set up the grid sampler for the "exact" gradients.
          * Copy settings from the random sampler and update.
          */
@@ -911,28 +929,53 @@ AdaptiveStochasticGradientDescent< TElastix >
   const unsigned int P = this->GetElastix()->GetElxTransformBase()
     ->GetAsITKBaseType()->GetNumberOfParameters();
   DerivativeType approxgradient( P );
-  DerivativeType exactgradient( P );
   DerivativeType diffgradient;
   double         exactgg = 0.0;
   double         diffgg  = 0.0;
 
+  /** The exact gradients are computed by the registration metric and its
+   * clones, with the scales of the optimizer. One batch has as many
+   * measurements as can be evaluated concurrently.
+   */
+  this->m_GradientEvaluator->RemoveAllCostFunctions();
+  this->m_GradientEvaluator->AddCostFunction( this->m_ScaledCostFunction );
+  for( unsigned int i = 0; i < this->m_CostFunctionClones.size(); ++i )
+  {
+    ScaledCostFunctionPointer scaledClone = ScaledCostFunctionType::New();
+    scaledClone->SetUnscaledCostFunction( this->m_CostFunctionClones[ i ] );
+    scaledClone->SetScales( this->m_ScaledCostFunction->GetScales() );
+    scaledClone->SetUseScales( this->m_ScaledCostFunction->GetUseScales() );
+    scaledClone->SetNegateCostFunction( this->m_ScaledCostFunction->GetNegateCostFunction() );
+    this->m_GradientEvaluator->AddCostFunction( scaledClone );
+  }
+  this->m_GradientEvaluator->SetNumberOfThreads( this->m_Threader->GetNumberOfThreads() );
+  const SizeValueType batchSize = vnl_math_max( static_cast< SizeValueType >( 1 ),
+    static_cast< SizeValueType >( this->m_GradientEvaluator->GetNumberOfConcurrentEvaluations() ) );
+
+  GradientEvaluatorType::ParametersContainerType perturbedMu0;
+  GradientEvaluatorType::MeasureContainerType    dummyvalues;
+  GradientEvaluatorType::DerivativeContainerType exactgradients;
+  GradientEvaluatorType::FailureContainerType    failures;
+  GradientEvaluatorType::ExceptionContainerType  exceptions;
+
   /** Compute gg for some random parameters. */
-  for( unsigned int i = 0; i < this->m_NumberOfGradientMeasurements; ++i )
+  for( SizeValueType start = 0; start < this->m_NumberOfGradientMeasurements; start += batchSize )
   {
-#ifndef _ELASTIX_BUILD_LIBRARY
-    /** Show progress 0-100% */
-    progressObserver->UpdateAndPrintProgress( i );
-#endif
-    /** Generate a perturbation, according to:
+    const SizeValueType end = vnl_math_min( start + batchSize,
+      static_cast< SizeValueType >( this->m_NumberOfGradientMeasurements ) );
+
+    /** Generate the perturbations of this batch, according to:
      *    \mu_i ~ N( \mu_0, perturbationsigma^2 I ).
      */
-    ParametersType perturbedMu0 = mu0;
-    this->AddRandomPerturbation( perturbedMu0, perturbationSigma );
+    perturbedMu0.assign( end - start, mu0 );
+    for( SizeValueType i = start; i < end; ++i )
+    {
+      this->AddRandomPerturbation( perturbedMu0[ i - start ], perturbationSigma );
+    }
 
-    /** Compute contribution to exactgg and diffgg. */
+    /** Set grid sampler(s) and get the exact derivatives. */
     if( stochasticgradients )
     {
-      /** Set grid sampler(s) and get exact derivative. */
       for( unsigned int m = 0; m < M; ++m )
       {
         if( gridSamplerVec[ m ].IsNotNull() )
@@ -941,9 +984,22 @@ AdaptiveStochasticGradientDescent< TElastix >
           ->SetAdvancedMetricImageSampler( gridSamplerVec[ m ] );
         }
       }
-      this->GetScaledDerivativeWithExceptionHandling( perturbedMu0, exactgradient );
+    }
+    this->m_GradientEvaluator->EvaluateValuesAndDerivatives(
+      perturbedMu0, dummyvalues, exactgradients, failures, exceptions );
+    for( SizeValueType i = start; i < end; ++i )
+    {
+      if( failures[ i - start ] )
+      {
+        this->m_StopCondition = MetricError;
+        this->StopOptimization();
+        throw exceptions[ i - start ];
+      }
+    }
 
-      /** Set random sampler(s), select new spatial samples and get approximate derivative. */
+    /** Set random sampler(s). */
+    if( stochasticgradients )
+    {
       for( unsigned int m = 0; m < M; ++m )
       {
         if( randomSamplerVec[ m ].IsNotNull() )
@@ -952,24 +1008,35 @@ AdaptiveStochasticGradientDescent< TElastix >
           SetAdvancedMetricImageSampler( randomSamplerVec[ m ] );
         }
       }
-      this->SelectNewSamples();
-      this->GetScaledDerivativeWithExceptionHandling( perturbedMu0, approxgradient );
-
-      /** Compute error vector. */
-      diffgradient = exactgradient - approxgradient;
-
-      /** Compute g^T g and e^T e */
-      exactgg += exactgradient.squared_magnitude();
-      diffgg  += diffgradient.squared_magnitude();
     }
-    else // no stochastic gradients
+
+    /** Compute contribution to exactgg and diffgg. */
+    for( SizeValueType i = start; i < end; ++i )
     {
-      /** Get exact gradient. */
-      this->GetScaledDerivativeWithExceptionHandling( perturbedMu0, exactgradient );
+#ifndef _ELASTIX_BUILD_LIBRARY
+      /** Show progress 0-100% */
+      progressObserver->UpdateAndPrintProgress( i );
+#endif
+      const DerivativeType & exactgradient = exactgradients[ i - start ];
+      if( stochasticgradients )
+      {
+        /** Select new spatial samples and get approximate derivative. */
+        this->SelectNewSamples();
+        this->GetScaledDerivativeWithExceptionHandling( perturbedMu0[ i - start ], approxgradient );
 
-      /** Compute g^T g. NB: diffgg=0. */
-      exactgg += exactgradient.squared_magnitude();
-    } // end else: no stochastic gradients
+        /** Compute error vector. */
+        diffgradient = exactgradient - approxgradient;
+
+        /** Compute g^T g and e^T e */
+        exactgg += exactgradient.squared_magnitude();
+        diffgg  += diffgradient.squared_magnitude();
+      }
+      else // no stochastic gradients
+      {
+        /** Compute g^T g. NB: diffgg=0. */
+        exactgg += exactgradient.squared_magnitude();
+      } // end else: no stochastic gradients
+    }
 
   } // end for loop over gradient measurements
 
@@ -1125,15 +1192,105 @@ void
 AdaptiveStochasticGradientDescent< TElastix >
 ::AddRandomPerturbation( ParametersType & parameters, double sigma )
 {
-  /** Add delta ~ sigma * N(0,I) to the input parameters. */
-  for( unsigned int p = 0; p < parameters.GetSize(); ++p )
+  /** Add delta ~ sigma * N(0,I) to the input parameters. Only the seed
+   * is drawn from the shared generator; the blocks are perturbed in parallel.
+   */
+  PerturbationThreaderParameterType temp;
+  temp.st_Parameters = &parameters;
+  temp.st_Sigma      = sigma;
+  temp.st_Seed       = this->m_RandomGenerator->GetIntegerVariate();
+
+  /** Each thread uses its own generator, created here. */
+  const ThreadIdType numberOfThreads = this->m_Threader->GetNumberOfThreads();
+  while( this->m_PerturbationGenerators.size() < numberOfThreads )
   {
-    parameters[ p ] += sigma * this->m_RandomGenerator->GetNormalVariate( 0.0, 1.0 );
+    this->m_PerturbationGenerators.push_back( itk::ThreadRandomGenerator::New() );
   }
+  temp.st_Generators = &this->m_PerturbationGenerators[ 0 ];
+
+  itk::PersistentThreadPool::SingleMethodExecute( this->m_Threader,
+    AddRandomPerturbationThreaderCallback, &temp );
 
 } // end AddRandomPerturbation()
 
 
+/**
+ * *************** AddRandomPerturbationThreaderCallback ***************
+ */
+
+template< class TElastix >
+ITK_THREAD_RETURN_TYPE
+AdaptiveStochasticGradientDescent< TElastix >
+::AddRandomPerturbationThreaderCallback( void * arg )
+{
+  typedef itk::MultiThreader::ThreadInfoStruct ThreadInfoType;
+  ThreadInfoType * infoStruct  = static_cast< ThreadInfoType * >( arg );
+  ThreadIdType     threadId    = infoStruct->ThreadID;
+  ThreadIdType     nrOfThreads = infoStruct->NumberOfThreads;
+
+  PerturbationThreaderParameterType * temp
+    = static_cast< PerturbationThreaderParameterType * >( infoStruct->UserData );
+  ParametersType & parameters = *( temp->st_Parameters );
+
+  /** The blocks are distributed round-robin over the threads. Each block
+   * has its own generator, so that the perturbation of a block is the same
+   * for any number of threads.
+   */
+  const SizeValueType    blockSize          = 4096;
+  const SizeValueType    numberOfParameters = parameters.GetSize();
+  const SizeValueType    numberOfBlocks
+    = ( numberOfParameters + blockSize - 1 ) / blockSize;
+  RandomGeneratorType * generator = temp->st_Generators[ threadId ];
+  for( SizeValueType b = threadId; b < numberOfBlocks; b += nrOfThreads )
+  {
+    generator->Initialize( static_cast< typename RandomGeneratorType::IntegerType >(
+      temp->st_Seed + b ) );
+    const SizeValueType pos_end = vnl_math_min( ( b + 1 ) * blockSize, numberOfParameters );
+    for( SizeValueType p = b * blockSize; p < pos_end; ++p )
+    {
+      parameters[ p ] += temp->st_Sigma * generator->GetNormalVariate( 0.0, 1.0 );
+    }
+  }
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end AddRandomPerturbationThreaderCallback()
+
+
+/**
+ * *************** AddCostFunctionClone ***************
+ */
+
+template< class TElastix >
+void
+AdaptiveStochasticGradientDescent< TElastix >
+::AddCostFunctionClone( CostFunctionType * costFunction )
+{
+  if( costFunction == NULL )
+  {
+    itkExceptionMacro( << "The cost function clone should not be NULL." );
+  }
+  this->m_CostFunctionClones.push_back( costFunction );
+  this->Modified();
+
+} // end AddCostFunctionClone()
+
+
+/**
+ * *************** RemoveAllCostFunctionClones ***************
+ */
+
+template< class TElastix >
+void
+AdaptiveStochasticGradientDescent< TElastix >
+::RemoveAllCostFunctionClones( void )
+{
+  this->m_CostFunctionClones.clear();
+  this->Modified();
+
+} // end RemoveAllCostFunctionClones()
+
+
 } // end namespace elastix
 
 #endif // end #ifndef __elxAdaptiveStochasticGradientDescent_hxx
@@ -21,6 +21,7 @@
 
 #include "itkCMAEvolutionStrategyOptimizer.h"
 #include "itkSymmetricEigenAnalysis.h"
+#include "itkThreadRandomGenerator.h"
 #include "vnl/vnl_math.h"
 #include <algorithm>
 #include "itkCommand.h"
@@ -38,7 +39,8 @@ CMAEvolutionStrategyOptimizer::CMAEvolutionStrategyOptimizer()
 {
   itkDebugMacro( "Constructor" );
 
-  this->m_RandomGenerator = RandomGeneratorType::GetInstance();
+  this->m_RandomGenerator = ThreadRandomGenerator::GetInstance();
+  this->m_OffspringEvaluator = CostFunctionBatchEvaluator::New();
 
   this->m_CurrentValue     = NumericTraits< MeasureType >::Zero;
   this->m_CurrentIteration = 0;
@@ -124,6 +126,7 @@ CMAEvolutionStrategyOptimizer::PrintSelf( std::ostream & os, Indent indent ) con
   os << indent << "m_PositionToleranceMin: " << this->m_PositionToleranceMin << std::endl;
   os << indent << "m_PositionToleranceMax: " << this->m_PositionToleranceMax << std::endl;
   os << indent << "m_ValueTolerance: " << this->m_ValueTolerance << std::endl;
+  os << indent << "m_CostFunctionClones: " << this->m_CostFunctionClones.size() << std::endl;
 
   os << indent << "m_RecombinationWeights: " << this->m_RecombinationWeights << std::endl;
   os << indent << "m_C: " << this->m_C << std::endl;
@@ -190,6 +193,9 @@ CMAEvolutionStrategyOptimizer::ResumeOptimization()
   this->m_Stop          = false;
   this->m_StopCondition = Unknown;
 
+  /** Prepare the concurrent evaluation of the offspring. */
+  this->InitializeOffspringEvaluator();
+
   this->InvokeEvent( StartEvent() );
 
   try
@@ -491,6 +497,93 @@ CMAEvolutionStrategyOptimizer::InitializeBCD( void )
 }   // end InitializeBCD
 
 
+/**
+ * ****************** AddCostFunctionClone *********************
+ */
+
+void
+CMAEvolutionStrategyOptimizer::AddCostFunctionClone( CostFunctionType * costFunction )
+{
+  if( costFunction == NULL )
+  {
+    itkExceptionMacro( << "The cost function clone should not be NULL." );
+  }
+  this->m_CostFunctionClones.push_back( costFunction );
+  this->Modified();
+
+}   // end AddCostFunctionClone
+
+
+/**
+ * ****************** RemoveAllCostFunctionClones *********************
+ */
+
+void
+CMAEvolutionStrategyOptimizer::RemoveAllCostFunctionClones( void )
+{
+  this->m_CostFunctionClones.clear();
+  this->Modified();
+
+}   // end RemoveAllCostFunctionClones
+
+
+/**
+ * ****************** InitializeOffspringEvaluator *********************
+ */
+
+void
+CMAEvolutionStrategyOptimizer::InitializeOffspringEvaluator( void )
+{
+  itkDebugMacro( "InitializeOffspringEvaluator" );
+
+  /** The first instance is the scaled cost function itself. */
+  this->m_OffspringEvaluator->RemoveAllCostFunctions();
+  this->m_OffspringEvaluator->AddCostFunction( this->m_ScaledCostFunction );
+
+  /** Wrap the clones with the same scaling. */
+  for( unsigned int i = 0; i < this->m_CostFunctionClones.size(); ++i )
+  {
+    ScaledCostFunctionPointer scaledClone = ScaledCostFunctionType::New();
+    scaledClone->SetUnscaledCostFunction( this->m_CostFunctionClones[ i ] );
+    scaledClone->SetScales( this->m_ScaledCostFunction->GetScales() );
+    scaledClone->SetUseScales( this->m_ScaledCostFunction->GetUseScales() );
+    scaledClone->SetNegateCostFunction( this->m_ScaledCostFunction->GetNegateCostFunction() );
+    this->m_OffspringEvaluator->AddCostFunction( scaledClone );
+  }
+
+}   // end InitializeOffspringEvaluator
+
+
+/**
+ * ****************** DrawSearchDirection *********************
+ */
+
+void
+CMAEvolutionStrategyOptimizer::DrawSearchDirection( unsigned int lam )
+{
+  const unsigned int N = this->GetScaledCostFunction()->GetNumberOfParameters();
+
+  /** draw from distribution N(0,I) */
+  for( unsigned int par = 0; par < N; ++par )
+  {
+    this->m_NormalizedSearchDirs[ lam ][ par ]
+      = this->m_RandomGenerator->GetNormalVariate();
+  }
+  /** Make like it was drawn from N(0,C) */
+  if( this->GetUseCovarianceMatrixAdaptation() )
+  {
+    this->m_SearchDirs[ lam ] = this->m_B * ( this->m_D * this->m_NormalizedSearchDirs[ lam ] );
+  }
+  else
+  {
+    this->m_SearchDirs[ lam ] = this->m_NormalizedSearchDirs[ lam ];
+  }
+  /** Make like it was drawn from N( 0, sigma^2 C ) */
+  this->m_SearchDirs[ lam ] *= this->m_CurrentSigma;
+
+}   // end DrawSearchDirection
+
+
 /**
  * ****************** GenerateOffspring *********************
  */
@@ -500,73 +593,68 @@ CMAEvolutionStrategyOptimizer::GenerateOffspring( void )
 {
   itkDebugMacro( "GenerateOffspring" );
 
-  /** Get the number of parameters from the cost function */
-  const unsigned int numberOfParameters
-    = this->GetScaledCostFunction()->GetNumberOfParameters();
-
   /** Some casts/aliases: */
-  const unsigned int N      = numberOfParameters;
   const unsigned int lambda = this->m_PopulationSize;
 
   /** Clear the old values */
   this->m_CostFunctionValues.clear();
 
-  /** Fill the m_NormalizedSearchDirs and SearchDirs */
-  unsigned int lam       = 0;
-  unsigned int nrOfFails = 0;
-  while( lam < lambda )
+  /** The offspring members that still need a cost function value, and
+   * the number of failed evaluations in a row, in the order in which they
+   * were evaluated. */
+  std::vector< unsigned int > todo( lambda );
+  unsigned int                nrOfFails = 0;
+  for( unsigned int lam = 0; lam < lambda; ++lam )
   {
-    /** draw from distribution N(0,I) */
-    for( unsigned int par = 0; par < N; ++par )
-    {
-      this->m_NormalizedSearchDirs[ lam ][ par ]
-        = this->m_RandomGenerator->GetNormalVariate();
-    }
-    /** Make like it was drawn from N(0,C) */
-    if( this->GetUseCovarianceMatrixAdaptation() )
-    {
-      this->m_SearchDirs[ lam ] = this->m_B * ( this->m_D * this->m_NormalizedSearchDirs[ lam ] );
-    }
-    else
-    {
-      this->m_SearchDirs[ lam ] = this->m_NormalizedSearchDirs[ lam ];
-    }
-    /** Make like it was drawn from N( 0, sigma^2 C ) */
-    this->m_SearchDirs[ lam ] *= this->m_CurrentSigma;
-
-    /** Compute the cost function */
-    MeasureType costFunctionValue = 0.0;
-    /** x_lam = m + d_lam */
-    ParametersType x_lam = this->GetScaledCurrentPosition();
-    x_lam += this->m_SearchDirs[ lam ];
-    try
+    todo[ lam ] = lam;
+  }
+
+  CostFunctionBatchEvaluator::ParametersContainerType   positions;
+  CostFunctionBatchEvaluator::MeasureContainerType      values;
+  CostFunctionBatchEvaluator::FailureContainerType      failures;
+  CostFunctionBatchEvaluator::ExceptionContainerType    exceptions;
+  while( !todo.empty() )
+  {
+    /** Fill the m_NormalizedSearchDirs and SearchDirs, in the same order
+     * as when the offspring would be evaluated one by one.
+     * x_lam = m + d_lam */
+    positions.resize( todo.size() );
+    for( unsigned int k = 0; k < todo.size(); ++k )
     {
-      costFunctionValue = this->GetScaledValue( x_lam );
+      this->DrawSearchDirection( todo[ k ] );
+      positions[ k ]  = this->GetScaledCurrentPosition();
+      positions[ k ] += this->m_SearchDirs[ todo[ k ] ];
     }
-    catch( ExceptionObject & err )
+
+    /** Compute the cost function values, concurrently if clones are available. */
+    this->m_OffspringEvaluator->Evaluate( positions, values, failures, exceptions );
+
+    std::vector< unsigned int > failed;
+    for( unsigned int k = 0; k < todo.size(); ++k )
     {
-      ++nrOfFails;
-      /** try another parameter vector if we haven't tried that for 10 times already */
-      if( nrOfFails <= 10 )
+      const unsigned int lam = todo[ k ];
+      if( !failures[ k ] )
       {
+        /** Successfull cost function evaluation */
+        this->m_CostFunctionValues.push_back(
+          MeasureIndexPairType( values[ k ], lam ) );
+
+        /** Reset the number of failed cost function evaluations */
+        nrOfFails = 0;
         continue;
       }
-      else
+
+      /** try another parameter vector if we haven't tried that for 10 times already */
+      ++nrOfFails;
+      if( nrOfFails > 10 )
       {
         this->m_StopCondition = MetricError;
         this->StopOptimization();
-        throw err;
+        throw exceptions[ k ];
       }
+      failed.push_back( lam );
     }
-    /** Successfull cost function evaluation */
-    this->m_CostFunctionValues.push_back(
-      MeasureIndexPairType( costFunctionValue, lam ) );
-
-    /** Reset the number of failed cost function evaluations */
-    nrOfFails = 0;
-
-    /** next offspring member */
-    ++lam;
+    todo.swap( failed );
   }
 
 }   // end GenerateOffspring
@@ -20,6 +20,7 @@
 #define __itkCMAEvolutionStrategyOptimizer_h
 
 #include "itkScaledSingleValuedNonLinearOptimizer.h"
+#include "itkCostFunctionBatchEvaluator.h"
 #include <vector>
 #include <utility>
 #include <deque>
@@ -219,6 +220,21 @@ public:
   itkSetMacro( ValueTolerance, double );
   itkGetConstMacro( ValueTolerance, double );
 
+  /** Setting: additional instances of the cost function, that compute the
+   * same value independently of the cost function, for example clones of
+   * a metric with their own transform. When set, the offspring of each
+   * generation are evaluated concurrently, each thread with its own instance.
+   * The scales and the Maximize flag are applied to the clones as well.
+   * Default: none, i.e. the offspring are evaluated one by one. */
+  void AddCostFunctionClone( CostFunctionType * costFunction );
+  void RemoveAllCostFunctionClones( void );
+
+  /** Set the number of threads used to evaluate the offspring. */
+  void SetNumberOfThreads( ThreadIdType numberOfThreads )
+  {
+    this->m_OffspringEvaluator->SetNumberOfThreads( numberOfThreads );
+  }
+
 protected:
 
   typedef Array< double >               RecombinationWeightsType;
@@ -236,6 +252,10 @@ protected:
   /** The random number generator used to generate the offspring. */
   RandomGeneratorType::Pointer m_RandomGenerator;
 
+  /** The evaluator of the offspring, and the clones of the cost function. */
+  CostFunctionBatchEvaluator::Pointer      m_OffspringEvaluator;
+  std::vector< CostFunctionType::Pointer > m_CostFunctionClones;
+
   /** The value of the cost function at the current position */
   MeasureType m_CurrentValue;
 
@@ -354,10 +374,18 @@ protected:
   /** Initialize the covariance matrix and its eigen decomposition */
   virtual void InitializeBCD( void );
 
+  /** Fill the offspring evaluator with the scaled cost function and
+   * scaled versions of the cost function clones. */
+  virtual void InitializeOffspringEvaluator( void );
+
   /** GenerateOffspring: Fill m_SearchDirs, m_NormalizedSearchDirs,
-   * and m_CostFunctionValues */
+   * and m_CostFunctionValues. The offspring of which the cost function
+   * evaluation failed are drawn again, at most 10 times in a row. */
   virtual void GenerateOffspring( void );
 
+  /** Draw the search direction of offspring member lam. */
+  virtual void DrawSearchDirection( unsigned int lam );
+
   /** Sort the m_CostFunctionValues vector and update m_MeasureHistory */
   virtual void SortCostFunctionValues( void );
 
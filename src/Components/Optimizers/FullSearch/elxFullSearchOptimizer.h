@@ -48,6 +48,17 @@ namespace elastix
  *   This varies the second transform parameter in the range [-4.0 3.0] with steps of 1.0
  *   and the third parameter in the range [-1.0 1.0] with steps of 0.5. The names are used
  *   as column headers in the screen output.
+ * \parameter NumberOfRefinementLevels: Enables a coarse-to-fine search when larger than 0.
+ *   The search space is first scanned with a step of 2^L grid points, after which the best
+ *   points are refined L times by evaluating their neighbours with half the previous step.
+ *   Points of the optimization surface that are not visited remain 0.
+ *   Can be given for each resolution.\n
+ *   example: <tt>(NumberOfRefinementLevels 2 2 0)</tt> \n
+ *   The default is 0, which scans the full search space.
+ * \parameter NumberOfRefinementCandidates: The number of best points that are refined
+ *   at each refinement level. Can be given for each resolution.\n
+ *   example: <tt>(NumberOfRefinementCandidates 4 4 1)</tt> \n
+ *   The default is 4.
  *
  * \ingroup Optimizers
  * \sa FullSearchOptimizer
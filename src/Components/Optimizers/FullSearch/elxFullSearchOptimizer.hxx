@@ -178,6 +178,7 @@ FullSearch< TElastix >
     this->m_OptimizationSurface->SetRegions(
       this->GetSearchSpaceSize() );
     this->m_OptimizationSurface->Allocate();
+    this->m_OptimizationSurface->FillBuffer( 0.0f );
     /** \todo try/catch block around Allocate? */
 
     /** Set the name of this image on disk. */
@@ -193,10 +194,33 @@ FullSearch< TElastix >
       << "." << resultImageFormat;
     this->m_OptimizationSurface->SetOutputFileName( makeString.str().c_str() );
 
-    elxout
-      << "Total number of iterations needed in this resolution: "
-      << this->GetNumberOfIterations()
-      << "." << std::endl;
+    /** Read the settings of the coarse-to-fine search. */
+    unsigned int numberOfRefinementLevels = 0;
+    this->GetConfiguration()->ReadParameter( numberOfRefinementLevels,
+      "NumberOfRefinementLevels", this->GetComponentLabel(), level, 0 );
+    this->SetNumberOfRefinementLevels( numberOfRefinementLevels );
+
+    unsigned int numberOfRefinementCandidates = 4;
+    this->GetConfiguration()->ReadParameter( numberOfRefinementCandidates,
+      "NumberOfRefinementCandidates", this->GetComponentLabel(), level, 0 );
+    this->SetNumberOfRefinementCandidates( numberOfRefinementCandidates );
+
+    if( numberOfRefinementLevels > 0 )
+    {
+      elxout
+        << "Searching coarse-to-fine, with "
+        << numberOfRefinementLevels
+        << " refinement levels; at most "
+        << this->GetNumberOfIterations()
+        << " iterations are needed in this resolution." << std::endl;
+    }
+    else
+    {
+      elxout
+        << "Total number of iterations needed in this resolution: "
+        << this->GetNumberOfIterations()
+        << "." << std::endl;
+    }
 
   }
   else
@@ -24,6 +24,9 @@
 #include "itkEventObject.h"
 #include "itkExceptionObject.h"
 #include "itkNumericTraits.h"
+#include <algorithm>
+#include <map>
+#include <set>
 
 namespace itk
 {
@@ -45,6 +48,10 @@ FullSearchOptimizer
   m_NumberOfSearchSpaceDimensions = 0;
   m_SearchSpace                   = 0;
   m_LastSearchSpaceChanges        = 0;
+  m_BatchSize                     = 64;
+  m_NumberOfRefinementLevels      = 0;
+  m_NumberOfRefinementCandidates  = 4;
+  m_BatchEvaluator                = CostFunctionBatchEvaluator::New();
 
 }   //end constructor
 
@@ -97,56 +104,354 @@ FullSearchOptimizer
 
   m_Stop = false;
 
+  /** The cost function itself is the first instance of the evaluator. */
+  m_BatchEvaluator->RemoveAllCostFunctions();
+  m_BatchEvaluator->AddCostFunction( m_CostFunction );
+  for( unsigned int i = 0; i < m_CostFunctionClones.size(); ++i )
+  {
+    m_BatchEvaluator->AddCostFunction( m_CostFunctionClones[ i ] );
+  }
+
   InvokeEvent( StartEvent() );
+
+  if( m_NumberOfRefinementLevels > 0 )
+  {
+    this->ResumeHierarchicalSearch();
+  }
+  else
+  {
+    this->ResumeFullSearch();
+  }
+
+}   //end function ResumeOptimization
+
+
+/**
+ * ******************** ResumeFullSearch ******************
+ */
+void
+FullSearchOptimizer
+::ResumeFullSearch( void )
+{
+  const unsigned long                 nrOfIterations = this->GetNumberOfIterations();
+  std::vector< SearchSpaceIndexType > indices;
+  std::vector< MeasureType >          values;
+  SearchSpaceIndexType                index = m_CurrentIndexInSearchSpace;
+
   while( !m_Stop )
   {
+    /** Collect the next batch of grid points. */
+    indices.clear();
+    for( unsigned long it = m_CurrentIteration;
+      it < nrOfIterations && indices.size() < m_BatchSize; ++it )
+    {
+      indices.push_back( index );
+      this->IncrementIndex( index );
+    }
 
-    try
+    this->EvaluateIndices( indices, values );
+
+    if( m_Stop )
     {
-      m_Value = m_CostFunction->GetValue( this->GetCurrentPosition() );
+      /** Stopped by an observer: continue after the last processed point
+       * when the optimization is resumed. */
+      this->IncrementIndex( m_CurrentIndexInSearchSpace );
+      m_CurrentPointInSearchSpace = this->IndexToPoint( m_CurrentIndexInSearchSpace );
+      break;
     }
-    catch( ExceptionObject & err )
+
+    if( m_CurrentIteration >= nrOfIterations )
     {
-      // An exception has occurred.
-      // Terminate immediately.
-      m_StopCondition = MetricError;
+      m_StopCondition = FullRangeSearched;
       StopOptimization();
+      break;
+    }
+
+  }   // end while
+
+}   // end function ResumeFullSearch
+
+
+/**
+ * ******************** ResumeHierarchicalSearch ******************
+ */
+void
+FullSearchOptimizer
+::ResumeHierarchicalSearch( void )
+{
+  const unsigned int        searchSpaceDimension = this->GetNumberOfSearchSpaceDimensions();
+  const SearchSpaceSizeType searchSpaceSize      = this->GetSearchSpaceSize();
+
+  /** Levels with a step of at least the size of the search space only
+   * visit its corners, so use at most one of them. This also keeps the
+   * step 2^L within the range of IndexValueType. */
+  IndexValueType largestSize = 1;
+  for( unsigned int ssdim = 0; ssdim < searchSpaceDimension; ssdim++ )
+  {
+    largestSize = std::max( largestSize, static_cast< IndexValueType >( searchSpaceSize[ ssdim ] ) );
+  }
+  unsigned int   L           = 0;
+  IndexValueType largestStep = 1;
+  while( L < m_NumberOfRefinementLevels && largestStep < largestSize )
+  {
+    largestStep *= 2;
+    ++L;
+  }
+
+  /** Grid points are identified by their linear index, with the first
+   * dimension running fastest, as in UpdateCurrentPosition(). */
+  std::vector< unsigned long > multipliers( searchSpaceDimension, 1 );
+  for( unsigned int ssdim = 1; ssdim < searchSpaceDimension; ssdim++ )
+  {
+    multipliers[ ssdim ] = multipliers[ ssdim - 1 ] * searchSpaceSize[ ssdim - 1 ];
+  }
 
-      // Pass exception to caller
-      throw err;
+  /** The values of all evaluated grid points. */
+  std::map< unsigned long, MeasureType > evaluated;
+
+  std::vector< SearchSpaceIndexType >                    candidates;
+  std::vector< SearchSpaceIndexType >                    proposals;
+  std::vector< SearchSpaceIndexType >                    indices;
+  std::vector< MeasureType >                             values;
+  std::vector< std::pair< MeasureType, unsigned long > > ranking;
+  SearchSpaceIndexType                                   index( searchSpaceDimension );
+
+  for( unsigned int level = 0; level <= L && !m_Stop; ++level )
+  {
+    const IndexValueType stride = static_cast< IndexValueType >( 1 ) << ( L - level );
+    proposals.clear();
+
+    if( level == 0 )
+    {
+      /** The coarse grid: the multiples of the stride and the last index. */
+      std::vector< std::vector< IndexValueType > > coarse( searchSpaceDimension );
+      for( unsigned int ssdim = 0; ssdim < searchSpaceDimension; ssdim++ )
+      {
+        const IndexValueType last = static_cast< IndexValueType >( searchSpaceSize[ ssdim ] ) - 1;
+        for( IndexValueType i = 0; i <= last; i += stride )
+        {
+          coarse[ ssdim ].push_back( i );
+        }
+        if( coarse[ ssdim ].back() != last )
+        {
+          coarse[ ssdim ].push_back( last );
+        }
+      }
+
+      std::vector< unsigned int > pos( searchSpaceDimension, 0 );
+      bool                        done = ( searchSpaceDimension == 0 );
+      while( !done )
+      {
+        for( unsigned int ssdim = 0; ssdim < searchSpaceDimension; ssdim++ )
+        {
+          index[ ssdim ] = coarse[ ssdim ][ pos[ ssdim ] ];
+        }
+        proposals.push_back( index );
+
+        done = true;
+        for( unsigned int ssdim = 0; ssdim < searchSpaceDimension; ssdim++ )
+        {
+          if( ++pos[ ssdim ] < coarse[ ssdim ].size() )
+          {
+            done = false;
+            break;
+          }
+          pos[ ssdim ] = 0;
+        }
+      }
+    }
+    else
+    {
+      /** The 3^N neighbourhoods of the candidates, with the stride of this level. */
+      unsigned long nrOfNeighbours = 1;
+      for( unsigned int ssdim = 0; ssdim < searchSpaceDimension; ssdim++ )
+      {
+        nrOfNeighbours *= 3;
+      }
+
+      for( unsigned int c = 0; c < candidates.size(); ++c )
+      {
+        for( unsigned long n = 0; n < nrOfNeighbours; ++n )
+        {
+          unsigned long m = n;
+          for( unsigned int ssdim = 0; ssdim < searchSpaceDimension; ssdim++ )
+          {
+            const IndexValueType last = static_cast< IndexValueType >( searchSpaceSize[ ssdim ] ) - 1;
+            const IndexValueType i    = candidates[ c ][ ssdim ]
+              + ( static_cast< IndexValueType >( m % 3 ) - 1 ) * stride;
+            index[ ssdim ] = std::min( std::max( i, static_cast< IndexValueType >( 0 ) ), last );
+            m /= 3;
+          }
+          proposals.push_back( index );
+        }
+      }
+    }
+
+    /** Only evaluate the grid points that were not evaluated before. */
+    indices.clear();
+    std::set< unsigned long > queued;
+    for( unsigned int k = 0; k < proposals.size(); ++k )
+    {
+      unsigned long key = 0;
+      for( unsigned int ssdim = 0; ssdim < searchSpaceDimension; ssdim++ )
+      {
+        key += static_cast< unsigned long >( proposals[ k ][ ssdim ] ) * multipliers[ ssdim ];
+      }
+      if( evaluated.count( key ) == 0 && queued.insert( key ).second )
+      {
+        indices.push_back( proposals[ k ] );
+      }
     }
 
+    this->EvaluateIndices( indices, values );
+
     if( m_Stop )
     {
       break;
     }
 
-    /** Check if the value is a minimum or maximum */
-    if( ( m_Value < m_BestValue )  ^  m_Maximize )         // ^ = xor, yields true if only one of the expressions is true
+    for( unsigned int k = 0; k < indices.size(); ++k )
+    {
+      unsigned long key = 0;
+      for( unsigned int ssdim = 0; ssdim < searchSpaceDimension; ssdim++ )
+      {
+        key += static_cast< unsigned long >( indices[ k ][ ssdim ] ) * multipliers[ ssdim ];
+      }
+      evaluated[ key ] = values[ k ];
+    }
+
+    /** Select the best points found so far as the candidates for refinement. */
+    ranking.clear();
+    std::map< unsigned long, MeasureType >::const_iterator evalIt;
+    for( evalIt = evaluated.begin(); evalIt != evaluated.end(); ++evalIt )
     {
-      m_BestValue              = m_Value;
-      m_BestPointInSearchSpace = m_CurrentPointInSearchSpace;
-      m_BestIndexInSearchSpace = m_CurrentIndexInSearchSpace;
+      const MeasureType cost = m_Maximize ? -evalIt->second : evalIt->second;
+      ranking.push_back( std::make_pair( cost, evalIt->first ) );
     }
+    const unsigned int nrOfCandidates = std::min(
+      m_NumberOfRefinementCandidates, static_cast< unsigned int >( ranking.size() ) );
+    std::partial_sort( ranking.begin(), ranking.begin() + nrOfCandidates, ranking.end() );
 
-    this->InvokeEvent( IterationEvent() );
+    candidates.assign( nrOfCandidates, index );
+    for( unsigned int c = 0; c < nrOfCandidates; ++c )
+    {
+      for( unsigned int ssdim = 0; ssdim < searchSpaceDimension; ssdim++ )
+      {
+        candidates[ c ][ ssdim ] = static_cast< IndexValueType >(
+          ( ranking[ c ].second / multipliers[ ssdim ] ) % searchSpaceSize[ ssdim ] );
+      }
+    }
 
-    /** Prepare for next step */
-    m_CurrentIteration++;
+  }   // end for levels
 
-    if( m_CurrentIteration >= this->GetNumberOfIterations() )
+  if( !m_Stop )
+  {
+    m_StopCondition = FullRangeSearched;
+    StopOptimization();
+  }
+
+}   // end function ResumeHierarchicalSearch
+
+
+/**
+ * ******************** EvaluateIndices ******************
+ */
+void
+FullSearchOptimizer
+::EvaluateIndices( const std::vector< SearchSpaceIndexType > & indices,
+  std::vector< MeasureType > & values )
+{
+  const unsigned long nrOfIndices = indices.size();
+  values.assign( nrOfIndices, NumericTraits< MeasureType >::Zero );
+
+  CostFunctionBatchEvaluator::ParametersContainerType   positions;
+  CostFunctionBatchEvaluator::MeasureContainerType      batchValues;
+  CostFunctionBatchEvaluator::FailureContainerType      failures;
+  CostFunctionBatchEvaluator::ExceptionContainerType    exceptions;
+
+  for( unsigned long start = 0; start < nrOfIndices; start += m_BatchSize )
+  {
+    const unsigned long end = std::min( start + m_BatchSize, nrOfIndices );
+
+    /** Compute the values, concurrently if clones are available. */
+    positions.resize( end - start );
+    for( unsigned long k = start; k < end; ++k )
     {
-      m_StopCondition = FullRangeSearched;
-      StopOptimization();
-      break;
+      positions[ k - start ] = this->IndexToPosition( indices[ k ] );
     }
+    m_BatchEvaluator->Evaluate( positions, batchValues, failures, exceptions );
+
+    /** Process the values in order. */
+    for( unsigned long k = start; k < end; ++k )
+    {
+      if( failures[ k - start ] )
+      {
+        // An exception has occurred.
+        // Terminate immediately.
+        m_StopCondition = MetricError;
+        StopOptimization();
 
-    /** Set the next position in search space. */
-    this->UpdateCurrentPosition();
+        // Pass exception to caller
+        throw exceptions[ k - start ];
+      }
 
-  }   // end while
+      m_CurrentIndexInSearchSpace = indices[ k ];
+      m_CurrentPointInSearchSpace = this->IndexToPoint( indices[ k ] );
+      this->SetCurrentPosition( positions[ k - start ] );
+      m_Value     = batchValues[ k - start ];
+      values[ k ] = m_Value;
 
-}   //end function ResumeOptimization
+      /** Check if the value is a minimum or maximum */
+      if( ( m_Value < m_BestValue )  ^  m_Maximize )         // ^ = xor, yields true if only one of the expressions is true
+      {
+        m_BestValue              = m_Value;
+        m_BestPointInSearchSpace = m_CurrentPointInSearchSpace;
+        m_BestIndexInSearchSpace = m_CurrentIndexInSearchSpace;
+      }
+
+      this->InvokeEvent( IterationEvent() );
+
+      /** Prepare for next step */
+      m_CurrentIteration++;
+
+      if( m_Stop )
+      {
+        return;
+      }
+    }
+  }
+
+}   // end function EvaluateIndices
+
+
+/**
+ * ******************** AddCostFunctionClone ******************
+ */
+void
+FullSearchOptimizer
+::AddCostFunctionClone( CostFunctionType * costFunction )
+{
+  if( costFunction == NULL )
+  {
+    itkExceptionMacro( << "The cost function clone should not be NULL." );
+  }
+  m_CostFunctionClones.push_back( costFunction );
+  this->Modified();
+
+}   // end function AddCostFunctionClone
+
+
+/**
+ * ******************** RemoveAllCostFunctionClones ******************
+ */
+void
+FullSearchOptimizer
+::RemoveAllCostFunctionClones( void )
+{
+  m_CostFunctionClones.clear();
+  this->Modified();
+
+}   // end function RemoveAllCostFunctionClones
 
 
 /**
@@ -195,35 +500,11 @@ FullSearchOptimizer
   /** Get the current parameters; const_cast, because we want to adapt it later. */
   ParametersType & currentPosition = const_cast< ParametersType & >( this->GetCurrentPosition() );
 
-  /** Get the dimension and sizes of the searchspace. */
-  const unsigned int          searchSpaceDimension = this->GetNumberOfSearchSpaceDimensions();
-  const SearchSpaceSizeType & searchSpaceSize      = this->GetSearchSpaceSize();
+  /** Get the dimension of the searchspace. */
+  const unsigned int searchSpaceDimension = this->GetNumberOfSearchSpaceDimensions();
 
   /** Derive the index of the next search space point */
-  bool JustSetPreviousDimToZero = true;
-  for( unsigned int ssdim = 0; ssdim < searchSpaceDimension; ssdim++ )  //loop over all dimensions of the search space
-  {
-    /** if the full range of ssdim-1 has been searched (so, if its
-     * index has just been set back to 0) then increase index[ssdim] */
-    if( JustSetPreviousDimToZero )
-    {
-      /** reset the bool */
-      JustSetPreviousDimToZero = false;
-
-      /** determine the new value of m_CurrentIndexInSearchSpace[ssdim] */
-      unsigned int dummy = m_CurrentIndexInSearchSpace[ ssdim ] + 1;
-      if( dummy == searchSpaceSize[ ssdim ] )
-      {
-        m_CurrentIndexInSearchSpace[ ssdim ] = 0;
-        JustSetPreviousDimToZero             = true;
-      }
-      else
-      {
-        m_CurrentIndexInSearchSpace[ ssdim ] = dummy;
-      }
-    }   // end if justsetprevdimtozero
-
-  }   // end for
+  this->IncrementIndex( m_CurrentIndexInSearchSpace );
 
   /** Initialise the iterator. */
   SearchSpaceIteratorType it( m_SearchSpace->Begin() );
@@ -249,6 +530,46 @@ FullSearchOptimizer
 }   // end UpdateCurrentPosition
 
 
+/**
+ * ********************* IncrementIndex *******************
+ */
+
+void
+FullSearchOptimizer
+::IncrementIndex( SearchSpaceIndexType & index )
+{
+  /** Get the dimension and sizes of the searchspace. */
+  const unsigned int          searchSpaceDimension = this->GetNumberOfSearchSpaceDimensions();
+  const SearchSpaceSizeType & searchSpaceSize      = this->GetSearchSpaceSize();
+
+  bool JustSetPreviousDimToZero = true;
+  for( unsigned int ssdim = 0; ssdim < searchSpaceDimension; ssdim++ )  //loop over all dimensions of the search space
+  {
+    /** if the full range of ssdim-1 has been searched (so, if its
+     * index has just been set back to 0) then increase index[ssdim] */
+    if( JustSetPreviousDimToZero )
+    {
+      /** reset the bool */
+      JustSetPreviousDimToZero = false;
+
+      /** determine the new value of index[ssdim] */
+      unsigned int dummy = index[ ssdim ] + 1;
+      if( dummy == searchSpaceSize[ ssdim ] )
+      {
+        index[ ssdim ]           = 0;
+        JustSetPreviousDimToZero = true;
+      }
+      else
+      {
+        index[ ssdim ] = dummy;
+      }
+    }   // end if justsetprevdimtozero
+
+  }   // end for
+
+}   // end IncrementIndex
+
+
 /**
  * ********************* ProcessSearchSpaceChanges **************
  */
@@ -24,6 +24,8 @@
 #include "itkImage.h"
 #include "itkArray.h"
 #include "itkFixedArray.h"
+#include "itkCostFunctionBatchEvaluator.h"
+#include <vector>
 
 namespace itk
 {
@@ -35,6 +37,21 @@ namespace itk
  * Optimizer that scans a subspace of the parameter space
  * and searches for the best parameters.
  *
+ * The grid points are evaluated in batches of BatchSize points. When clones
+ * of the cost function are added with AddCostFunctionClone(), the points of
+ * a batch are evaluated concurrently; the iteration events are still invoked
+ * for each point, in the order of the grid. When an observer stops the
+ * optimization, the values of the rest of the batch are discarded, and
+ * ResumeOptimization() continues with the point after the last processed one.
+ *
+ * With NumberOfRefinementLevels L > 0 the search is hierarchical. First the
+ * grid with a step of 2^L times the step of the search space is evaluated.
+ * Then, for each level with a halved step, the neighbourhoods of the best
+ * NumberOfRefinementCandidates points found so far are evaluated, until the
+ * step of the search space is reached. All points are points of the search
+ * space grid, but only a small part of the grid is evaluated. A stopped
+ * hierarchical search starts again at the coarsest level when it is resumed.
+ *
  * \todo This optimizer has similar functionality as the recently added
  * itkExhaustiveOptimizer. See if we can replace it by that optimizer,
  * or inherit from it.
@@ -191,6 +208,34 @@ public:
   /** Get Stop condition. */
   itkGetConstMacro( StopCondition, StopConditionType );
 
+  /** Set/Get the number of grid points that are evaluated at once. A larger
+   * batch keeps more clones busy, but more values are discarded when the
+   * optimization is stopped during a batch. Default: 64. */
+  itkSetClampMacro( BatchSize, unsigned long, 1, NumericTraits< unsigned long >::max() );
+  itkGetConstMacro( BatchSize, unsigned long );
+
+  /** Set/Get the number of refinement levels of the hierarchical search.
+   * Default: 0, i.e. the full grid is searched. */
+  itkSetMacro( NumberOfRefinementLevels, unsigned int );
+  itkGetConstMacro( NumberOfRefinementLevels, unsigned int );
+
+  /** Set/Get the number of best points that are refined at each level of the
+   * hierarchical search. Default: 4. */
+  itkSetClampMacro( NumberOfRefinementCandidates, unsigned int, 1, NumericTraits< unsigned int >::max() );
+  itkGetConstMacro( NumberOfRefinementCandidates, unsigned int );
+
+  /** Add instances of the cost function that compute the same value
+   * independently of the cost function, for example clones of a metric with
+   * their own transform. They are used to evaluate a batch concurrently. */
+  void AddCostFunctionClone( CostFunctionType * costFunction );
+  void RemoveAllCostFunctionClones( void );
+
+  /** Set the number of threads used to evaluate a batch. */
+  void SetNumberOfThreads( ThreadIdType numberOfThreads )
+  {
+    this->m_BatchEvaluator->SetNumberOfThreads( numberOfThreads );
+  }
+
 protected:
 
   FullSearchOptimizer();
@@ -215,6 +260,30 @@ protected:
   unsigned long m_LastSearchSpaceChanges;
   virtual void ProcessSearchSpaceChanges( void );
 
+  /** Set index to the next index in the search space, in the order of
+   * UpdateCurrentPosition(). */
+  virtual void IncrementIndex( SearchSpaceIndexType & index );
+
+  /** Evaluate the cost function at the indices, in batches, and process
+   * the values in order: update the current and best point and invoke an
+   * iteration event for each index. Stops when m_Stop is set. */
+  virtual void EvaluateIndices( const std::vector< SearchSpaceIndexType > & indices,
+    std::vector< MeasureType > & values );
+
+  /** Search the grid exhaustively, starting at the current index. */
+  virtual void ResumeFullSearch( void );
+
+  /** Search the grid hierarchically. */
+  virtual void ResumeHierarchicalSearch( void );
+
+  /** The evaluator of the batches, and the clones of the cost function. */
+  CostFunctionBatchEvaluator::Pointer m_BatchEvaluator;
+  std::vector< CostFunctionPointer >  m_CostFunctionClones;
+
+  unsigned long m_BatchSize;
+  unsigned int  m_NumberOfRefinementLevels;
+  unsigned int  m_NumberOfRefinementCandidates;
+
 private:
 
   FullSearchOptimizer( const Self & ); // purposely not implemented
@@ -17,6 +17,7 @@
  *=========================================================================*/
 
 #include "itkGradientDescentOptimizer2.h"
+#include "itkPersistentThreadPool.h"
 
 #include "itkCommand.h"
 #include "itkEventObject.h"
@@ -216,6 +217,21 @@ GradientDescentOptimizer2
   /** Get a reference to the previously allocated newPosition. */
   ParametersType & newPosition = this->m_ScaledCurrentPosition;
 
+  /** Advance one step on the shared thread pool, when available. */
+  PersistentThreadPool * pool = PersistentThreadPool::GetGlobalInstance();
+  if( pool != NULL && pool->GetNumberOfThreads() > 1 )
+  {
+    MultiThreaderParameterType temp;
+    temp.t_NewPosition = &newPosition;
+    temp.t_Optimizer   = this;
+    if( pool->Execute( AdvanceOneStepThreaderCallback, &temp,
+      this->m_Threader->GetNumberOfThreads() ) )
+    {
+      this->InvokeEvent( IterationEvent() );
+      return;
+    }
+  }
+
   /** Advance one step. */
 #ifndef ELASTIX_USE_OPENMP // If no OpenMP detected then use single-threaded code
   /** Get a reference to the current position. */
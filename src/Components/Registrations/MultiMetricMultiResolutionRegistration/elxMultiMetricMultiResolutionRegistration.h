@@ -88,6 +88,20 @@ namespace elastix
  *    example: <tt>(Metric0Use "false" "true")</tt> \n
  *    example: <tt>(Metric1Use "true" "false")</tt> \n
  *    The default is "true".
+ * \parameter UseConcurrentMetricEvaluation: Whether the metrics that support it
+ *    are evaluated in parallel, each with a part of the threads, in each
+ *    resolution. Supported are for example AdvancedMattesMutualInformation,
+ *    AdvancedMeanSquares, AdvancedNormalizedCorrelation,
+ *    TransformBendingEnergyPenalty and CorrespondingPointsEuclideanDistanceMetric. \n
+ *    example: <tt>(UseConcurrentMetricEvaluation "true")</tt> \n
+ *    The default is "false".
+ * \parameter UseSharedTransformEvaluation: Whether the image metrics that use
+ *    the same image sampler share the transformed samples, in each resolution.
+ *    The samples are then transformed once per iteration instead of once per
+ *    metric. Only effective when fewer samplers than metrics are selected, so
+ *    that some metrics share a sampler. \n
+ *    example: <tt>(UseSharedTransformEvaluation "true")</tt> \n
+ *    The default is "false".
  *
  * \ingroup Registrations
  */
@@ -197,6 +197,18 @@ MultiMetricMultiResolutionRegistration< TElastix >
   this->GetConfiguration()->ReadParameter( useRelativeWeights, "UseRelativeWeights", 0 );
   this->GetCombinationMetric()->SetUseRelativeWeights( useRelativeWeights );
 
+  /** Set whether the metrics are evaluated concurrently. */
+  bool useConcurrentMetricEvaluation = false;
+  this->GetConfiguration()->ReadParameter( useConcurrentMetricEvaluation,
+    "UseConcurrentMetricEvaluation", "", level, 0 );
+  this->GetCombinationMetric()->SetUseConcurrentMetricEvaluation( useConcurrentMetricEvaluation );
+
+  /** Set whether the metrics share the transformed samples. */
+  bool useSharedTransformEvaluation = false;
+  this->GetConfiguration()->ReadParameter( useSharedTransformEvaluation,
+    "UseSharedTransformEvaluation", "", level, 0 );
+  this->GetCombinationMetric()->SetUseSharedTransformEvaluation( useSharedTransformEvaluation );
+
   /** Set the metric weights. The default metric weight is 1.0 / nrOfMetrics. */
   if( !useRelativeWeights )
   {
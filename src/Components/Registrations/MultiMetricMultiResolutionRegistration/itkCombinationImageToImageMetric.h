@@ -50,6 +50,18 @@ namespace itk
  * why we chose to reimplement the Get{Transform,Interpolator}()
  * methods.
  *
+ * When UseConcurrentMetricEvaluation is on, the sub-metrics that support it
+ * (see AdvancedImageToImageMetric::GetSupportsConcurrentEvaluation()) are
+ * evaluated in parallel, after the thread-unsafe preparation of all metrics
+ * in BeforeThreadedGetValueAndDerivative(). The threads of this metric are
+ * then divided over these sub-metrics in Initialize(). The other sub-metrics
+ * are evaluated one after the other, with all threads.
+ *
+ * When UseSharedTransformEvaluation is on, and several image metrics use the
+ * same image sampler, the samples of that sampler are transformed once per
+ * GetValueAndDerivative() into a SampleTransformBuffer. The metrics then read
+ * the mapped points, and for B-spline transforms the Jacobian weights, from
+ * this buffer instead of evaluating the transform again.
  *
  * \ingroup RegistrationMetrics
  *
@@ -165,6 +177,11 @@ public:
   typedef typename Superclass::ThreaderType   ThreaderType;
   typedef typename Superclass::ThreadInfoType ThreadInfoType;
 
+  /** Typedefs for the shared transform evaluation. */
+  typedef typename Superclass::ImageSampleContainerType     ImageSampleContainerType;
+  typedef typename Superclass::SampleTransformBufferType    SampleTransformBufferType;
+  typedef typename Superclass::SampleTransformBufferPointer SampleTransformBufferPointer;
+
   /**
    * Get and set the metrics and their weights.
    **/
@@ -203,6 +220,26 @@ public:
   /** \todo: Temporary, should think about interface. */
   itkSetMacro( UseMultiThread, bool );
 
+  /** Set/Get whether the sub-metrics that support it are evaluated
+   * concurrently. Should be set before Initialize(). Default: false.
+   */
+  itkSetMacro( UseConcurrentMetricEvaluation, bool );
+  itkGetConstMacro( UseConcurrentMetricEvaluation, bool );
+  itkBooleanMacro( UseConcurrentMetricEvaluation );
+
+  /** Set/Get whether the image metrics that share an image sampler also
+   * share the transformed samples. Should be set before Initialize().
+   * Default: false.
+   */
+  itkSetMacro( UseSharedTransformEvaluation, bool );
+  itkGetConstMacro( UseSharedTransformEvaluation, bool );
+  itkBooleanMacro( UseSharedTransformEvaluation );
+
+  /** Get the buffer with the shared transformed samples, for example to set
+   * the memory limit of its weight cache.
+   */
+  itkGetObjectMacro( SharedSampleTransformBuffer, SampleTransformBufferType );
+
   /** Select which metrics are used.
    * This is useful in case you want to compute a certain measure, but not
    * actually use it during the registration.
@@ -450,14 +487,32 @@ private:
    */
   double GetFinalMetricWeight( unsigned int pos ) const;
 
-  /** For threading: store thread data. */
+  /** Whether metric pos can be evaluated concurrently with other metrics. */
+  bool GetMetricSupportsConcurrentEvaluation( unsigned int pos ) const;
+
+  /** Get the number of metrics that are evaluated concurrently. Returns 0
+   * when UseConcurrentMetricEvaluation is off or less than two metrics
+   * support it.
+   */
+  unsigned int GetNumberOfConcurrentMetrics( void ) const;
+
+  /** Give the shared sample transform buffer to the image metrics that use
+   * the most common sample container, if at least two do.
+   */
+  void InitializeSharedSampleTransformBuffer( void );
+
+  /** Transform the shared samples with the current parameters. */
+  void UpdateSharedSampleTransformBuffer( void ) const;
+
+  /** For threading: store thread data. Thread i evaluates the metrics
+   * st_MetricIndices[ i ], st_MetricIndices[ i + NumberOfThreads ], etc.
+   */
   struct MultiThreaderComboMetricsType
   {
-    std::vector< SingleValuedCostFunctionPointer > st_MetricsIterator;
-    typename std::vector< MeasureType >::iterator st_MetricValuesIterator;
-    typename std::vector< DerivativeType >::iterator st_MetricDerivativesIterator;
-    std::vector< double > st_MetricComputationTime;
-    ParametersType *      st_Parameters;
+    const Self *                st_ThisComboMetric;
+    const ParametersType *      st_Parameters;
+    std::vector< unsigned int > st_MetricIndices;
+    std::vector< std::string >  st_ErrorMessages;
   };
 
   struct MultiThreaderCombineDerivativeType
@@ -468,6 +523,10 @@ private:
   };
 
   bool m_UseMultiThread;
+  bool m_UseConcurrentMetricEvaluation;
+  bool m_UseSharedTransformEvaluation;
+
+  SampleTransformBufferPointer m_SharedSampleTransformBuffer;
 
 };
 
@@ -21,6 +21,7 @@
 #include "itkCombinationImageToImageMetric.h"
 #include "itkTimeProbe.h"
 #include "itkMath.h"
+#include <algorithm>
 
 /** Macros to reduce some copy-paste work.
  * These macros provide the implementation of
@@ -164,7 +165,10 @@ CombinationImageToImageMetric< TFixedImage, TMovingImage >
   this->m_UseRelativeWeights = false;
   this->ComputeGradientOff();
 
-  this->m_UseMultiThread = true;
+  this->m_UseMultiThread                = true;
+  this->m_UseConcurrentMetricEvaluation = false;
+  this->m_UseSharedTransformEvaluation  = false;
+  this->m_SharedSampleTransformBuffer   = SampleTransformBufferType::New();
 
 } // end Constructor
 
@@ -195,6 +199,10 @@ CombinationImageToImageMetric< TFixedImage, TMovingImage >
     os << indent << "UseMetric: " << ( this->m_UseMetric[ i ] ? "true\n" : "false\n" );
     os << indent << "MetricComputationTime: " << this->m_MetricComputationTime[ i ] << "\n";
   }
+  os << indent << "UseConcurrentMetricEvaluation: "
+     << ( this->m_UseConcurrentMetricEvaluation ? "true" : "false" ) << std::endl;
+  os << indent << "UseSharedTransformEvaluation: "
+     << ( this->m_UseSharedTransformEvaluation ? "true" : "false" ) << std::endl;
 
 } // end PrintSelf()
 
@@ -617,6 +625,22 @@ CombinationImageToImageMetric< TFixedImage, TMovingImage >
     itkExceptionMacro( << "At least one metric should be set!" );
   }
 
+  /** The metrics that are evaluated concurrently share the threads of
+   * this metric. The remainder is given to the first metrics.
+   */
+  const ThreadIdType numberOfConcurrentMetrics = this->GetNumberOfConcurrentMetrics();
+  ThreadIdType       threadsPerConcurrentMetric = this->GetNumberOfThreads();
+  ThreadIdType       remainingThreads           = 0;
+  if( numberOfConcurrentMetrics > 1 )
+  {
+    threadsPerConcurrentMetric = std::max( this->GetNumberOfThreads() / numberOfConcurrentMetrics,
+      static_cast< ThreadIdType >( 1 ) );
+    if( this->GetNumberOfThreads() > numberOfConcurrentMetrics )
+    {
+      remainingThreads = this->GetNumberOfThreads() % numberOfConcurrentMetrics;
+    }
+  }
+
   /** Call Initialize for all metrics. */
   for( unsigned int i = 0; i < this->GetNumberOfMetrics(); i++ )
   {
@@ -632,6 +656,17 @@ CombinationImageToImageMetric< TFixedImage, TMovingImage >
       // The NumberOfThreadsPerMetric is changed after Initialize() so we save it before and then
       // set it on.
       unsigned nrOfThreadsPerMetric = this->GetNumberOfThreads();
+      if( numberOfConcurrentMetrics > 1 && this->GetMetricSupportsConcurrentEvaluation( i ) )
+      {
+        nrOfThreadsPerMetric = threadsPerConcurrentMetric;
+        if( remainingThreads > 0 )
+        {
+          ++nrOfThreadsPerMetric;
+          --remainingThreads;
+        }
+      }
+      // Set it before Initialize() too, which sizes the per-thread variables.
+      testPtr1->SetNumberOfThreads( nrOfThreadsPerMetric );
       testPtr1->Initialize();
       testPtr1->SetNumberOfThreads( nrOfThreadsPerMetric );
     }
@@ -641,9 +676,92 @@ CombinationImageToImageMetric< TFixedImage, TMovingImage >
     }
   }
 
+  /** Let the metrics that use the same samples share the transformed samples. */
+  this->InitializeSharedSampleTransformBuffer();
+
 } // end Initialize()
 
 
+/**
+ * ************** InitializeSharedSampleTransformBuffer ***************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+CombinationImageToImageMetric< TFixedImage, TMovingImage >
+::InitializeSharedSampleTransformBuffer( void )
+{
+  /** Collect the sample container of each image metric. */
+  std::vector< const ImageSampleContainerType * > sampleContainers( this->m_NumberOfMetrics, NULL );
+  for( unsigned int i = 0; i < this->m_NumberOfMetrics; i++ )
+  {
+    ImageMetricType * testPtr1 = dynamic_cast< ImageMetricType * >( this->GetMetric( i ) );
+    if( !testPtr1 ) { continue; }
+
+    /** Detach the buffer from a previous resolution. */
+    testPtr1->SetSampleTransformBuffer( NULL );
+    if( this->m_UseSharedTransformEvaluation
+      && testPtr1->GetUseImageSampler() && testPtr1->GetImageSampler() )
+    {
+      sampleContainers[ i ] = testPtr1->GetImageSampler()->GetOutput();
+    }
+  }
+
+  /** Select the container that is used by the most metrics. */
+  const ImageSampleContainerType * sharedContainer = NULL;
+  unsigned int                     maxCount        = 1;
+  for( unsigned int i = 0; i < this->m_NumberOfMetrics; i++ )
+  {
+    if( !sampleContainers[ i ] ) { continue; }
+    const unsigned int count = static_cast< unsigned int >( std::count(
+      sampleContainers.begin(), sampleContainers.end(), sampleContainers[ i ] ) );
+    if( count > maxCount )
+    {
+      maxCount        = count;
+      sharedContainer = sampleContainers[ i ];
+    }
+  }
+
+  /** Give these metrics the buffer. */
+  this->m_SharedSampleTransformBuffer->Invalidate();
+  for( unsigned int i = 0; sharedContainer && i < this->m_NumberOfMetrics; i++ )
+  {
+    if( sampleContainers[ i ] == sharedContainer )
+    {
+      ImageMetricType * testPtr1 = dynamic_cast< ImageMetricType * >( this->GetMetric( i ) );
+      testPtr1->SetSampleTransformBuffer( this->m_SharedSampleTransformBuffer );
+    }
+  }
+
+} // end InitializeSharedSampleTransformBuffer()
+
+
+/**
+ * ************** UpdateSharedSampleTransformBuffer ***************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+CombinationImageToImageMetric< TFixedImage, TMovingImage >
+::UpdateSharedSampleTransformBuffer( void ) const
+{
+  /** Transform the samples of the first metric that uses the buffer. The
+   * samplers have already been updated in BeforeThreadedGetValueAndDerivative().
+   */
+  for( unsigned int i = 0; i < this->m_NumberOfMetrics; i++ )
+  {
+    ImageMetricType * testPtr1 = dynamic_cast< ImageMetricType * >( this->GetMetric( i ) );
+    if( testPtr1 && testPtr1->GetSampleTransformBuffer() == this->m_SharedSampleTransformBuffer.GetPointer() )
+    {
+      this->m_SharedSampleTransformBuffer->Update( testPtr1->GetTransform(),
+        testPtr1->GetImageSampler()->GetOutput(), this->GetNumberOfThreads() );
+      return;
+    }
+  }
+
+} // end UpdateSharedSampleTransformBuffer()
+
+
 /**
  * ******************* InitializeThreadingParameters *******************
  */
@@ -695,6 +813,58 @@ CombinationImageToImageMetric< TFixedImage, TMovingImage >
 } // end GetFinalMetricWeight()
 
 
+/**
+ * ************** GetMetricSupportsConcurrentEvaluation ***************
+ */
+
+template< class TFixedImage, class TMovingImage >
+bool
+CombinationImageToImageMetric< TFixedImage, TMovingImage >
+::GetMetricSupportsConcurrentEvaluation( unsigned int pos ) const
+{
+  const ImageMetricType *    testPtr1 = dynamic_cast< const ImageMetricType * >( this->GetMetric( pos ) );
+  const PointSetMetricType * testPtr2 = dynamic_cast< const PointSetMetricType * >( this->GetMetric( pos ) );
+  if( testPtr1 )
+  {
+    return testPtr1->GetSupportsConcurrentEvaluation();
+  }
+  else if( testPtr2 )
+  {
+    return testPtr2->GetSupportsConcurrentEvaluation();
+  }
+  return false;
+
+} // end GetMetricSupportsConcurrentEvaluation()
+
+
+/**
+ * ******************* GetNumberOfConcurrentMetrics *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+unsigned int
+CombinationImageToImageMetric< TFixedImage, TMovingImage >
+::GetNumberOfConcurrentMetrics( void ) const
+{
+  if( !this->m_UseConcurrentMetricEvaluation )
+  {
+    return 0;
+  }
+
+  unsigned int numberOfConcurrentMetrics = 0;
+  for( unsigned int i = 0; i < this->m_NumberOfMetrics; i++ )
+  {
+    if( this->GetMetricSupportsConcurrentEvaluation( i ) )
+    {
+      ++numberOfConcurrentMetrics;
+    }
+  }
+
+  return numberOfConcurrentMetrics > 1 ? numberOfConcurrentMetrics : 0;
+
+} // end GetNumberOfConcurrentMetrics()
+
+
 /**
  * ********************* GetValue ****************************
  */
@@ -857,71 +1027,74 @@ CombinationImageToImageMetric< TFixedImage, TMovingImage >
   /** Initialize some threading related parameters. */
   this->InitializeThreadingParameters();
 
-  /** Decide whether or not to use multi-threading.
-   * If the global maximum number of threads is smaller than the number
-   * of metrics, then setting the number of threads to the number of
-   * threads will result in a bug: all metrics after the max will not be
-   * run. For now we decide to run this metric single-threadedly in that case.
-   *
-   * Actually we should sum the number of threads of each metric and check that
-   * it does not surpass the global maximum. But for now we don't.
-   */
-  bool useMultiThread = this->m_UseMultiThread;
-  if( MultiThreader::GetGlobalMaximumNumberOfThreads() < this->m_NumberOfMetrics )
+  /** Transform the samples that are shared by several metrics once. */
+  if( this->m_UseSharedTransformEvaluation )
   {
-    useMultiThread = false;
+    this->UpdateSharedSampleTransformBuffer();
   }
 
-  // For now we disable multi-threading of the combo metric, since the MacMini build
-  // segfaults with it. Have to investigate this issue later
-  useMultiThread = false;
-
-  /** Compute all metric values and derivatives, single-threadedly. */
-  if( !useMultiThread )
+  /** Compute the metric values and derivatives. The metrics that support
+   * it are evaluated concurrently, the others one after the other.
+   */
+  const bool                  useConcurrentEvaluation = this->GetNumberOfConcurrentMetrics() > 1;
+  std::vector< unsigned int > concurrentMetrics;
+  for( unsigned int i = 0; i < this->m_NumberOfMetrics; i++ )
   {
-    for( unsigned int i = 0; i < this->m_NumberOfMetrics; i++ )
+    if( useConcurrentEvaluation && this->GetMetricSupportsConcurrentEvaluation( i ) )
     {
-      /** Compute ... */
-      timer.Reset();
-      timer.Start();
-      this->m_Metrics[ i ]->GetValueAndDerivative( parameters,
-        this->m_MetricValues[ i ], this->m_MetricDerivatives[ i ] );
-      timer.Stop();
-
-      /** Store computation time. */
-      this->m_MetricComputationTime[ i ] = timer.GetMean() * 1000.0;
+      concurrentMetrics.push_back( i );
+      continue;
     }
+
+    /** Compute ... */
+    timer.Reset();
+    timer.Start();
+    this->m_Metrics[ i ]->GetValueAndDerivative( parameters,
+      this->m_MetricValues[ i ], this->m_MetricDerivatives[ i ] );
+    timer.Stop();
+
+    /** Store computation time. */
+    this->m_MetricComputationTime[ i ] = timer.GetMean() * 1000.0;
   }
-  /** Compute all metric values and derivatives, multi-threadedly. */
-  else
+
+  /** Compute the remaining metric values and derivatives, concurrently.
+   * The number of threads may be clamped by the global maximum, in which
+   * case a thread evaluates several metrics.
+   */
+  if( !concurrentMetrics.empty() )
   {
     /** Setup struct with multi-threading information. */
-    MultiThreaderComboMetricsType * temp_c = new MultiThreaderComboMetricsType;
-    temp_c->st_MetricsIterator           = this->m_Metrics;
-    temp_c->st_MetricDerivativesIterator = this->m_MetricDerivatives.begin();
-    temp_c->st_MetricValuesIterator      = this->m_MetricValues.begin();
-    temp_c->st_MetricComputationTime.resize( this->m_NumberOfMetrics, 0 );
-    temp_c->st_Parameters = const_cast< ParametersType * >( &parameters );
+    MultiThreaderComboMetricsType temp_c;
+    temp_c.st_ThisComboMetric = this;
+    temp_c.st_Parameters      = &parameters;
+    temp_c.st_MetricIndices   = concurrentMetrics;
+    temp_c.st_ErrorMessages.resize( concurrentMetrics.size() );
 
     /** GetValueAndDerivative */
-    local_threader->SetNumberOfThreads( this->m_NumberOfMetrics );
-    local_threader->SetSingleMethod( GetValueAndDerivativeComboThreaderCallback, temp_c );
-    local_threader->SingleMethodExecute();
+    local_threader->SetNumberOfThreads( concurrentMetrics.size() );
+    PersistentThreadPool::SingleMethodExecute( local_threader,
+      GetValueAndDerivativeComboThreaderCallback, &temp_c );
 
-    /** Store computation time. */
-    for( unsigned int i = 0; i < this->m_NumberOfMetrics; i++ )
+    /** Rethrow the first error in the calling thread. */
+    for( unsigned int k = 0; k < concurrentMetrics.size(); k++ )
     {
-      this->m_MetricComputationTime[ i ] = temp_c->st_MetricComputationTime[ i ];
+      if( !temp_c.st_ErrorMessages[ k ].empty() )
+      {
+        itkExceptionMacro( << "Metric " << concurrentMetrics[ k ]
+                           << " failed:\n" << temp_c.st_ErrorMessages[ k ] );
+      }
     }
-
-    delete temp_c;
   }
 
+  /** The buffer is only valid for these parameters. */
+  this->m_SharedSampleTransformBuffer->Invalidate();
+
+  /** Decide whether or not to use multi-threading for the combination. */
+  const ThreadIdType numberOfThreads = this->GetNumberOfThreads();
+  const bool         useMultiThread  = this->m_UseMultiThread && numberOfThreads > 1;
+
   /** Compute the derivative magnitude, single-threadedly. */
-  // I get random segfaults on the Linux or Mac systems when this is enabled.
-  // For now disable multi-threading and force single-threaded:
-  //if( !this->m_UseMultiThread )
-  if( true )
+  if( !useMultiThread )
   {
     for( unsigned int i = 0; i < this->m_NumberOfMetrics; i++ )
     {
@@ -932,15 +1105,15 @@ CombinationImageToImageMetric< TFixedImage, TMovingImage >
   else
   {
     /** Setup struct with multi-threading information. */
-    ThreadIdType                         numberOfThreads = this->GetNumberOfThreads();
-    MultiThreaderCombineDerivativeType * temp_m          = new MultiThreaderCombineDerivativeType;
-    temp_m->st_ThisComboMetric = const_cast< Self * >( this );
-    temp_m->st_DerivativesSumOfSquares.resize( numberOfThreads * this->m_NumberOfMetrics );
+    MultiThreaderCombineDerivativeType temp_m;
+    temp_m.st_ThisComboMetric = const_cast< Self * >( this );
+    temp_m.st_DerivativesSumOfSquares.resize( numberOfThreads * this->m_NumberOfMetrics, 0.0 );
+    temp_m.st_Derivative = 0;
 
     /** Compute derivatives magnitude multi-threadedly. */
     local_threader->SetNumberOfThreads( numberOfThreads );
-    local_threader->SetSingleMethod( ComputeDerivativesMagnitudeThreaderCallback, temp_m );
-    local_threader->SingleMethodExecute();
+    PersistentThreadPool::SingleMethodExecute( local_threader,
+      ComputeDerivativesMagnitudeThreaderCallback, &temp_m );
 
     /** Gather the results. */
     for( unsigned int i = 0; i < this->m_NumberOfMetrics; i++ )
@@ -948,12 +1121,10 @@ CombinationImageToImageMetric< TFixedImage, TMovingImage >
       double mag = 0.0;
       for( unsigned int j = 0; j < numberOfThreads; j++ )
       {
-        mag += temp_m->st_DerivativesSumOfSquares[ i * numberOfThreads + j ];
+        mag += temp_m.st_DerivativesSumOfSquares[ i * numberOfThreads + j ];
       }
       this->m_MetricDerivativesMagnitude[ i ] = vcl_sqrt( mag );
     }
-
-    delete temp_m;
   }
 
   /** Combine the metric values, single-threadedly. */
@@ -968,10 +1139,7 @@ CombinationImageToImageMetric< TFixedImage, TMovingImage >
   }   // end of combine metrics
 
   /** Combine the metric derivatives, single-threadedly. */
-  // I get random segfaults on the linux or Mac systems when this is enabled.
-  // For now disable multi-threading and force single-threaded:
-  //if( !this->m_UseMultiThread )
-  if( true )
+  if( !useMultiThread )
   {
     /** The first derivative. */
     if( this->m_UseMetric[ 0 ] )
@@ -981,6 +1149,7 @@ CombinationImageToImageMetric< TFixedImage, TMovingImage >
     }
     else
     {
+      derivative.SetSize( this->GetNumberOfParameters() );
       derivative.Fill( 0 );
     }
 
@@ -998,18 +1167,20 @@ CombinationImageToImageMetric< TFixedImage, TMovingImage >
   /** Combine the derivatives, multi-threadedly. */
   else
   {
+    /** The threads write into the derivative, so it must have its size.
+     * The callers may pass an empty derivative.
+     */
+    derivative.SetSize( this->GetNumberOfParameters() );
+
     /** Setup struct with multi-threading information. */
-    ThreadIdType                         numberOfThreads = this->GetNumberOfThreads();
-    MultiThreaderCombineDerivativeType * temp_d          = new MultiThreaderCombineDerivativeType;
-    temp_d->st_ThisComboMetric = const_cast< Self * >( this );
-    temp_d->st_Derivative      = &derivative[ 0 ];
+    MultiThreaderCombineDerivativeType temp_d;
+    temp_d.st_ThisComboMetric = const_cast< Self * >( this );
+    temp_d.st_Derivative      = derivative.data_block();
 
     /** Combine derivatives */
     local_threader->SetNumberOfThreads( numberOfThreads );
-    local_threader->SetSingleMethod( CombineDerivativesThreaderCallback, temp_d );
-    local_threader->SingleMethodExecute();
-
-    delete temp_d;
+    PersistentThreadPool::SingleMethodExecute( local_threader,
+      CombineDerivativesThreaderCallback, &temp_d );
   }
 
 } // end GetValueAndDerivative()
@@ -1024,20 +1195,43 @@ ITK_THREAD_RETURN_TYPE
 CombinationImageToImageMetric< TFixedImage, TMovingImage >
 ::GetValueAndDerivativeComboThreaderCallback( void * arg )
 {
-  ThreadInfoType * infoStruct = static_cast< ThreadInfoType * >( arg );
-  ThreadIdType     threadID   = infoStruct->ThreadID;
+  ThreadInfoType * infoStruct  = static_cast< ThreadInfoType * >( arg );
+  ThreadIdType     threadID    = infoStruct->ThreadID;
+  ThreadIdType     nrOfThreads = infoStruct->NumberOfThreads;
 
   MultiThreaderComboMetricsType * temp
     = static_cast< MultiThreaderComboMetricsType * >( infoStruct->UserData );
+  const Self * comboMetric = temp->st_ThisComboMetric;
 
+  /** Each metric writes only its own value, derivative and time, so the
+   * threads do not share any output.
+   */
   itk::TimeProbe timer;
-  timer.Start();
-  temp->st_MetricsIterator[ threadID ]->GetValueAndDerivative(
-    *temp->st_Parameters,
-    temp->st_MetricValuesIterator[ threadID ],
-    temp->st_MetricDerivativesIterator[ threadID ] );
-  timer.Stop();
-  temp->st_MetricComputationTime[ threadID ] = timer.GetMean() * 1000.0;
+  for( unsigned int k = threadID; k < temp->st_MetricIndices.size(); k += nrOfThreads )
+  {
+    const unsigned int i = temp->st_MetricIndices[ k ];
+    try
+    {
+      timer.Reset();
+      timer.Start();
+      comboMetric->m_Metrics[ i ]->GetValueAndDerivative( *temp->st_Parameters,
+        comboMetric->m_MetricValues[ i ], comboMetric->m_MetricDerivatives[ i ] );
+      timer.Stop();
+      comboMetric->m_MetricComputationTime[ i ] = timer.GetMean() * 1000.0;
+    }
+    catch( ExceptionObject & excp )
+    {
+      temp->st_ErrorMessages[ k ] = excp.GetDescription();
+    }
+    catch( std::exception & excp )
+    {
+      temp->st_ErrorMessages[ k ] = excp.what();
+    }
+    catch( ... )
+    {
+      temp->st_ErrorMessages[ k ] = "Unknown exception thrown by the metric.";
+    }
+  }
 
   return ITK_THREAD_RETURN_VALUE;
 
@@ -1071,21 +1265,20 @@ CombinationImageToImageMetric< TFixedImage, TMovingImage >
   unsigned int jmax = ( threadId + 1 ) * subSize;
   jmax = ( jmax > numberOfParameters ) ? numberOfParameters : jmax;
 
-  /** Compute the sum of squares within compute range. */
+  /** Compute the sum of squares within compute range. Also for the unused
+   * metrics, just like the single-threaded version.
+   */
   double derivativeValue = 0.0;
   for( unsigned int i = 0; i < numberOfMetrics; i++ )
   {
-    if( temp->st_ThisComboMetric->m_UseMetric[ i ] )
+    const DerivativeType & derivative   = temp->st_ThisComboMetric->m_MetricDerivatives[ i ];
+    double                 sumOfSquares = 0.0;
+    for( unsigned int j = jmin; j < jmax; j++ )
     {
-      const DerivativeType & derivative   = temp->st_ThisComboMetric->m_MetricDerivatives[ i ];
-      double                 sumOfSquares = 0.0;
-      for( unsigned int j = jmin; j < jmax; j++ )
-      {
-        derivativeValue = derivative[ j ];
-        sumOfSquares   += derivativeValue * derivativeValue;
-      }
-      temp->st_DerivativesSumOfSquares[ i * nrOfThreads + threadId ] = sumOfSquares;
+      derivativeValue = derivative[ j ];
+      sumOfSquares   += derivativeValue * derivativeValue;
     }
+    temp->st_DerivativesSumOfSquares[ i * nrOfThreads + threadId ] = sumOfSquares;
   }
 
   return ITK_THREAD_RETURN_VALUE;
@@ -1130,6 +1323,13 @@ CombinationImageToImageMetric< TFixedImage, TMovingImage >
       temp->st_Derivative[ j ] = weight * metricDerivative[ j ];
     }
   }
+  else
+  {
+    for( unsigned int j = jmin; j < jmax; j++ )
+    {
+      temp->st_Derivative[ j ] = 0.0;
+    }
+  }
 
   // Other metrics, add
   for( unsigned int i = 1; i < numberOfMetrics; i++ )
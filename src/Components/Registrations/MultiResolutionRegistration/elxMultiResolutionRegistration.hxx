@@ -21,6 +21,7 @@
 #include "elxMultiResolutionRegistration.h"
 #include "vnl/vnl_math.h"
 #include "itkTimeProbe.h"
+#include "itkGenericMultiResolutionPyramidImageFilter.h"
 
 namespace elastix
 {
@@ -122,6 +123,21 @@ MultiResolutionRegistration< TElastix >
   this->SetMovingImagePyramid( this->GetElastix()->
     GetElxMovingImagePyramidBase()->GetAsITKBaseType() );
 
+  /** Share the fixed image pyramid with other registrations to the same
+   * fixed image. Not the generic pyramid: it may compute one level at a
+   * time, and its outputs also depend on its smoothing schedule.
+   */
+  typedef itk::GenericMultiResolutionPyramidImageFilter<
+    FixedImageType, FixedImageType >                  GenericFixedImagePyramidType;
+  if( !dynamic_cast< GenericFixedImagePyramidType * >( this->GetFixedImagePyramid() ) )
+  {
+    this->SetFixedSideCache( this->GetElastix()->GetFixedSideCache() );
+  }
+  else
+  {
+    this->SetFixedSideCache( 0 );
+  }
+
   this->SetInterpolator( this->GetElastix()->
     GetElxInterpolatorBase()->GetAsITKBaseType() );
 
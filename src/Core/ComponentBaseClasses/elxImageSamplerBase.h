@@ -36,6 +36,14 @@ namespace elastix
  *
  * This class contains all the common functionality for ImageSamplers.
  *
+ * \parameter UseMaskVoxelList: Whether the Random and RandomCoordinate samplers
+ *    draw their samples from a list of the voxels inside the fixed image mask,
+ *    instead of trying random points until one is inside the mask. The list is
+ *    computed once per resolution. This is much faster for small masks in
+ *    large images. Can be given for each resolution.\n
+ *    example: <tt>(UseMaskVoxelList "true")</tt> \n
+ *    The default is "false".
+ *
  * \ingroup ImageSamplers
  * \ingroup ComponentBaseClasses
  */
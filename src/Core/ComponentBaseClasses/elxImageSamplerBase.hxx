@@ -56,6 +56,12 @@ ImageSamplerBase< TElastix >
     }
   }
 
+  /** Draw the samples from a precomputed list of the voxels inside the mask? */
+  bool useMaskVoxelList = false;
+  this->m_Configuration->ReadParameter( useMaskVoxelList,
+    "UseMaskVoxelList", this->GetComponentLabel(), level, 0 );
+  this->GetAsITKBaseType()->SetUseMaskVoxelList( useMaskVoxelList );
+
   /** Temporary?: Use the multi-threaded version or not. */
   std::string useMultiThread = this->m_Configuration->GetCommandLineArgument( "-mts" ); // mts: multi-threaded samplers
   if( useMultiThread == "true" )
@@ -64,6 +70,11 @@ ImageSamplerBase< TElastix >
   }
   else { this->GetAsITKBaseType()->SetUseMultiThread( false ); }
 
+  /** Share the samples with other registrations to the same fixed image,
+   * when elastix runs in batch mode. Only deterministic samplers use it.
+   */
+  this->GetAsITKBaseType()->SetFixedSideCache( this->GetElastix()->GetFixedSideCache() );
+
 } // end BeforeEachResolutionBase()
 
 
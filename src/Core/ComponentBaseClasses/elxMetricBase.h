@@ -63,6 +63,29 @@ namespace elastix
  *    CheckNumberOfSamples. \n
  *    example: <tt>(RequiredRatioOfValidSamples 0.1)</tt> \n
  *    The default is 0.25.
+ * \parameter MetricSampleScheduler: How the samples are distributed over the
+ *    threads: "Static" (one contiguous chunk per thread) or "WorkStealing"
+ *    (small blocks, idle threads take blocks from busy threads). Can be given
+ *    for each resolution or for all resolutions at once. \n
+ *    example: <tt>(MetricSampleScheduler "WorkStealing")</tt> \n
+ *    The default is "Static".
+ * \parameter MetricSampleBlockSize: The number of samples per block, used by
+ *    the "WorkStealing" scheduler. \n
+ *    example: <tt>(MetricSampleBlockSize 512)</tt> \n
+ *    The default is 256.
+ * \parameter UseBSplineWeightCache: Whether the B-spline support indices and
+ *    weights of the samples are computed once and reused in later iterations.
+ *    Only has effect for a B-spline transform without initial transform, and
+ *    is only useful when the same samples are used in every iteration, e.g.
+ *    with the "Full" or "Grid" sampler, or with NewSamplesEveryIteration
+ *    "false". The hit rate is reported after each resolution. \n
+ *    example: <tt>(UseBSplineWeightCache "true")</tt> \n
+ *    The default is "false".
+ * \parameter BSplineWeightCacheMaximumMemory: The maximum memory of the
+ *    B-spline weight cache, in megabytes. Samples that do not fit are not
+ *    cached. \n
+ *    example: <tt>(BSplineWeightCacheMaximumMemory 1024)</tt> \n
+ *    The default is 256.
  *
  * \ingroup Metrics
  * \ingroup ComponentBaseClasses
@@ -155,6 +178,11 @@ public:
    */
   virtual void AfterEachIterationBase( void );
 
+  /** Execute stuff after each resolution:
+   * \li Report the hit rate of the B-spline weight cache, if used.
+   */
+  virtual void AfterEachResolutionBase( void );
+
   /** Force the metric to base its computation on a new subset of image samples.
    * Not every metric may have implemented this.
    */
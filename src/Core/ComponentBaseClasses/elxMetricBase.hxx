@@ -177,8 +177,53 @@ MetricBase< TElastix >
         const unsigned int nrOfThreads = atoi( tmp.c_str() );
         thisAsAdvanced->SetNumberOfThreads( nrOfThreads );
       }
+
+      /** How should the samples be distributed over the threads? */
+      std::string scheduler = "Static";
+      this->GetConfiguration()->ReadParameter( scheduler,
+        "MetricSampleScheduler", this->GetComponentLabel(), level, 0 );
+      unsigned long blockSize = 256;
+      this->GetConfiguration()->ReadParameter( blockSize,
+        "MetricSampleBlockSize", this->GetComponentLabel(), level, 0 );
+
+      typedef itk::SampleBlockScheduler SampleBlockSchedulerType;
+      SampleBlockSchedulerType * sampleBlockScheduler
+        = thisAsAdvanced->GetSampleBlockScheduler();
+      if( scheduler == "WorkStealing" )
+      {
+        sampleBlockScheduler->SetSchedulingMode( SampleBlockSchedulerType::WorkStealing );
+      }
+      else if( scheduler == "Static" )
+      {
+        sampleBlockScheduler->SetSchedulingMode( SampleBlockSchedulerType::Static );
+      }
+      else
+      {
+        itkExceptionMacro( << "ERROR: MetricSampleScheduler should be \"Static\" "
+          << "or \"WorkStealing\", not \"" << scheduler << "\"." );
+      }
+      sampleBlockScheduler->SetBlockSize( blockSize );
     }
 
+    /** Should the B-spline weights of the samples be cached? */
+    bool useBSplineWeightCache = false;
+    this->GetConfiguration()->ReadParameter( useBSplineWeightCache,
+      "UseBSplineWeightCache", this->GetComponentLabel(), level, 0 );
+    thisAsAdvanced->SetUseBSplineWeightCache( useBSplineWeightCache );
+    if( useBSplineWeightCache )
+    {
+      unsigned long maximumMemory = 256;
+      this->GetConfiguration()->ReadParameter( maximumMemory,
+        "BSplineWeightCacheMaximumMemory", this->GetComponentLabel(), level, 0 );
+      thisAsAdvanced->GetBSplineWeightCache()->SetMaximumMemorySize( maximumMemory * 1024 * 1024 );
+      thisAsAdvanced->GetBSplineWeightCache()->Clear();
+    }
+
+    /** Share the fixed image extrema with other registrations to the same
+     * fixed image, when elastix runs in batch mode.
+     */
+    thisAsAdvanced->SetFixedSideCache( this->GetElastix()->GetFixedSideCache() );
+
   } // end advanced metric
 
 } // end BeforeEachResolutionBase()
@@ -214,6 +259,35 @@ MetricBase< TElastix >
 } // end AfterEachIterationBase()
 
 
+/**
+ * ******************* AfterEachResolutionBase ******************
+ */
+
+template< class TElastix >
+void
+MetricBase< TElastix >
+::AfterEachResolutionBase( void )
+{
+  /** Report the effectiveness of the B-spline weight cache. */
+  AdvancedMetricType * thisAsAdvanced
+    = dynamic_cast< AdvancedMetricType * >( this );
+  if( thisAsAdvanced != 0 && thisAsAdvanced->GetUseBSplineWeightCache() )
+  {
+    const typename AdvancedMetricType::BSplineWeightCacheType * cache
+      = thisAsAdvanced->GetBSplineWeightCache();
+    const itk::SizeValueType lookups = cache->GetNumberOfHits() + cache->GetNumberOfMisses();
+    if( lookups > 0 )
+    {
+      elxout << "B-spline weight cache of " << this->GetComponentLabel()
+             << ": hit rate " << cache->GetHitRate()
+             << " (" << lookups << " lookups, "
+             << cache->GetCapacity() << " samples cached)" << std::endl;
+    }
+  }
+
+} // end AfterEachResolutionBase()
+
+
 /**
  * ********************* SelectNewSamples ************************
  */
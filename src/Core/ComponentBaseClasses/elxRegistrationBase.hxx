@@ -118,9 +118,50 @@ RegistrationBase< TElastix >
     return fixedMaskSpatialObject;
   }
 
-  /** Erode, and convert to spatial object. */
+  /** The eroded mask depends on the mask, the schedule and the level only,
+   * so registrations to the same fixed image may share it. While one
+   * registration erodes it, the others wait.
+   */
+  itk::SharedObjectCache *            cache = this->GetElastix()->GetFixedSideCache();
+  std::ostringstream                  key;
+  itk::SharedObjectCache::Reservation reservation;
+  if( cache )
+  {
+    key << "ErodedFixedMask";
+    itk::SharedObjectCache::AppendToKey( key, maskImage );
+    const typename FixedImagePyramidType::ScheduleType & schedule = pyramid->GetSchedule();
+    for( unsigned int i = 0; i < schedule.rows(); ++i )
+    {
+      for( unsigned int j = 0; j < schedule.cols(); ++j )
+      {
+        key << " " << schedule[ i ][ j ];
+      }
+    }
+    key << " level " << level;
+
+    const FixedMaskImageType * cachedMask
+      = dynamic_cast< const FixedMaskImageType * >( cache->FindOrReserve( key.str(), reservation ) );
+    if( cachedMask )
+    {
+      fixedMaskSpatialObject->SetImage( cachedMask );
+      return fixedMaskSpatialObject;
+    }
+  }
+
+  /** Erode, and convert to spatial object. A shared mask is read through a
+   * view, since the erosion sets the requested region of its input.
+   */
   FixedMaskErodeFilterPointer erosion = FixedMaskErodeFilterType::New();
-  erosion->SetInput( maskImage );
+  if( cache )
+  {
+    FixedMaskImagePointer maskImageView = FixedMaskImageType::New();
+    maskImageView->Graft( maskImage );
+    erosion->SetInput( maskImageView );
+  }
+  else
+  {
+    erosion->SetInput( maskImage );
+  }
   erosion->SetSchedule( pyramid->GetSchedule() );
   erosion->SetIsMovingMask( false );
   erosion->SetResolutionLevel( level );
@@ -147,6 +188,14 @@ RegistrationBase< TElastix >
   /** Release some memory. */
   erodedFixedMaskAsImage->DisconnectPipeline();
 
+  /** Share it with the waiting registrations. */
+  if( cache )
+  {
+    fixedMaskSpatialObject->SetImage( static_cast< FixedMaskImageType * >(
+      reservation.Insert( erodedFixedMaskAsImage ) ) );
+    return fixedMaskSpatialObject;
+  }
+
   fixedMaskSpatialObject->SetImage( erodedFixedMaskAsImage );
   return fixedMaskSpatialObject;
 
@@ -847,9 +847,13 @@ ResamplerBase< TElastix >
    * elastix. Releasing some memory at this point helps a lot.
    */
 
-  /** Release more memory, but only if this is the final elastix level. */
+  /** Release more memory, but only if this is the final elastix level,
+   * and not when the fixed image and mask are shared with other
+   * registrations.
+   */
   if( this->GetConfiguration()->GetElastixLevel() + 1
-    == this->GetConfiguration()->GetTotalNumberOfElastixLevels() )
+    == this->GetConfiguration()->GetTotalNumberOfElastixLevels()
+    && !this->GetElastix()->GetFixedSideCache() )
   {
     /** Release fixed image memory. */
     const unsigned int nofi = this->GetElastix()->GetNumberOfFixedImages();
@@ -24,8 +24,10 @@
 #include "elxBaseComponentSE.h"
 #include "itkAdvancedTransform.h"
 #include "itkAdvancedCombinationTransform.h"
+#include "itkBakedDisplacementFieldTransform.h"
 #include "elxComponentDatabase.h"
 #include "elxProgressCommand.h"
+#include "itkMultiThreader.h"
 
 #include <fstream>
 #include <iomanip>
@@ -51,6 +53,25 @@ namespace elastix
  *   "Compose" by composition: \f$T(x) = T_1 ( T_0(x) )\f$.\n
  *   example: <tt>(HowToCombineTransforms "Add")</tt>\n
  *   Default: "Add".
+ * \parameter UseInitialTransformCache: Whether to store the initial transform
+ *   outputs of the samples, so that only the current transform is evaluated
+ *   in each iteration. Only used with "Compose", and only effective when the
+ *   samples are not renewed every iteration.\n
+ *   example: <tt>(UseInitialTransformCache "true")</tt>\n
+ *   Default: "false".
+ * \parameter BakeInitialTransform: Whether to replace the initial transform by a
+ *   displacement field, which is sampled from it once. The initial transform may
+ *   be a long chain of transforms; the displacement field is interpolated
+ *   multilinearly, at a cost that does not depend on the length of the chain.
+ *   The field covers the fixed image, or in transformix the output image; outside
+ *   it, the original chain is used. The approximation error is written to the log.
+ *   This parameter can also be added to a transform parameter file for transformix.\n
+ *   example: <tt>(BakeInitialTransform "true")</tt>\n
+ *   Default: "false".
+ * \parameter BakedInitialTransformSpacingFactor: The spacing of the displacement
+ *   field of BakeInitialTransform, as a factor of the voxel spacing, for each dimension.\n
+ *   example: <tt>(BakedInitialTransformSpacingFactor 2.0 2.0 1.0)</tt>\n
+ *   Default: 1.0 for each dimension. If only one value is given, it is used for all dimensions.
  *
  * \transformparameter UseDirectionCosines: Controls whether to use or ignore the
  * direction cosines (world matrix, transform matrix) set in the images.
@@ -107,6 +128,20 @@ namespace elastix
  * The location is relative to the path from where elastix/transformix is started!\n
  * Default: "NoInitialTransform", which (obviously) means that there is no initial transform
  * to be loaded.
+ * \transformparameter OutputPointsFileFormat: The format in which transformix writes the
+ * points that are transformed with <tt>-def inputPoints.txt</tt>. Choose from "txt", which
+ * writes the outputpoints.txt report with indices, points and deformations, and "bin",
+ * which only writes the transformed points to outputpoints.bin, in the binary format that
+ * is also accepted as input point file.\n
+ * example <tt>(OutputPointsFileFormat "bin")</tt>\n
+ * Default: "bin" for a binary input point file, and "txt" otherwise.
+ * \transformparameter DeformationFieldNumberOfSlabs: The number of slabs in which the
+ * deformation field of <tt>-def all</tt> is computed and written. With more than one slab
+ * the memory use scales with the slab size, and writing a slab overlaps with computing the
+ * next one. This requires a ResultImageFormat that supports streamed writing, such as mhd
+ * or nii; otherwise the field is written in one piece.\n
+ * example <tt>(DeformationFieldNumberOfSlabs 16)</tt>\n
+ * Default: 1, which computes the whole field before writing it.
  *
  * The command line arguments used by this class are:
  * \commandlinearg -t0: optional argument for elastix for specifying an initial transform
@@ -119,6 +154,8 @@ namespace elastix
  *    "point", depending if the user supplies voxel indices or real world coordinates.
  *    The second line should be the number of points that should be transformed. The
  *    third and following lines give the indices or points.\n
+ *    For large point sets a binary input point file can be used instead; see
+ *    itk::TransformixInputPointFileReader for its format.\n
  *    It is also possible to deform all points, thereby generating a deformation field
  *    image. This is done by:\n
  *    example: <tt>-def all</tt> \n
@@ -183,6 +220,8 @@ public:
     itkGetStaticConstMacro( FixedImageDimension ) >   CombinationTransformType;
   typedef typename
     CombinationTransformType::InitialTransformType InitialTransformType;
+  typedef itk::BakedDisplacementFieldTransform< CoordRepType,
+    itkGetStaticConstMacro( FixedImageDimension ) >   BakedTransformType;
 
   /** Typedef's from Transform. */
   typedef typename ITKBaseType::ParametersType ParametersType;
@@ -283,6 +322,11 @@ public:
    */
   virtual void ReadInitialTransformFromVector( const size_t index );
 
+  /** Function to replace the initial transform by a displacement field,
+   * if BakeInitialTransform is set.
+   */
+  virtual void BakeInitialTransform( void );
+
   /** Function to transform coordinates from fixed to moving image. */
   virtual void TransformPoints( void ) const;
 
@@ -331,6 +375,30 @@ protected:
   void AutomaticScalesEstimationStackTransform(
     const unsigned int & numSubTransforms, ScalesType & scales ) const;
 
+  /** Transform a set of points with multiple threads. Each thread calls
+   * TransformPointBatch() on blocks of points.
+   */
+  virtual void TransformPointsBatch(
+    const std::vector< InputPointType > & inputPoints,
+    std::vector< OutputPointType > & outputPoints ) const;
+
+  /** Write points in the binary format of the TransformixInputPointFileReader. */
+  virtual void WriteBinaryPointFile( const std::string & filename,
+    const std::vector< OutputPointType > & points ) const;
+
+  /** The threader callback of TransformPointsBatch(). */
+  static ITK_THREAD_RETURN_TYPE TransformPointsThreaderCallback( void * arg );
+
+  /** The data shared by the threads of TransformPointsBatch(). */
+  struct TransformPointsThreaderStruct
+  {
+    const ITKBaseType *    st_Transform;
+    const InputPointType * st_InputPoints;
+    OutputPointType *      st_OutputPoints;
+    itk::SizeValueType     st_NumberOfPoints;
+    itk::SizeValueType     st_BatchSize;
+  };
+
   /** Member variables. */
   ParametersType * m_TransformParametersPointer;
   std::string      m_TransformParametersFileName;
@@ -353,7 +421,21 @@ private:
       return "NoInitialTransform";
     }
 
-    const Self * t0 = dynamic_cast<const Self *>( this->GetInitialTransform() );
+    /** An initial transform that is not an elastix transform, passed in
+     * memory, can not be referred to.
+     */
+    const InitialTransformType * initialTransform = this->GetInitialTransform();
+    const BakedTransformType *   baked
+      = dynamic_cast< const BakedTransformType * >( initialTransform );
+    if( baked )
+    {
+      initialTransform = baked->GetSourceTransform();
+    }
+    const Self * t0 = dynamic_cast<const Self *>( initialTransform );
+    if( !t0 )
+    {
+      return "NoInitialTransform";
+    }
     return t0->GetTransformParametersFileName();
   }
 
@@ -25,18 +25,21 @@
 #include "itkTransformixInputPointFileReader.h"
 #include "vnl/vnl_math.h"
 #include <itksys/SystemTools.hxx>
+#include <algorithm>
 #include "itkVector.h"
 #include "itkTransformToDisplacementFieldFilter.h"
 #include "itkTransformToDeterminantOfSpatialJacobianSource.h"
 #include "itkTransformToSpatialJacobianSource.h"
 #include "itkImageFileWriter.h"
+#include "itkSlabStreamingImageFileWriter.h"
 #include "itkImageGridSampler.h"
 #include "itkContinuousIndex.h"
 #include "itkChangeInformationImageFilter.h"
+#include "itkPersistentThreadPool.h"
 #include "itkMesh.h"
 #include "itkMeshFileReader.h"
 #include "itkMeshFileWriter.h"
-#include "itkTransformMeshFilter.h"
+#include "itkTimeProbe.h"
 
 namespace itk
 {
@@ -256,6 +259,12 @@ TransformBase< TElastix >
     {
       thisAsGrouper->SetUseComposition( false );
     }
+
+    /** Read whether the initial transform outputs of the samples are cached. */
+    bool useInitialTransformCache = false;
+    this->m_Configuration->ReadParameter(
+      useInitialTransformCache, "UseInitialTransformCache", 0, false );
+    thisAsGrouper->SetUseInitialTransformCache( useInitialTransformCache );
   }
 
   /** Set the initial transform. Elastix returns an itk::Object, so try to
@@ -272,6 +281,14 @@ TransformBase< TElastix >
       this->SetInitialTransform( testPointer );
     }
   }
+  else if( this->m_Elastix->GetNumberOfConfigurations() > 0 )
+  {
+    /** In-memory transform parameter maps of the initial transform were
+     * given; the last one is the initial transform itself.
+     */
+    this->ReadInitialTransformFromVector(
+      this->m_Elastix->GetNumberOfConfigurations() - 1 );
+  }
   else
   {
     std::string fileName =  this->m_Configuration->GetCommandLineArgument( "-t0" );
@@ -288,6 +305,9 @@ TransformBase< TElastix >
     }
   }
 
+  /** Possibly replace the initial transform by a displacement field. */
+  this->BakeInitialTransform();
+
 } // end BeforeRegistrationBase()
 
 
@@ -460,8 +480,19 @@ TransformBase< TElastix >
   this->m_Configuration->ReadParameter( fileName,
     "InitialTransformParametersFileName", 0 );
 
-  /** Call the function ReadInitialTransformFromFile. */
-  if( fileName != "NoInitialTransform" )
+  /** Call the function ReadInitialTransformFromFile. The root of the
+   * chain may use an initial transform object that was passed in memory.
+   */
+  if( fileName == "NoInitialTransform" && this->m_Elastix->GetInitialTransform() )
+  {
+    InitialTransformType * testPointer = dynamic_cast< InitialTransformType * >(
+      this->m_Elastix->GetInitialTransform() );
+    if( testPointer )
+    {
+      this->SetInitialTransform( testPointer );
+    }
+  }
+  else if( fileName != "NoInitialTransform" )
   {
 #ifdef _ELASTIX_BUILD_LIBRARY
     /** Get initial transform index number. */
@@ -492,6 +523,9 @@ TransformBase< TElastix >
 #endif
   }
 
+  /** Possibly replace the initial transform by a displacement field. */
+  this->BakeInitialTransform();
+
   /** Task 3 - Read from the configuration file how to combine the
    * initial transform with the current transform.
    */
@@ -638,6 +672,103 @@ TransformBase< TElastix >
 } // end ReadInitialTransformFromFile()
 
 
+/**
+ * ******************* BakeInitialTransform *************
+ */
+
+template< class TElastix >
+void
+TransformBase< TElastix >
+::BakeInitialTransform( void )
+{
+  /** Check if the initial transform should be baked. */
+  bool bakeInitialTransform = false;
+  this->m_Configuration->ReadParameter( bakeInitialTransform,
+    "BakeInitialTransform", 0, false );
+  const InitialTransformType * initialTransform = this->GetInitialTransform();
+  if( !bakeInitialTransform || !initialTransform
+    || dynamic_cast< const BakedTransformType * >( initialTransform ) )
+  {
+    return;
+  }
+
+  /** The field covers the fixed image during registration, and the output
+   * image of the resampler in transformix. The latter takes the
+   * UseDirectionCosines parameter into account.
+   */
+  typename FixedImageType::ConstPointer domain = this->m_Elastix->GetFixedImage();
+  if( domain.IsNull() )
+  {
+    typename FixedImageType::Pointer dummyImage = FixedImageType::New();
+    typename FixedImageType::RegionType region;
+    region.SetIndex(
+      this->m_Elastix->GetElxResamplerBase()->GetAsITKBaseType()->GetOutputStartIndex() );
+    region.SetSize(
+      this->m_Elastix->GetElxResamplerBase()->GetAsITKBaseType()->GetSize() );
+    dummyImage->SetRegions( region );
+    dummyImage->SetOrigin(
+      this->m_Elastix->GetElxResamplerBase()->GetAsITKBaseType()->GetOutputOrigin() );
+    dummyImage->SetSpacing(
+      this->m_Elastix->GetElxResamplerBase()->GetAsITKBaseType()->GetOutputSpacing() );
+    dummyImage->SetDirection(
+      this->m_Elastix->GetElxResamplerBase()->GetAsITKBaseType()->GetOutputDirection() );
+    domain = dummyImage;
+  }
+
+  /** Set up a grid with the requested spacing that covers the domain. */
+  const typename FixedImageType::RegionType & region = domain->GetLargestPossibleRegion();
+  typename BakedTransformType::SizeType    gridSize;
+  typename BakedTransformType::SpacingType gridSpacing;
+  typename BakedTransformType::OriginType  gridOrigin;
+  for( unsigned int dim = 0; dim < FixedImageDimension; ++dim )
+  {
+    double spacingFactor = 1.0;
+    this->m_Configuration->ReadParameter( spacingFactor,
+      "BakedInitialTransformSpacingFactor", this->GetComponentLabel(), dim, 0 );
+    spacingFactor = std::max( spacingFactor, 1e-3 );
+
+    const double extent = ( region.GetSize()[ dim ] - 1 ) * domain->GetSpacing()[ dim ];
+    gridSpacing[ dim ] = spacingFactor * domain->GetSpacing()[ dim ];
+    gridSize[ dim ]    = static_cast< typename BakedTransformType::SizeType::SizeValueType >(
+      std::ceil( extent / gridSpacing[ dim ] - 1e-6 ) ) + 1;
+    gridSize[ dim ] = std::max( gridSize[ dim ],
+      static_cast< typename BakedTransformType::SizeType::SizeValueType >( 2 ) );
+  }
+  domain->TransformIndexToPhysicalPoint( region.GetIndex(), gridOrigin );
+
+  /** Sample the initial transform. */
+  elxout << "Baking the initial transform into a displacement field ..." << std::endl;
+  itk::TimeProbe timer;
+  timer.Start();
+
+  typename BakedTransformType::Pointer baked = BakedTransformType::New();
+  baked->SetSourceTransform( initialTransform );
+  baked->SetSize( gridSize );
+  baked->SetSpacing( gridSpacing );
+  baked->SetOrigin( gridOrigin );
+  baked->SetDirection( domain->GetDirection() );
+  const std::string threads = this->m_Configuration->GetCommandLineArgument( "-threads" );
+  if( !threads.empty() )
+  {
+    baked->SetNumberOfThreads( atoi( threads.c_str() ) );
+  }
+  baked->Bake();
+
+  timer.Stop();
+
+  /** Report the size and the approximation error. */
+  elxout << "  Grid size: " << gridSize << ", spacing: " << gridSpacing << "\n"
+         << "  Approximation error at " << baked->GetNumberOfErrorSamples()
+         << " cell centres: mean " << baked->GetMeanApproximationError()
+         << ", maximum " << baked->GetMaximumApproximationError() << "\n"
+         << "  Baking the initial transform took "
+         << this->ConvertSecondsToDHMS( timer.GetMean(), 2 ) << std::endl;
+
+  this->SetInitialTransform( baked );
+
+} // end BakeInitialTransform()
+
+
 /**
  * ******************* WriteToFile ******************************
  */
@@ -1233,11 +1364,26 @@ TransformBase< TElastix >
 
   /** Apply the transform. */
   elxout << "  The input points are transformed." << std::endl;
+  this->TransformPointsBatch( inputpointvec, outputpointvec );
+
+  /** Binary output skips the text report. */
+  std::string outputPointsFileFormat = ippReader->GetPointsAreBinary() ? "bin" : "txt";
+  this->m_Configuration->ReadParameter( outputPointsFileFormat,
+    "OutputPointsFileFormat", 0, false );
+  if( outputPointsFileFormat == "bin" )
+  {
+    std::string outputPointsFileName = this->m_Configuration
+      ->GetCommandLineArgument( "-out" );
+    outputPointsFileName += "outputpoints.bin";
+    elxout << "  The transformed points are saved in: "
+           <<  outputPointsFileName << std::endl;
+    this->WriteBinaryPointFile( outputPointsFileName, outputpointvec );
+    return;
+  }
+
+  /** Compute the indices and the displacements for the report. */
   for( unsigned int j = 0; j < nrofpoints; j++ )
   {
-    /** Call TransformPoint. */
-    outputpointvec[ j ] = this->GetAsITKBaseType()->TransformPoint( inputpointvec[ j ] );
-
     /** Transform back to index in fixed image domain. */
     dummyImage->TransformPhysicalPointToContinuousIndex(
       outputpointvec[ j ], fixedcindex );
@@ -1351,8 +1497,7 @@ TransformBase< TElastix >
     DummyIPPPixelType, FixedImageDimension, MeshTraitsType > MeshType;
   typedef itk::MeshFileReader< MeshType > MeshReaderType;
   typedef itk::MeshFileWriter< MeshType > MeshWriterType;
-  typedef itk::TransformMeshFilter<
-    MeshType, MeshType, CombinationTransformType >       TransformMeshFilterType;
+  typedef typename MeshType::PointType    MeshPointType;
 
   /** Read the input points. */
   typename MeshReaderType::Pointer meshReader = MeshReaderType::New();
@@ -1373,15 +1518,36 @@ TransformBase< TElastix >
   unsigned long nrofpoints = meshReader->GetOutput()->GetNumberOfPoints();
   elxout << "  Number of specified input points: " << nrofpoints << std::endl;
 
-  /** Apply the transform. */
+  /** Apply the transform. The points of the mesh are replaced in place,
+   * so that the cells and the point data are written unchanged.
+   */
   elxout << "  The input points are transformed." << std::endl;
-  typename TransformMeshFilterType::Pointer meshTransformer = TransformMeshFilterType::New();
-  meshTransformer->SetTransform(
-    const_cast< CombinationTransformType * >( this->GetAsCombinationTransform() ) );
-  meshTransformer->SetInput( meshReader->GetOutput() );
+  typename MeshType::Pointer      mesh = meshReader->GetOutput();
+  std::vector< InputPointType >  inputpointvec( nrofpoints );
+  std::vector< OutputPointType > outputpointvec( nrofpoints );
+  for( unsigned long j = 0; j < nrofpoints; j++ )
+  {
+    MeshPointType point; point.Fill( 0.0f );
+    mesh->GetPoint( j, &point );
+    for( unsigned int i = 0; i < FixedImageDimension; i++ )
+    {
+      inputpointvec[ j ][ i ] = point[ i ];
+    }
+  }
+
   try
   {
-    meshTransformer->Update();
+    this->TransformPointsBatch( inputpointvec, outputpointvec );
+
+    for( unsigned long j = 0; j < nrofpoints; j++ )
+    {
+      MeshPointType point;
+      for( unsigned int i = 0; i < FixedImageDimension; i++ )
+      {
+        point[ i ] = outputpointvec[ j ][ i ];
+      }
+      mesh->SetPoint( j, point );
+    }
   }
   catch( itk::ExceptionObject & err )
   {
@@ -1397,7 +1563,7 @@ TransformBase< TElastix >
          <<  outputPointsFileName << std::endl;
   typename MeshWriterType::Pointer meshWriter = MeshWriterType::New();
   meshWriter->SetFileName( outputPointsFileName.c_str() );
-  meshWriter->SetInput( meshTransformer->GetOutput() );
+  meshWriter->SetInput( mesh );
 
   try
   {
@@ -1412,6 +1578,139 @@ TransformBase< TElastix >
 } // end TransformPointsSomePointsVTK()
 
 
+/**
+ * ************** TransformPointsBatch *********************
+ */
+
+template< class TElastix >
+void
+TransformBase< TElastix >
+::TransformPointsBatch(
+  const std::vector< InputPointType > & inputPoints,
+  std::vector< OutputPointType > & outputPoints ) const
+{
+  outputPoints.resize( inputPoints.size() );
+  if( inputPoints.empty() ) { return; }
+
+  TransformPointsThreaderStruct userData;
+  userData.st_Transform      = this->GetAsITKBaseType();
+  userData.st_InputPoints    = &inputPoints[ 0 ];
+  userData.st_OutputPoints   = &outputPoints[ 0 ];
+  userData.st_NumberOfPoints = inputPoints.size();
+  userData.st_BatchSize      = 1024;
+
+  /** Do not start more threads than there are batches. */
+  const itk::SizeValueType numberOfBatches
+    = ( userData.st_NumberOfPoints + userData.st_BatchSize - 1 ) / userData.st_BatchSize;
+  itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+  threader->SetNumberOfThreads( static_cast< itk::ThreadIdType >( std::min(
+    static_cast< itk::SizeValueType >( threader->GetNumberOfThreads() ), numberOfBatches ) ) );
+
+  /** Launch, on the shared thread pool when available. */
+  itk::PersistentThreadPool::SingleMethodExecute( threader,
+    TransformPointsThreaderCallback, &userData );
+
+} // end TransformPointsBatch()
+
+
+/**
+ * ************** TransformPointsThreaderCallback *********************
+ */
+
+template< class TElastix >
+ITK_THREAD_RETURN_TYPE
+TransformBase< TElastix >
+::TransformPointsThreaderCallback( void * arg )
+{
+  itk::MultiThreader::ThreadInfoStruct * infoStruct
+    = static_cast< itk::MultiThreader::ThreadInfoStruct * >( arg );
+  const itk::ThreadIdType threadId        = infoStruct->ThreadID;
+  const itk::ThreadIdType numberOfThreads = infoStruct->NumberOfThreads;
+  TransformPointsThreaderStruct * userData
+    = static_cast< TransformPointsThreaderStruct * >( infoStruct->UserData );
+
+  const itk::SizeValueType numberOfPoints = userData->st_NumberOfPoints;
+  const itk::SizeValueType batchSize      = userData->st_BatchSize;
+
+  /** The batches are divided round-robin over the threads. */
+  typename ITKBaseType::SampleBatchType batch;
+  for( itk::SizeValueType first = threadId * batchSize; first < numberOfPoints;
+    first += numberOfThreads * batchSize )
+  {
+    const itk::SizeValueType n = std::min( batchSize, numberOfPoints - first );
+    userData->st_Transform->TransformPointBatch(
+      userData->st_InputPoints + first, n, batch );
+
+    /** The batch stores the points dimension after dimension. */
+    for( itk::SizeValueType s = 0; s < n; ++s )
+    {
+      OutputPointType & opp = userData->st_OutputPoints[ first + s ];
+      for( unsigned int d = 0; d < MovingImageDimension; ++d )
+      {
+        opp[ d ] = batch.m_TransformedPoints[ d * n + s ];
+      }
+    }
+  }
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end TransformPointsThreaderCallback()
+
+
+/**
+ * ************** WriteBinaryPointFile *********************
+ */
+
+template< class TElastix >
+void
+TransformBase< TElastix >
+::WriteBinaryPointFile( const std::string & filename,
+  const std::vector< OutputPointType > & points ) const
+{
+  typedef itk::TransformixInputPointFileReader<
+    itk::PointSet< bool, MovingImageDimension > > IPPReaderType;
+
+  std::ofstream file( filename.c_str(), std::ios::out | std::ios::binary );
+  if( !file.is_open() )
+  {
+    itkExceptionMacro( << "ERROR: could not open " << filename << " for writing." );
+  }
+
+  /** Write the header. The transformed points are always world coordinates. */
+  const std::string signature        = IPPReaderType::GetBinaryPointFileSignature();
+  const itk::uint32_t dimension        = MovingImageDimension;
+  const itk::uint32_t pointsAreIndices = 0;
+  const itk::uint64_t numberOfPoints   = points.size();
+  file.write( signature.c_str(), signature.size() );
+  file.write( reinterpret_cast< const char * >( &dimension ), sizeof( dimension ) );
+  file.write( reinterpret_cast< const char * >( &pointsAreIndices ), sizeof( pointsAreIndices ) );
+  file.write( reinterpret_cast< const char * >( &numberOfPoints ), sizeof( numberOfPoints ) );
+
+  /** Write the coordinates in chunks. */
+  const std::size_t     chunkSize = 4096;
+  std::vector< double > buffer( chunkSize * MovingImageDimension );
+  for( std::size_t first = 0; first < points.size(); first += chunkSize )
+  {
+    const std::size_t n = std::min( chunkSize, points.size() - first );
+    for( std::size_t j = 0; j < n; ++j )
+    {
+      for( unsigned int i = 0; i < MovingImageDimension; ++i )
+      {
+        buffer[ j * MovingImageDimension + i ] = points[ first + j ][ i ];
+      }
+    }
+    file.write( reinterpret_cast< const char * >( &buffer[ 0 ] ),
+      n * MovingImageDimension * sizeof( double ) );
+  }
+
+  if( !file )
+  {
+    itkExceptionMacro( << "ERROR: could not write the points to " << filename << "." );
+  }
+
+} // end WriteBinaryPointFile()
+
+
 /**
  * ************** TransformPointsAllPoints **********************
  *
@@ -1437,6 +1736,8 @@ TransformBase< TElastix >
     DeformationFieldImageType >                       ChangeInfoFilterType;
   typedef itk::ImageFileWriter<
     DeformationFieldImageType >                       DeformationFieldWriterType;
+  typedef itk::SlabStreamingImageFileWriter<
+    DeformationFieldImageType >                       DeformationFieldSlabWriterType;
 
   /** Create an setup deformation field generator. */
   typename DeformationFieldGeneratorType::Pointer defGenerator
@@ -1463,13 +1764,10 @@ TransformBase< TElastix >
   infoChanger->SetChangeDirection( retdc & !this->GetElastix()->GetUseDirectionCosines() );
   infoChanger->SetInput( defGenerator->GetOutput() );
 
-  /** Track the progress of the generation of the deformation field. */
-#ifndef _ELASTIX_BUILD_LIBRARY
-  typename ProgressCommandType::Pointer progressObserver = ProgressCommandType::New();
-  progressObserver->ConnectObserver( defGenerator );
-  progressObserver->SetStartString( "  Progress: " );
-  progressObserver->SetEndString( "%" );
-#endif
+  /** Read the number of slabs in which the field is computed and written. */
+  unsigned int numberOfSlabs = 1;
+  this->m_Configuration->ReadParameter( numberOfSlabs,
+    "DeformationFieldNumberOfSlabs", 0, false );
 
   /** Create a name for the deformation field file. */
   std::string resultImageFormat = "mhd";
@@ -1478,14 +1776,52 @@ TransformBase< TElastix >
   makeFileName << this->m_Configuration->GetCommandLineArgument( "-out" )
                << "deformationField." << resultImageFormat;
 
-  /** Write outputImage to disk. */
-  typename DeformationFieldWriterType::Pointer defWriter
-    = DeformationFieldWriterType::New();
-  defWriter->SetInput( infoChanger->GetOutput() );
-  defWriter->SetFileName( makeFileName.str().c_str() );
+  /** Write outputImage to disk. When slabs are requested, the field is
+   * streamed, so that it never has to be in memory as a whole.
+   */
+  itk::ProcessObject::Pointer defWriter;
+  if( numberOfSlabs > 1 )
+  {
+    typename DeformationFieldSlabWriterType::Pointer slabWriter
+      = DeformationFieldSlabWriterType::New();
+    slabWriter->SetInput( infoChanger->GetOutput() );
+    slabWriter->SetFileName( makeFileName.str().c_str() );
+    slabWriter->SetNumberOfSlabs( numberOfSlabs );
+    defWriter = slabWriter.GetPointer();
+  }
+  else
+  {
+    typename DeformationFieldWriterType::Pointer imageWriter
+      = DeformationFieldWriterType::New();
+    imageWriter->SetInput( infoChanger->GetOutput() );
+    imageWriter->SetFileName( makeFileName.str().c_str() );
+    defWriter = imageWriter.GetPointer();
+  }
+
+  /** Track the progress of the generation of the deformation field.
+   * When streaming, the progress of the generator restarts for each slab,
+   * so the progress of the writer is shown instead.
+   */
+#ifndef _ELASTIX_BUILD_LIBRARY
+  typename ProgressCommandType::Pointer progressObserver = ProgressCommandType::New();
+  if( numberOfSlabs > 1 )
+  {
+    progressObserver->ConnectObserver( defWriter );
+  }
+  else
+  {
+    progressObserver->ConnectObserver( defGenerator );
+  }
+  progressObserver->SetStartString( "  Progress: " );
+  progressObserver->SetEndString( "%" );
+#endif
 
   /** Do the writing. */
   elxout << "  Computing and writing the deformation field ..." << std::endl;
+  if( numberOfSlabs > 1 )
+  {
+    elxout << "  (in at most " << numberOfSlabs << " slabs)" << std::endl;
+  }
   try
   {
     defWriter->Update();
@@ -17,7 +17,7 @@
  *=========================================================================*/
 #include "elxElastixBase.h"
 #include <sstream>
-#include "itkMersenneTwisterRandomVariateGenerator.h"
+#include "itkThreadRandomGenerator.h"
 
 namespace elastix
 {
@@ -65,6 +65,9 @@ ElastixBase::ElastixBase()
   this->m_InitialTransform = 0;
   this->m_FinalTransform   = 0;
 
+  /** No fixed-side results are shared by default. */
+  this->m_FixedSideCache = 0;
+
   /** From Elastix 4.3 to 4.7: Ignore direction cosines by default, for
    * backward compatability. From Elastix 4.8: set it to true by default.*/
   this->m_UseDirectionCosines = true;
@@ -237,12 +240,13 @@ ElastixBase::BeforeAllBase( void )
   /** Set the random seed. Use 121212 as a default, which is the same as
    * the default in the MersenneTwister code.
    * Use silent parameter file readout, to avoid annoying warning when
-   * starting elastix */
-  typedef itk::Statistics::MersenneTwisterRandomVariateGenerator RandomGeneratorType;
-  typedef RandomGeneratorType::IntegerType                       SeedType;
+   * starting elastix. In an ElastixContext this seeds the generator of
+   * the context. */
+  typedef itk::ThreadRandomGenerator::GeneratorType RandomGeneratorType;
+  typedef RandomGeneratorType::IntegerType          SeedType;
   unsigned int randomSeed = 121212;
   this->GetConfiguration()->ReadParameter( randomSeed, "RandomSeed", 0, false );
-  RandomGeneratorType::Pointer randomGenerator = RandomGeneratorType::GetInstance();
+  RandomGeneratorType::Pointer randomGenerator = itk::ThreadRandomGenerator::GetInstance();
   randomGenerator->SetSeed( static_cast< SeedType >( randomSeed ) );
 
   /** Return a value. */
@@ -38,6 +38,7 @@
 #include "itkVectorContainer.h"
 #include "itkImageFileReader.h"
 #include "itkChangeInformationImageFilter.h"
+#include "itkSharedObjectCache.h"
 
 #include <fstream>
 #include <iomanip>
@@ -170,6 +171,7 @@ public:
   typedef ComponentDatabaseType::Pointer   ComponentDatabasePointer;
   typedef ComponentDatabaseType::IndexType DBIndexType;
   typedef std::vector< double >            FlatDirectionCosinesType;
+  typedef itk::SharedObjectCache           SharedObjectCacheType;
 
   /** Typedef that is used in the elastix dll version. */
   typedef itk::ParameterMapInterface::ParameterMapType ParameterMapType;
@@ -206,6 +208,13 @@ public:
   elxGetObjectMacro( ComponentDatabase, ComponentDatabaseType );
   elxSetObjectMacro( ComponentDatabase, ComponentDatabaseType );
 
+  /** Set/Get the cache of the fixed-side results, shared by registrations
+   * of several moving images to the same fixed image. NULL (the default)
+   * disables sharing. See ELASTIX::RegisterImageBatch().
+   */
+  elxGetObjectMacro( FixedSideCache, SharedObjectCacheType );
+  elxSetObjectMacro( FixedSideCache, SharedObjectCacheType );
+
   /** Get the component containers.
    * The component containers store components, such as
    * the metric, in the form of an itk::Object::Pointer.
@@ -368,6 +377,8 @@ protected:
   DBIndexType              m_DBIndex;
   ComponentDatabasePointer m_ComponentDatabase;
 
+  SharedObjectCacheType::Pointer m_FixedSideCache;
+
   FlatDirectionCosinesType m_OriginalFixedImageDirection;
 
   /** Convenient mini class to load the files specified by a filename container
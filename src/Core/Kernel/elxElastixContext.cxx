@@ -0,0 +1,249 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "elxElastixContext.h"
+#include "itkMultiThreader.h"
+
+namespace elastix
+{
+
+/**
+ * ********************* Constructor ****************************
+ */
+
+ElastixContext::ElastixContext()
+{
+  this->m_ComponentDatabase      = 0;
+  this->m_ComponentLoader        = 0;
+  this->m_ComponentsLoaded       = false;
+  this->m_RandomGenerator        = RandomGeneratorInstanceType::New();
+  this->m_ThreadPool             = 0;
+  this->m_MaximumNumberOfThreads = 0;
+
+} // end Constructor
+
+
+/**
+ * ********************** Destructor ****************************
+ */
+
+ElastixContext::~ElastixContext()
+{
+  /** The calling thread should not keep referring to this context. */
+  if( xl::get_thread_xout() == &this->m_Xout )
+  {
+    this->Deactivate();
+  }
+
+} // end Destructor
+
+
+/**
+ * ******************* GetNumberOfThreads ***********************
+ */
+
+ElastixContext::ThreadIdType
+ElastixContext::GetNumberOfThreads( void ) const
+{
+  if( this->m_MaximumNumberOfThreads > 0 )
+  {
+    return this->m_MaximumNumberOfThreads;
+  }
+  return itk::MultiThreader::GetGlobalDefaultNumberOfThreads();
+
+} // end GetNumberOfThreads()
+
+
+/**
+ * ********************* SetupLogging ***************************
+ *
+ * Same as xoutSetup(), but with the target cells of this context.
+ */
+
+int
+ElastixContext::SetupLogging( const char * logfilename,
+  bool setupLogging, bool setupCout )
+{
+  int returndummy = 0;
+
+  /** Start from scratch, so that a context can be reused. */
+  this->m_Xout.RemoveOutput( "log" );
+  this->m_Xout.RemoveOutput( "cout" );
+  if( this->m_LogFileStream.is_open() )
+  {
+    this->m_LogFileStream.close();
+  }
+  this->m_LogFileStream.clear();
+
+  if( setupLogging )
+  {
+    /** Open the logfile for writing. */
+    this->m_LogFileStream.open( logfilename );
+    if( !this->m_LogFileStream.is_open() )
+    {
+      std::cerr << "ERROR: LogFile cannot be opened!" << std::endl;
+      return 1;
+    }
+    returndummy |= this->m_Xout.AddOutput( "log", &this->m_LogFileStream );
+  }
+  if( setupCout )
+  {
+    returndummy |= this->m_Xout.AddOutput( "cout", &std::cout );
+  }
+
+  /** Set outputs of LogOnly and CoutOnly. */
+  returndummy |= this->m_LogOnlyXout.AddOutput( "log", &this->m_LogFileStream );
+  returndummy |= this->m_CoutOnlyXout.AddOutput( "cout", &std::cout );
+
+  /** Copy the outputs to the warning-, error- and standard-xouts. */
+  this->m_WarningXout.SetOutputs( this->m_Xout.GetCOutputs() );
+  this->m_ErrorXout.SetOutputs( this->m_Xout.GetCOutputs() );
+  this->m_StandardXout.SetOutputs( this->m_Xout.GetCOutputs() );
+
+  this->m_WarningXout.SetOutputs( this->m_Xout.GetXOutputs() );
+  this->m_ErrorXout.SetOutputs( this->m_Xout.GetXOutputs() );
+  this->m_StandardXout.SetOutputs( this->m_Xout.GetXOutputs() );
+
+  /** Link the warning-, error- and standard-xouts to xout. */
+  returndummy |= this->m_Xout.AddTargetCell( "warning", &this->m_WarningXout );
+  returndummy |= this->m_Xout.AddTargetCell( "error", &this->m_ErrorXout );
+  returndummy |= this->m_Xout.AddTargetCell( "standard", &this->m_StandardXout );
+  returndummy |= this->m_Xout.AddTargetCell( "logonly", &this->m_LogOnlyXout );
+  returndummy |= this->m_Xout.AddTargetCell( "coutonly", &this->m_CoutOnlyXout );
+
+  /** Format the output. */
+  this->m_Xout[ "standard" ] << std::fixed;
+  this->m_Xout[ "standard" ] << std::showpoint;
+
+  return returndummy;
+
+} // end SetupLogging()
+
+
+/**
+ * ********************* LoadComponents *************************
+ */
+
+int
+ElastixContext::LoadComponents( const char * argv0 )
+{
+  if( this->m_ComponentsLoaded )
+  {
+    return 0;
+  }
+
+  if( this->m_ComponentDatabase.IsNull() )
+  {
+    this->m_ComponentDatabase = ComponentDatabaseType::New();
+  }
+  if( this->m_ComponentLoader.IsNull() )
+  {
+    this->m_ComponentLoader = ComponentLoaderType::New();
+    this->m_ComponentLoader->SetComponentDatabase( this->m_ComponentDatabase );
+  }
+
+  const int returndummy = this->m_ComponentLoader->LoadComponents( argv0 );
+  this->m_ComponentsLoaded = ( returndummy == 0 );
+  return returndummy;
+
+} // end LoadComponents()
+
+
+/**
+ * ************************ Activate ****************************
+ */
+
+void
+ElastixContext::Activate( void )
+{
+  /** Create the pool, or resize it when the budget changed. */
+  if( this->m_ThreadPool.IsNull() )
+  {
+    this->m_ThreadPool = ThreadPoolType::New();
+  }
+  this->m_ThreadPool->SetNumberOfThreads( this->GetNumberOfThreads() );
+
+  /** The calling thread, and then the workers: a job with as many thread
+   * ids as the pool has threads visits every worker exactly once.
+   */
+  xl::set_thread_xout( &this->m_Xout );
+  ThreadPoolType::SetThreadInstance( this->m_ThreadPool );
+  RandomGeneratorInstanceType::SetThreadInstance( this->m_RandomGenerator );
+  if( !this->m_ThreadPool->Execute( ActivateThreaderCallback, this,
+    this->m_ThreadPool->GetNumberOfThreads() ) )
+  {
+    /** The guard does not deactivate a context that failed to activate. */
+    this->Deactivate();
+    itkExceptionMacro( << "ERROR: the thread pool of the context is busy, "
+                       << "so its threads could not be activated." );
+  }
+
+} // end Activate()
+
+
+/**
+ * ************************ Deactivate **************************
+ */
+
+void
+ElastixContext::Deactivate( void )
+{
+  xl::set_thread_xout( 0 );
+  ThreadPoolType::SetThreadInstance( NULL );
+  RandomGeneratorInstanceType::SetThreadInstance( NULL );
+
+} // end Deactivate()
+
+
+/**
+ * **************** ActivateThreaderCallback ********************
+ */
+
+ITK_THREAD_RETURN_TYPE
+ElastixContext::ActivateThreaderCallback( void * arg )
+{
+  itk::MultiThreader::ThreadInfoStruct * infoStruct
+    = static_cast< itk::MultiThreader::ThreadInfoStruct * >( arg );
+  Self * context = static_cast< Self * >( infoStruct->UserData );
+
+  xl::set_thread_xout( &context->m_Xout );
+  ThreadPoolType::SetThreadInstance( context->m_ThreadPool );
+  RandomGeneratorInstanceType::SetThreadInstance( context->m_RandomGenerator );
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end ActivateThreaderCallback()
+
+
+/**
+ * ************************ PrintSelf ***************************
+ */
+
+void
+ElastixContext::PrintSelf( std::ostream & os, itk::Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "MaximumNumberOfThreads: " << this->m_MaximumNumberOfThreads << std::endl;
+  os << indent << "ComponentDatabase: " << this->m_ComponentDatabase.GetPointer() << std::endl;
+  os << indent << "ThreadPool: " << this->m_ThreadPool.GetPointer() << std::endl;
+  os << indent << "RandomGenerator: " << this->m_RandomGenerator.GetPointer() << std::endl;
+
+} // end PrintSelf()
+
+
+} // end namespace elastix
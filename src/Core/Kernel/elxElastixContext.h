@@ -0,0 +1,198 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __elxElastixContext_h
+#define __elxElastixContext_h
+
+#include "elxComponentDatabase.h"
+#include "elxComponentLoader.h"
+#include "itkObject.h"
+#include "itkPersistentThreadPool.h"
+#include "itkThreadRandomGenerator.h"
+#include "xoutmain.h"
+
+#include <fstream>
+
+namespace elastix
+{
+
+/**
+ * \class ElastixContext
+ * \brief The state that a registration would otherwise share with all
+ * other registrations in the process.
+ *
+ * elastix keeps its logger (xout), its component database, its thread
+ * pool and its random generator in process-wide variables, so that only one
+ * registration can run at a time. An ElastixContext owns its own copies of
+ * these:
+ * - the xout target cells and log file, configured by SetupLogging();
+ * - a ComponentDatabase, filled by LoadComponents();
+ * - a PersistentThreadPool of MaximumNumberOfThreads threads;
+ * - a random generator, which ElastixBase seeds with the RandomSeed.
+ *
+ * Activate() makes the xout, the thread pool and the random generator of the
+ * context the ones of the calling thread and of the workers of the pool.
+ * Components that launch their threads through
+ * PersistentThreadPool::SingleMethodExecute() then run on the pool of the
+ * context, and never use more threads than it has. Components that get their
+ * generator from itk::ThreadRandomGenerator draw from the one of the context,
+ * so that the result of a registration does not depend on the others.
+ * An ElastixMain with a context uses the component database of the context,
+ * and leaves the global thread settings alone.
+ *
+ * Several registrations can thus run concurrently, each in its own thread
+ * with its own context. A context must be used by one registration at a
+ * time. ELASTIX::SetContext() and ElastixFilter::SetContext() accept one.
+ *
+ * \ingroup Kernel
+ */
+
+class ElastixContext : public itk::Object
+{
+public:
+
+  /** Standard itk. */
+  typedef ElastixContext                  Self;
+  typedef itk::Object                     Superclass;
+  typedef itk::SmartPointer< Self >       Pointer;
+  typedef itk::SmartPointer< const Self > ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( ElastixContext, Object );
+
+  /** Typedefs. */
+  typedef ComponentDatabase                          ComponentDatabaseType;
+  typedef ComponentDatabaseType::Pointer             ComponentDatabasePointer;
+  typedef ComponentLoader                            ComponentLoaderType;
+  typedef ComponentLoaderType::Pointer               ComponentLoaderPointer;
+  typedef itk::PersistentThreadPool                  ThreadPoolType;
+  typedef ThreadPoolType::Pointer                    ThreadPoolPointer;
+  typedef itk::ThreadIdType                          ThreadIdType;
+  typedef itk::ThreadRandomGenerator                 RandomGeneratorInstanceType;
+  typedef RandomGeneratorInstanceType::GeneratorType RandomGeneratorType;
+  typedef RandomGeneratorType::Pointer               RandomGeneratorPointer;
+
+  /** Set/Get the maximum number of threads of the registrations in this
+   * context. 0 means the default number of threads of the MultiThreader.
+   * Takes effect in the next Activate(). Default: 0.
+   */
+  itkSetMacro( MaximumNumberOfThreads, ThreadIdType );
+  itkGetConstMacro( MaximumNumberOfThreads, ThreadIdType );
+
+  /** Get the number of threads that the thread pool gets. */
+  ThreadIdType GetNumberOfThreads( void ) const;
+
+  /** Configure the xout of this context, as xoutSetup() does for the
+   * process-wide xout. Returns 0 if everything went ok, 1 otherwise.
+   */
+  int SetupLogging( const char * logfilename, bool setupLogging, bool setupCout );
+
+  /** Fill the component database of this context, once. */
+  int LoadComponents( const char * argv0 );
+
+  /** Get the component database of this context. */
+  itkGetObjectMacro( ComponentDatabase, ComponentDatabaseType );
+
+  /** Get the thread pool of this context; created by Activate(). */
+  itkGetObjectMacro( ThreadPool, ThreadPoolType );
+
+  /** Get the random generator of this context. */
+  itkGetObjectMacro( RandomGenerator, RandomGeneratorType );
+
+  /** Make the xout, the thread pool and the random generator of this
+   * context the ones of the calling thread and of the workers of the pool.
+   * Nothing is logged before SetupLogging() has been called. Throws when
+   * the pool is busy, e.g. when the context is used by two registrations.
+   */
+  void Activate( void );
+
+  /** Let the calling thread use the process-wide xout, thread pool and
+   * random generator again.
+   */
+  void Deactivate( void );
+
+  /** Activates a context for the lifetime of the guard; does nothing for a
+   * NULL context.
+   */
+  class ActivationGuard
+  {
+public:
+
+    ActivationGuard( ElastixContext * context ) : m_Context( context )
+    {
+      if( this->m_Context ) { this->m_Context->Activate(); }
+    }
+
+
+    ~ActivationGuard()
+    {
+      if( this->m_Context ) { this->m_Context->Deactivate(); }
+    }
+
+
+private:
+
+    ActivationGuard( const ActivationGuard & ); // purposely not implemented
+    void operator=( const ActivationGuard & );  // purposely not implemented
+
+    ElastixContext * m_Context;
+  };
+
+protected:
+
+  ElastixContext();
+  virtual ~ElastixContext();
+
+  /** PrintSelf. */
+  virtual void PrintSelf( std::ostream & os, itk::Indent indent ) const;
+
+  /** Installs the xout, the pool and the generator of the context in a worker. */
+  static ITK_THREAD_RETURN_TYPE ActivateThreaderCallback( void * arg );
+
+private:
+
+  ElastixContext( const Self & );  // purposely not implemented
+  void operator=( const Self & );  // purposely not implemented
+
+  /** The xout target cells and the log file. */
+  xl::xoutbase_type   m_Xout;
+  xl::xoutsimple_type m_WarningXout;
+  xl::xoutsimple_type m_ErrorXout;
+  xl::xoutsimple_type m_StandardXout;
+  xl::xoutsimple_type m_CoutOnlyXout;
+  xl::xoutsimple_type m_LogOnlyXout;
+  std::ofstream       m_LogFileStream;
+
+  ComponentDatabasePointer m_ComponentDatabase;
+  ComponentLoaderPointer   m_ComponentLoader;
+  bool                     m_ComponentsLoaded;
+  RandomGeneratorPointer   m_RandomGenerator;
+
+  /** Declared after the xout cells, so that the workers, which may still
+   * refer to them, are stopped first.
+   */
+  ThreadPoolPointer m_ThreadPool;
+  ThreadIdType      m_MaximumNumberOfThreads;
+
+};
+
+} // end namespace elastix
+
+#endif // end #ifndef __elxElastixContext_h
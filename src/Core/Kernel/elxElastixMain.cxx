@@ -154,6 +154,10 @@ ElastixMain::ElastixMain()
   this->m_InitialTransform = 0;
   this->m_TransformParametersMap.clear();
 
+  this->m_ThreadPool     = 0;
+  this->m_Context        = 0;
+  this->m_FixedSideCache = 0;
+
 } // end Constructor
 
 
@@ -170,6 +174,12 @@ ElastixMain::ComponentLoaderPointer   ElastixMain::s_ComponentLoader = 0;
 
 ElastixMain::~ElastixMain()
 {
+  /** Stop sharing the thread pool before it is destroyed. */
+  if( ThreadPoolType::GetGlobalInstance() == this->m_ThreadPool.GetPointer() )
+  {
+    ThreadPoolType::SetGlobalInstance( NULL );
+  }
+
 #ifdef ELASTIX_USE_OPENCL
   itk::OpenCLContext::Pointer context = itk::OpenCLContext::GetInstance();
   if( context->IsCreated() )
@@ -319,8 +329,9 @@ ElastixMain::Run( void )
 
   /** Set some information in the ElastixBase. */
   this->GetElastixBase()->SetConfiguration( this->m_Configuration );
-  this->GetElastixBase()->SetComponentDatabase( this->s_CDB );
+  this->GetElastixBase()->SetComponentDatabase( this->GetActiveComponentDatabase() );
   this->GetElastixBase()->SetDBIndex( this->m_DBIndex );
+  this->GetElastixBase()->SetFixedSideCache( this->m_FixedSideCache );
 
   /** Populate the component containers. ImageSampler is not mandatory.
    * No defaults are specified for ImageSampler, Metric, Transform
@@ -382,6 +393,32 @@ ElastixMain::Run( void )
   /** Set the initial transform, if it happens to be there. */
   this->GetElastixBase()->SetInitialTransform( this->GetInitialTransform() );
 
+  /** Set the parameter maps of an in-memory initial transform. Each map
+   * gets its index as "-tp", which is how the transform parameter maps
+   * refer to each other when elastix is used as a library.
+   */
+  if( !this->m_InitialTransformParameterMaps.empty() )
+  {
+    std::vector< ConfigurationPointer > configurations(
+      this->m_InitialTransformParameterMaps.size() );
+    for( size_t i = 0; i < configurations.size(); ++i )
+    {
+      std::ostringstream index;
+      index << i;
+      ArgumentMapType argmap;
+      argmap.insert( ArgumentMapType::value_type( "-tp", index.str() ) );
+
+      configurations[ i ] = ConfigurationType::New();
+      if( configurations[ i ]->Initialize( argmap, this->m_InitialTransformParameterMaps[ i ] ) )
+      {
+        xout[ "error" ] << "ERROR: Something went wrong during initialization of the "
+                        << "configuration object of initial transform " << i << "." << std::endl;
+        return 1;
+      }
+    }
+    this->GetElastixBase()->SetConfigurations( configurations );
+  }
+
   /** Set the original fixed image direction cosines (relevant in case the
    * UseDirectionCosines parameter was set to false.
    */
@@ -635,7 +672,7 @@ ElastixMain::InitDBIndex( void )
     }
 
     /** Load the components. */
-    if( this->s_CDB.IsNull() )
+    if( this->GetActiveComponentDatabase() == NULL )
     {
       int loadReturnCode = this->LoadComponents();
       if( loadReturnCode != 0 )
@@ -645,10 +682,10 @@ ElastixMain::InitDBIndex( void )
       }
     }
 
-    if( this->s_CDB.IsNotNull() )
+    if( this->GetActiveComponentDatabase() != NULL )
     {
       /** Get the DBIndex from the ComponentDatabase. */
-      this->m_DBIndex = this->s_CDB->GetIndex(
+      this->m_DBIndex = this->GetActiveComponentDatabase()->GetIndex(
         this->m_FixedImagePixelType,
         this->m_FixedImageDimension,
         this->m_MovingImagePixelType,
@@ -737,6 +774,13 @@ ElastixMain::GetTotalNumberOfElastixLevels( void )
 int
 ElastixMain::LoadComponents( void )
 {
+  /** A context has its own component database. */
+  if( this->m_Context.IsNotNull() )
+  {
+    return this->m_Context->LoadComponents(
+      this->m_Configuration->GetCommandLineArgument( "-argv0" ).c_str() );
+  }
+
   /** Create a ComponentDatabase. */
   if( this->s_CDB.IsNull() )
   {
@@ -780,6 +824,22 @@ ElastixMain::UnloadComponents( void )
 } // end UnloadComponents()
 
 
+/**
+ * ********************* GetActiveComponentDatabase **************************
+ */
+
+ComponentDatabase *
+ElastixMain::GetActiveComponentDatabase( void ) const
+{
+  if( this->m_Context.IsNotNull() )
+  {
+    return this->m_Context->GetComponentDatabase();
+  }
+  return s_CDB.GetPointer();
+
+} // end GetActiveComponentDatabase()
+
+
 /**
  * ************************* GetElastixBase ***************************
  */
@@ -812,7 +872,7 @@ ElastixMain::CreateComponent(
   /** A pointer to the New() function. */
   PtrToCreator  testcreator = 0;
   ObjectPointer testpointer = 0;
-  testcreator = this->s_CDB->GetCreator( name,  this->m_DBIndex );
+  testcreator = this->GetActiveComponentDatabase()->GetCreator( name,  this->m_DBIndex );
   testpointer = testcreator ? testcreator() : NULL;
   if( testpointer.IsNull() )
   {
@@ -969,8 +1029,18 @@ ElastixMain::SetProcessPriority( void ) const
  */
 
 void
-ElastixMain::SetMaximumNumberOfThreads( void ) const
+ElastixMain::SetMaximumNumberOfThreads( void )
 {
+  /** A context has its own thread budget; the global settings are shared
+   * with the registrations in other contexts, so leave them alone.
+   */
+  if( this->m_Context.IsNotNull() )
+  {
+    this->m_Context->Activate();
+    this->m_ThreadPool = this->m_Context->GetThreadPool();
+    return;
+  }
+
   /** Get the number of threads from the command line. */
   std::string maximumNumberOfThreadsString
     = this->m_Configuration->GetCommandLineArgument( "-threads" );
@@ -983,6 +1053,18 @@ ElastixMain::SetMaximumNumberOfThreads( void ) const
     itk::MultiThreader::SetGlobalMaximumNumberOfThreads(
       maximumNumberOfThreads );
   }
+
+  /** Create the thread pool, or resize it, with as many threads as the
+   * components will use by default, and let all components share it.
+   */
+  if( this->m_ThreadPool.IsNull() )
+  {
+    this->m_ThreadPool = ThreadPoolType::New();
+  }
+  this->m_ThreadPool->SetNumberOfThreads(
+    itk::MultiThreader::GetGlobalDefaultNumberOfThreads() );
+  ThreadPoolType::SetGlobalInstance( this->m_ThreadPool );
+
 } // end SetMaximumNumberOfThreads()
 
 
@@ -1009,6 +1091,30 @@ ElastixMain::GetOriginalFixedImageDirectionFlat( void ) const
 } // end GetOriginalFixedImageDirectionFlat()
 
 
+/**
+ * ******************** SetInitialTransformParameterMaps ********************
+ */
+
+void
+ElastixMain::SetInitialTransformParameterMaps(
+  const std::vector< ParameterMapType > & maps )
+{
+  this->m_InitialTransformParameterMaps = maps;
+  this->Modified();
+} // end SetInitialTransformParameterMaps()
+
+
+/**
+ * ******************** GetInitialTransformParameterMaps ********************
+ */
+
+const std::vector< ElastixMain::ParameterMapType > &
+ElastixMain::GetInitialTransformParameterMaps( void ) const
+{
+  return this->m_InitialTransformParameterMaps;
+} // end GetInitialTransformParameterMaps()
+
+
 /**
  * ******************** GetTransformParametersMap ********************
  */
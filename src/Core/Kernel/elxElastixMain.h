@@ -20,6 +20,7 @@
 
 #include "elxComponentDatabase.h"
 #include "elxComponentLoader.h"
+#include "elxElastixContext.h"
 
 #include "elxElastixBase.h"
 #include "itkObject.h"
@@ -28,6 +29,7 @@
 #include <fstream>
 
 #include "itkParameterMapInterface.h"
+#include "itkPersistentThreadPool.h"
 
 #ifdef ELASTIX_USE_OPENCL
 #include "itkOpenCLContext.h"
@@ -148,6 +150,19 @@ public:
   /** Typedef that is used in the elastix dll version. */
   typedef itk::ParameterMapInterface::ParameterMapType ParameterMapType;
 
+  /** Typedef for the thread pool shared by all components. */
+  typedef itk::PersistentThreadPool ThreadPoolType;
+  typedef ThreadPoolType::Pointer   ThreadPoolPointer;
+
+  /** Typedef for the context that owns the logger, the component database
+   * and the thread pool of a registration.
+   */
+  typedef ElastixContext              ElastixContextType;
+  typedef ElastixContextType::Pointer ElastixContextPointer;
+
+  /** Typedef for the cache of the fixed-side results. */
+  typedef itk::SharedObjectCache SharedObjectCacheType;
+
   /** Set/Get functions for the description of the image type. */
   itkSetMacro( FixedImagePixelType,   PixelTypeDescriptionType );
   itkSetMacro( MovingImagePixelType,  PixelTypeDescriptionType );
@@ -212,6 +227,17 @@ public:
   itkSetObjectMacro( InitialTransform, ObjectType );
   itkGetObjectMacro( InitialTransform, ObjectType );
 
+  /** Set/Get the transform parameter maps of an initial transform, as an
+   * in-memory alternative to the "-t0" file. The last map is the initial
+   * transform; its InitialTransformParametersFileName may refer to an
+   * earlier map by its index, as in the maps returned by the ElastixFilter.
+   * Only used when no InitialTransform object is set. Library only.
+   */
+  virtual void SetInitialTransformParameterMaps(
+    const std::vector< ParameterMapType > & maps );
+
+  virtual const std::vector< ParameterMapType > & GetInitialTransformParameterMaps( void ) const;
+
   /** Set/Get the original fixed image direction as a flat array
    * (d11 d21 d31 d21 d22 etc ) */
   virtual void SetOriginalFixedImageDirectionFlat(
@@ -269,8 +295,29 @@ public:
   /** Set maximum number of threads, which is read from the command line arguments.
    * Syntax:
    * -threads \<int\>
+   * Also (re)sizes the thread pool that is shared by the metrics, the
+   * optimizer and the penalty terms, and makes it the global pool.
+   */
+  virtual void SetMaximumNumberOfThreads( void );
+
+  /** Get the thread pool shared by all components. */
+  itkGetObjectMacro( ThreadPool, ThreadPoolType );
+
+  /** Set/Get the context of this registration. Without a context, the
+   * process-wide component database, xout and thread pool are used. With a
+   * context, those of the context are used, and the global maximum number
+   * of threads is left alone, so that registrations with different contexts
+   * can run concurrently in different threads.
+   */
+  itkSetObjectMacro( Context, ElastixContextType );
+  itkGetObjectMacro( Context, ElastixContextType );
+
+  /** Set/Get the cache in which the fixed image pyramid, the eroded fixed
+   * masks, the fixed image samples and the fixed image extrema are shared
+   * with other registrations to the same fixed image. Default: NULL.
    */
-  virtual void SetMaximumNumberOfThreads( void ) const;
+  itkSetObjectMacro( FixedSideCache, SharedObjectCacheType );
+  itkGetObjectMacro( FixedSideCache, SharedObjectCacheType );
 
   /** Functions to get/set the ComponentDatabase. */
   static ComponentDatabase * GetComponentDatabase( void )
@@ -328,7 +375,8 @@ protected:
   ObjectPointer m_FinalTransform;
 
   /** The initial transform. */
-  ObjectPointer m_InitialTransform;
+  ObjectPointer                   m_InitialTransform;
+  std::vector< ParameterMapType > m_InitialTransformParameterMaps;
   /** Transformation parameters map containing parameters that is the
    *  result of registration.
    */
@@ -336,10 +384,22 @@ protected:
 
   FlatDirectionCosinesType m_OriginalFixedImageDirection;
 
+  /** The long-lived worker threads, created once per run. */
+  ThreadPoolPointer m_ThreadPool;
+
+  /** The context, or NULL to use the process-wide state. */
+  ElastixContextPointer m_Context;
+
+  /** The cache of the fixed-side results, or NULL. */
+  SharedObjectCacheType::Pointer m_FixedSideCache;
+
   static ComponentDatabasePointer s_CDB;
   static ComponentLoaderPointer   s_ComponentLoader;
   virtual int LoadComponents( void );
 
+  /** Get the component database of the context, or s_CDB without context. */
+  ComponentDatabase * GetActiveComponentDatabase( void ) const;
+
   /** InitDBIndex sets m_DBIndex by asking the ImageTypes
    * from the Configuration object and obtaining the corresponding
    * DB index from the ComponentDatabase.
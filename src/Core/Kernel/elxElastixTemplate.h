@@ -309,6 +309,12 @@ public:
   /** Return configuration from vector of configurations. Library only. */
   virtual ConfigurationPointer GetConfiguration( const size_t index );
 
+  /** Return the number of configurations in the vector of configurations. */
+  virtual size_t GetNumberOfConfigurations( void ) const
+  {
+    return this->m_Configurations.size();
+  }
+
   virtual ConfigurationPointer GetConfiguration()
   {
     return Superclass2::GetConfiguration();
@@ -104,7 +104,7 @@ TransformixMain::Run( void )
 
   /** Set some information in the ElastixBase. */
   this->GetElastixBase()->SetConfiguration( this->m_Configuration );
-  this->GetElastixBase()->SetComponentDatabase( this->s_CDB );
+  this->GetElastixBase()->SetComponentDatabase( this->GetActiveComponentDatabase() );
   this->GetElastixBase()->SetDBIndex( this->m_DBIndex );
 
   /** Populate the component containers. No default is specified for the Transform. */
@@ -284,7 +284,7 @@ TransformixMain::InitDBIndex( void )
     }
 
     /** Load the components. */
-    if( this->s_CDB.IsNull() )
+    if( this->GetActiveComponentDatabase() == NULL )
     {
       int loadReturnCode = this->LoadComponents();
       if( loadReturnCode != 0 )
@@ -294,10 +294,10 @@ TransformixMain::InitDBIndex( void )
       }
     }
 
-    if( this->s_CDB.IsNotNull() )
+    if( this->GetActiveComponentDatabase() != NULL )
     {
       /** Get the DBIndex from the ComponentDatabase. */
-      this->m_DBIndex = this->s_CDB->GetIndex(
+      this->m_DBIndex = this->GetActiveComponentDatabase()->GetIndex(
         this->m_FixedImagePixelType,
         this->m_FixedImageDimension,
         this->m_MovingImagePixelType,
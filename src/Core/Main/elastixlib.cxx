@@ -28,26 +28,131 @@
 
 #include "elxElastixMain.h"
 #include <iostream>
+#include <sstream>
 #include <string>
 #include <vector>
 #include <queue>
+#include <algorithm>
 #include "itkObject.h"
 #include "itkDataObject.h"
 #include <itksys/SystemTools.hxx>
 #include <itksys/SystemInformation.hxx>
 
 #include "itkTimeProbe.h"
+#include "itkMultiThreader.h"
+#include "itkSimpleFastMutexLock.h"
+#include "itkSharedObjectCache.h"
 #include <time.h>
 
 namespace elastix
 {
 
+namespace
+{
+
+/** The state that the threads of RegisterImageBatch() share. */
+struct BatchJobType
+{
+  ELASTIX::ImagePointer                            FixedImage;
+  ELASTIX::ImagePointer                            FixedMask;
+  const std::vector< ELASTIX::ImagePointer > *     MovingImages;
+  const std::vector< ELASTIX::ImagePointer > *     MovingMasks;
+  const std::vector< ELASTIX::ParameterMapType > * ParameterMaps;
+  std::string                                      OutputPath;
+  bool                                             PerformLogging;
+  bool                                             PerformCout;
+  itk::SharedObjectCache *                         FixedSideCache;
+  itk::ThreadIdType                                ThreadsPerRegistration;
+
+  /** The next moving image, protected by the mutex. */
+  itk::SimpleFastMutexLock Mutex;
+  std::size_t              NextMovingImage;
+
+  /** The results, one entry per moving image. */
+  std::vector< ELASTIX::ImagePointer > *         ResultImages;
+  std::vector< ELASTIX::ParameterMapListType > * TransformParametersLists;
+  std::vector< int > *                           ReturnValues;
+};
+
+/** Registers moving images until there are none left, in a context of its own. */
+ITK_THREAD_RETURN_TYPE
+BatchThreaderCallback( void * arg )
+{
+  itk::MultiThreader::ThreadInfoStruct * infoStruct
+    = static_cast< itk::MultiThreader::ThreadInfoStruct * >( arg );
+  BatchJobType * job = static_cast< BatchJobType * >( infoStruct->UserData );
+
+  ElastixContext::Pointer context = ElastixContext::New();
+  context->SetMaximumNumberOfThreads( job->ThreadsPerRegistration );
+
+  while( true )
+  {
+    job->Mutex.Lock();
+    const std::size_t i = job->NextMovingImage++;
+    job->Mutex.Unlock();
+    if( i >= job->MovingImages->size() )
+    {
+      break;
+    }
+
+    /** Every moving image gets a subfolder of the output path. */
+    std::string outputPath = "";
+    if( !job->OutputPath.empty() )
+    {
+      std::ostringstream makeFolderName;
+      makeFolderName << job->OutputPath;
+      if( job->OutputPath.find_last_of( "/" ) != job->OutputPath.size() - 1 )
+      {
+        makeFolderName << "/";
+      }
+      makeFolderName << i << "/";
+      outputPath = makeFolderName.str();
+      itksys::SystemTools::MakeDirectory( outputPath.c_str() );
+    }
+
+    /** The parameter maps are passed by reference, so copy them. */
+    std::vector< ELASTIX::ParameterMapType > parameterMaps = *job->ParameterMaps;
+    ELASTIX::ImagePointer                    movingMask    = 0;
+    if( i < job->MovingMasks->size() )
+    {
+      movingMask = ( *job->MovingMasks )[ i ];
+    }
+
+    /** An exception must not escape from the thread. */
+    ELASTIX elastix;
+    elastix.SetContext( context );
+    elastix.SetFixedSideCache( job->FixedSideCache );
+    try
+    {
+      ( *job->ReturnValues )[ i ] = elastix.RegisterImages(
+        job->FixedImage, ( *job->MovingImages )[ i ],
+        parameterMaps, outputPath,
+        job->PerformLogging, job->PerformCout,
+        job->FixedMask, movingMask );
+    }
+    catch( itk::ExceptionObject & excp )
+    {
+      std::cerr << "Error while registering moving image " << i << ":\n" << excp << std::endl;
+      ( *job->ReturnValues )[ i ] = 1;
+    }
+    ( *job->ResultImages )[ i ]             = elastix.GetResultImage();
+    ( *job->TransformParametersLists )[ i ] = elastix.GetTransformParameterMapList();
+  }
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end BatchThreaderCallback()
+
+} // end namespace
+
 /**
  * ******************* Constructor ***********************
  */
 
 ELASTIX::ELASTIX() :
-  m_ResultImage( 0 )
+  m_ResultImage( 0 ),
+  m_Context( 0 ),
+  m_FixedSideCache( 0 )
 {} // end Constructor
 
 
@@ -62,6 +167,83 @@ ELASTIX::~ELASTIX()
 } // end Destructor
 
 
+/**
+ * ******************* SetContext ***********************
+ */
+
+void
+ELASTIX::SetContext( ElastixContext * context )
+{
+  this->m_Context = context;
+} // end SetContext()
+
+
+/**
+ * ******************* GetContext ***********************
+ */
+
+ElastixContext *
+ELASTIX::GetContext( void ) const
+{
+  return this->m_Context;
+} // end GetContext()
+
+
+/**
+ * ******************* SetFixedSideCache ***********************
+ */
+
+void
+ELASTIX::SetFixedSideCache( itk::SharedObjectCache * cache )
+{
+  this->m_FixedSideCache = cache;
+} // end SetFixedSideCache()
+
+
+/**
+ * ******************* GetFixedSideCache ***********************
+ */
+
+itk::SharedObjectCache *
+ELASTIX::GetFixedSideCache( void ) const
+{
+  return this->m_FixedSideCache;
+} // end GetFixedSideCache()
+
+
+/**
+ * ******************* GetBatchResultImages ***********************
+ */
+
+const std::vector< ELASTIX::ImagePointer > &
+ELASTIX::GetBatchResultImages( void ) const
+{
+  return this->m_BatchResultImages;
+} // end GetBatchResultImages()
+
+
+/**
+ * ******************* GetBatchTransformParameterMapLists ***********************
+ */
+
+const std::vector< ELASTIX::ParameterMapListType > &
+ELASTIX::GetBatchTransformParameterMapLists( void ) const
+{
+  return this->m_BatchTransformParametersLists;
+} // end GetBatchTransformParameterMapLists()
+
+
+/**
+ * ******************* GetBatchReturnValues ***********************
+ */
+
+const std::vector< int > &
+ELASTIX::GetBatchReturnValues( void ) const
+{
+  return this->m_BatchReturnValues;
+} // end GetBatchReturnValues()
+
+
 /**
  * ******************* GetResultImage ***********************
  */
@@ -136,6 +318,33 @@ ELASTIX::RegisterImages(
   bool performCout,
   ImagePointer fixedMask,
   ImagePointer movingMask )
+{
+  return this->RegisterImages(
+    fixedImage, movingImage,
+    parameterMaps,
+    ParameterMapListType(),
+    outputPath,
+    performLogging, performCout,
+    fixedMask, movingMask );
+
+} // end RegisterImages()
+
+
+/**
+ * ******************* RegisterImages ***********************
+ */
+
+int
+ELASTIX::RegisterImages(
+  ImagePointer fixedImage,
+  ImagePointer movingImage,
+  std::vector< ParameterMapType > & parameterMaps,
+  const ParameterMapListType & initialTransformParameterMaps,
+  std::string outputPath,
+  bool performLogging,
+  bool performCout,
+  ImagePointer fixedMask,
+  ImagePointer movingMask )
 {
   /** Some typedef's. */
   typedef elx::ElastixMain                            ElastixMainType;
@@ -153,8 +362,11 @@ ELASTIX::RegisterImages(
   typedef std::queue< ArgPairType >             ParameterFileListType;
   typedef ParameterFileListType::value_type     ParameterFileListEntryType;
 
-  // Clear output transform parameters
-  this->m_TransformParametersList.clear();
+  /** The output transform parameters start with the maps of the initial
+   * transform, which are referred to by index.
+   */
+  this->m_TransformParametersList = initialTransformParameterMaps;
+  const std::size_t initialTransformOffset = initialTransformParameterMaps.size();
 
   /** Some declarations and initialisations. */
   ElastixMainVectorType elastices;
@@ -239,8 +451,23 @@ ELASTIX::RegisterImages(
   /** The argv0 argument, required for finding the component.dll/so's. */
   argMap.insert( ArgumentMapEntryType( "-argv0", "elastix" ) );
 
-  /** Setup xout. */
-  returndummy = elx::xoutSetup( logFileName.c_str(), performLogging, performCout );
+  /** Let the components divide their work over the threads of the context. */
+  if( this->m_Context && this->m_Context->GetMaximumNumberOfThreads() > 0 )
+  {
+    std::ostringstream threads;
+    threads << this->m_Context->GetMaximumNumberOfThreads();
+    argMap.insert( ArgumentMapEntryType( "-threads", threads.str() ) );
+  }
+
+  /** Setup xout, of the context if there is one. */
+  if( this->m_Context )
+  {
+    returndummy = this->m_Context->SetupLogging( logFileName.c_str(), performLogging, performCout );
+  }
+  else
+  {
+    returndummy = elx::xoutSetup( logFileName.c_str(), performLogging, performCout );
+  }
   if( returndummy && performCout )
   {
     if( performCout )
@@ -249,6 +476,9 @@ ELASTIX::RegisterImages(
     }
     return returndummy;
   }
+
+  /** From here on this thread logs to, and computes with, the context. */
+  ElastixContext::ActivationGuard activation( this->m_Context );
   elxout << std::endl;
 
   /** Declare a timer, start it and print the start time. */
@@ -294,9 +524,15 @@ ELASTIX::RegisterImages(
   {
     /** Create another instance of ElastixMain. */
     elastices.push_back( ElastixMainType::New() );
+    elastices[ i ]->SetContext( this->m_Context );
+    elastices[ i ]->SetFixedSideCache( this->m_FixedSideCache );
 
-    /** Set stuff we get from a former registration. */
+    /** Set stuff we get from a former registration, or the initial transform. */
     elastices[ i ]->SetInitialTransform( transform );
+    if( i == 0 )
+    {
+      elastices[ i ]->SetInitialTransformParameterMaps( initialTransformParameterMaps );
+    }
     elastices[ i ]->SetFixedImageContainer( fixedImageContainer );
     elastices[ i ]->SetMovingImageContainer( movingImageContainer );
     elastices[ i ]->SetFixedMaskContainer( fixedMaskContainer );
@@ -354,11 +590,11 @@ ELASTIX::RegisterImages(
     this->m_TransformParametersList.push_back( elastices[ i ]->GetTransformParametersMap() );
 
     /** Set initial transform to an index number instead of a parameter filename. */
-    if( i > 0 )
+    if( i > 0 || initialTransformOffset > 0 )
     {
       std::stringstream toString;
-      toString << ( i - 1 );
-      this->m_TransformParametersList[ i ][ "InitialTransformParametersFileName" ][ 0 ]
+      toString << ( initialTransformOffset + i - 1 );
+      this->m_TransformParametersList[ initialTransformOffset + i ][ "InitialTransformParametersFileName" ][ 0 ]
         = toString.str();
     }
 
@@ -403,8 +639,11 @@ ELASTIX::RegisterImages(
   movingMaskContainer  = 0;
   resultImageContainer = 0;
 
-  /** Close the modules. */
-  ElastixMainType::UnloadComponents();
+  /** Close the modules. A context keeps its own components. */
+  if( !this->m_Context )
+  {
+    ElastixMainType::UnloadComponents();
+  }
 
   /** Exit and return the error code. */
   return 0;
@@ -412,6 +651,122 @@ ELASTIX::RegisterImages(
 } // end RegisterImages()
 
 
+/**
+ * ******************* RegisterImageBatch ***********************
+ */
+
+int
+ELASTIX::RegisterImageBatch(
+  ImagePointer fixedImage,
+  const std::vector< ImagePointer > & movingImages,
+  std::vector< ParameterMapType > & parameterMaps,
+  std::string outputPath,
+  bool performLogging,
+  bool performCout,
+  ImagePointer fixedMask,
+  const std::vector< ImagePointer > & movingMasks,
+  unsigned int maximumNumberOfConcurrentRegistrations )
+{
+  const std::size_t numberOfMovingImages = movingImages.size();
+  this->m_BatchResultImages.assign( numberOfMovingImages, 0 );
+  this->m_BatchTransformParametersLists.assign( numberOfMovingImages, ParameterMapListType() );
+  this->m_BatchReturnValues.assign( numberOfMovingImages, 0 );
+  if( numberOfMovingImages == 0 )
+  {
+    return 0;
+  }
+
+  /** The subfolders are created in the output folder, which must exist. */
+  if( performLogging && !itksys::SystemTools::FileIsDirectory( outputPath.c_str() ) )
+  {
+    if( performCout )
+    {
+      std::cerr << "ERROR: the output directory does not exist." << std::endl;
+      std::cerr << "You are responsible for creating it." << std::endl;
+    }
+    return -2;
+  }
+
+  /** Divide the threads over the concurrent registrations. */
+  const itk::ThreadIdType numberOfThreads
+    = itk::MultiThreader::GetGlobalDefaultNumberOfThreads();
+  itk::ThreadIdType numberOfRegistrations = maximumNumberOfConcurrentRegistrations;
+  if( numberOfRegistrations == 0 )
+  {
+    numberOfRegistrations = numberOfThreads;
+  }
+  if( numberOfRegistrations > numberOfMovingImages )
+  {
+    numberOfRegistrations = static_cast< itk::ThreadIdType >( numberOfMovingImages );
+  }
+
+  /** Share the fixed-side results, in a temporary cache if none is set.
+   * The cache lets one registration compute each result while the others
+   * wait for it.
+   */
+  itk::SharedObjectCache::Pointer fixedSideCache = this->m_FixedSideCache;
+  if( fixedSideCache.IsNull() )
+  {
+    fixedSideCache = itk::SharedObjectCache::New();
+  }
+
+  /** Bring the fixed image and mask up to date here, so that the
+   * registrations, which all update them, find nothing left to do.
+   */
+  try
+  {
+    fixedImage->Update();
+    if( fixedMask.IsNotNull() )
+    {
+      fixedMask->Update();
+    }
+  }
+  catch( itk::ExceptionObject & excp )
+  {
+    std::cerr << "Error while updating the fixed image:\n" << excp << std::endl;
+    return 1;
+  }
+
+  /** The threader limits the number of threads to its maximum. */
+  itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+  threader->SetNumberOfThreads( numberOfRegistrations );
+  numberOfRegistrations = threader->GetNumberOfThreads();
+
+  BatchJobType job;
+  job.FixedImage               = fixedImage;
+  job.FixedMask                = fixedMask;
+  job.MovingImages             = &movingImages;
+  job.MovingMasks              = &movingMasks;
+  job.ParameterMaps            = &parameterMaps;
+  job.OutputPath               = outputPath;
+  job.PerformLogging           = performLogging;
+  job.PerformCout              = performCout;
+  job.FixedSideCache           = fixedSideCache;
+  job.ThreadsPerRegistration   = std::max< itk::ThreadIdType >( 1, numberOfThreads / numberOfRegistrations );
+  job.NextMovingImage          = 0;
+  job.ResultImages             = &this->m_BatchResultImages;
+  job.TransformParametersLists = &this->m_BatchTransformParametersLists;
+  job.ReturnValues             = &this->m_BatchReturnValues;
+
+  /** Each thread runs whole registrations, so launch dedicated threads
+   * instead of occupying the thread pool that the registrations use.
+   */
+  threader->SetSingleMethod( BatchThreaderCallback, &job );
+  threader->SingleMethodExecute();
+
+  /** Return the first error. */
+  for( std::size_t i = 0; i < numberOfMovingImages; ++i )
+  {
+    if( this->m_BatchReturnValues[ i ] != 0 )
+    {
+      return this->m_BatchReturnValues[ i ];
+    }
+  }
+  return 0;
+
+} // end RegisterImageBatch()
+
+
 /** ConvertSecondsToDHMS
  *
  */
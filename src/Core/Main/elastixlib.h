@@ -31,9 +31,16 @@
  *                          *
  ********************************************************************************/
 
+namespace itk
+{
+class SharedObjectCache;
+}
+
 namespace elastix
 {
 
+class ElastixContext;
+
 class ELASTIXLIB_API ELASTIX
 {
 public:
@@ -96,6 +103,76 @@ public:
     ImagePointer fixedMask = 0,
     ImagePointer movingMask = 0 );
 
+  /** As above, starting from an initial transform that is given in memory,
+   *  as the list of transform parameter maps that GetTransformParameterMapList()
+   *  returns. The maps of the initial transform are prepended to the output
+   *  transform parameter map list, and no files are read.
+   */
+  int RegisterImages( ImagePointer fixedImage,
+    ImagePointer movingImage,
+    std::vector< ParameterMapType > & parameterMaps,
+    const ParameterMapListType & initialTransformParameterMaps,
+    std::string outputPath,
+    bool performLogging,
+    bool performCout,
+    ImagePointer fixedMask = 0,
+    ImagePointer movingMask = 0 );
+
+  /** Set/Get the context of the registrations, which owns their logger,
+   *  component database and thread pool; see elx::ElastixContext. With a
+   *  context, RegisterImages() can be called concurrently from several
+   *  threads, as long as every thread uses its own ELASTIX and context.
+   *  Default NULL: the process-wide state is used. The caller keeps ownership.
+   */
+  void SetContext( ElastixContext * context );
+
+  ElastixContext * GetContext( void ) const;
+
+  /** Set/Get the cache in which the fixed image pyramid, the eroded fixed
+   *  masks, the samples of deterministic samplers and the fixed image
+   *  extrema are shared between registrations to the same fixed image.
+   *  The fixed image and mask must then not be changed while the cache is
+   *  in use. Default NULL: nothing is shared. The caller keeps ownership.
+   */
+  void SetFixedSideCache( itk::SharedObjectCache * cache );
+
+  itk::SharedObjectCache * GetFixedSideCache( void ) const;
+
+  /** Register many moving images to one fixed image, with the same
+   *  parameter maps. The fixed-side results are computed once, and shared
+   *  through the FixedSideCache, or through a temporary cache if none is
+   *  set. At most maximumNumberOfConcurrentRegistrations registrations run
+   *  at the same time (0: one per thread of the global default number of
+   *  threads), each in its own thread and context, with an equal share of
+   *  the threads. While one registration computes a fixed-side result,
+   *  the others that need it wait. Every context has its own random number
+   *  generator, seeded with the RandomSeed of the parameter maps, so the
+   *  result of a registration does not depend on the others. The output of
+   *  moving image i goes to the subfolder "i" of outputPath, which is
+   *  created. The Context of this object is not used.
+   *  Params:
+   *    movingMasks  empty, or one (possibly NULL) mask per moving image
+   *  return value: 0 if all registrations succeeded, otherwise the first
+   *    nonzero return value of RegisterImages(), or -2 if outputPath does
+   *    not exist while performLogging is set.
+   */
+  int RegisterImageBatch( ImagePointer fixedImage,
+    const std::vector< ImagePointer > & movingImages,
+    std::vector< ParameterMapType > & parameterMaps,
+    std::string outputPath,
+    bool performLogging,
+    bool performCout,
+    ImagePointer fixedMask = 0,
+    const std::vector< ImagePointer > & movingMasks = std::vector< ImagePointer >(),
+    unsigned int maximumNumberOfConcurrentRegistrations = 0 );
+
+  /** Get the results of the last RegisterImageBatch(), per moving image. */
+  const std::vector< ImagePointer > & GetBatchResultImages( void ) const;
+
+  const std::vector< ParameterMapListType > & GetBatchTransformParameterMapLists( void ) const;
+
+  const std::vector< int > & GetBatchReturnValues( void ) const;
+
   /** Getter for result image. */
   ImagePointer GetResultImage( void );
 
@@ -117,6 +194,17 @@ private:
   /* Final transformation*/
   ParameterMapListType m_TransformParametersList;
 
+  /* The context, or NULL */
+  ElastixContext * m_Context;
+
+  /* The cache of the fixed-side results, or NULL */
+  itk::SharedObjectCache * m_FixedSideCache;
+
+  /* The results of the last batch */
+  std::vector< ImagePointer >         m_BatchResultImages;
+  std::vector< ParameterMapListType > m_BatchTransformParametersLists;
+  std::vector< int >                  m_BatchReturnValues;
+
 };
 
 // end class ELASTIX
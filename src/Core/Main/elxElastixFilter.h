@@ -57,6 +57,8 @@ public:
   typedef ElastixMainType::ArgumentMapType          ArgumentMapType;
   typedef ArgumentMapType::value_type               ArgumentMapEntryType;
   typedef ElastixMainType::FlatDirectionCosinesType FlatDirectionCosinesType;
+  typedef ElastixMainType::ElastixContextType       ElastixContextType;
+  typedef ElastixMainType::SharedObjectCacheType    SharedObjectCacheType;
 
   typedef ElastixMainType::DataObjectContainerType           DataObjectContainerType;
   typedef ElastixMainType::DataObjectContainerPointer        DataObjectContainerPointer;
@@ -131,6 +133,23 @@ public:
   itkGetMacro( InitialTransformParameterFileName, std::string );
   virtual void RemoveInitialTransformParameterFileName( void ) { this->SetInitialTransformParameterFileName( "" ); }
 
+  /** Set/Get/Remove the initial transform as a transform parameter object,
+   * for example the TransformParameterObject of another ElastixFilter. This
+   * avoids writing the initial transform to disk. The maps of the initial
+   * transform are prepended to the output TransformParameterObject.
+   */
+  virtual void SetInitialTransformParameterObject( ParameterObjectType * parameterObject );
+  const ParameterObjectType * GetInitialTransformParameterObject( void ) const;
+  virtual void RemoveInitialTransformParameterObject( void );
+
+  /** Set/Get/Remove the initial transform as a transform object, e.g. an
+   * itk::Transform. Note that such a transform can not be stored in the
+   * output TransformParameterObject, unless it is an elastix transform.
+   */
+  itkSetObjectMacro( InitialTransform, itk::Object );
+  itkGetConstObjectMacro( InitialTransform, itk::Object );
+  virtual void RemoveInitialTransform( void ) { this->SetInitialTransform( NULL ); }
+
   /** Set/Get/Remove fixed point set filename. */
   itkSetMacro( FixedPointSetFileName, std::string );
   itkGetMacro( FixedPointSetFileName, std::string );
@@ -162,6 +181,22 @@ public:
   itkGetConstReferenceMacro( LogToFile, bool );
   itkBooleanMacro( LogToFile );
 
+  /** Set/Get the context that owns the logger, the component database and
+   * the thread pool of the registration. Filters with different contexts
+   * can be updated concurrently from different threads. Default: none,
+   * the process-wide state is used.
+   */
+  itkSetObjectMacro( Context, ElastixContextType );
+  itkGetObjectMacro( Context, ElastixContextType );
+
+  /** Set/Get the cache in which the fixed-side results, such as the fixed
+   * image pyramid, are shared with other filters that register to the same
+   * fixed image, possibly concurrently with different contexts. The fixed
+   * image and mask must not change while the cache is in use. Default: none.
+   */
+  itkSetObjectMacro( FixedSideCache, SharedObjectCacheType );
+  itkGetObjectMacro( FixedSideCache, SharedObjectCacheType );
+
 protected:
 
   ElastixFilter( void );
@@ -188,7 +223,9 @@ private:
   /** Let elastix handle input verification internally */
   virtual void VerifyInputInformation( void ) ITK_OVERRIDE {};
 
-  std::string m_InitialTransformParameterFileName;
+  std::string              m_InitialTransformParameterFileName;
+  ElastixMainObjectPointer m_InitialTransform;
+
   std::string m_FixedPointSetFileName;
   std::string m_MovingPointSetFileName;
 
@@ -198,6 +235,9 @@ private:
   bool m_LogToConsole;
   bool m_LogToFile;
 
+  ElastixContextType::Pointer    m_Context;
+  SharedObjectCacheType::Pointer m_FixedSideCache;
+
   unsigned int m_InputUID;
 
 };
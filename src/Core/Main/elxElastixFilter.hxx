@@ -37,6 +37,7 @@ ElastixFilter< TFixedImage, TMovingImage >
   this->AddRequiredInputName( "ParameterObject" );
 
   this->m_InitialTransformParameterFileName = "";
+  this->m_InitialTransform                  = 0;
   this->m_FixedPointSetFileName             = "";
   this->m_MovingPointSetFileName            = "";
 
@@ -46,6 +47,9 @@ ElastixFilter< TFixedImage, TMovingImage >
   this->m_LogToConsole = false;
   this->m_LogToFile    = false;
 
+  this->m_Context        = 0;
+  this->m_FixedSideCache = 0;
+
   ParameterObjectPointer defaultParameterObject = ParameterObject::New();
   defaultParameterObject->AddParameterMap( ParameterObject::GetDefaultParameterMap( "translation" ) );
   defaultParameterObject->AddParameterMap( ParameterObject::GetDefaultParameterMap( "affine" ) );
@@ -77,7 +81,7 @@ ElastixFilter< TFixedImage, TMovingImage >
   DataObjectContainerPointer fixedMaskContainer   = 0;
   DataObjectContainerPointer movingMaskContainer  = 0;
   DataObjectContainerPointer resultImageContainer = 0;
-  ElastixMainObjectPointer   transform            = 0;
+  ElastixMainObjectPointer   transform            = this->m_InitialTransform;
   ParameterMapVectorType     transformParameterMapVector;
   FlatDirectionCosinesType   fixedImageOriginalDirection;
 
@@ -131,6 +135,28 @@ ElastixFilter< TFixedImage, TMovingImage >
   // Elastix must always write result image to guarantee that the ITK pipeline is in a consistent state
   parameterMapVector[ parameterMapVector.size() - 1 ][ "WriteResultImage" ] = ParameterValueVectorType( 1, "true" );
 
+  // The initial transform can be given in only one way
+  const ParameterObjectType * initialTransformParameterObject = this->GetInitialTransformParameterObject();
+  unsigned int numberOfInitialTransforms = 0;
+  if( !this->m_InitialTransformParameterFileName.empty() ) { ++numberOfInitialTransforms; }
+  if( initialTransformParameterObject != NULL ) { ++numberOfInitialTransforms; }
+  if( this->m_InitialTransform.IsNotNull() ) { ++numberOfInitialTransforms; }
+  if( numberOfInitialTransforms > 1 )
+  {
+    itkExceptionMacro( "Only one of SetInitialTransformParameterFileName(), "
+                    << "SetInitialTransformParameterObject() and SetInitialTransform() can be used." );
+  }
+
+  // The maps of an in-memory initial transform come first in the output,
+  // so that the output can be passed to transformix as it is
+  ParameterMapVectorType initialTransformParameterMapVector;
+  if( initialTransformParameterObject != NULL )
+  {
+    initialTransformParameterMapVector = initialTransformParameterObject->GetParameterMap();
+    transformParameterMapVector = initialTransformParameterMapVector;
+  }
+  const unsigned int initialTransformOffset = initialTransformParameterMapVector.size();
+
   // Setup argument map
   ArgumentMapType argumentMap;
 
@@ -190,12 +216,25 @@ ElastixFilter< TFixedImage, TMovingImage >
     }
   }
 
-  // Setup xout
-  if( elx::xoutSetup( logFileName.c_str(), this->GetLogToFile(), this->GetLogToConsole() ) )
+  // Let the components divide their work over the threads of the context
+  if( this->m_Context.IsNotNull() && this->m_Context->GetMaximumNumberOfThreads() > 0 )
+  {
+    argumentMap.insert( ArgumentMapEntryType( "-threads",
+      ParameterObject::ToString( this->m_Context->GetMaximumNumberOfThreads() ) ) );
+  }
+
+  // Setup xout, of the context if there is one
+  const int xoutError = this->m_Context.IsNotNull()
+    ? this->m_Context->SetupLogging( logFileName.c_str(), this->GetLogToFile(), this->GetLogToConsole() )
+    : elx::xoutSetup( logFileName.c_str(), this->GetLogToFile(), this->GetLogToConsole() );
+  if( xoutError )
   {
     itkExceptionMacro( "Error while setting up xout" );
   }
 
+  // From here on this thread logs to, and computes with, the context
+  ElastixContextType::ActivationGuard activation( this->m_Context );
+
   // Run the (possibly multiple) registration(s)
   for( unsigned int i = 0; i < parameterMapVector.size(); ++i )
   {
@@ -210,13 +249,19 @@ ElastixFilter< TFixedImage, TMovingImage >
 
     // Create new instance of ElastixMain
     ElastixMainPointer elastix = ElastixMainType::New();
+    elastix->SetContext( this->m_Context );
+    elastix->SetFixedSideCache( this->m_FixedSideCache );
 
     // Set elastix levels
     elastix->SetElastixLevel( i );
     elastix->SetTotalNumberOfElastixLevels( parameterMapVector.size() );
 
-    // Set stuff we get from a previous registration
+    // Set stuff we get from a previous registration, or the initial transform
     elastix->SetInitialTransform( transform );
+    if( i == 0 )
+    {
+      elastix->SetInitialTransformParameterMaps( initialTransformParameterMapVector );
+    }
     elastix->SetFixedImageContainer( fixedImageContainer );
     elastix->SetMovingImageContainer( movingImageContainer );
     elastix->SetFixedMaskContainer( fixedMaskContainer );
@@ -256,11 +301,11 @@ ElastixFilter< TFixedImage, TMovingImage >
       = parameterMapVector[ i ][ "DefaultPixelValue" ];
 
     // Set initial transform to an index number instead of a parameter filename
-    if( i > 0 )
+    if( i > 0 || initialTransformOffset > 0 )
     {
       std::stringstream index;
-      index << ( i - 1 ); // MS: Can this be done in the constructor of stringstream?
-      transformParameterMapVector[ i ][ "InitialTransformParametersFileName" ][ 0 ] = index.str();
+      index << ( initialTransformOffset + i - 1 ); // MS: Can this be done in the constructor of stringstream?
+      transformParameterMapVector[ initialTransformOffset + i ][ "InitialTransformParametersFileName" ][ 0 ] = index.str();
     }
   } // End loop over registrations
 
@@ -318,6 +363,45 @@ ElastixFilter< TFixedImage, TMovingImage >
   return itkDynamicCastInDebugMode< const ParameterObjectType * >( itk::ProcessObject::GetInput( "ParameterObject" ) );
 }
 
+/**
+ * ********************* SetInitialTransformParameterObject *********************
+ */
+
+template< typename TFixedImage, typename TMovingImage >
+void
+ElastixFilter< TFixedImage, TMovingImage >
+::SetInitialTransformParameterObject( ParameterObjectType * parameterObject )
+{
+  this->SetInput( "InitialTransformParameterObject", parameterObject );
+}
+
+
+/**
+ * ********************* GetInitialTransformParameterObject *********************
+ */
+
+template< typename TFixedImage, typename TMovingImage >
+const typename ElastixFilter< TFixedImage, TMovingImage >::ParameterObjectType *
+ElastixFilter< TFixedImage, TMovingImage >
+::GetInitialTransformParameterObject( void ) const
+{
+  return itkDynamicCastInDebugMode< const ParameterObjectType * >( itk::ProcessObject::GetInput( "InitialTransformParameterObject" ) );
+}
+
+
+/**
+ * ********************* RemoveInitialTransformParameterObject *********************
+ */
+
+template< typename TFixedImage, typename TMovingImage >
+void
+ElastixFilter< TFixedImage, TMovingImage >
+::RemoveInitialTransformParameterObject( void )
+{
+  this->RemoveInput( "InitialTransformParameterObject" );
+}
+
+
 /**
  * ********************* GetTransformParameterObject *********************
  */
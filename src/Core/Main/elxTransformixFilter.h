@@ -103,6 +103,23 @@ public:
 
   const ParameterObjectType * GetTransformParameterObject( void ) const;
 
+  /** Set/Get/Remove an initial transform as a transform parameter object.
+   * Its maps are applied before the maps of the TransformParameterObject,
+   * whose first transform, the one with "NoInitialTransform", is composed
+   * with the last map of the initial transform. No files are involved.
+   */
+  virtual void SetInitialTransformParameterObject( ParameterObjectType * parameterObject );
+  const ParameterObjectType * GetInitialTransformParameterObject( void ) const;
+  virtual void RemoveInitialTransformParameterObject( void );
+
+  /** Set/Get/Remove the initial transform as a transform object, e.g. an
+   * itk::Transform. It is used as the initial transform of the first map of
+   * the TransformParameterObject.
+   */
+  itkSetObjectMacro( InitialTransform, itk::Object );
+  itkGetConstObjectMacro( InitialTransform, itk::Object );
+  virtual void RemoveInitialTransform( void ) { this->SetInitialTransform( NULL ); }
+
   /** Set/Get/Remove output directory. */
   itkSetMacro( OutputDirectory, std::string );
   itkGetConstMacro( OutputDirectory, std::string );
@@ -147,6 +164,8 @@ private:
   using itk::ProcessObject::GetInput;
   using itk::ProcessObject::RemoveInput;
 
+  itk::Object::Pointer m_InitialTransform;
+
   std::string m_FixedPointSetFileName;
   bool        m_ComputeSpatialJacobian;
   bool        m_ComputeDeterminantOfSpatialJacobian;
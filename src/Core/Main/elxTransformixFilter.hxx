@@ -34,6 +34,7 @@ TransformixFilter< TMovingImage >
 
   this->AddRequiredInputName( "TransformParameterObject" );
 
+  this->m_InitialTransform                    = 0;
   this->m_FixedPointSetFileName               = "";
   this->m_ComputeSpatialJacobian              = false;
   this->m_ComputeDeterminantOfSpatialJacobian = false;
@@ -184,6 +185,47 @@ TransformixFilter< TMovingImage >
     itkExceptionMacro( "Empty parameter map in parameter object." );
   }
 
+  // Prepend the maps of an in-memory initial transform. The maps refer to
+  // each other by index, so the indices of the transform maps are shifted.
+  const ParameterObjectType * initialTransformParameterObject = this->GetInitialTransformParameterObject();
+  if( initialTransformParameterObject != NULL )
+  {
+    if( this->m_InitialTransform.IsNotNull() )
+    {
+      itkExceptionMacro( "Only one of SetInitialTransformParameterObject() and SetInitialTransform() can be used." );
+    }
+
+    ParameterMapVectorType chainedParameterMapVector = initialTransformParameterObject->GetParameterMap();
+    const unsigned int offset = chainedParameterMapVector.size();
+    for( unsigned int i = 0; i < transformParameterMapVector.size(); ++i )
+    {
+      ParameterMapType & map = transformParameterMapVector[ i ];
+      if( offset == 0 || map.count( "InitialTransformParametersFileName" ) == 0
+        || map[ "InitialTransformParametersFileName" ].empty() )
+      {
+        continue;
+      }
+
+      std::string & initialTransform = map[ "InitialTransformParametersFileName" ][ 0 ];
+      std::stringstream index;
+      if( initialTransform == "NoInitialTransform" )
+      {
+        index << ( offset - 1 );
+      }
+      else
+      {
+        index << ( offset + atoi( initialTransform.c_str() ) );
+      }
+      initialTransform = index.str();
+    }
+    chainedParameterMapVector.insert( chainedParameterMapVector.end(),
+      transformParameterMapVector.begin(), transformParameterMapVector.end() );
+    transformParameterMapVector = chainedParameterMapVector;
+  }
+
+  // Set the initial transform object, which is picked up by the first map
+  transformix->SetInitialTransform( this->m_InitialTransform );
+
   // Set pixel types from input image, override user settings
   for( unsigned int i = 0; i < transformParameterMapVector.size(); ++i )
   {
@@ -221,6 +263,45 @@ TransformixFilter< TMovingImage >
 } // end GenerateData()
 
 
+/**
+ * ********************* SetInitialTransformParameterObject *********************
+ */
+
+template< typename TMovingImage >
+void
+TransformixFilter< TMovingImage >
+::SetInitialTransformParameterObject( ParameterObjectType * parameterObject )
+{
+  this->SetInput( "InitialTransformParameterObject", parameterObject );
+} // end SetInitialTransformParameterObject()
+
+
+/**
+ * ********************* GetInitialTransformParameterObject *********************
+ */
+
+template< typename TMovingImage >
+const typename TransformixFilter< TMovingImage >::ParameterObjectType *
+TransformixFilter< TMovingImage >
+::GetInitialTransformParameterObject( void ) const
+{
+  return itkDynamicCastInDebugMode< const ParameterObjectType * >( this->GetInput( "InitialTransformParameterObject" ) );
+} // end GetInitialTransformParameterObject()
+
+
+/**
+ * ********************* RemoveInitialTransformParameterObject *********************
+ */
+
+template< typename TMovingImage >
+void
+TransformixFilter< TMovingImage >
+::RemoveInitialTransformParameterObject( void )
+{
+  this->RemoveInput( "InitialTransformParameterObject" );
+} // end RemoveInitialTransformParameterObject()
+
+
 /**
  * ********************* SetInput *********************
  */
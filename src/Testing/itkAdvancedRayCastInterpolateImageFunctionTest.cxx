@@ -0,0 +1,290 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "itkAdvancedRayCastInterpolateImageFunction.h"
+#include "itkEuler3DTransform.h"
+#include "itkImageRegionIteratorWithIndex.h"
+#include "itkMultiThreader.h"
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+//-------------------------------------------------------------------------------------
+
+/** Cast rays through a small volume, with the source in front of each of the
+ * three axes, so that the rays traverse the volume in x, y and z. The
+ * integral of IntegrateAboveThreshold() and the state of the ray afterwards
+ * are compared with the original loop over GetCurrentIntensity() and
+ * IncrementVoxelPointers(). Evaluate() is compared with the original loop,
+ * and evaluating the rays concurrently should give the same values as
+ * evaluating them serially.
+ */
+
+const unsigned int Dimension = 3;
+typedef itk::Image< short, Dimension >                                    ImageType;
+typedef itk::AdvancedRayCastInterpolateImageFunction< ImageType, double > InterpolatorType;
+typedef itk::Euler3DTransform< double >                                   TransformType;
+typedef InterpolatorType::PointType                                       PointType;
+typedef InterpolatorType::DirectionType                                   DirectionType;
+typedef InterpolatorType::OutputType                                      OutputType;
+typedef itk::MultiThreader                                                ThreaderType;
+typedef ThreaderType::ThreadInfoStruct                                    ThreadInfoType;
+
+/** The ray of the interpolator, with the original integration loop. */
+class ReferenceRay : public RayCastHelper< ImageType, double >
+{
+public:
+
+  /** The loop of IntegrateAboveThreshold() before it was optimized. */
+  bool IntegrateAboveThresholdPerStep( double & integral, double threshold )
+  {
+    integral = 0.0;
+    if( !this->m_ValidRay )
+    {
+      return false;
+    }
+
+    for( this->m_NumVoxelPlanesTraversed = 0;
+      this->m_NumVoxelPlanesTraversed < this->m_TotalRayVoxelPlanes;
+      this->m_NumVoxelPlanesTraversed++ )
+    {
+      const double intensity = this->GetCurrentIntensity();
+      if( intensity > threshold )
+      {
+        integral += intensity - threshold;
+      }
+      this->IncrementVoxelPointers();
+    }
+
+    integral *= this->GetRayPointSpacing();
+    return true;
+  }
+
+
+  /** The state of the ray after the integration should be the same. */
+  bool HasSameState( const ReferenceRay & other ) const
+  {
+    for( unsigned int i = 0; i < 3; ++i )
+    {
+      if( this->m_Position3Dvox[ i ] != other.m_Position3Dvox[ i ]
+        || this->m_RayIntersectionVoxelIndex[ i ] != other.m_RayIntersectionVoxelIndex[ i ] )
+      {
+        return false;
+      }
+    }
+    for( unsigned int i = 0; i < 4; ++i )
+    {
+      if( this->m_RayIntersectionVoxels[ i ] != other.m_RayIntersectionVoxels[ i ] )
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+};
+
+/** The rays of one thread are evaluated concurrently with the others. */
+struct EvaluateJobType
+{
+  InterpolatorType *          m_Interpolator;
+  std::vector< PointType > *  m_Points;
+  std::vector< OutputType > * m_Values;
+};
+
+ITK_THREAD_RETURN_TYPE
+EvaluateThreaderCallback( void * arg )
+{
+  ThreadInfoType *        infoStruct  = static_cast< ThreadInfoType * >( arg );
+  const itk::ThreadIdType threadId    = infoStruct->ThreadID;
+  const itk::ThreadIdType nrOfThreads = infoStruct->NumberOfThreads;
+  EvaluateJobType *       job         = static_cast< EvaluateJobType * >( infoStruct->UserData );
+
+  for( std::size_t i = threadId; i < job->m_Points->size(); i += nrOfThreads )
+  {
+    ( *job->m_Values )[ i ] = job->m_Interpolator->Evaluate( ( *job->m_Points )[ i ] );
+  }
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end EvaluateThreaderCallback()
+
+
+/** A small volume with an anisotropic spacing and a smooth pattern. */
+ImageType::Pointer
+CreateVolume( void )
+{
+  ImageType::SizeType size;
+  size[ 0 ] = 20; size[ 1 ] = 24; size[ 2 ] = 16;
+  ImageType::SpacingType spacing;
+  spacing[ 0 ] = 1.5; spacing[ 1 ] = 1.0; spacing[ 2 ] = 2.0;
+  ImageType::RegionType region;
+  region.SetSize( size );
+
+  ImageType::Pointer image = ImageType::New();
+  image->SetRegions( region );
+  image->SetSpacing( spacing );
+  image->Allocate();
+
+  itk::ImageRegionIteratorWithIndex< ImageType > it( image, region );
+  for( it.GoToBegin(); !it.IsAtEnd(); ++it )
+  {
+    const ImageType::IndexType & index = it.GetIndex();
+    const double                 value = 200.0 + 150.0 * std::sin( 0.4 * index[ 0 ] )
+      * std::cos( 0.3 * index[ 1 ] ) + 10.0 * index[ 2 ] - 5.0 * ( index[ 0 ] % 3 );
+    it.Set( static_cast< short >( value ) );
+  }
+  return image;
+}
+
+
+int
+main( int argc, char * argv[] )
+{
+  ImageType::Pointer image = CreateVolume();
+
+  /** The center of the volume. */
+  PointType center;
+  for( unsigned int d = 0; d < Dimension; ++d )
+  {
+    center[ d ] = 0.5 * image->GetSpacing()[ d ]
+      * image->GetLargestPossibleRegion().GetSize()[ d ];
+  }
+
+  /** A slightly rotated geometry, so that the rays are oblique. */
+  TransformType::Pointer transform = TransformType::New();
+  transform->SetCenter( center );
+  transform->SetRotation( 0.05, -0.08, 0.11 );
+
+  InterpolatorType::Pointer interpolator = InterpolatorType::New();
+  interpolator->SetInputImage( image );
+  interpolator->SetTransform( transform );
+  interpolator->SetThreshold( 50.0 );
+
+  const double threshold = interpolator->GetThreshold();
+
+  for( unsigned int axis = 0; axis < Dimension; ++axis )
+  {
+    const unsigned int axis1 = ( axis + 1 ) % Dimension;
+    const unsigned int axis2 = ( axis + 2 ) % Dimension;
+
+    /** The source in front of the volume, and the detector behind it. The
+     * detector is larger than the projection, so that some rays miss.
+     */
+    PointType focalPoint = center;
+    focalPoint[ axis ] -= 300.0;
+    interpolator->SetFocalPoint( focalPoint );
+
+    std::vector< PointType > points;
+    for( int i = -20; i <= 20; ++i )
+    {
+      for( int j = -20; j <= 20; ++j )
+      {
+        PointType point = center;
+        point[ axis ]  += 100.0;
+        point[ axis1 ] += 1.3 * i;
+        point[ axis2 ] += 1.7 * j;
+        points.push_back( point );
+      }
+    }
+
+    /** Compare the integration loops and Evaluate() serially. */
+    const PointType           transformedFocalPoint = transform->TransformPoint( focalPoint );
+    std::vector< OutputType > values( points.size() );
+    unsigned int              numberOfValidRays = 0;
+    for( std::size_t i = 0; i < points.size(); ++i )
+    {
+      const DirectionType direction = transformedFocalPoint - points[ i ];
+
+      ReferenceRay ray, reference;
+      ray.SetImage( image );
+      ray.ZeroState();
+      ray.Initialise();
+      reference.SetImage( image );
+      reference.ZeroState();
+      reference.Initialise();
+
+      const bool validRay       = ray.SetRay( points[ i ], direction );
+      const bool validReference = reference.SetRay( points[ i ], direction );
+      if( validRay != validReference )
+      {
+        std::cerr << "ERROR: the rays differ." << std::endl;
+        return EXIT_FAILURE;
+      }
+      if( !validRay )
+      {
+        continue;
+      }
+      ++numberOfValidRays;
+
+      double integral = 0.0, referenceIntegral = 0.0;
+      ray.IntegrateAboveThreshold( integral, threshold );
+      reference.IntegrateAboveThresholdPerStep( referenceIntegral, threshold );
+      values[ i ] = interpolator->Evaluate( points[ i ] );
+
+      const double tolerance = 1e-12 * std::max( std::abs( referenceIntegral ), 1.0 );
+      if( std::abs( integral - referenceIntegral ) > tolerance
+        || std::abs( values[ i ] - referenceIntegral ) > tolerance )
+      {
+        std::cerr << "ERROR: traversing in direction " << axis << ", ray " << i
+                  << " gives " << integral << " and Evaluate() gives " << values[ i ]
+                  << ", whereas the original loop gives " << referenceIntegral << "." << std::endl;
+        return EXIT_FAILURE;
+      }
+      if( !ray.HasSameState( reference ) )
+      {
+        std::cerr << "ERROR: traversing in direction " << axis << ", ray " << i
+                  << " ends in a different state." << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+
+    std::cout << "Traversing in direction " << axis << ": " << numberOfValidRays
+              << " of " << points.size() << " rays hit the volume." << std::endl;
+    if( numberOfValidRays == 0 || numberOfValidRays == points.size() )
+    {
+      std::cerr << "ERROR: the rays should partly hit the volume." << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    /** Evaluate the rays concurrently. */
+    std::vector< OutputType > concurrentValues( points.size(), -1.0 );
+    EvaluateJobType           job;
+    job.m_Interpolator = interpolator;
+    job.m_Points       = &points;
+    job.m_Values       = &concurrentValues;
+
+    ThreaderType::Pointer threader = ThreaderType::New();
+    threader->SetNumberOfThreads( 4 );
+    threader->SetSingleMethod( EvaluateThreaderCallback, &job );
+    threader->SingleMethodExecute();
+
+    for( std::size_t i = 0; i < points.size(); ++i )
+    {
+      if( concurrentValues[ i ] != interpolator->Evaluate( points[ i ] ) )
+      {
+        std::cerr << "ERROR: the concurrent evaluation of ray " << i
+                  << " differs from the serial one." << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+  }
+
+  return EXIT_SUCCESS;
+
+} // end main
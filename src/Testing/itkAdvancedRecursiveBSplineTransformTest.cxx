@@ -407,6 +407,86 @@ main( int argc, char * argv[] )
     return EXIT_FAILURE;
   }
 
+  /** TransformPointBatch. */
+  RecursiveTransformType::SampleBatchType batch;
+  recursiveTransform->TransformPointBatch( &pointList[ 0 ], N, batch );
+  double batchDifference = 0.0;
+  for( unsigned int i = 0; i < N; ++i )
+  {
+    for( unsigned int j = 0; j < Dimension; ++j )
+    {
+      const double diff = batch.m_TransformedPoints[ j * N + i ] - transformedPointList2[ i ][ j ];
+      batchDifference += diff * diff;
+    }
+  }
+  batchDifference = vcl_sqrt( batchDifference );
+  std::cerr << "The Recursive B-spline TransformPointBatch() difference is " << batchDifference << std::endl;
+  if( batchDifference > 1e-10 )
+  {
+    std::cerr << "ERROR: Recursive B-spline TransformPointBatch() returning incorrect result." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  /** EvaluateJacobianWithImageGradientProductBatch. */
+  std::vector< RecursiveTransformType::MovingImageGradientType > gradients( N );
+  for( unsigned int i = 0; i < N; ++i )
+  {
+    for( unsigned int j = 0; j < Dimension; ++j )
+    {
+      gradients[ i ][ j ] = mersenneTwister->GetUniformVariate( -1.0, 1.0 );
+    }
+  }
+  recursiveTransform->EvaluateJacobianWithImageGradientProductBatch(
+    &pointList[ 0 ], &gradients[ 0 ], N, batch );
+  RecursiveTransformType::DerivativeType imageJacobian( nonzji );
+  NonZeroJacobianIndicesType             nzjiSample( nonzji );
+  batchDifference = 0.0;
+  double nzjiBatchDifference = 0.0;
+  for( unsigned int i = 0; i < N; ++i )
+  {
+    recursiveTransform->EvaluateJacobianWithImageGradientProduct(
+      pointList[ i ], gradients[ i ], imageJacobian, nzjiSample );
+    for( unsigned int k = 0; k < nonzji; ++k )
+    {
+      const double diff = batch.m_ImageJacobians[ i * nonzji + k ] - imageJacobian[ k ];
+      batchDifference     += diff * diff;
+      nzjiBatchDifference += ( batch.m_NonZeroJacobianIndices[ i * nonzji + k ] != nzjiSample[ k ] ) ? 1.0 : 0.0;
+    }
+  }
+  batchDifference = vcl_sqrt( batchDifference );
+  std::cerr << "The Recursive B-spline EvaluateJacobianWithImageGradientProductBatch() difference is "
+            << batchDifference << std::endl;
+  if( batchDifference > 1e-10 || nzjiBatchDifference > 0.0 )
+  {
+    std::cerr << "ERROR: Recursive B-spline EvaluateJacobianWithImageGradientProductBatch() returning incorrect result." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  /** TransformPointUsingWeights, as used by the B-spline weight cache. */
+  std::vector< TransformType::ScalarType > precomputedWeights( transform->GetNumberOfAffectedWeights() );
+  TransformType::IndexType                 supportIndex;
+  double                                   weightsDifference = 0.0;
+  for( unsigned int i = 0; i < N; ++i )
+  {
+    OutputPointType oppWeights = pointList[ i ];
+    if( transform->ComputeSupportIndexAndWeights( pointList[ i ], supportIndex, &precomputedWeights[ 0 ] ) )
+    {
+      transform->TransformPointUsingWeights( pointList[ i ], supportIndex, &precomputedWeights[ 0 ], oppWeights );
+    }
+    for( unsigned int j = 0; j < Dimension; ++j )
+    {
+      weightsDifference += ( oppWeights[ j ] - transformedPointList1[ i ][ j ] )
+        * ( oppWeights[ j ] - transformedPointList1[ i ][ j ] );
+    }
+  }
+  weightsDifference = vcl_sqrt( weightsDifference );
+  std::cerr << "The B-spline TransformPointUsingWeights() difference is " << weightsDifference << std::endl;
+  if( weightsDifference > 1e-10 )
+  {
+    std::cerr << "ERROR: B-spline TransformPointUsingWeights() returning incorrect result." << std::endl;
+    return EXIT_FAILURE;
+  }
+
   /** Jacobian. */
   JacobianType jacobianElastix; jacobianElastix.SetSize( Dimension, nzji.size() ); jacobianElastix.Fill( 0.0 );
   transform->GetJacobian( inputPoint, jacobianElastix, nzjiElastix );
@@ -0,0 +1,152 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "itkBakedDisplacementFieldTransform.h"
+#include "itkAdvancedCombinationTransform.h"
+#include "itkAdvancedEuler3DTransform.h"
+#include "itkMersenneTwisterRandomVariateGenerator.h"
+#include "itkTimeProbe.h"
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+//-------------------------------------------------------------------------------------
+
+/** Bake a chain of rigid transforms into a displacement field. The chain is
+ * affine, so the multilinear interpolation should reproduce it up to the
+ * single precision of the field, inside the grid, and exactly outside it.
+ */
+
+int
+main( int argc, char * argv[] )
+{
+  const unsigned int Dimension = 3;
+  typedef double ScalarType;
+  typedef itk::AdvancedEuler3DTransform< ScalarType >                   EulerTransformType;
+  typedef itk::AdvancedCombinationTransform< ScalarType, Dimension >    CombinationTransformType;
+  typedef itk::BakedDisplacementFieldTransform< ScalarType, Dimension > BakedTransformType;
+  typedef BakedTransformType::InputPointType                            PointType;
+  typedef BakedTransformType::SpatialJacobianType                       SpatialJacobianType;
+  typedef itk::Statistics::MersenneTwisterRandomVariateGenerator        RandomGeneratorType;
+
+  /** A chain of three rigid transforms. */
+  CombinationTransformType::Pointer chain = CombinationTransformType::New();
+  EulerTransformType::Pointer       first = EulerTransformType::New();
+  first->SetRotation( 0.1, -0.05, 0.2 );
+  EulerTransformType::OutputVectorType translation;
+  translation[ 0 ] = 3.0; translation[ 1 ] = -2.0; translation[ 2 ] = 1.5;
+  first->SetTranslation( translation );
+  chain->SetCurrentTransform( first );
+  for( unsigned int stage = 0; stage < 2; ++stage )
+  {
+    EulerTransformType::Pointer euler = EulerTransformType::New();
+    euler->SetRotation( -0.03 * stage, 0.04, 0.02 );
+    translation[ 0 ] = -1.0; translation[ 1 ] = 0.5 * stage; translation[ 2 ] = 2.0;
+    euler->SetTranslation( translation );
+
+    CombinationTransformType::Pointer next = CombinationTransformType::New();
+    next->SetInitialTransform( chain );
+    next->SetCurrentTransform( euler );
+    next->SetUseComposition( true );
+    chain = next;
+  }
+
+  /** Bake it on a 40 x 40 x 30 grid with a spacing of 2. */
+  BakedTransformType::Pointer     baked = BakedTransformType::New();
+  BakedTransformType::SizeType    size;
+  BakedTransformType::SpacingType spacing;
+  BakedTransformType::OriginType  origin;
+  size[ 0 ] = 40; size[ 1 ] = 40; size[ 2 ] = 30;
+  spacing.Fill( 2.0 );
+  origin.Fill( -10.0 );
+  baked->SetSourceTransform( chain );
+  baked->SetSize( size );
+  baked->SetSpacing( spacing );
+  baked->SetOrigin( origin );
+  baked->Bake();
+
+  std::cout << "Approximation error at " << baked->GetNumberOfErrorSamples()
+            << " cell centres: mean " << baked->GetMeanApproximationError()
+            << ", maximum " << baked->GetMaximumApproximationError() << std::endl;
+  if( baked->GetNumberOfErrorSamples() == 0 || baked->GetMaximumApproximationError() > 1e-3 )
+  {
+    std::cerr << "ERROR: the approximation error of an affine chain should be negligible." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  /** Compare the points and the spatial Jacobians at random points. */
+  RandomGeneratorType::Pointer randomGenerator = RandomGeneratorType::GetInstance();
+  randomGenerator->Initialize( 12345 );
+  const unsigned int       numberOfPoints = 10000;
+  std::vector< PointType > points( numberOfPoints );
+  double                   maxPointDiff    = 0.0;
+  double                   maxJacobianDiff = 0.0;
+  for( unsigned int i = 0; i < numberOfPoints; ++i )
+  {
+    for( unsigned int d = 0; d < Dimension; ++d )
+    {
+      points[ i ][ d ] = randomGenerator->GetUniformVariate(
+        origin[ d ], origin[ d ] + ( size[ d ] - 1 ) * spacing[ d ] );
+    }
+    maxPointDiff = std::max( maxPointDiff,
+      baked->TransformPoint( points[ i ] ).EuclideanDistanceTo( chain->TransformPoint( points[ i ] ) ) );
+
+    SpatialJacobianType sjBaked, sjChain;
+    baked->GetSpatialJacobian( points[ i ], sjBaked );
+    chain->GetSpatialJacobian( points[ i ], sjChain );
+    maxJacobianDiff = std::max( maxJacobianDiff, ( sjBaked - sjChain ).GetVnlMatrix().absolute_value_max() );
+  }
+  std::cout << "Maximum difference of the points: " << maxPointDiff
+            << ", of the spatial Jacobians: " << maxJacobianDiff << std::endl;
+  if( maxPointDiff > 1e-3 || maxJacobianDiff > 1e-3 )
+  {
+    std::cerr << "ERROR: the baked transform differs from the chain." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  /** Outside the grid the chain itself is used. */
+  PointType outside;
+  outside.Fill( -100.0 );
+  if( baked->TransformPoint( outside ) != chain->TransformPoint( outside ) )
+  {
+    std::cerr << "ERROR: outside the grid the chain should be used." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  /** Time both. */
+  PointType      sum;
+  itk::TimeProbe timerChain, timerBaked;
+  sum.Fill( 0.0 );
+  timerChain.Start();
+  for( unsigned int i = 0; i < numberOfPoints; ++i )
+  {
+    sum[ 0 ] += chain->TransformPoint( points[ i ] )[ 0 ];
+  }
+  timerChain.Stop();
+  timerBaked.Start();
+  for( unsigned int i = 0; i < numberOfPoints; ++i )
+  {
+    sum[ 1 ] += baked->TransformPoint( points[ i ] )[ 0 ];
+  }
+  timerBaked.Stop();
+  std::cout << "Time chain: " << timerChain.GetMean() << " s, baked: "
+            << timerBaked.GetMean() << " s (checksum " << sum[ 0 ] - sum[ 1 ] << ")" << std::endl;
+
+  return EXIT_SUCCESS;
+
+} // end main
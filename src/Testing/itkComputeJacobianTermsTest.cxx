@@ -0,0 +1,153 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "itkComputeJacobianTerms.h"
+#include "itkAdvancedBSplineDeformableTransform.h"
+#include "itkImage.h"
+
+#include <cmath>
+
+//-------------------------------------------------------------------------------------
+
+/** Compute the Jacobian terms of the automatic parameter estimation of the
+ * ASGD optimizer for a B-spline transform, with one thread and with several
+ * threads. The threaded terms should be close to the single-threaded ones,
+ * with and without scales, and running the threaded computation again
+ * should give exactly the same terms.
+ */
+
+const unsigned int Dimension = 2;
+
+typedef itk::Image< float, Dimension >          ImageType;
+typedef itk::AdvancedBSplineDeformableTransform
+  < double, Dimension, 3 >                      TransformType;
+typedef itk::ComputeJacobianTerms
+  < ImageType, TransformType >                  ComputeJacobianTermsType;
+typedef ComputeJacobianTermsType::ScalesType    ScalesType;
+
+struct JacobianTermsType
+{
+  double m_TrC;
+  double m_TrCC;
+  double m_MaxJJ;
+  double m_MaxJCJ;
+};
+
+/** Compute the Jacobian terms with the given number of threads. */
+JacobianTermsType
+ComputeTerms( ImageType * image, TransformType * transform,
+  const ScalesType & scales, bool useScales, itk::ThreadIdType numberOfThreads )
+{
+  ComputeJacobianTermsType::Pointer computer = ComputeJacobianTermsType::New();
+  computer->SetFixedImage( image );
+  computer->SetFixedImageRegion( image->GetBufferedRegion() );
+  computer->SetTransform( transform );
+  computer->SetNumberOfJacobianMeasurements( 2000 );
+  computer->SetScales( scales );
+  computer->SetUseScales( useScales );
+  computer->SetNumberOfThreads( numberOfThreads );
+
+  JacobianTermsType terms;
+  computer->Compute( terms.m_TrC, terms.m_TrCC, terms.m_MaxJJ, terms.m_MaxJCJ );
+  return terms;
+
+} // end ComputeTerms()
+
+
+/** Check that two terms are equal within a relative tolerance. */
+bool
+CompareTerm( const char * name, double serial, double threaded, double tolerance )
+{
+  std::cout << "  " << name << ": " << serial << " " << threaded << std::endl;
+  if( std::fabs( serial - threaded ) > tolerance * std::fabs( serial ) )
+  {
+    std::cerr << "ERROR: the threaded " << name << " " << threaded
+              << " differs from the serial " << serial << std::endl;
+    return false;
+  }
+  return true;
+
+} // end CompareTerm()
+
+
+//-------------------------------------------------------------------------------------
+
+int
+main( int argc, char * argv[] )
+{
+  /** A 64 x 64 image, with a B-spline grid spacing of 8 pixels. */
+  ImageType::RegionType region;
+  ImageType::SizeType   size;
+  size.Fill( 64 );
+  region.SetSize( size );
+  ImageType::Pointer image = ImageType::New();
+  image->SetRegions( region );
+  image->Allocate();
+  image->FillBuffer( 0.0f );
+
+  TransformType::RegionType gridRegion;
+  TransformType::SizeType   gridSize;
+  gridSize.Fill( 64 / 8 + 3 );
+  gridRegion.SetSize( gridSize );
+  TransformType::SpacingType gridSpacing;
+  gridSpacing.Fill( 8.0 );
+  TransformType::OriginType gridOrigin;
+  gridOrigin.Fill( -8.0 );
+
+  TransformType::Pointer transform = TransformType::New();
+  transform->SetGridOrigin( gridOrigin );
+  transform->SetGridSpacing( gridSpacing );
+  transform->SetGridRegion( gridRegion );
+  TransformType::ParametersType parameters( transform->GetNumberOfParameters() );
+  parameters.Fill( 0.0 );
+  transform->SetParameters( parameters );
+
+  ScalesType scales( transform->GetNumberOfParameters() );
+  for( unsigned int i = 0; i < scales.GetSize(); ++i )
+  {
+    scales[ i ] = 1.0 + 0.01 * ( i % 7 );
+  }
+
+  for( unsigned int useScales = 0; useScales < 2; ++useScales )
+  {
+    std::cout << ( useScales ? "With scales:" : "Without scales:" ) << std::endl;
+    const JacobianTermsType serial    = ComputeTerms( image, transform, scales, useScales == 1, 1 );
+    const JacobianTermsType threaded  = ComputeTerms( image, transform, scales, useScales == 1, 4 );
+    const JacobianTermsType threaded2 = ComputeTerms( image, transform, scales, useScales == 1, 4 );
+
+    /** The threads sum their samples separately, so only the rounding differs. */
+    const double tolerance = 1e-10;
+    if( !CompareTerm( "TrC", serial.m_TrC, threaded.m_TrC, tolerance )
+      || !CompareTerm( "TrCC", serial.m_TrCC, threaded.m_TrCC, tolerance )
+      || !CompareTerm( "maxJJ", serial.m_MaxJJ, threaded.m_MaxJJ, tolerance )
+      || !CompareTerm( "maxJCJ", serial.m_MaxJCJ, threaded.m_MaxJCJ, tolerance ) )
+    {
+      return EXIT_FAILURE;
+    }
+
+    /** The threaded parts of C are added in a fixed order. */
+    if( threaded.m_TrC != threaded2.m_TrC || threaded.m_TrCC != threaded2.m_TrCC
+      || threaded.m_MaxJJ != threaded2.m_MaxJJ || threaded.m_MaxJCJ != threaded2.m_MaxJCJ )
+    {
+      std::cerr << "ERROR: the threaded Jacobian terms differ between runs" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  return EXIT_SUCCESS;
+
+} // end main
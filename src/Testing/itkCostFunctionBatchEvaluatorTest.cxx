@@ -0,0 +1,231 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "itkCostFunctionBatchEvaluator.h"
+
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+//-------------------------------------------------------------------------------------
+
+/** A batch of positions is evaluated once serially, with a single cost
+ * function instance, and once concurrently, with clones. The values, the
+ * failed positions and the exceptions should be the same. The exceptions
+ * should keep the description and location of the original ExceptionObject,
+ * and other exceptions should be converted to an ExceptionObject.
+ */
+
+const unsigned int NumberOfParameters = 10;
+
+/** A cost function that, like a metric, stores the position it evaluates.
+ * Clones that would share this state would give wrong values.
+ */
+class StatefulCostFunction : public itk::SingleValuedCostFunction
+{
+public:
+
+  typedef StatefulCostFunction            Self;
+  typedef itk::SingleValuedCostFunction   Superclass;
+  typedef itk::SmartPointer< Self >       Pointer;
+  typedef itk::SmartPointer< const Self > ConstPointer;
+
+  itkNewMacro( Self );
+  itkTypeMacro( StatefulCostFunction, SingleValuedCostFunction );
+
+  virtual unsigned int GetNumberOfParameters( void ) const
+  {
+    return NumberOfParameters;
+  }
+
+
+  virtual MeasureType GetValue( const ParametersType & parameters ) const
+  {
+    /** Throw three kinds of exceptions, depending on the first parameter. */
+    if( parameters[ 0 ] < -4.0 )
+    {
+      itkExceptionMacro( << "Position out of range." );
+    }
+    else if( parameters[ 0 ] < -3.0 )
+    {
+      throw std::runtime_error( "Standard exception." );
+    }
+    else if( parameters[ 0 ] < -2.0 )
+    {
+      throw 42;
+    }
+
+    this->m_Position = parameters;
+    MeasureType value = 0.0;
+    for( unsigned int i = 0; i < NumberOfParameters; ++i )
+    {
+      for( unsigned int k = 0; k < 1000; ++k )
+      {
+        value += std::sin( this->m_Position[ i ] * ( k + 1 ) ) / ( k + 1 );
+      }
+    }
+    return value;
+  }
+
+
+  virtual void GetDerivative( const ParametersType & parameters,
+    DerivativeType & derivative ) const
+  {
+    itkExceptionMacro( << "Not implemented." );
+  }
+
+
+protected:
+
+  StatefulCostFunction() {}
+  virtual ~StatefulCostFunction() {}
+
+private:
+
+  mutable ParametersType m_Position;
+
+};
+
+typedef itk::CostFunctionBatchEvaluator EvaluatorType;
+
+int
+main( int argc, char * argv[] )
+{
+  /** The positions; some of them throw. */
+  const unsigned int                     numberOfPositions = 200;
+  EvaluatorType::ParametersContainerType positions( numberOfPositions,
+    EvaluatorType::ParametersType( NumberOfParameters ) );
+  for( unsigned int p = 0; p < numberOfPositions; ++p )
+  {
+    for( unsigned int i = 0; i < NumberOfParameters; ++i )
+    {
+      positions[ p ][ i ] = 5.0 * std::sin( 0.37 * p + 1.3 * i );
+    }
+  }
+
+  /** A serial evaluator with one instance, and one with four clones. */
+  EvaluatorType::Pointer serial = EvaluatorType::New();
+  serial->AddCostFunction( StatefulCostFunction::New() );
+  serial->SetNumberOfThreads( 4 );
+
+  EvaluatorType::Pointer concurrent = EvaluatorType::New();
+  for( unsigned int c = 0; c < 4; ++c )
+  {
+    concurrent->AddCostFunction( StatefulCostFunction::New() );
+  }
+  concurrent->SetNumberOfThreads( 4 );
+
+  if( serial->GetNumberOfConcurrentEvaluations() != 1
+    || concurrent->GetNumberOfConcurrentEvaluations() != 4 )
+  {
+    std::cerr << "ERROR: wrong number of concurrent evaluations." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  EvaluatorType::MeasureContainerType   serialValues, concurrentValues;
+  EvaluatorType::FailureContainerType   serialFailures, concurrentFailures;
+  EvaluatorType::ExceptionContainerType serialExceptions, concurrentExceptions;
+  serial->Evaluate( positions, serialValues, serialFailures, serialExceptions );
+  concurrent->Evaluate( positions, concurrentValues, concurrentFailures, concurrentExceptions );
+
+  /** Compare. The same code computes each value, so they should be equal. */
+  unsigned int numberOfFailures[ 3 ] = { 0, 0, 0 };
+  for( unsigned int p = 0; p < numberOfPositions; ++p )
+  {
+    if( serialFailures[ p ] != concurrentFailures[ p ]
+      || ( !serialFailures[ p ] && serialValues[ p ] != concurrentValues[ p ] ) )
+    {
+      std::cerr << "ERROR: the concurrent evaluation of position " << p
+                << " differs from the serial one." << std::endl;
+      return EXIT_FAILURE;
+    }
+    if( !serialFailures[ p ] ) { continue; }
+
+    if( std::string( serialExceptions[ p ].GetDescription() )
+      != concurrentExceptions[ p ].GetDescription() )
+    {
+      std::cerr << "ERROR: the exceptions of position " << p << " differ." << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    /** The ExceptionObject should be the original one, with its location. */
+    const std::string description = concurrentExceptions[ p ].GetDescription();
+    const std::string file        = concurrentExceptions[ p ].GetFile();
+    if( positions[ p ][ 0 ] < -4.0 )
+    {
+      ++numberOfFailures[ 0 ];
+      if( description.find( "Position out of range." ) == std::string::npos
+        || file.find( "itkCostFunctionBatchEvaluatorTest" ) == std::string::npos )
+      {
+        std::cerr << "ERROR: the original exception was not kept:\n"
+                  << concurrentExceptions[ p ] << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+    else if( positions[ p ][ 0 ] < -3.0 )
+    {
+      ++numberOfFailures[ 1 ];
+      if( description.find( "Standard exception." ) == std::string::npos )
+      {
+        std::cerr << "ERROR: the std::exception was not converted:\n"
+                  << concurrentExceptions[ p ] << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+    else
+    {
+      ++numberOfFailures[ 2 ];
+      if( description.find( "Unknown exception" ) == std::string::npos )
+      {
+        std::cerr << "ERROR: the unknown exception was not converted:\n"
+                  << concurrentExceptions[ p ] << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+  }
+
+  std::cout << "Failed evaluations: " << numberOfFailures[ 0 ] << " ExceptionObject, "
+            << numberOfFailures[ 1 ] << " std::exception, "
+            << numberOfFailures[ 2 ] << " unknown." << std::endl;
+  if( numberOfFailures[ 0 ] == 0 || numberOfFailures[ 1 ] == 0 || numberOfFailures[ 2 ] == 0 )
+  {
+    std::cerr << "ERROR: not all kinds of exceptions were tested." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  /** A rethrown exception keeps its location. */
+  for( unsigned int p = 0; p < numberOfPositions; ++p )
+  {
+    if( !concurrentFailures[ p ] || positions[ p ][ 0 ] >= -4.0 ) { continue; }
+    try
+    {
+      throw concurrentExceptions[ p ];
+    }
+    catch( itk::ExceptionObject & err )
+    {
+      if( err.GetLine() != serialExceptions[ p ].GetLine() || err.GetLine() == 0 )
+      {
+        std::cerr << "ERROR: the rethrown exception lost its location." << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+    break;
+  }
+
+  return EXIT_SUCCESS;
+
+} // end main
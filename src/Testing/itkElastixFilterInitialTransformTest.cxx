@@ -0,0 +1,213 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "elxElastixFilter.h"
+#include "elxParameterObject.h"
+#include "itkImage.h"
+#include "itkImageRegionConstIterator.h"
+#include "itkImageRegionIteratorWithIndex.h"
+#include "itkMultiThreader.h"
+
+#include <string>
+#include <cmath>
+
+//-------------------------------------------------------------------------------------
+
+/** Register a moving image to a fixed image in two stages. The first stage
+ * gives the initial transform of the second one, once through a transform
+ * parameter file on disk, and once in memory through
+ * SetInitialTransformParameterObject(). Both should give exactly the same
+ * transform parameters and result image. In memory, the maps of the
+ * initial transform should come first in the output, with the second stage
+ * referring to them by index.
+ */
+
+typedef itk::Image< float, 2 >                         ImageType;
+typedef elastix::ElastixFilter< ImageType, ImageType > ElastixFilterType;
+typedef elastix::ParameterObject                       ParameterObjectType;
+typedef ParameterObjectType::ParameterMapType          ParameterMapType;
+typedef ParameterObjectType::ParameterValueVectorType  ParameterValueVectorType;
+
+/** A smooth blob, shifted by ( dx, dy ). */
+ImageType::Pointer
+CreateImage( double dx, double dy )
+{
+  ImageType::RegionType region;
+  ImageType::SizeType   size;
+  size.Fill( 64 );
+  region.SetSize( size );
+
+  ImageType::Pointer image = ImageType::New();
+  image->SetRegions( region );
+  image->Allocate();
+
+  itk::ImageRegionIteratorWithIndex< ImageType > it( image, region );
+  for( it.GoToBegin(); !it.IsAtEnd(); ++it )
+  {
+    const double x = it.GetIndex()[ 0 ] - 32.0 - dx;
+    const double y = it.GetIndex()[ 1 ] - 30.0 - dy;
+    it.Set( static_cast< float >( 100.0 * std::exp( -( x * x + 2.0 * y * y ) / 200.0 ) ) );
+  }
+  return image;
+
+} // end CreateImage()
+
+
+/** A parameter map of a translation registration. */
+ParameterMapType
+CreateParameterMap( const std::string & maximumNumberOfIterations )
+{
+  ParameterMapType parameterMap;
+  parameterMap[ "FixedInternalImagePixelType" ]  = ParameterValueVectorType( 1, "float" );
+  parameterMap[ "MovingInternalImagePixelType" ] = ParameterValueVectorType( 1, "float" );
+  parameterMap[ "Registration" ]                 = ParameterValueVectorType( 1, "MultiResolutionRegistration" );
+  parameterMap[ "FixedImagePyramid" ]            = ParameterValueVectorType( 1, "FixedSmoothingImagePyramid" );
+  parameterMap[ "MovingImagePyramid" ]           = ParameterValueVectorType( 1, "MovingSmoothingImagePyramid" );
+  parameterMap[ "Interpolator" ]                 = ParameterValueVectorType( 1, "BSplineInterpolator" );
+  parameterMap[ "Metric" ]                       = ParameterValueVectorType( 1, "AdvancedMeanSquares" );
+  parameterMap[ "Optimizer" ]                    = ParameterValueVectorType( 1, "AdaptiveStochasticGradientDescent" );
+  parameterMap[ "ResampleInterpolator" ]         = ParameterValueVectorType( 1, "FinalBSplineInterpolator" );
+  parameterMap[ "Resampler" ]                    = ParameterValueVectorType( 1, "DefaultResampler" );
+  parameterMap[ "Transform" ]                    = ParameterValueVectorType( 1, "TranslationTransform" );
+  parameterMap[ "ImageSampler" ]                 = ParameterValueVectorType( 1, "RandomCoordinate" );
+  parameterMap[ "NumberOfResolutions" ]          = ParameterValueVectorType( 1, "1" );
+  parameterMap[ "MaximumNumberOfIterations" ]    = ParameterValueVectorType( 1, maximumNumberOfIterations );
+  parameterMap[ "NumberOfSpatialSamples" ]       = ParameterValueVectorType( 1, "512" );
+  parameterMap[ "NewSamplesEveryIteration" ]     = ParameterValueVectorType( 1, "true" );
+  parameterMap[ "AutomaticParameterEstimation" ] = ParameterValueVectorType( 1, "true" );
+  parameterMap[ "RandomSeed" ]                   = ParameterValueVectorType( 1, "20161018" );
+  parameterMap[ "DefaultPixelValue" ]            = ParameterValueVectorType( 1, "0" );
+  return parameterMap;
+
+} // end CreateParameterMap()
+
+
+//-------------------------------------------------------------------------------------
+
+int
+main( int argc, char * argv[] )
+{
+  /** Check. */
+  if( argc < 2 )
+  {
+    std::cerr << "ERROR: insufficient command line arguments.\n"
+              << "  initialTransformParameterFileName" << std::endl;
+    return EXIT_FAILURE;
+  }
+  const std::string initialTransformParameterFileName = argv[ 1 ];
+
+  /** One thread, so that the sums in the metric are always computed in the same order. */
+  itk::MultiThreader::SetGlobalDefaultNumberOfThreads( 1 );
+
+  ImageType::Pointer fixedImage  = CreateImage( 0.0, 0.0 );
+  ImageType::Pointer movingImage = CreateImage( 3.0, -2.0 );
+
+  /** The first stage stops early, so that the second stage has work left. */
+  ParameterObjectType::Pointer firstStage = ParameterObjectType::New();
+  firstStage->SetParameterMap( CreateParameterMap( "10" ) );
+  ParameterObjectType::Pointer secondStage = ParameterObjectType::New();
+  secondStage->SetParameterMap( CreateParameterMap( "100" ) );
+
+  ElastixFilterType::Pointer   initialFilter                   = ElastixFilterType::New();
+  ElastixFilterType::Pointer   fileFilter                      = ElastixFilterType::New();
+  ElastixFilterType::Pointer   memoryFilter                    = ElastixFilterType::New();
+  ParameterObjectType::Pointer initialTransformParameterObject = ParameterObjectType::New();
+  try
+  {
+    initialFilter->SetFixedImage( fixedImage );
+    initialFilter->SetMovingImage( movingImage );
+    initialFilter->SetParameterObject( firstStage );
+    initialFilter->LogToConsoleOff();
+    initialFilter->Update();
+
+    /** The old path: the initial transform is read from disk. */
+    initialFilter->GetTransformParameterObject()->WriteParameterFile(
+      initialFilter->GetTransformParameterObject()->GetParameterMap( 0 ), initialTransformParameterFileName );
+    fileFilter->SetFixedImage( fixedImage );
+    fileFilter->SetMovingImage( movingImage );
+    fileFilter->SetParameterObject( secondStage );
+    fileFilter->SetInitialTransformParameterFileName( initialTransformParameterFileName );
+    fileFilter->LogToConsoleOff();
+    fileFilter->Update();
+
+    /** The new path: the initial transform is passed in memory. It is read
+     * from the same file, since writing the file rounds the parameters.
+     */
+    initialTransformParameterObject->ReadParameterFile( initialTransformParameterFileName );
+    memoryFilter->SetFixedImage( fixedImage );
+    memoryFilter->SetMovingImage( movingImage );
+    memoryFilter->SetParameterObject( secondStage );
+    memoryFilter->SetInitialTransformParameterObject( initialTransformParameterObject );
+    memoryFilter->LogToConsoleOff();
+    memoryFilter->Update();
+  }
+  catch( itk::ExceptionObject & excp )
+  {
+    std::cerr << "ERROR: caught ITK exception during the registrations:\n" << excp << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  /** The initial map comes first, and the second stage refers to it by index. */
+  const ParameterObjectType * fileResult   = fileFilter->GetTransformParameterObject();
+  const ParameterObjectType * memoryResult = memoryFilter->GetTransformParameterObject();
+  if( fileResult->GetParameterMap().size() != 1 || memoryResult->GetParameterMap().size() != 2 )
+  {
+    std::cerr << "ERROR: the output has " << fileResult->GetParameterMap().size()
+              << " transform parameter maps from file and " << memoryResult->GetParameterMap().size()
+              << " from memory, instead of 1 and 2." << std::endl;
+    return EXIT_FAILURE;
+  }
+  ParameterMapType memoryMap = memoryResult->GetParameterMap( 1 );
+  ParameterMapType fileMap   = fileResult->GetParameterMap( 0 );
+  if( memoryMap[ "InitialTransformParametersFileName" ] != ParameterValueVectorType( 1, "0" ) )
+  {
+    std::cerr << "ERROR: the second stage does not refer to the initial map by index." << std::endl;
+    return EXIT_FAILURE;
+  }
+  if( memoryResult->GetParameterMap( 0 ) != initialTransformParameterObject->GetParameterMap( 0 ) )
+  {
+    std::cerr << "ERROR: the initial map is not the first map of the output." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  /** The same initial transform gives the same registration. */
+  const ParameterValueVectorType & fileParameters   = fileMap[ "TransformParameters" ];
+  const ParameterValueVectorType & memoryParameters = memoryMap[ "TransformParameters" ];
+  std::cout << "From file: " << fileParameters[ 0 ] << " " << fileParameters[ 1 ]
+            << ", from memory: " << memoryParameters[ 0 ] << " " << memoryParameters[ 1 ] << std::endl;
+  if( fileParameters != memoryParameters )
+  {
+    std::cerr << "ERROR: the transform parameters differ." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  itk::ImageRegionConstIterator< ImageType > itFile(
+    fileFilter->GetOutput(), fileFilter->GetOutput()->GetBufferedRegion() );
+  itk::ImageRegionConstIterator< ImageType > itMemory(
+    memoryFilter->GetOutput(), memoryFilter->GetOutput()->GetBufferedRegion() );
+  for( ; !itFile.IsAtEnd(); ++itFile, ++itMemory )
+  {
+    if( itFile.Get() != itMemory.Get() )
+    {
+      std::cerr << "ERROR: the result images differ at index " << itFile.GetIndex() << "." << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  return EXIT_SUCCESS;
+
+} // end main
@@ -0,0 +1,271 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "itkFullSearchOptimizer.h"
+#include "itkCommand.h"
+
+#include <vector>
+
+//-------------------------------------------------------------------------------------
+
+/** The plain full search, with one point per batch and without clones, is
+ * the reference. The batched search with clones should find the same best
+ * point with the same number of evaluations. The hierarchical search should
+ * find the same best point of this convex function with fewer evaluations,
+ * also with more refinement levels than the search space needs.
+ * A batched search that is stopped by an observer and resumed should process
+ * every grid point exactly once.
+ */
+
+typedef itk::FullSearchOptimizer      OptimizerType;
+typedef OptimizerType::ParametersType ParametersType;
+
+/** A convex cost function of the first two of three parameters, which
+ * counts its evaluations.
+ */
+class QuadraticCostFunction : public itk::SingleValuedCostFunction
+{
+public:
+
+  typedef QuadraticCostFunction           Self;
+  typedef itk::SingleValuedCostFunction   Superclass;
+  typedef itk::SmartPointer< Self >       Pointer;
+  typedef itk::SmartPointer< const Self > ConstPointer;
+
+  itkNewMacro( Self );
+  itkTypeMacro( QuadraticCostFunction, SingleValuedCostFunction );
+
+  virtual unsigned int GetNumberOfParameters( void ) const
+  {
+    return 3;
+  }
+
+
+  virtual MeasureType GetValue( const ParametersType & p ) const
+  {
+    ++this->m_NumberOfEvaluations;
+    return ( p[ 0 ] - 1.33 ) * ( p[ 0 ] - 1.33 )
+           + 2.0 * ( p[ 1 ] + 0.71 ) * ( p[ 1 ] + 0.71 )
+           + 0.1 * p[ 0 ] * p[ 1 ] + p[ 2 ];
+  }
+
+
+  virtual void GetDerivative( const ParametersType & parameters,
+    DerivativeType & derivative ) const
+  {
+    itkExceptionMacro( << "Not implemented." );
+  }
+
+
+  unsigned long GetNumberOfEvaluations( void ) const
+  {
+    return this->m_NumberOfEvaluations;
+  }
+
+
+protected:
+
+  QuadraticCostFunction() : m_NumberOfEvaluations( 0 ) {}
+  virtual ~QuadraticCostFunction() {}
+
+private:
+
+  mutable unsigned long m_NumberOfEvaluations;
+
+};
+
+/** Records the processed grid points, and stops the optimizer once. */
+class IterationObserver : public itk::Command
+{
+public:
+
+  typedef IterationObserver         Self;
+  typedef itk::Command              Superclass;
+  typedef itk::SmartPointer< Self > Pointer;
+
+  itkNewMacro( Self );
+
+  void Execute( itk::Object * caller, const itk::EventObject & event )
+  {
+    OptimizerType * optimizer = dynamic_cast< OptimizerType * >( caller );
+    if( optimizer == NULL || !itk::IterationEvent().CheckEvent( &event ) )
+    {
+      return;
+    }
+    const OptimizerType::SearchSpaceIndexType & index = optimizer->GetCurrentIndexInSearchSpace();
+    const unsigned long linearIndex = index[ 0 ] + index[ 1 ] * optimizer->GetSearchSpaceSize()[ 0 ];
+    ++this->m_Processed[ linearIndex ];
+    if( optimizer->GetCurrentIteration() + 1 == this->m_StopAtIteration )
+    {
+      optimizer->StopOptimization();
+    }
+  }
+
+
+  void Execute( const itk::Object * caller, const itk::EventObject & event )
+  {}
+
+  std::vector< unsigned int > m_Processed;
+  unsigned long               m_StopAtIteration;
+
+protected:
+
+  IterationObserver() : m_StopAtIteration( 0 ) {}
+
+};
+
+/** Set up an optimizer with the given number of instances of the cost function. */
+OptimizerType::Pointer
+CreateOptimizer( unsigned int numberOfInstances, unsigned long batchSize,
+  unsigned int levels, std::vector< QuadraticCostFunction::Pointer > & costFunctions )
+{
+  costFunctions.clear();
+  for( unsigned int i = 0; i < numberOfInstances; ++i )
+  {
+    costFunctions.push_back( QuadraticCostFunction::New() );
+  }
+
+  OptimizerType::Pointer optimizer = OptimizerType::New();
+  ParametersType         initialPosition( 3 );
+  initialPosition.Fill( 0.0 );
+  optimizer->SetCostFunction( costFunctions[ 0 ] );
+  for( unsigned int i = 1; i < numberOfInstances; ++i )
+  {
+    optimizer->AddCostFunctionClone( costFunctions[ i ] );
+  }
+  optimizer->SetNumberOfThreads( numberOfInstances );
+  optimizer->SetInitialPosition( initialPosition );
+  optimizer->AddSearchDimension( 0, -3.0, 3.0, 0.1 );
+  optimizer->AddSearchDimension( 1, -2.0, 2.0, 0.1 );
+  optimizer->SetBatchSize( batchSize );
+  optimizer->SetNumberOfRefinementLevels( levels );
+  optimizer->MinimizeOn();
+  return optimizer;
+}
+
+
+/** The total number of evaluations of all instances. */
+unsigned long
+GetNumberOfEvaluations( const std::vector< QuadraticCostFunction::Pointer > & costFunctions )
+{
+  unsigned long n = 0;
+  for( unsigned int i = 0; i < costFunctions.size(); ++i )
+  {
+    n += costFunctions[ i ]->GetNumberOfEvaluations();
+  }
+  return n;
+}
+
+
+int
+main( int argc, char * argv[] )
+{
+  std::vector< QuadraticCostFunction::Pointer > costFunctions;
+
+  /** The reference: the plain full search. */
+  OptimizerType::Pointer plain = CreateOptimizer( 1, 1, 0, costFunctions );
+  plain->StartOptimization();
+  const unsigned long                       nrOfIterations = plain->GetNumberOfIterations();
+  const OptimizerType::SearchSpaceIndexType bestIndex      = plain->GetBestIndexInSearchSpace();
+  const double                              bestValue      = plain->GetBestValue();
+  std::cout << "Plain search: best index " << bestIndex << ", value " << bestValue
+            << ", " << GetNumberOfEvaluations( costFunctions ) << " evaluations." << std::endl;
+  if( plain->GetCurrentIteration() != nrOfIterations
+    || GetNumberOfEvaluations( costFunctions ) != nrOfIterations )
+  {
+    std::cerr << "ERROR: the plain search did not evaluate each grid point once." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  /** The batched search with clones. */
+  OptimizerType::Pointer batched = CreateOptimizer( 4, 64, 0, costFunctions );
+  batched->StartOptimization();
+  std::cout << "Batched search: best index " << batched->GetBestIndexInSearchSpace()
+            << ", " << GetNumberOfEvaluations( costFunctions ) << " evaluations." << std::endl;
+  if( batched->GetBestIndexInSearchSpace() != bestIndex
+    || batched->GetBestValue() != bestValue
+    || batched->GetCurrentIteration() != nrOfIterations
+    || GetNumberOfEvaluations( costFunctions ) != nrOfIterations )
+  {
+    std::cerr << "ERROR: the batched search differs from the plain search." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  /** The hierarchical search with clones. */
+  OptimizerType::Pointer hierarchical = CreateOptimizer( 4, 64, 3, costFunctions );
+  hierarchical->StartOptimization();
+  std::cout << "Hierarchical search: best index " << hierarchical->GetBestIndexInSearchSpace()
+            << ", " << GetNumberOfEvaluations( costFunctions ) << " evaluations." << std::endl;
+  if( hierarchical->GetBestIndexInSearchSpace() != bestIndex
+    || hierarchical->GetBestValue() != bestValue
+    || hierarchical->GetCurrentIteration() != GetNumberOfEvaluations( costFunctions )
+    || GetNumberOfEvaluations( costFunctions ) >= nrOfIterations / 4 )
+  {
+    std::cerr << "ERROR: the hierarchical search did not find the best point efficiently." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  /** Refinement levels beyond a step of the size of the search space, 64 for
+   * these 61 x 41 grid points, should not change the hierarchical search. */
+  OptimizerType::Pointer coarsest = CreateOptimizer( 1, 64, 6, costFunctions );
+  coarsest->StartOptimization();
+  const unsigned long nrOfCoarsestEvaluations = GetNumberOfEvaluations( costFunctions );
+  OptimizerType::Pointer manyLevels = CreateOptimizer( 1, 64, 40, costFunctions );
+  manyLevels->StartOptimization();
+  std::cout << "Hierarchical search with 40 levels: best index " << manyLevels->GetBestIndexInSearchSpace()
+            << ", " << GetNumberOfEvaluations( costFunctions ) << " evaluations." << std::endl;
+  if( manyLevels->GetBestIndexInSearchSpace() != coarsest->GetBestIndexInSearchSpace()
+    || GetNumberOfEvaluations( costFunctions ) != nrOfCoarsestEvaluations )
+  {
+    std::cerr << "ERROR: the search with 40 levels differs from the one with 6 levels." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  /** A batched search that is stopped in the middle of a batch and resumed. */
+  OptimizerType::Pointer     resumed  = CreateOptimizer( 4, 64, 0, costFunctions );
+  IterationObserver::Pointer observer = IterationObserver::New();
+  observer->m_Processed.assign( nrOfIterations, 0 );
+  observer->m_StopAtIteration = 1000;
+  resumed->AddObserver( itk::IterationEvent(), observer );
+  resumed->StartOptimization();
+  if( resumed->GetCurrentIteration() != observer->m_StopAtIteration )
+  {
+    std::cerr << "ERROR: the search did not stop at the requested iteration." << std::endl;
+    return EXIT_FAILURE;
+  }
+  resumed->ResumeOptimization();
+
+  for( unsigned long i = 0; i < nrOfIterations; ++i )
+  {
+    if( observer->m_Processed[ i ] != 1 )
+    {
+      std::cerr << "ERROR: after resuming, grid point " << i << " was processed "
+                << observer->m_Processed[ i ] << " times." << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  if( resumed->GetCurrentIteration() != nrOfIterations
+    || resumed->GetBestIndexInSearchSpace() != bestIndex
+    || resumed->GetStopCondition() != OptimizerType::FullRangeSearched )
+  {
+    std::cerr << "ERROR: the resumed search differs from the plain search." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+
+} // end main
@@ -0,0 +1,191 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "itkGenericMultiResolutionPyramidImageFilter.h"
+#include "itkImage.h"
+#include "itkImageRegionConstIterator.h"
+#include "itkImageRegionIteratorWithIndex.h"
+
+#include <algorithm>
+#include <cmath>
+
+//-------------------------------------------------------------------------------------
+
+/** Compute a pyramid directly from the input, and from the next finer
+ * level with ComputeFromPreviousLevel, for several schedules. Each level
+ * should have the same origin, spacing and region in both. A level that
+ * is computed from the finer level should be close to the direct one. A
+ * level that cannot be computed from the finer level, since its sigma is
+ * smaller or, for the shrinker, its shrink factors are no multiples of the
+ * finer ones, should be computed from the input, and be exactly the same.
+ */
+
+const unsigned int Dimension      = 2;
+const unsigned int NumberOfLevels = 3;
+
+typedef itk::Image< float, Dimension >     ImageType;
+typedef itk::GenericMultiResolutionPyramidImageFilter
+  < ImageType, ImageType >                 PyramidType;
+typedef PyramidType::RescaleScheduleType   RescaleScheduleType;
+typedef PyramidType::SmoothingScheduleType SmoothingScheduleType;
+
+struct ScheduleCaseType
+{
+  const char * m_Name;
+  unsigned int m_ShrinkFactors[ NumberOfLevels ];
+  double       m_Sigmas[ NumberOfLevels ];
+  bool         m_UseShrinkImageFilter;
+  bool         m_FromPreviousLevel[ NumberOfLevels ];
+};
+
+/** Run the pyramid, directly or from the previous level. */
+PyramidType::Pointer
+RunPyramid( ImageType * image, const ScheduleCaseType & scheduleCase,
+  bool computeFromPreviousLevel )
+{
+  RescaleScheduleType   rescaleSchedule( NumberOfLevels, Dimension );
+  SmoothingScheduleType smoothingSchedule( NumberOfLevels, Dimension );
+  for( unsigned int level = 0; level < NumberOfLevels; ++level )
+  {
+    for( unsigned int dim = 0; dim < Dimension; ++dim )
+    {
+      rescaleSchedule[ level ][ dim ]   = scheduleCase.m_ShrinkFactors[ level ];
+      smoothingSchedule[ level ][ dim ] = scheduleCase.m_Sigmas[ level ];
+    }
+  }
+
+  PyramidType::Pointer pyramid = PyramidType::New();
+  pyramid->SetInput( image );
+  pyramid->SetNumberOfLevels( NumberOfLevels );
+  pyramid->SetRescaleSchedule( rescaleSchedule );
+  pyramid->SetSmoothingSchedule( smoothingSchedule );
+  pyramid->SetUseShrinkImageFilter( scheduleCase.m_UseShrinkImageFilter );
+  pyramid->SetComputeFromPreviousLevel( computeFromPreviousLevel );
+  pyramid->Update();
+  return pyramid;
+
+} // end RunPyramid()
+
+
+/** Compare the geometry and the pixels of a level. */
+bool
+CompareLevel( const ScheduleCaseType & scheduleCase, unsigned int level,
+  const ImageType * direct, const ImageType * fromPrevious )
+{
+  if( direct->GetLargestPossibleRegion() != fromPrevious->GetLargestPossibleRegion()
+    || direct->GetBufferedRegion() != fromPrevious->GetBufferedRegion() )
+  {
+    std::cerr << "ERROR: " << scheduleCase.m_Name << ", level " << level
+              << ": the regions differ" << std::endl;
+    return false;
+  }
+  for( unsigned int dim = 0; dim < Dimension; ++dim )
+  {
+    if( std::fabs( direct->GetOrigin()[ dim ] - fromPrevious->GetOrigin()[ dim ] ) > 1e-9
+      || std::fabs( direct->GetSpacing()[ dim ] - fromPrevious->GetSpacing()[ dim ] ) > 1e-9 )
+    {
+      std::cerr << "ERROR: " << scheduleCase.m_Name << ", level " << level
+                << ": the origin or spacing differs" << std::endl;
+      return false;
+    }
+  }
+
+  /** The blob has values up to 100. */
+  const double tolerance         = scheduleCase.m_FromPreviousLevel[ level ] ? 1.0 : 0.0;
+  double       maximumDifference = 0.0;
+  itk::ImageRegionConstIterator< ImageType > itDirect( direct, direct->GetBufferedRegion() );
+  itk::ImageRegionConstIterator< ImageType > itFromPrevious( fromPrevious, fromPrevious->GetBufferedRegion() );
+  for( ; !itDirect.IsAtEnd(); ++itDirect, ++itFromPrevious )
+  {
+    maximumDifference = std::max( maximumDifference,
+      std::fabs( static_cast< double >( itDirect.Get() ) - itFromPrevious.Get() ) );
+  }
+
+  std::cout << scheduleCase.m_Name << ", level " << level
+            << ( scheduleCase.m_FromPreviousLevel[ level ] ? ", from the finer level" : ", from the input" )
+            << ": maximum difference " << maximumDifference << std::endl;
+  if( maximumDifference > tolerance )
+  {
+    std::cerr << "ERROR: " << scheduleCase.m_Name << ", level " << level
+              << ": the maximum difference " << maximumDifference
+              << " exceeds " << tolerance << std::endl;
+    return false;
+  }
+  return true;
+
+} // end CompareLevel()
+
+
+//-------------------------------------------------------------------------------------
+
+int
+main( int argc, char * argv[] )
+{
+  /** A smooth blob. */
+  ImageType::RegionType region;
+  ImageType::SizeType   size;
+  size.Fill( 128 );
+  region.SetSize( size );
+  ImageType::SpacingType spacing;
+  spacing[ 0 ] = 1.0;
+  spacing[ 1 ] = 0.8;
+  ImageType::PointType origin;
+  origin[ 0 ] = -10.0;
+  origin[ 1 ] = 5.0;
+
+  ImageType::Pointer image = ImageType::New();
+  image->SetRegions( region );
+  image->SetSpacing( spacing );
+  image->SetOrigin( origin );
+  image->Allocate();
+  itk::ImageRegionIteratorWithIndex< ImageType > it( image, region );
+  for( it.GoToBegin(); !it.IsAtEnd(); ++it )
+  {
+    const double x = it.GetIndex()[ 0 ] - 60.0;
+    const double y = it.GetIndex()[ 1 ] - 70.0;
+    it.Set( static_cast< float >( 100.0 * std::exp( -( x * x + 2.0 * y * y ) / 800.0 ) ) );
+  }
+
+  /** The schedules, from coarse to fine, and for each level whether it can
+   * be computed from the finer level. The finest level never can.
+   */
+  const ScheduleCaseType scheduleCases[] = {
+    { "shrinker, multiples", { 4, 2, 1 }, { 2.0, 1.0, 0.5 }, true, { true, true, false } },
+    { "resampler, no multiples", { 3, 2, 1 }, { 1.5, 1.0, 0.5 }, false, { true, true, false } },
+    { "shrinker, no multiples", { 3, 2, 1 }, { 1.5, 1.0, 0.5 }, true, { false, true, false } },
+    { "shrinker, smaller sigma", { 4, 2, 1 }, { 1.0, 2.0, 0.5 }, true, { false, true, false } },
+    { "resampler, smaller sigma", { 4, 2, 1 }, { 2.0, 0.5, 1.0 }, false, { true, false, false } }
+  };
+  const unsigned int numberOfCases = sizeof( scheduleCases ) / sizeof( ScheduleCaseType );
+
+  for( unsigned int i = 0; i < numberOfCases; ++i )
+  {
+    PyramidType::Pointer direct       = RunPyramid( image, scheduleCases[ i ], false );
+    PyramidType::Pointer fromPrevious = RunPyramid( image, scheduleCases[ i ], true );
+    for( unsigned int level = 0; level < NumberOfLevels; ++level )
+    {
+      if( !CompareLevel( scheduleCases[ i ], level,
+        direct->GetOutput( level ), fromPrevious->GetOutput( level ) ) )
+      {
+        return EXIT_FAILURE;
+      }
+    }
+  }
+
+  return EXIT_SUCCESS;
+
+} // end main
@@ -0,0 +1,141 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "itkImageRandomSampler.h"
+#include "itkImageRandomCoordinateSampler.h"
+#include "itkImageMaskSpatialObject2.h"
+#include "itkThreadRandomGenerator.h"
+#include "itkImage.h"
+#include "itkImageRegionIteratorWithIndex.h"
+
+#include <string>
+
+//-------------------------------------------------------------------------------------
+
+/** Draw samples within a sparse mask, which covers a fifth of its bounding
+ * box, once with the single-threaded code and once with multiple threads
+ * and random streams of one sample each. The single-threaded code may try
+ * ten times the number of samples, which is enough for this mask. The
+ * multi-threaded code should not give up earlier, however short the
+ * streams, and all its samples should be inside the mask.
+ */
+
+typedef itk::Image< float, 2 >                         ImageType;
+typedef itk::Image< unsigned char, 2 >                 MaskImageType;
+typedef itk::ImageMaskSpatialObject2< 2 >              MaskType;
+typedef itk::ImageRandomSampler< ImageType >           RandomSamplerType;
+typedef itk::ImageRandomCoordinateSampler< ImageType > RandomCoordinateSamplerType;
+
+const unsigned long NumberOfSamples = 2000;
+
+/** Sample with the single-threaded and the multi-threaded code. */
+template< class TSampler >
+bool
+TestSampler( const std::string & name, ImageType * image, MaskType * mask )
+{
+  for( unsigned int useMultiThread = 0; useMultiThread < 2; ++useMultiThread )
+  {
+    itk::ThreadRandomGenerator::GetInstance()->SetSeed( 20161018 );
+
+    typename TSampler::Pointer sampler = TSampler::New();
+    sampler->SetInput( image );
+    sampler->SetMask( mask );
+    sampler->SetNumberOfSamples( NumberOfSamples );
+    sampler->SetNumberOfSamplesPerRandomStream( 1 );
+    sampler->SetUseMultiThread( useMultiThread == 1 );
+    sampler->SetNumberOfThreads( 4 );
+
+    try
+    {
+      sampler->Update();
+    }
+    catch( itk::ExceptionObject & excp )
+    {
+      std::cerr << "ERROR: the " << name << " could not find the samples "
+                << ( useMultiThread ? "with" : "without" ) << " multi-threading:\n"
+                << excp.GetDescription() << std::endl;
+      return false;
+    }
+
+    typename TSampler::ImageSampleContainerType * samples = sampler->GetOutput();
+    if( samples->Size() != NumberOfSamples )
+    {
+      std::cerr << "ERROR: the " << name << " gives " << samples->Size()
+                << " samples instead of " << NumberOfSamples << std::endl;
+      return false;
+    }
+    for( unsigned long i = 0; i < samples->Size(); ++i )
+    {
+      if( !mask->IsInside( samples->ElementAt( i ).m_ImageCoordinates ) )
+      {
+        std::cerr << "ERROR: sample " << i << " of the " << name
+                  << " is outside the mask" << std::endl;
+        return false;
+      }
+    }
+  }
+
+  std::cout << "The " << name << " found all samples." << std::endl;
+  return true;
+
+} // end TestSampler()
+
+
+//-------------------------------------------------------------------------------------
+
+int
+main( int argc, char * argv[] )
+{
+  /** A constant image, and a mask of diagonal stripes through the whole
+   * image, so that cropping to its bounding box does not help.
+   */
+  ImageType::RegionType region;
+  ImageType::SizeType   size;
+  size.Fill( 100 );
+  region.SetSize( size );
+
+  ImageType::Pointer image = ImageType::New();
+  image->SetRegions( region );
+  image->Allocate();
+  image->FillBuffer( 1.0f );
+
+  MaskImageType::Pointer maskImage = MaskImageType::New();
+  maskImage->SetRegions( region );
+  maskImage->Allocate();
+  itk::ImageRegionIteratorWithIndex< MaskImageType > it( maskImage, region );
+  for( it.GoToBegin(); !it.IsAtEnd(); ++it )
+  {
+    const long x = it.GetIndex()[ 0 ];
+    const long y = it.GetIndex()[ 1 ];
+    it.Set( ( ( x / 10 + y / 10 ) % 5 == 0 ) ? 1 : 0 );
+  }
+
+  MaskType::Pointer mask = MaskType::New();
+  mask->SetImage( maskImage );
+
+  if( !TestSampler< RandomSamplerType >( "ImageRandomSampler", image, mask ) )
+  {
+    return EXIT_FAILURE;
+  }
+  if( !TestSampler< RandomCoordinateSamplerType >( "ImageRandomCoordinateSampler", image, mask ) )
+  {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+
+} // end main
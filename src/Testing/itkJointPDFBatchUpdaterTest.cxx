@@ -0,0 +1,135 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "itkJointPDFBatchUpdater.h"
+#include "itkBSplineKernelFunction2.h"
+#include "itkMersenneTwisterRandomVariateGenerator.h"
+#include "itkTimeProbe.h"
+
+#include <vector>
+#include <cmath>
+#include <iomanip>
+#include <algorithm>
+
+//-------------------------------------------------------------------------------------
+
+/** Compare the vectorised joint histogram update with a straightforward
+ * per-sample implementation using the B-spline kernels of elastix,
+ * and time the instruction sets that are supported by this CPU.
+ */
+
+int
+main( int argc, char * argv[] )
+{
+  typedef itk::JointPDFBatchUpdater                               UpdaterType;
+  typedef itk::Statistics::MersenneTwisterRandomVariateGenerator RandomGeneratorType;
+
+  const unsigned int  numberOfBins    = 32;
+  const unsigned int  padding         = 2;
+  const unsigned int  histogramSize   = numberOfBins + 2 * padding;
+  const itk::SizeValueType numberOfSamples = 64;
+  const unsigned int  repetitions     = 20000;
+
+  /** Random Parzen window terms inside the histogram. */
+  RandomGeneratorType::Pointer randomGenerator = RandomGeneratorType::GetInstance();
+  randomGenerator->Initialize( 12345 );
+  std::vector< double > fixedTerms( numberOfSamples );
+  std::vector< double > movingTerms( numberOfSamples );
+  for( itk::SizeValueType i = 0; i < numberOfSamples; ++i )
+  {
+    fixedTerms[ i ]  = padding + randomGenerator->GetUniformVariate( 0.0, numberOfBins - 1.0 );
+    movingTerms[ i ] = padding + randomGenerator->GetUniformVariate( 0.0, numberOfBins - 1.0 );
+  }
+
+  /** The fixed kernel is usually of order 0, the moving kernel of order 3. */
+  itk::BSplineKernelFunction2< 0 >::Pointer fixedKernel  = itk::BSplineKernelFunction2< 0 >::New();
+  itk::BSplineKernelFunction2< 3 >::Pointer movingKernel = itk::BSplineKernelFunction2< 3 >::New();
+  const double fixedOffset  = 0.5;
+  const double movingOffset = 0.5 - 3.0 / 2.0;
+
+  /** Compute the reference histogram. */
+  std::vector< double > reference( histogramSize * histogramSize, 0.0 );
+  for( itk::SizeValueType i = 0; i < numberOfSamples; ++i )
+  {
+    const double fi = std::floor( fixedTerms[ i ] + fixedOffset );
+    const double mi = std::floor( movingTerms[ i ] + movingOffset );
+    for( unsigned int f = 0; f < 1; ++f )
+    {
+      const double fw = fixedKernel->Evaluate( fi + f - fixedTerms[ i ] );
+      for( unsigned int m = 0; m < 4; ++m )
+      {
+        const double mw = movingKernel->Evaluate( mi + m - movingTerms[ i ] );
+        reference[ static_cast< unsigned int >( fi + f ) * histogramSize
+        + static_cast< unsigned int >( mi + m ) ] += fw * mw;
+      }
+    }
+  }
+
+  /** Run all supported instruction sets. */
+  const UpdaterType::InstructionSetType supported = UpdaterType::GetSupportedInstructionSet();
+  std::vector< double > scalarResult;
+  for( unsigned int is = 0; is <= static_cast< unsigned int >( supported ); ++is )
+  {
+    UpdaterType::SetInstructionSet( static_cast< UpdaterType::InstructionSetType >( is ) );
+
+    std::vector< double > pdf( histogramSize * histogramSize, 0.0 );
+    UpdaterType::UpdateJointPDF( &fixedTerms[ 0 ], &movingTerms[ 0 ], numberOfSamples,
+      0, 3, fixedOffset, movingOffset, &pdf[ 0 ], histogramSize );
+
+    /** Compare with the reference. */
+    double maxDiff = 0.0;
+    for( unsigned int j = 0; j < pdf.size(); ++j )
+    {
+      maxDiff = std::max( maxDiff, std::abs( pdf[ j ] - reference[ j ] ) );
+    }
+    std::cout << std::setw( 8 ) << UpdaterType::GetInstructionSetName( UpdaterType::GetInstructionSet() )
+              << ": max difference with reference: " << maxDiff;
+    if( maxDiff > 1e-12 )
+    {
+      std::cerr << "\nERROR: the joint histogram differs from the reference." << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    /** The vectorised code should give exactly the same result as the scalar code. */
+    if( is == 0 )
+    {
+      scalarResult = pdf;
+    }
+    else if( pdf != scalarResult )
+    {
+      std::cerr << "\nERROR: the joint histogram differs from the scalar result." << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    /** Time it. */
+    itk::TimeProbe timer;
+    timer.Start();
+    for( unsigned int r = 0; r < repetitions; ++r )
+    {
+      UpdaterType::UpdateJointPDF( &fixedTerms[ 0 ], &movingTerms[ 0 ], numberOfSamples,
+        0, 3, fixedOffset, movingOffset, &pdf[ 0 ], histogramSize );
+    }
+    timer.Stop();
+    std::cout << ", time: " << timer.GetMean() << " s" << std::endl;
+  }
+
+  /** Restore the default. */
+  UpdaterType::SetInstructionSet( supported );
+
+  return EXIT_SUCCESS;
+
+} // end main
@@ -0,0 +1,254 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "itkKNNGraphAlphaMutualInformationImageToImageMetric.h"
+#include "itkAdvancedTranslationTransform.h"
+#include "itkImageFullSampler.h"
+#include "itkBSplineInterpolateImageFunction.h"
+#include "itkLinearInterpolateImageFunction.h"
+#include "itkImageRegionIteratorWithIndex.h"
+#include "itkMultiThreader.h"
+#include "itkTimeProbe.h"
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+//-------------------------------------------------------------------------------------
+
+/** Compare the kNN graph alpha-MI of three features, computed as before,
+ * with serial queries and with the fixed tree generated in every iteration,
+ * to the one with the queries divided over the threads and the fixed tree
+ * reused. Both should give the same values and derivatives, also after the
+ * sampler has regenerated its samples, which must not reuse the old tree.
+ */
+
+const unsigned int Dimension        = 2;
+const unsigned int NumberOfFeatures = 3;
+typedef itk::Image< float, Dimension >                                    ImageType;
+typedef itk::KNNGraphAlphaMutualInformationImageToImageMetric<
+  ImageType, ImageType >                                                  MetricType;
+typedef itk::AdvancedTranslationTransform< double, Dimension >            TransformType;
+typedef itk::ImageFullSampler< ImageType >                                SamplerType;
+typedef itk::BSplineInterpolateImageFunction< ImageType, double, double > InterpolatorType;
+typedef itk::LinearInterpolateImageFunction< ImageType, double >          FixedImageInterpolatorType;
+typedef MetricType::TransformParametersType                               ParametersType;
+typedef MetricType::DerivativeType                                        DerivativeType;
+
+/** A smooth feature image; the moving images are shifted copies. */
+ImageType::Pointer
+CreateFeatureImage( unsigned int feature, double shift )
+{
+  ImageType::RegionType region;
+  ImageType::SizeType   size;
+  size.Fill( 128 );
+  region.SetSize( size );
+
+  ImageType::Pointer image = ImageType::New();
+  image->SetRegions( region );
+  image->Allocate();
+
+  itk::ImageRegionIteratorWithIndex< ImageType > it( image, region );
+  for( it.GoToBegin(); !it.IsAtEnd(); ++it )
+  {
+    const double x = it.GetIndex()[ 0 ] - shift;
+    const double y = it.GetIndex()[ 1 ];
+    double       value;
+    if( feature == 0 )
+    {
+      value = 100.0 * std::sin( 0.05 * x ) * std::cos( 0.07 * y );
+    }
+    else if( feature == 1 )
+    {
+      value = 50.0 * std::cos( 0.03 * ( x + y ) );
+    }
+    else
+    {
+      value = 0.01 * ( ( x - 64.0 ) * ( x - 64.0 ) + ( y - 64.0 ) * ( y - 64.0 ) );
+    }
+    it.Set( static_cast< float >( value ) );
+  }
+  return image;
+}
+
+
+/** Set up a metric for the given images. */
+MetricType::Pointer
+CreateMetric( const std::vector< ImageType::Pointer > & fixedImages,
+  const std::vector< ImageType::Pointer > & movingImages,
+  bool useMultiThread, bool reuseFixedTree )
+{
+  MetricType::Pointer    metric    = MetricType::New();
+  TransformType::Pointer transform = TransformType::New();
+  SamplerType::Pointer   sampler   = SamplerType::New();
+
+  /** Sample away from the border, so that all samples stay valid. */
+  ImageType::RegionType region = fixedImages[ 0 ]->GetBufferedRegion();
+  for( unsigned int d = 0; d < Dimension; ++d )
+  {
+    region.SetIndex( d, region.GetIndex( d ) + 10 );
+    region.SetSize( d, region.GetSize( d ) - 20 );
+  }
+
+  for( unsigned int i = 0; i < NumberOfFeatures; ++i )
+  {
+    metric->SetFixedImage( fixedImages[ i ], i );
+    metric->SetFixedImageRegion( region, i );
+    metric->SetFixedImageInterpolator( FixedImageInterpolatorType::New(), i );
+    metric->SetMovingImage( movingImages[ i ], i );
+    InterpolatorType::Pointer interpolator = InterpolatorType::New();
+    interpolator->SetSplineOrder( 1 );
+    metric->SetInterpolator( interpolator, i );
+  }
+  metric->SetTransform( transform );
+  metric->SetImageSampler( sampler );
+  metric->SetANNkDTree( 50, "ANN_KD_SL_MIDPT" );
+  metric->SetANNStandardTreeSearch( 20, 0.0 );
+  metric->SetAlpha( 0.99 );
+  metric->SetUseMultiThread( useMultiThread );
+  metric->SetNumberOfThreads( itk::MultiThreader::GetGlobalDefaultNumberOfThreads() );
+  metric->SetReuseFixedTree( reuseFixedTree );
+  metric->Initialize();
+  return metric;
+}
+
+
+int
+main( int argc, char * argv[] )
+{
+  std::vector< ImageType::Pointer > fixedImages, movingImages;
+  for( unsigned int i = 0; i < NumberOfFeatures; ++i )
+  {
+    fixedImages.push_back( CreateFeatureImage( i, 0.0 ) );
+    movingImages.push_back( CreateFeatureImage( i, 3.0 ) );
+  }
+
+  MetricType::Pointer reference = CreateMetric( fixedImages, movingImages, false, false );
+  MetricType::Pointer threaded  = CreateMetric( fixedImages, movingImages, true, true );
+
+  /** The parameters of some iterations of a registration. */
+  const unsigned int            numberOfIterations = 10;
+  std::vector< ParametersType > parameters( numberOfIterations, ParametersType( Dimension ) );
+  for( unsigned int it = 0; it < numberOfIterations; ++it )
+  {
+    parameters[ it ][ 0 ] = 3.0 * it / numberOfIterations;
+    parameters[ it ][ 1 ] = 0.1 * it;
+  }
+
+  /** Time both, and compare the results. */
+  itk::TimeProbe timerReference, timerThreaded;
+  double         maxValueDiff      = 0.0;
+  double         maxDerivativeDiff = 0.0;
+  double         maxDerivative     = 0.0;
+  for( unsigned int it = 0; it < numberOfIterations; ++it )
+  {
+    double         valueReference, valueThreaded;
+    DerivativeType derivativeReference, derivativeThreaded;
+
+    timerReference.Start();
+    reference->GetValueAndDerivative( parameters[ it ], valueReference, derivativeReference );
+    timerReference.Stop();
+
+    timerThreaded.Start();
+    threaded->GetValueAndDerivative( parameters[ it ], valueThreaded, derivativeThreaded );
+    timerThreaded.Stop();
+
+    maxValueDiff = std::max( maxValueDiff, std::abs( valueReference - valueThreaded ) );
+    for( unsigned int i = 0; i < derivativeReference.GetSize(); ++i )
+    {
+      maxDerivative     = std::max( maxDerivative, std::abs( derivativeReference[ i ] ) );
+      maxDerivativeDiff = std::max( maxDerivativeDiff,
+        std::abs( derivativeReference[ i ] - derivativeThreaded[ i ] ) );
+    }
+  }
+
+  std::cout << "Threads: " << itk::MultiThreader::GetGlobalDefaultNumberOfThreads()
+            << ", fixed tree reuses: " << threaded->GetNumberOfFixedTreeReuses() << std::endl;
+  std::cout << "Maximum difference of the values: " << maxValueDiff
+            << ", of the derivatives: " << maxDerivativeDiff
+            << " (maximum derivative " << maxDerivative << ")" << std::endl;
+  std::cout << "Time serial: " << timerReference.GetMean() << " s, threaded: "
+            << timerThreaded.GetMean() << " s per iteration" << std::endl;
+
+  /** The samples do not change, so only the first iteration generates the fixed tree. */
+  if( threaded->GetNumberOfFixedTreeReuses() != numberOfIterations - 1
+    || reference->GetNumberOfFixedTreeReuses() != 0 )
+  {
+    std::cerr << "ERROR: the fixed tree should be reused in all but the first iteration." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  /** Only the order of the summation differs. */
+  if( maxDerivative == 0.0 || maxValueDiff > 1e-10
+    || maxDerivativeDiff > 1e-10 * std::max( maxDerivative, 1.0 ) )
+  {
+    std::cerr << "ERROR: the threaded metric differs from the serial one." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  /** New samples: the samplers regenerate their output in place, as when
+   * new samples are selected every iteration. The first iteration should
+   * generate the fixed tree again, the second should reuse it.
+   */
+  ImageType::RegionType newRegion = fixedImages[ 0 ]->GetBufferedRegion();
+  for( unsigned int d = 0; d < Dimension; ++d )
+  {
+    newRegion.SetIndex( d, newRegion.GetIndex( d ) + 15 );
+    newRegion.SetSize( d, newRegion.GetSize( d ) - 35 );
+  }
+  reference->GetImageSampler()->SetInputImageRegion( newRegion );
+  threaded->GetImageSampler()->SetInputImageRegion( newRegion );
+
+  const unsigned long numberOfReuses = threaded->GetNumberOfFixedTreeReuses();
+  maxValueDiff      = 0.0;
+  maxDerivativeDiff = 0.0;
+  maxDerivative     = 0.0;
+  for( unsigned int it = 0; it < 2; ++it )
+  {
+    double         valueReference, valueThreaded;
+    DerivativeType derivativeReference, derivativeThreaded;
+    reference->GetValueAndDerivative( parameters[ it ], valueReference, derivativeReference );
+    threaded->GetValueAndDerivative( parameters[ it ], valueThreaded, derivativeThreaded );
+
+    maxValueDiff = std::max( maxValueDiff, std::abs( valueReference - valueThreaded ) );
+    for( unsigned int i = 0; i < derivativeReference.GetSize(); ++i )
+    {
+      maxDerivative     = std::max( maxDerivative, std::abs( derivativeReference[ i ] ) );
+      maxDerivativeDiff = std::max( maxDerivativeDiff,
+        std::abs( derivativeReference[ i ] - derivativeThreaded[ i ] ) );
+    }
+  }
+
+  std::cout << "New samples: " << threaded->GetImageSampler()->GetOutput()->Size()
+            << ", fixed tree reuses: " << threaded->GetNumberOfFixedTreeReuses() - numberOfReuses
+            << ", maximum difference of the values: " << maxValueDiff
+            << ", of the derivatives: " << maxDerivativeDiff << std::endl;
+  if( threaded->GetNumberOfFixedTreeReuses() != numberOfReuses + 1 )
+  {
+    std::cerr << "ERROR: the fixed tree should be generated again for the new samples only." << std::endl;
+    return EXIT_FAILURE;
+  }
+  if( maxDerivative == 0.0 || maxValueDiff > 1e-10
+    || maxDerivativeDiff > 1e-10 * std::max( maxDerivative, 1.0 ) )
+  {
+    std::cerr << "ERROR: after new samples, the threaded metric differs from the serial one." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+
+} // end main
@@ -0,0 +1,263 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "itkPersistentThreadPool.h"
+#include "itkArray.h"
+
+#include <iomanip>
+
+// Report timings
+#include "itkTimeProbe.h"
+#include "itkTimeProbesCollectorBase.h"
+
+/** This test compares the per-iteration overhead of launching threads with
+ * an itk::MultiThreader, which creates new threads every call, with the
+ * overhead of the PersistentThreadPool, which reuses its workers.
+ * The job is the update of AdvanceOneStep for a small parameter vector,
+ * so that the launch overhead dominates.
+ */
+
+typedef itk::Array< double >           ParametersType;
+typedef itk::PersistentThreadPool      ThreadPoolType;
+typedef ThreadPoolType::ThreaderType   ThreaderType;
+typedef ThreaderType::ThreadInfoStruct ThreadInfoType;
+
+struct JobType
+{
+  ParametersType * m_NewPosition;
+  ParametersType * m_CurrentPosition;
+  ParametersType * m_Gradient;
+  double           m_LearningRate;
+  bool             m_Throw;
+};
+
+/** The threaded AdvanceOneStep. */
+ITK_THREAD_RETURN_TYPE
+AdvanceOneStepThreaderCallback( void * arg )
+{
+  ThreadInfoType *        infoStruct  = static_cast< ThreadInfoType * >( arg );
+  const itk::ThreadIdType threadId    = infoStruct->ThreadID;
+  const itk::ThreadIdType nrOfThreads = infoStruct->NumberOfThreads;
+  JobType *               job         = static_cast< JobType * >( infoStruct->UserData );
+
+  if( job->m_Throw && threadId == nrOfThreads - 1 )
+  {
+    itkGenericExceptionMacro( << "Exception thrown in thread " << threadId );
+  }
+
+  const unsigned int spaceDimension = job->m_NewPosition->GetSize();
+  const unsigned int subSize        = ( spaceDimension + nrOfThreads - 1 ) / nrOfThreads;
+  const unsigned int jmin           = threadId * subSize;
+  unsigned int       jmax           = ( threadId + 1 ) * subSize;
+  jmax = ( jmax > spaceDimension ) ? spaceDimension : jmax;
+
+  for( unsigned int j = jmin; j < jmax; ++j )
+  {
+    ( *job->m_NewPosition )[ j ] = ( *job->m_CurrentPosition )[ j ]
+      - job->m_LearningRate * ( *job->m_Gradient )[ j ];
+  }
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end AdvanceOneStepThreaderCallback()
+
+
+/** A job that launches AdvanceOneStep from within one of its threads. */
+struct NestedJobType
+{
+  ThreaderType * m_Threader;
+  JobType *      m_Job;
+};
+
+ITK_THREAD_RETURN_TYPE
+NestedThreaderCallback( void * arg )
+{
+  ThreadInfoType * infoStruct = static_cast< ThreadInfoType * >( arg );
+  NestedJobType *  nestedJob  = static_cast< NestedJobType * >( infoStruct->UserData );
+
+  if( infoStruct->ThreadID == 0 )
+  {
+    ThreadPoolType::SingleMethodExecute( nestedJob->m_Threader,
+      AdvanceOneStepThreaderCallback, nestedJob->m_Job );
+  }
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end NestedThreaderCallback()
+
+
+//-------------------------------------------------------------------------------------
+
+int
+main( int argc, char * argv[] )
+{
+  std::cout << std::fixed << std::showpoint << std::setprecision( 8 );
+
+  const itk::ThreadIdType nrOfThreads    = 8;
+  const unsigned int      nrOfParams     = 10000;
+  const unsigned int      nrOfIterations = 2000;
+
+  /** Setup. */
+  ParametersType currentPosition( nrOfParams );
+  ParametersType gradient( nrOfParams );
+  ParametersType newPositionThreader( nrOfParams );
+  ParametersType newPositionPool( nrOfParams );
+  for( unsigned int i = 0; i < nrOfParams; ++i )
+  {
+    currentPosition[ i ] = 2.1 + i;
+    gradient[ i ]        = 0.5 * i;
+  }
+
+  JobType job;
+  job.m_CurrentPosition = &currentPosition;
+  job.m_Gradient        = &gradient;
+  job.m_LearningRate    = 3.67;
+  job.m_Throw           = false;
+
+  ThreaderType::Pointer threader = ThreaderType::New();
+  threader->SetNumberOfThreads( nrOfThreads );
+
+  ThreadPoolType::Pointer pool = ThreadPoolType::New();
+  pool->SetNumberOfThreads( nrOfThreads );
+
+  itk::TimeProbesCollectorBase timeCollector;
+
+  /** Time the classic MultiThreader. */
+  job.m_NewPosition = &newPositionThreader;
+  for( unsigned int i = 0; i < nrOfIterations; ++i )
+  {
+    timeCollector.Start( "MultiThreader" );
+    threader->SetSingleMethod( AdvanceOneStepThreaderCallback, &job );
+    threader->SingleMethodExecute();
+    timeCollector.Stop( "MultiThreader" );
+  }
+
+  /** Time the persistent thread pool. */
+  job.m_NewPosition = &newPositionPool;
+  for( unsigned int i = 0; i < nrOfIterations; ++i )
+  {
+    timeCollector.Start( "PersistentThreadPool" );
+    pool->Execute( AdvanceOneStepThreaderCallback, &job, nrOfThreads );
+    timeCollector.Stop( "PersistentThreadPool" );
+  }
+
+  /** Report per-iteration timings. */
+  timeCollector.Report( std::cout, false, true );
+  std::cout << std::endl;
+
+  /** Both should give exactly the same result. */
+  for( unsigned int i = 0; i < nrOfParams; ++i )
+  {
+    if( newPositionThreader[ i ] != newPositionPool[ i ] )
+    {
+      std::cerr << "ERROR: results differ at element " << i << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  /** More thread ids than workers must also be handled. */
+  newPositionPool.Fill( 0.0 );
+  pool->Execute( AdvanceOneStepThreaderCallback, &job, 3 * nrOfThreads + 1 );
+  for( unsigned int i = 0; i < nrOfParams; ++i )
+  {
+    if( newPositionThreader[ i ] != newPositionPool[ i ] )
+    {
+      std::cerr << "ERROR: results differ at element " << i
+                << " when using more thread ids than threads" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  /** Exceptions must be passed to the calling thread. */
+  job.m_Throw = true;
+  bool caught = false;
+  try
+  {
+    pool->Execute( AdvanceOneStepThreaderCallback, &job, nrOfThreads );
+  }
+  catch( itk::ExceptionObject & excp )
+  {
+    std::cout << "Caught expected exception: " << excp.GetDescription() << std::endl;
+    caught = true;
+  }
+  if( !caught )
+  {
+    std::cerr << "ERROR: exception in a job was not passed on" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  /** The pool must still be usable after an exception. */
+  job.m_Throw = false;
+  if( !pool->Execute( AdvanceOneStepThreaderCallback, &job, nrOfThreads ) )
+  {
+    std::cerr << "ERROR: the pool is still busy after an exception" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  /** A job started right after the workers are (re)started must not be
+   * missed by a worker that has not run yet. Without a fix this hangs.
+   */
+  for( unsigned int i = 0; i < 200; ++i )
+  {
+    newPositionPool.Fill( 0.0 );
+    pool->SetNumberOfThreads( nrOfThreads - ( i % 2 ) );
+    if( !pool->Execute( AdvanceOneStepThreaderCallback, &job, nrOfThreads ) )
+    {
+      std::cerr << "ERROR: the pool is busy right after setting the number of threads" << std::endl;
+      return EXIT_FAILURE;
+    }
+    for( unsigned int j = 0; j < nrOfParams; ++j )
+    {
+      if( newPositionThreader[ j ] != newPositionPool[ j ] )
+      {
+        std::cerr << "ERROR: results differ at element " << j
+                  << " when executing right after setting the number of threads" << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+  }
+
+  /** A thread instance is a budget: a job launched from within one of its
+   * jobs runs in the calling thread, instead of on new threads.
+   */
+  ThreadPoolType::Pointer budgetPool = ThreadPoolType::New();
+  budgetPool->SetNumberOfThreads( 2 );
+  ThreadPoolType::SetThreadInstance( budgetPool );
+  newPositionPool.Fill( 0.0 );
+  NestedJobType nestedJob;
+  nestedJob.m_Threader = threader;
+  nestedJob.m_Job      = &job;
+  ThreadPoolType::SingleMethodExecute( threader, NestedThreaderCallback, &nestedJob );
+  ThreadPoolType::SetThreadInstance( NULL );
+  if( budgetPool->GetNumberOfExecutedJobs() != 1 )
+  {
+    std::cerr << "ERROR: the nested job should not run on the pool" << std::endl;
+    return EXIT_FAILURE;
+  }
+  for( unsigned int i = 0; i < nrOfParams; ++i )
+  {
+    if( newPositionThreader[ i ] != newPositionPool[ i ] )
+    {
+      std::cerr << "ERROR: results differ at element " << i
+                << " when running a nested job" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  return EXIT_SUCCESS;
+
+} // end main
@@ -0,0 +1,239 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "elastixlib.h"
+#include "itkSharedObjectCache.h"
+#include "itkImage.h"
+#include "itkImageRegionIteratorWithIndex.h"
+#include "itkMultiThreader.h"
+
+#include <vector>
+#include <string>
+#include <cmath>
+#include <cstdlib>
+
+//-------------------------------------------------------------------------------------
+
+/** Register three moving images to one fixed image with a mask, once one
+ * after the other and once concurrently, with random samples, an optimizer
+ * that draws random perturbations and an eroded fixed mask. Every
+ * registration has its own random generator, seeded with the RandomSeed,
+ * so both should give exactly the same transform parameters. In both, the
+ * fixed image pyramid and the eroded masks should be computed once, and be
+ * found by the other registrations. Then repeat the concurrent
+ * registrations, with more than one thread each.
+ */
+
+typedef elastix::ELASTIX                 ElastixType;
+typedef ElastixType::ParameterMapType    ParameterMapType;
+typedef ElastixType::ParameterValuesType ParameterValuesType;
+typedef itk::Image< float, 2 >           ImageType;
+typedef itk::Image< unsigned char, 2 >   MaskImageType;
+
+/** A smooth blob, shifted by ( dx, dy ). */
+ImageType::Pointer
+CreateImage( double dx, double dy )
+{
+  ImageType::RegionType region;
+  ImageType::SizeType   size;
+  size.Fill( 64 );
+  region.SetSize( size );
+
+  ImageType::Pointer image = ImageType::New();
+  image->SetRegions( region );
+  image->Allocate();
+
+  itk::ImageRegionIteratorWithIndex< ImageType > it( image, region );
+  for( it.GoToBegin(); !it.IsAtEnd(); ++it )
+  {
+    const double x = it.GetIndex()[ 0 ] - 32.0 - dx;
+    const double y = it.GetIndex()[ 1 ] - 30.0 - dy;
+    it.Set( static_cast< float >( 100.0 * std::exp( -( x * x + 2.0 * y * y ) / 200.0 ) ) );
+  }
+  return image;
+}
+
+
+/** A square mask in the middle of the image. */
+MaskImageType::Pointer
+CreateMask( void )
+{
+  MaskImageType::RegionType region;
+  MaskImageType::SizeType   size;
+  size.Fill( 64 );
+  region.SetSize( size );
+
+  MaskImageType::Pointer mask = MaskImageType::New();
+  mask->SetRegions( region );
+  mask->Allocate();
+
+  itk::ImageRegionIteratorWithIndex< MaskImageType > it( mask, region );
+  for( it.GoToBegin(); !it.IsAtEnd(); ++it )
+  {
+    const long x = it.GetIndex()[ 0 ];
+    const long y = it.GetIndex()[ 1 ];
+    it.Set( ( x > 8 && x < 56 && y > 8 && y < 56 ) ? 1 : 0 );
+  }
+  return mask;
+}
+
+
+/** Add a parameter with one value to the map. */
+void
+SetParameter( ParameterMapType & parameterMap, const std::string & name,
+  const std::string & value )
+{
+  parameterMap[ name ] = ParameterValuesType( 1, value );
+}
+
+
+int
+main( int argc, char * argv[] )
+{
+  /** Give every registration one thread, however many run concurrently, so
+   * that the sums in the metric are computed in the same order.
+   */
+  itk::MultiThreader::SetGlobalDefaultNumberOfThreads( 1 );
+
+  ParameterMapType parameterMap;
+  SetParameter( parameterMap, "FixedInternalImagePixelType", "float" );
+  SetParameter( parameterMap, "MovingInternalImagePixelType", "float" );
+  SetParameter( parameterMap, "FixedImageDimension", "2" );
+  SetParameter( parameterMap, "MovingImageDimension", "2" );
+  SetParameter( parameterMap, "Registration", "MultiResolutionRegistration" );
+  SetParameter( parameterMap, "FixedImagePyramid", "FixedSmoothingImagePyramid" );
+  SetParameter( parameterMap, "MovingImagePyramid", "MovingSmoothingImagePyramid" );
+  SetParameter( parameterMap, "Interpolator", "BSplineInterpolator" );
+  SetParameter( parameterMap, "Metric", "AdvancedMeanSquares" );
+  SetParameter( parameterMap, "Optimizer", "AdaptiveStochasticGradientDescent" );
+  SetParameter( parameterMap, "ResampleInterpolator", "FinalBSplineInterpolator" );
+  SetParameter( parameterMap, "Resampler", "DefaultResampler" );
+  SetParameter( parameterMap, "Transform", "TranslationTransform" );
+  SetParameter( parameterMap, "ImageSampler", "RandomCoordinate" );
+  SetParameter( parameterMap, "NumberOfResolutions", "2" );
+  SetParameter( parameterMap, "ErodeMask", "true" );
+  SetParameter( parameterMap, "MaximumNumberOfIterations", "100" );
+  SetParameter( parameterMap, "NumberOfSpatialSamples", "512" );
+  SetParameter( parameterMap, "NewSamplesEveryIteration", "true" );
+  SetParameter( parameterMap, "AutomaticParameterEstimation", "true" );
+  SetParameter( parameterMap, "RandomSeed", "20161018" );
+  SetParameter( parameterMap, "WriteResultImage", "false" );
+  std::vector< ParameterMapType > parameterMaps( 1, parameterMap );
+
+  ImageType::Pointer                       fixedImage = CreateImage( 0.0, 0.0 );
+  MaskImageType::Pointer                   fixedMask  = CreateMask();
+  std::vector< ElastixType::ImagePointer > movingImages;
+  movingImages.push_back( CreateImage( 3.0, -2.0 ).GetPointer() );
+  movingImages.push_back( CreateImage( -2.5, 1.5 ).GetPointer() );
+  movingImages.push_back( CreateImage( 1.0, 4.0 ).GetPointer() );
+  const unsigned int numberOfMovingImages = static_cast< unsigned int >( movingImages.size() );
+
+  /** One after the other, and concurrently. */
+  std::vector< ElastixType::ParameterMapListType > results[ 2 ];
+  const unsigned int                               concurrency[ 2 ] = { 1, numberOfMovingImages };
+  for( unsigned int run = 0; run < 2; ++run )
+  {
+    itk::SharedObjectCache::Pointer cache = itk::SharedObjectCache::New();
+    ElastixType                     elastix;
+    elastix.SetFixedSideCache( cache );
+    const int error = elastix.RegisterImageBatch( fixedImage.GetPointer(), movingImages,
+      parameterMaps, "", false, false, fixedMask.GetPointer(),
+      std::vector< ElastixType::ImagePointer >(), concurrency[ run ] );
+    if( error != 0 )
+    {
+      std::cerr << "ERROR: RegisterImageBatch() returned " << error << "." << std::endl;
+      return EXIT_FAILURE;
+    }
+    results[ run ] = elastix.GetBatchTransformParameterMapLists();
+
+    /** The pyramid and the eroded mask of each level are computed once. */
+    std::cout << "Concurrent registrations: " << concurrency[ run ]
+              << ", shared objects: " << cache->GetNumberOfObjects()
+              << ", hits: " << cache->GetNumberOfHits()
+              << ", misses: " << cache->GetNumberOfMisses() << std::endl;
+    if( cache->GetNumberOfObjects() < 3
+      || cache->GetNumberOfMisses() != cache->GetNumberOfObjects()
+      || cache->GetNumberOfHits() < ( numberOfMovingImages - 1 ) * cache->GetNumberOfObjects() )
+    {
+      std::cerr << "ERROR: the fixed-side results should be computed once, and shared." << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  /** The registrations do not depend on each other. */
+  for( unsigned int i = 0; i < numberOfMovingImages; ++i )
+  {
+    const ParameterValuesType & serial     = results[ 0 ][ i ].back()[ "TransformParameters" ];
+    const ParameterValuesType & concurrent = results[ 1 ][ i ].back()[ "TransformParameters" ];
+    std::cout << "Moving image " << i << ": " << serial[ 0 ] << " " << serial[ 1 ] << std::endl;
+    if( serial != concurrent )
+    {
+      std::cerr << "ERROR: the concurrent registration of moving image " << i
+                << " gives " << concurrent[ 0 ] << " " << concurrent[ 1 ]
+                << ", whereas the serial one gives " << serial[ 0 ] << " " << serial[ 1 ]
+                << "." << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  /** Repeat the concurrent registrations with two threads each, so that
+   * every context starts the workers of its thread pool and uses them right
+   * away. The sums in the metric are then computed in another order, so
+   * compare with the serial result within a tolerance.
+   */
+  itk::MultiThreader::SetGlobalDefaultNumberOfThreads( 2 * numberOfMovingImages );
+  const unsigned int numberOfRepeats = 10;
+  const double       tolerance       = 0.1;
+  for( unsigned int repeat = 0; repeat < numberOfRepeats; ++repeat )
+  {
+    ElastixType elastix;
+    const int   error = elastix.RegisterImageBatch( fixedImage.GetPointer(), movingImages,
+      parameterMaps, "", false, false, fixedMask.GetPointer(),
+      std::vector< ElastixType::ImagePointer >(), numberOfMovingImages );
+    if( error != 0 )
+    {
+      std::cerr << "ERROR: RegisterImageBatch() returned " << error
+                << " in repeat " << repeat << "." << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    const std::vector< ElastixType::ParameterMapListType > & repeated
+      = elastix.GetBatchTransformParameterMapLists();
+    for( unsigned int i = 0; i < numberOfMovingImages; ++i )
+    {
+      const ParameterValuesType & serial     = results[ 0 ][ i ].back()[ "TransformParameters" ];
+      const ParameterValuesType & concurrent = repeated[ i ].back().find( "TransformParameters" )->second;
+      for( unsigned int d = 0; d < serial.size(); ++d )
+      {
+        const double difference
+          = std::atof( concurrent[ d ].c_str() ) - std::atof( serial[ d ].c_str() );
+        if( std::fabs( difference ) > tolerance )
+        {
+          std::cerr << "ERROR: in repeat " << repeat << ", the concurrent registration of moving image "
+                    << i << " gives " << concurrent[ 0 ] << " " << concurrent[ 1 ]
+                    << ", whereas the serial one gives " << serial[ 0 ] << " " << serial[ 1 ]
+                    << "." << std::endl;
+          return EXIT_FAILURE;
+        }
+      }
+    }
+  }
+  std::cout << "Repeated the concurrent registrations " << numberOfRepeats << " times." << std::endl;
+
+  return EXIT_SUCCESS;
+
+} // end main
@@ -0,0 +1,218 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "itkSharedObjectCache.h"
+#include "itkImageFullSampler.h"
+#include "itkImageMaskSpatialObject2.h"
+#include "itkImageRegionIterator.h"
+#include "itkImageRegionIteratorWithIndex.h"
+#include "itkMultiThreader.h"
+#include "itkSimpleFastMutexLock.h"
+#include "itksys/SystemTools.hxx"
+
+//-------------------------------------------------------------------------------------
+
+/** Two full samplers that sample the same image within the same mask share
+ * their samples through a SharedObjectCache. The second should get exactly
+ * the samples of the first, without computing them, and a modified image
+ * should not be served from the cache. Threads that look up the same key at
+ * the same time should compute the object once, also when the first attempt
+ * fails.
+ */
+
+const unsigned int Dimension = 2;
+typedef itk::Image< float, Dimension >            ImageType;
+typedef itk::Image< unsigned char, Dimension >    MaskImageType;
+typedef itk::ImageMaskSpatialObject2< Dimension > MaskType;
+typedef itk::ImageFullSampler< ImageType >        SamplerType;
+typedef SamplerType::ImageSampleContainerType     SampleContainerType;
+
+/** Sample the image within the mask, with a spatial object of its own. */
+SamplerType::Pointer
+Sample( ImageType * image, MaskImageType * maskImage, itk::SharedObjectCache * cache )
+{
+  MaskType::Pointer mask = MaskType::New();
+  mask->SetImage( maskImage );
+
+  SamplerType::Pointer sampler = SamplerType::New();
+  sampler->SetInput( image );
+  sampler->SetMask( mask );
+  sampler->SetInputImageRegion( image->GetBufferedRegion() );
+  sampler->SetFixedSideCache( cache );
+  sampler->Update();
+  return sampler;
+}
+
+
+/** The threads look up the same keys at the same time. */
+struct ComputeJobType
+{
+  itk::SharedObjectCache * m_Cache;
+  itk::SimpleFastMutexLock m_Mutex;
+  unsigned int             m_NumberOfComputations;
+  unsigned int             m_NumberOfFailures;
+  unsigned int             m_NumberOfWrongObjects;
+};
+
+ITK_THREAD_RETURN_TYPE
+ComputeThreaderCallback( void * arg )
+{
+  itk::MultiThreader::ThreadInfoStruct * infoStruct
+    = static_cast< itk::MultiThreader::ThreadInfoStruct * >( arg );
+  ComputeJobType * job = static_cast< ComputeJobType * >( infoStruct->UserData );
+
+  /** The first computation of the key "fails" fails, as if it threw, and
+   * is tried again. The reservation is released when it goes out of scope.
+   */
+  const char * keys[ 2 ] = { "succeeds", "fails" };
+  for( unsigned int k = 0; k < 2; ++k )
+  {
+    itk::LightObject * object = NULL;
+    while( object == NULL )
+    {
+      itk::SharedObjectCache::Reservation reservation;
+      object = job->m_Cache->FindOrReserve( keys[ k ], reservation );
+      if( object != NULL )
+      {
+        break;
+      }
+
+      /** Take some time, so that the other threads have to wait. */
+      itksys::SystemTools::Delay( 50 );
+      job->m_Mutex.Lock();
+      const bool fail = ( k == 1 && job->m_NumberOfFailures == 0 );
+      if( fail ) { ++job->m_NumberOfFailures; }
+      else { ++job->m_NumberOfComputations; }
+      job->m_Mutex.Unlock();
+      if( !fail )
+      {
+        object = reservation.Insert( MaskImageType::New() );
+      }
+    }
+    if( dynamic_cast< MaskImageType * >( object ) == NULL )
+    {
+      job->m_Mutex.Lock();
+      ++job->m_NumberOfWrongObjects;
+      job->m_Mutex.Unlock();
+    }
+  }
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end ComputeThreaderCallback()
+
+
+/** Check that two sample containers are equal. */
+bool
+Equal( const SampleContainerType * a, const SampleContainerType * b )
+{
+  if( a->Size() != b->Size() ) { return false; }
+  for( unsigned long i = 0; i < a->Size(); ++i )
+  {
+    if( a->ElementAt( i ).m_ImageCoordinates != b->ElementAt( i ).m_ImageCoordinates
+      || a->ElementAt( i ).m_ImageValue != b->ElementAt( i ).m_ImageValue )
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+int
+main( int argc, char * argv[] )
+{
+  /** A ramp image, and a disc mask. */
+  ImageType::RegionType region;
+  ImageType::SizeType   size;
+  size.Fill( 64 );
+  region.SetSize( size );
+
+  ImageType::Pointer image = ImageType::New();
+  image->SetRegions( region );
+  image->Allocate();
+  MaskImageType::Pointer maskImage = MaskImageType::New();
+  maskImage->SetRegions( region );
+  maskImage->Allocate();
+
+  itk::ImageRegionIteratorWithIndex< ImageType > it( image, region );
+  itk::ImageRegionIterator< MaskImageType >      mit( maskImage, region );
+  for( it.GoToBegin(), mit.GoToBegin(); !it.IsAtEnd(); ++it, ++mit )
+  {
+    const double x = it.GetIndex()[ 0 ] - 32.0;
+    const double y = it.GetIndex()[ 1 ] - 32.0;
+    it.Set( static_cast< float >( 2.0 * x + y ) );
+    mit.Set( x * x + y * y < 400.0 ? 1 : 0 );
+  }
+
+  /** Without a cache. */
+  SamplerType::Pointer reference = Sample( image, maskImage, 0 );
+
+  /** The first sampler computes the samples, the second finds them. */
+  itk::SharedObjectCache::Pointer cache  = itk::SharedObjectCache::New();
+  SamplerType::Pointer            first  = Sample( image, maskImage, cache );
+  SamplerType::Pointer            second = Sample( image, maskImage, cache );
+  std::cout << "Samples: " << reference->GetOutput()->Size()
+            << ", cache hits: " << cache->GetNumberOfHits()
+            << ", misses: " << cache->GetNumberOfMisses() << std::endl;
+  if( cache->GetNumberOfObjects() != 1 || cache->GetNumberOfHits() != 1 )
+  {
+    std::cerr << "ERROR: the second sampler should have found the samples of the first." << std::endl;
+    return EXIT_FAILURE;
+  }
+  if( !Equal( reference->GetOutput(), first->GetOutput() )
+    || !Equal( reference->GetOutput(), second->GetOutput() ) )
+  {
+    std::cerr << "ERROR: the shared samples differ from the computed ones." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  /** A modified image gets a key of its own. */
+  image->Modified();
+  SamplerType::Pointer third = Sample( image, maskImage, cache );
+  if( cache->GetNumberOfObjects() != 2 || cache->GetNumberOfHits() != 1 )
+  {
+    std::cerr << "ERROR: the samples of a modified image should not be shared." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  /** Compute two objects in several threads at the same time. */
+  itk::SharedObjectCache::Pointer concurrentCache = itk::SharedObjectCache::New();
+  ComputeJobType                  job;
+  job.m_Cache                = concurrentCache;
+  job.m_NumberOfComputations = 0;
+  job.m_NumberOfFailures     = 0;
+  job.m_NumberOfWrongObjects = 0;
+
+  itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+  threader->SetNumberOfThreads( 8 );
+  threader->SetSingleMethod( ComputeThreaderCallback, &job );
+  threader->SingleMethodExecute();
+
+  std::cout << "Threads: " << threader->GetNumberOfThreads()
+            << ", computations: " << job.m_NumberOfComputations
+            << ", failures: " << job.m_NumberOfFailures << std::endl;
+  if( job.m_NumberOfComputations != 2 || job.m_NumberOfWrongObjects != 0
+    || job.m_NumberOfFailures != 1 || concurrentCache->GetNumberOfObjects() != 2 )
+  {
+    std::cerr << "ERROR: each object should be computed once, and once more after a failure." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+
+} // end main
@@ -0,0 +1,169 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "itkSlabStreamingImageFileWriter.h"
+#include "itkImageFileWriter.h"
+#include "itkImageFileReader.h"
+#include "itkCastImageFilter.h"
+#include "itkImage.h"
+#include "itkVector.h"
+#include "itkImageRegionConstIterator.h"
+#include "itkImageRegionIteratorWithIndex.h"
+
+#include <string>
+
+//-------------------------------------------------------------------------------------
+
+/** Write a deformation field with the itk::ImageFileWriter, and with the
+ * SlabStreamingImageFileWriter in several slabs, which are computed one
+ * at a time by the upstream filter. Both files should contain exactly the
+ * same image.
+ */
+
+const unsigned int Dimension = 3;
+
+typedef itk::Vector< float, Dimension >                           VectorType;
+typedef itk::Image< VectorType, Dimension >                       DeformationFieldType;
+typedef itk::CastImageFilter
+  < DeformationFieldType, DeformationFieldType >                  CastFilterType;
+typedef itk::ImageFileWriter< DeformationFieldType >              WriterType;
+typedef itk::SlabStreamingImageFileWriter< DeformationFieldType > SlabWriterType;
+typedef itk::ImageFileReader< DeformationFieldType >              ReaderType;
+
+//-------------------------------------------------------------------------------------
+
+int
+main( int argc, char * argv[] )
+{
+  /** Check. */
+  if( argc < 3 )
+  {
+    std::cerr << "ERROR: insufficient command line arguments.\n"
+              << "  outputFileNameReference outputFileNameSlabs" << std::endl;
+    return EXIT_FAILURE;
+  }
+  const std::string referenceFileName = argv[ 1 ];
+  const std::string slabsFileName     = argv[ 2 ];
+
+  /** A smooth deformation field with a non-trivial geometry. */
+  DeformationFieldType::RegionType region;
+  DeformationFieldType::SizeType   size;
+  size[ 0 ] = 40;
+  size[ 1 ] = 30;
+  size[ 2 ] = 25;
+  region.SetSize( size );
+  DeformationFieldType::SpacingType spacing;
+  spacing[ 0 ] = 1.0;
+  spacing[ 1 ] = 0.8;
+  spacing[ 2 ] = 2.5;
+  DeformationFieldType::PointType origin;
+  origin[ 0 ] = -10.0;
+  origin[ 1 ] = 5.0;
+  origin[ 2 ] = 3.0;
+
+  DeformationFieldType::Pointer field = DeformationFieldType::New();
+  field->SetRegions( region );
+  field->SetSpacing( spacing );
+  field->SetOrigin( origin );
+  field->Allocate();
+  itk::ImageRegionIteratorWithIndex< DeformationFieldType > it( field, region );
+  for( it.GoToBegin(); !it.IsAtEnd(); ++it )
+  {
+    const DeformationFieldType::IndexType index = it.GetIndex();
+    VectorType                            vector;
+    vector[ 0 ] = 0.1f * index[ 0 ] - 0.05f * index[ 2 ];
+    vector[ 1 ] = 0.01f * index[ 0 ] * index[ 1 ];
+    vector[ 2 ] = -0.2f * index[ 2 ] + 0.3f;
+    it.Set( vector );
+  }
+
+  /** The reference: the ImageFileWriter. */
+  WriterType::Pointer writer = WriterType::New();
+  writer->SetInput( field );
+  writer->SetFileName( referenceFileName.c_str() );
+
+  /** The slabs are computed by a filter, as the deformation field is in transformix. */
+  CastFilterType::Pointer caster = CastFilterType::New();
+  caster->SetInput( field );
+  SlabWriterType::Pointer slabWriter = SlabWriterType::New();
+  slabWriter->SetInput( caster->GetOutput() );
+  slabWriter->SetFileName( slabsFileName.c_str() );
+  slabWriter->SetNumberOfSlabs( 5 );
+
+  try
+  {
+    writer->Update();
+    slabWriter->Update();
+  }
+  catch( itk::ExceptionObject & excp )
+  {
+    std::cerr << "ERROR: caught ITK exception while writing:\n" << excp << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::cout << "Written in " << slabWriter->GetNumberOfWrittenSlabs() << " slabs." << std::endl;
+  if( slabWriter->GetNumberOfWrittenSlabs() < 2 )
+  {
+    std::cerr << "ERROR: the deformation field was not written in slabs." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  /** Read both files back. */
+  ReaderType::Pointer referenceReader = ReaderType::New();
+  referenceReader->SetFileName( referenceFileName.c_str() );
+  ReaderType::Pointer slabsReader = ReaderType::New();
+  slabsReader->SetFileName( slabsFileName.c_str() );
+  try
+  {
+    referenceReader->Update();
+    slabsReader->Update();
+  }
+  catch( itk::ExceptionObject & excp )
+  {
+    std::cerr << "ERROR: caught ITK exception while reading:\n" << excp << std::endl;
+    return EXIT_FAILURE;
+  }
+  const DeformationFieldType * reference = referenceReader->GetOutput();
+  const DeformationFieldType * slabs     = slabsReader->GetOutput();
+
+  /** Compare the geometry and the pixels. */
+  if( reference->GetLargestPossibleRegion() != slabs->GetLargestPossibleRegion()
+    || reference->GetSpacing() != slabs->GetSpacing()
+    || reference->GetOrigin() != slabs->GetOrigin()
+    || reference->GetDirection() != slabs->GetDirection() )
+  {
+    std::cerr << "ERROR: the geometry of the files differs." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  itk::ImageRegionConstIterator< DeformationFieldType > itReference(
+    reference, reference->GetLargestPossibleRegion() );
+  itk::ImageRegionConstIterator< DeformationFieldType > itSlabs(
+    slabs, slabs->GetLargestPossibleRegion() );
+  for( ; !itReference.IsAtEnd(); ++itReference, ++itSlabs )
+  {
+    if( itReference.Get() != itSlabs.Get() )
+    {
+      std::cerr << "ERROR: the files differ at index " << itReference.GetIndex()
+                << ": " << itReference.Get() << " and " << itSlabs.Get() << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  return EXIT_SUCCESS;
+
+} // end main
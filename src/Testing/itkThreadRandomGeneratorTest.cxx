@@ -0,0 +1,134 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "itkThreadRandomGenerator.h"
+#include "itkMultiThreader.h"
+
+#include <vector>
+
+//-------------------------------------------------------------------------------------
+
+/** Several threads draw random numbers concurrently, each from its own
+ * generator, installed as the thread instance. Each thread should get the
+ * sequence of its own seed, as if it ran alone, and the global generator
+ * should not be affected. Without a thread instance, GetInstance() should
+ * give the global generator.
+ */
+
+typedef itk::ThreadRandomGenerator               ThreadRandomGeneratorType;
+typedef ThreadRandomGeneratorType::GeneratorType GeneratorType;
+typedef GeneratorType::IntegerType               SeedType;
+typedef itk::MultiThreader                       ThreaderType;
+typedef ThreaderType::ThreadInfoStruct           ThreadInfoType;
+
+const unsigned int NumberOfThreads = 4;
+const unsigned int NumberOfDraws   = 100000;
+
+struct JobType
+{
+  std::vector< GeneratorType::Pointer > *  m_Generators;
+  std::vector< std::vector< SeedType > > * m_Draws;
+};
+
+/** Install the generator of this thread, and draw from GetInstance(). */
+ITK_THREAD_RETURN_TYPE
+DrawThreaderCallback( void * arg )
+{
+  ThreadInfoType *        infoStruct = static_cast< ThreadInfoType * >( arg );
+  const itk::ThreadIdType threadId   = infoStruct->ThreadID;
+  JobType *               job        = static_cast< JobType * >( infoStruct->UserData );
+
+  ThreadRandomGeneratorType::SetThreadInstance( ( *job->m_Generators )[ threadId ] );
+  std::vector< SeedType > & draws = ( *job->m_Draws )[ threadId ];
+  for( unsigned int i = 0; i < NumberOfDraws; ++i )
+  {
+    draws[ i ] = ThreadRandomGeneratorType::GetInstance()->GetIntegerVariate();
+  }
+  ThreadRandomGeneratorType::SetThreadInstance( NULL );
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end DrawThreaderCallback()
+
+
+int
+main( int argc, char * argv[] )
+{
+  /** Without a thread instance, the global generator is used. */
+  if( ThreadRandomGeneratorType::GetThreadInstance() != NULL
+    || ThreadRandomGeneratorType::GetInstance() != GeneratorType::GetInstance() )
+  {
+    std::cerr << "ERROR: without a thread instance, the global generator should be used." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  /** Create the generators before seeding the global generator, since
+   * creating a generator draws its seed from the global one.
+   */
+  std::vector< GeneratorType::Pointer > generators;
+  for( unsigned int t = 0; t < NumberOfThreads; ++t )
+  {
+    generators.push_back( ThreadRandomGeneratorType::New() );
+    generators[ t ]->Initialize( static_cast< SeedType >( 1000 + t ) );
+  }
+  GeneratorType::GetInstance()->Initialize( 121212 );
+
+  /** Draw concurrently. */
+  std::vector< std::vector< SeedType > > draws( NumberOfThreads,
+    std::vector< SeedType >( NumberOfDraws ) );
+  JobType                                job;
+  job.m_Generators = &generators;
+  job.m_Draws      = &draws;
+
+  ThreaderType::Pointer threader = ThreaderType::New();
+  threader->SetNumberOfThreads( NumberOfThreads );
+  threader->SetSingleMethod( DrawThreaderCallback, &job );
+  threader->SingleMethodExecute();
+
+  /** Each thread should have drawn the sequence of its own seed. */
+  GeneratorType::Pointer reference = ThreadRandomGeneratorType::New();
+  for( unsigned int t = 0; t < NumberOfThreads; ++t )
+  {
+    reference->Initialize( static_cast< SeedType >( 1000 + t ) );
+    for( unsigned int i = 0; i < NumberOfDraws; ++i )
+    {
+      if( draws[ t ][ i ] != reference->GetIntegerVariate() )
+      {
+        std::cerr << "ERROR: thread " << t << " did not draw from its own generator." << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+  }
+
+  /** The global generator should not have been used. */
+  reference->Initialize( 121212 );
+  if( GeneratorType::GetInstance()->GetIntegerVariate() != reference->GetIntegerVariate() )
+  {
+    std::cerr << "ERROR: the threads used the global generator." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  /** The calling thread uses the global generator again. */
+  if( ThreadRandomGeneratorType::GetInstance() != GeneratorType::GetInstance() )
+  {
+    std::cerr << "ERROR: the thread instance leaked into the calling thread." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+
+} // end main
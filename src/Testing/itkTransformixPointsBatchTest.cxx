@@ -0,0 +1,269 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "itkTransformixInputPointFileReader.h"
+#include "itkAdvancedBSplineDeformableTransform.h"
+#include "itkPointSet.h"
+#include "itkMultiThreader.h"
+#include "itkMersenneTwisterRandomVariateGenerator.h"
+
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+//-------------------------------------------------------------------------------------
+
+/** Write the same points to a text and to a binary input point file, and
+ * read both with the TransformixInputPointFileReader; the points should be
+ * exactly the same. Then transform them with a B-spline transform, once
+ * point by point with TransformPoint(), as transformix did before, and once
+ * with TransformPointBatch() on blocks of points that are divided over
+ * several threads, as transformix does now. The results should agree up to
+ * the rounding.
+ */
+
+const unsigned int Dimension = 3;
+
+typedef itk::DefaultStaticMeshTraits
+  < bool, Dimension, Dimension, double >                       MeshTraitsType;
+typedef itk::PointSet< bool, Dimension, MeshTraitsType >       PointSetType;
+typedef itk::TransformixInputPointFileReader< PointSetType >   ReaderType;
+typedef itk::AdvancedBSplineDeformableTransform
+  < double, Dimension, 3 >                                     TransformType;
+typedef TransformType::InputPointType                          PointType;
+typedef itk::Statistics::MersenneTwisterRandomVariateGenerator RandomGeneratorType;
+
+/** The data shared by the threads, as in transformix. */
+struct TransformPointsJobType
+{
+  const TransformType * m_Transform;
+  const PointType *     m_InputPoints;
+  PointType *           m_OutputPoints;
+  itk::SizeValueType    m_NumberOfPoints;
+  itk::SizeValueType    m_BatchSize;
+};
+
+/** Transform the blocks of points of one thread, round-robin. */
+ITK_THREAD_RETURN_TYPE
+TransformPointsThreaderCallback( void * arg )
+{
+  itk::MultiThreader::ThreadInfoStruct * infoStruct
+    = static_cast< itk::MultiThreader::ThreadInfoStruct * >( arg );
+  TransformPointsJobType * job = static_cast< TransformPointsJobType * >( infoStruct->UserData );
+
+  TransformType::SampleBatchType batch;
+  for( itk::SizeValueType first = infoStruct->ThreadID * job->m_BatchSize;
+    first < job->m_NumberOfPoints;
+    first += infoStruct->NumberOfThreads * job->m_BatchSize )
+  {
+    const itk::SizeValueType n = std::min( job->m_BatchSize, job->m_NumberOfPoints - first );
+    job->m_Transform->TransformPointBatch( job->m_InputPoints + first, n, batch );
+    for( itk::SizeValueType s = 0; s < n; ++s )
+    {
+      for( unsigned int d = 0; d < Dimension; ++d )
+      {
+        job->m_OutputPoints[ first + s ][ d ] = batch.m_TransformedPoints[ d * n + s ];
+      }
+    }
+  }
+
+  return ITK_THREAD_RETURN_VALUE;
+
+} // end TransformPointsThreaderCallback()
+
+
+/** Read an input point file. */
+bool
+ReadPoints( const std::string & fileName, bool expectBinary, std::vector< PointType > & points )
+{
+  ReaderType::Pointer reader = ReaderType::New();
+  reader->SetFileName( fileName.c_str() );
+  try
+  {
+    reader->Update();
+  }
+  catch( itk::ExceptionObject & excp )
+  {
+    std::cerr << "ERROR: caught ITK exception while reading " << fileName << ":\n"
+              << excp << std::endl;
+    return false;
+  }
+
+  if( reader->GetPointsAreBinary() != expectBinary || reader->GetPointsAreIndices() )
+  {
+    std::cerr << "ERROR: the format of " << fileName << " is not recognised." << std::endl;
+    return false;
+  }
+
+  const PointSetType::PointsContainer * container = reader->GetOutput()->GetPoints();
+  points.resize( container->Size() );
+  for( unsigned long i = 0; i < container->Size(); ++i )
+  {
+    points[ i ] = container->ElementAt( i );
+  }
+  return true;
+
+} // end ReadPoints()
+
+
+//-------------------------------------------------------------------------------------
+
+int
+main( int argc, char * argv[] )
+{
+  /** Check. */
+  if( argc < 3 )
+  {
+    std::cerr << "ERROR: insufficient command line arguments.\n"
+              << "  textPointFileName binaryPointFileName" << std::endl;
+    return EXIT_FAILURE;
+  }
+  const std::string textFileName   = argv[ 1 ];
+  const std::string binaryFileName = argv[ 2 ];
+
+  /** Random points in the 64 x 64 x 64 domain of the B-spline grid, more
+   * than fit in a few blocks of 1024.
+   */
+  const unsigned long          numberOfPoints = 10000;
+  RandomGeneratorType::Pointer random         = RandomGeneratorType::GetInstance();
+  random->SetSeed( 20161018 );
+  std::vector< PointType > points( numberOfPoints );
+  for( unsigned long i = 0; i < numberOfPoints; ++i )
+  {
+    for( unsigned int d = 0; d < Dimension; ++d )
+    {
+      points[ i ][ d ] = random->GetUniformVariate( 0.0, 63.0 );
+    }
+  }
+
+  /** Write the text file, with full precision. */
+  std::ofstream textFile( textFileName.c_str() );
+  textFile << "point\n" << numberOfPoints << "\n" << std::setprecision( 17 );
+  for( unsigned long i = 0; i < numberOfPoints; ++i )
+  {
+    for( unsigned int d = 0; d < Dimension; ++d )
+    {
+      textFile << points[ i ][ d ] << " ";
+    }
+    textFile << "\n";
+  }
+  textFile.close();
+
+  /** Write the binary file. */
+  std::ofstream binaryFile( binaryFileName.c_str(), std::ios::out | std::ios::binary );
+  const itk::uint32_t dimension        = Dimension;
+  const itk::uint32_t pointsAreIndices = 0;
+  const itk::uint64_t nrOfPoints       = numberOfPoints;
+  binaryFile.write( ReaderType::GetBinaryPointFileSignature(), 8 );
+  binaryFile.write( reinterpret_cast< const char * >( &dimension ), sizeof( dimension ) );
+  binaryFile.write( reinterpret_cast< const char * >( &pointsAreIndices ), sizeof( pointsAreIndices ) );
+  binaryFile.write( reinterpret_cast< const char * >( &nrOfPoints ), sizeof( nrOfPoints ) );
+  for( unsigned long i = 0; i < numberOfPoints; ++i )
+  {
+    for( unsigned int d = 0; d < Dimension; ++d )
+    {
+      const double value = points[ i ][ d ];
+      binaryFile.write( reinterpret_cast< const char * >( &value ), sizeof( value ) );
+    }
+  }
+  binaryFile.close();
+
+  /** Read both files back. */
+  std::vector< PointType > textPoints;
+  std::vector< PointType > binaryPoints;
+  if( !ReadPoints( textFileName, false, textPoints )
+    || !ReadPoints( binaryFileName, true, binaryPoints ) )
+  {
+    return EXIT_FAILURE;
+  }
+  if( textPoints.size() != numberOfPoints || binaryPoints.size() != numberOfPoints )
+  {
+    std::cerr << "ERROR: " << textPoints.size() << " text and " << binaryPoints.size()
+              << " binary points were read instead of " << numberOfPoints << std::endl;
+    return EXIT_FAILURE;
+  }
+  for( unsigned long i = 0; i < numberOfPoints; ++i )
+  {
+    if( textPoints[ i ] != points[ i ] || binaryPoints[ i ] != points[ i ] )
+    {
+      std::cerr << "ERROR: point " << i << " differs between the files: "
+                << textPoints[ i ] << " and " << binaryPoints[ i ] << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  /** A B-spline transform with a grid spacing of 8 and random coefficients. */
+  TransformType::RegionType gridRegion;
+  TransformType::SizeType   gridSize;
+  gridSize.Fill( 64 / 8 + 3 );
+  gridRegion.SetSize( gridSize );
+  TransformType::SpacingType gridSpacing;
+  gridSpacing.Fill( 8.0 );
+  TransformType::OriginType gridOrigin;
+  gridOrigin.Fill( -8.0 );
+
+  TransformType::Pointer transform = TransformType::New();
+  transform->SetGridOrigin( gridOrigin );
+  transform->SetGridSpacing( gridSpacing );
+  transform->SetGridRegion( gridRegion );
+  TransformType::ParametersType parameters( transform->GetNumberOfParameters() );
+  for( unsigned int i = 0; i < parameters.GetSize(); ++i )
+  {
+    parameters[ i ] = random->GetUniformVariate( -2.0, 2.0 );
+  }
+  transform->SetParameters( parameters );
+
+  /** The old path: point by point. */
+  std::vector< PointType > serialPoints( numberOfPoints );
+  for( unsigned long i = 0; i < numberOfPoints; ++i )
+  {
+    serialPoints[ i ] = transform->TransformPoint( binaryPoints[ i ] );
+  }
+
+  /** The new path: blocks of points, divided over the threads. */
+  std::vector< PointType > batchPoints( numberOfPoints );
+  TransformPointsJobType   job;
+  job.m_Transform      = transform;
+  job.m_InputPoints    = &binaryPoints[ 0 ];
+  job.m_OutputPoints   = &batchPoints[ 0 ];
+  job.m_NumberOfPoints = numberOfPoints;
+  job.m_BatchSize      = 1024;
+
+  itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+  threader->SetNumberOfThreads( 4 );
+  threader->SetSingleMethod( TransformPointsThreaderCallback, &job );
+  threader->SingleMethodExecute();
+
+  double maximumDifference = 0.0;
+  for( unsigned long i = 0; i < numberOfPoints; ++i )
+  {
+    maximumDifference = std::max( maximumDifference,
+      serialPoints[ i ].EuclideanDistanceTo( batchPoints[ i ] ) );
+  }
+  std::cout << "Maximum difference between the serial and the batched points: "
+            << maximumDifference << std::endl;
+  if( maximumDifference > 1e-10 )
+  {
+    std::cerr << "ERROR: the batched points differ from the serial points." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+
+} // end main